@@ -0,0 +1,292 @@
+/**
+ * @file all_pairs.cpp
+ * @brief Implements the blocked Floyd-Warshall kernel.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include "all_pairs.h"
+#include "topological_map.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ALL_PAIRS_X86 1
+#include <immintrin.h>
+#else
+#define ALL_PAIRS_X86 0
+#endif
+
+using namespace std;
+
+/// The number of rows and columns in a tile. A tile of distances and predecessors takes 48 KB.
+static const int tile_size = 64;
+
+/// The multiple maps smaller than a tile are padded to, the number of doubles in an AVX-512 register.
+static const int lane_count = 8;
+
+/// The alignment of the matrices, one cache line and one AVX-512 register.
+static const size_t matrix_alignment = 64;
+
+/// Relaxes one tile of the distance matrix through the intermediate nodes of another.
+using TileKernel = void (*)(double* dist, int* pred, int stride, int size, int i0, int j0, int k0);
+
+/**
+ * @brief Relaxes the tile at (i0, j0) through the nodes k0 to k0 + size - 1.
+ *
+ * The inner loop is free of branches, so compilers can vectorise it for any
+ * target. Rows with no path to the intermediate node are skipped.
+ *
+ * @param dist The distance matrix.
+ * @param pred The predecessor matrix.
+ * @param stride The length of a row of either matrix.
+ * @param size The number of rows and columns in the tile, a multiple of lane_count.
+ * @param i0 The first row of the tile.
+ * @param j0 The first column of the tile.
+ * @param k0 The first intermediate node.
+ */
+static void relax_tile_portable(double* dist, int* pred, int stride, int size, int i0, int j0, int k0) {
+    for (int k = k0; k < k0 + size; k++) {
+        const double* dk = dist + (size_t)k * stride;
+        const int* pk = pred + (size_t)k * stride;
+        for (int i = i0; i < i0 + size; i++) {
+            double* di = dist + (size_t)i * stride;
+            int* pi = pred + (size_t)i * stride;
+            const double dik = di[k];
+            if (dik == numeric_limits<double>::infinity()) {
+                continue;
+            }
+            for (int j = j0; j < j0 + size; j++) {
+                const double through = dik + dk[j];
+                const bool shorter = through < di[j];
+                di[j] = shorter ? through : di[j];
+                pi[j] = shorter ? pk[j] : pi[j];
+            }
+        }
+    }
+}
+
+#if ALL_PAIRS_X86
+
+/**
+ * @brief Relaxes a tile as relax_tile_portable does, eight columns at a time with AVX-512.
+ *
+ * A comparison mask selects both the new distances and the predecessors they come with.
+ */
+__attribute__((target("avx512f,avx512vl")))
+static void relax_tile_avx512(double* dist, int* pred, int stride, int size, int i0, int j0, int k0) {
+    for (int k = k0; k < k0 + size; k++) {
+        const double* dk = dist + (size_t)k * stride;
+        const int* pk = pred + (size_t)k * stride;
+        for (int i = i0; i < i0 + size; i++) {
+            double* di = dist + (size_t)i * stride;
+            int* pi = pred + (size_t)i * stride;
+            const double dik = di[k];
+            if (dik == numeric_limits<double>::infinity()) {
+                continue;
+            }
+            const __m512d via = _mm512_set1_pd(dik);
+            for (int j = j0; j < j0 + size; j += 8) {
+                const __m512d through = _mm512_add_pd(via, _mm512_load_pd(dk + j));
+                const __m512d current = _mm512_load_pd(di + j);
+                const __mmask8 shorter = _mm512_cmp_pd_mask(through, current, _CMP_LT_OQ);
+                _mm512_store_pd(di + j, _mm512_mask_mov_pd(current, shorter, through));
+                __m256i* pij = (__m256i*)(pi + j);
+                _mm256_store_si256(pij, _mm256_mask_mov_epi32(_mm256_load_si256(pij), shorter,
+                                                              _mm256_load_si256((const __m256i*)(pk + j))));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Relaxes a tile as relax_tile_portable does, four columns at a time with AVX2.
+ *
+ * The 64-bit lanes of the comparison mask are narrowed to 32 bits to blend the predecessors.
+ */
+__attribute__((target("avx2")))
+static void relax_tile_avx2(double* dist, int* pred, int stride, int size, int i0, int j0, int k0) {
+    const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    for (int k = k0; k < k0 + size; k++) {
+        const double* dk = dist + (size_t)k * stride;
+        const int* pk = pred + (size_t)k * stride;
+        for (int i = i0; i < i0 + size; i++) {
+            double* di = dist + (size_t)i * stride;
+            int* pi = pred + (size_t)i * stride;
+            const double dik = di[k];
+            if (dik == numeric_limits<double>::infinity()) {
+                continue;
+            }
+            const __m256d via = _mm256_set1_pd(dik);
+            for (int j = j0; j < j0 + size; j += 4) {
+                const __m256d through = _mm256_add_pd(via, _mm256_load_pd(dk + j));
+                const __m256d current = _mm256_load_pd(di + j);
+                const __m256d shorter = _mm256_cmp_pd(through, current, _CMP_LT_OQ);
+                _mm256_store_pd(di + j, _mm256_blendv_pd(current, through, shorter));
+                const __m128i narrow = _mm256_castsi256_si128(
+                    _mm256_permutevar8x32_epi32(_mm256_castpd_si256(shorter), low_halves));
+                __m128i* pij = (__m128i*)(pi + j);
+                _mm_store_si128(pij, _mm_blendv_epi8(_mm_load_si128(pij),
+                                                     _mm_load_si128((const __m128i*)(pk + j)), narrow));
+            }
+        }
+    }
+}
+
+#endif
+
+/**
+ * @brief Picks the fastest kernel the processor supports.
+ *
+ * @param name Set to the name of the kernel.
+ * @return The kernel.
+ */
+static TileKernel select_kernel(const char** name) {
+#if ALL_PAIRS_X86
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+        *name = "avx512";
+        return relax_tile_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return relax_tile_avx2;
+    }
+#endif
+    *name = "portable";
+    return relax_tile_portable;
+}
+
+/// The name of the kernel in use, set when it is picked.
+static const char* kernel_name = nullptr;
+
+/**
+ * @brief Returns the kernel in use, picking it on the first call.
+ *
+ * @return The kernel.
+ */
+static TileKernel tile_kernel() {
+    static const TileKernel kernel = select_kernel(&kernel_name);
+    return kernel;
+}
+
+// Implementation of AllPairsDistances class
+
+/**
+ * @brief Frees a matrix.
+ *
+ * @param data The matrix.
+ */
+void AllPairsDistances::AlignedDelete::operator()(void* data) const {
+    ::operator delete[](data, align_val_t(matrix_alignment));
+}
+
+/**
+ * @brief Computes every shortest path with a blocked Floyd-Warshall.
+ *
+ * The matrices are padded to whole tiles with unreachable nodes, which
+ * never shorten a path, so every tile is full and the kernels need no
+ * remainder loops. A map smaller than a tile is one tile of its own size,
+ * padded only to a whole vector. For each block of intermediate nodes the tile on the
+ * diagonal is relaxed first, then the tiles in its row and column, which
+ * depend only on it, and then every other tile, which depends only on those.
+ *
+ * @param adjacency The edges of the map.
+ */
+AllPairsDistances::AllPairsDistances(const CsrAdjacency& adjacency):
+    _num_nodes(adjacency.NumNodes()),
+    _stride(adjacency.NumNodes() <= tile_size ?
+            (adjacency.NumNodes() + lane_count - 1) / lane_count * lane_count :
+            (adjacency.NumNodes() + tile_size - 1) / tile_size * tile_size) {
+    const size_t cells = (size_t)_stride * _stride;
+    _dist.reset(static_cast<double*>(::operator new[](cells * sizeof(double), align_val_t(matrix_alignment))));
+    _pred.reset(static_cast<int*>(::operator new[](cells * sizeof(int), align_val_t(matrix_alignment))));
+    for (size_t cell = 0; cell < cells; cell++) {
+        _dist[cell] = numeric_limits<double>::infinity();
+        _pred[cell] = -1;
+    }
+
+    for (int u = 0; u < _num_nodes; u++) {
+        _dist[(size_t)u * _stride + u] = 0;
+        for (const Edge& edge : adjacency.EdgesOf(u)) {
+            double& dist = _dist[(size_t)u * _stride + edge.target];
+            if (edge.distance < dist) {
+                dist = edge.distance;
+                _pred[(size_t)u * _stride + edge.target] = u;
+            }
+        }
+    }
+
+    const TileKernel relax_tile = tile_kernel();
+    const int size = min(_stride, tile_size);
+    const int num_tiles = (size == 0) ? 0 : _stride / size;
+    double* dist = _dist.get();
+    int* pred = _pred.get();
+    for (int kb = 0; kb < num_tiles; kb++) {
+        const int k0 = kb * size;
+        relax_tile(dist, pred, _stride, size, k0, k0, k0);
+        for (int b = 0; b < num_tiles; b++) {
+            if (b != kb) {
+                relax_tile(dist, pred, _stride, size, k0, b * size, k0);
+                relax_tile(dist, pred, _stride, size, b * size, k0, k0);
+            }
+        }
+        for (int ib = 0; ib < num_tiles; ib++) {
+            for (int jb = 0; jb < num_tiles; jb++) {
+                if (ib != kb && jb != kb) {
+                    relax_tile(dist, pred, _stride, size, ib * size, jb * size, k0);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Returns the number of nodes.
+ *
+ * @return The number of nodes.
+ */
+int AllPairsDistances::NumNodes() const { return _num_nodes; }
+
+/**
+ * @brief Returns the shortest distance from one node to another.
+ *
+ * @param source The node to start from.
+ * @param target The node to reach.
+ * @return The distance, or infinity if the target is unreachable.
+ */
+double AllPairsDistances::Distance(int source, int target) const {
+    return _dist[(size_t)source * _stride + target];
+}
+
+/**
+ * @brief Returns the node before the target on the shortest path from the source.
+ *
+ * @param source The node to start from.
+ * @param target The node to reach.
+ * @return The predecessor, or -1 if the target is the source or is unreachable.
+ */
+int AllPairsDistances::Predecessor(int source, int target) const {
+    return _pred[(size_t)source * _stride + target];
+}
+
+/**
+ * @brief Returns the shortest path tree of a source.
+ *
+ * @param source The source of the tree.
+ * @return The tree, read from the source's rows of the matrices.
+ */
+ShortestPathTree AllPairsDistances::Tree(int source) const {
+    const double* dist = _dist.get() + (size_t)source * _stride;
+    const int* pred = _pred.get() + (size_t)source * _stride;
+    return ShortestPathTree(source, vector<double>(dist, dist + _num_nodes), vector<int>(pred, pred + _num_nodes));
+}
+
+/**
+ * @brief Returns the instruction set the kernel runs on.
+ *
+ * @return "avx512", "avx2" or "portable".
+ */
+const char* AllPairsDistances::KernelName() {
+    tile_kernel();
+    return kernel_name;
+}
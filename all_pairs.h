@@ -0,0 +1,61 @@
+/**
+ * @file all_pairs.h
+ * @brief Defines a blocked Floyd-Warshall kernel computing every shortest path of a small dense map.
+ */
+#ifndef ALL_PAIRS_H
+#define ALL_PAIRS_H
+
+#include <memory>
+#include "shortest_path.h"
+
+class CsrAdjacency;
+
+/// The shortest path distances and predecessors between every pair of nodes, found by Floyd-Warshall.
+/// The matrices are flat, 64-byte aligned and padded to whole tiles, and are relaxed tile by tile
+/// so each step works on blocks that stay in cache. The inner min(d[i][j], d[i][k] + d[k][j]) loop
+/// runs on AVX-512 or AVX2 when the processor has them, chosen at run time, and on portable code
+/// otherwise. The cost is O(n^3) time and O(n^2) memory whatever the number of edges, so this
+/// suits small dense districts, where it beats a Dijkstra search from every node.
+class AllPairsDistances {
+public:
+    /// Computes every shortest path.
+    /// \param adjacency The edges of the map.
+    explicit AllPairsDistances(const CsrAdjacency& adjacency);
+
+    /// Returns the number of nodes.
+    int NumNodes() const;
+
+    /// Returns the distance from one node to another, or infinity if it is unreachable.
+    double Distance(int source, int target) const;
+
+    /// Returns the node before the target on the shortest path from the source,
+    /// or -1 if the target is the source or is unreachable.
+    int Predecessor(int source, int target) const;
+
+    /// Returns the shortest path tree of a source, as Dijkstra's search would find it.
+    /// \param source The source of the tree.
+    ShortestPathTree Tree(int source) const;
+
+    /// Returns the instruction set the kernel runs on: "avx512", "avx2" or "portable".
+    static const char* KernelName();
+
+private:
+    /// Releases memory allocated with 64-byte alignment.
+    struct AlignedDelete {
+        void operator()(void* data) const;
+    };
+
+    /// The number of nodes.
+    int _num_nodes;
+
+    /// The length of a matrix row, a whole number of tiles.
+    int _stride;
+
+    /// The distance from each node to each other, row by row.
+    std::unique_ptr<double[], AlignedDelete> _dist;
+
+    /// The predecessor of each node on the path from each other, row by row.
+    std::unique_ptr<int[], AlignedDelete> _pred;
+};
+
+#endif
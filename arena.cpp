@@ -0,0 +1,139 @@
+/**
+ * @file arena.cpp
+ * @brief Implements the monotonic arena.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include "arena.h"
+
+using namespace std;
+
+// Implementation of Arena class
+
+/**
+ * @brief Constructs an empty arena.
+ *
+ * @param chunk_size The size of the first chunk in bytes.
+ */
+Arena::Arena(size_t chunk_size) : _chunk_size(max<size_t>(chunk_size, 64)) {}
+
+/**
+ * @brief Frees every chunk.
+ */
+Arena::~Arena() {
+    for (const Chunk& chunk : _chunks) {
+        ::operator delete(chunk.data);
+    }
+}
+
+/**
+ * @brief Returns the current position.
+ *
+ * @return A mark to pass to Rewind.
+ */
+Arena::Mark Arena::GetMark() const {
+    return Mark{_current, _offset, _used_before};
+}
+
+/**
+ * @brief Releases everything allocated since a mark was taken.
+ *
+ * The chunks filled since the mark are kept and reused by later allocations.
+ *
+ * @param mark A mark taken on this arena.
+ */
+void Arena::Rewind(const Mark& mark) {
+    _current = mark.chunk;
+    _offset = mark.offset;
+    _used_before = mark.used_before;
+}
+
+/**
+ * @brief Releases everything allocated, keeping the chunks.
+ */
+void Arena::Reset() {
+    _current = 0;
+    _offset = 0;
+    _used_before = 0;
+}
+
+/**
+ * @brief Returns the number of bytes handed out since the last reset.
+ *
+ * @return The bytes used, including the unused ends of chunks that were moved past.
+ */
+size_t Arena::BytesUsed() const { return _used_before + _offset; }
+
+/**
+ * @brief Returns the number of bytes held in chunks.
+ *
+ * @return The total size of the chunks.
+ */
+size_t Arena::BytesReserved() const {
+    size_t total = 0;
+    for (const Chunk& chunk : _chunks) {
+        total += chunk.size;
+    }
+    return total;
+}
+
+/**
+ * @brief Returns the arena of the calling thread.
+ *
+ * @return An arena that lives as long as the thread.
+ */
+Arena& Arena::ThreadLocal() {
+    thread_local Arena arena;
+    return arena;
+}
+
+/**
+ * @brief Hands out memory from the current chunk, moving to the next chunk when it is full.
+ *
+ * Chunks kept from before a rewind are reused when large enough. Otherwise a
+ * new chunk, twice the size of the last or large enough for the request, is
+ * inserted after the current one.
+ *
+ * @param bytes The number of bytes.
+ * @param alignment The alignment, a power of two.
+ * @return The memory.
+ */
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    for (;;) {
+        if (_current < _chunks.size()) {
+            const uintptr_t base = reinterpret_cast<uintptr_t>(_chunks[_current].data);
+            const size_t aligned = ((base + _offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+            if (aligned + bytes <= _chunks[_current].size) {
+                _offset = aligned + bytes;
+                return _chunks[_current].data + aligned;
+            }
+        }
+
+        // Chunks are aligned for any fundamental type, so only larger alignments need padding
+        const size_t needed = bytes + (alignment > alignof(max_align_t) ? alignment : 0);
+        const size_t next = _chunks.empty() ? 0 : _current + 1;
+        if (next == _chunks.size() || _chunks[next].size < needed) {
+            const size_t size = max(needed, _chunks.empty() ? _chunk_size : 2 * _chunks.back().size);
+            _chunks.insert(_chunks.begin() + next, Chunk{static_cast<char*>(::operator new(size)), size});
+        }
+        if (next != _current) {
+            _used_before += _chunks[_current].size;
+        }
+        _current = next;
+        _offset = 0;
+    }
+}
+
+/**
+ * @brief Does nothing, as memory is only reclaimed by Rewind and Reset.
+ */
+void Arena::do_deallocate(void*, size_t, size_t) {}
+
+/**
+ * @brief Returns true only for the arena itself, as no other resource can free its memory.
+ */
+bool Arena::do_is_equal(const memory_resource& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file arena.h
+ * @brief Defines a monotonic arena for the scratch memory of queries and planning.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+/// A monotonic memory resource that hands out memory from a few large chunks.
+/// Allocation bumps a pointer and deallocation does nothing. Memory is reclaimed
+/// all at once by rewinding to a mark, which keeps the chunks for the next use, so
+/// after warming up a repeated workload allocates nothing from the system.
+/// Containers draw from an arena through std::pmr, for example std::pmr::vector<int>.
+/// An arena is used by one thread at a time.
+class Arena : public std::pmr::memory_resource {
+public:
+    /// A position in the arena to rewind to.
+    struct Mark {
+        /// The chunk in use.
+        size_t chunk;
+
+        /// The offset of the first free byte in the chunk.
+        size_t offset;
+
+        /// The total size of the chunks before the one in use.
+        size_t used_before;
+    };
+
+    /// Constructor. No memory is reserved until the first allocation.
+    /// \param chunk_size The size of the first chunk in bytes. Later chunks double in size.
+    explicit Arena(size_t chunk_size = 64 * 1024);
+
+    /// Destructor. Frees every chunk.
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /// Returns the current position, to rewind to later.
+    Mark GetMark() const;
+
+    /// Releases everything allocated since a mark was taken, in constant time.
+    /// \param mark A mark taken on this arena, with no rewind to an earlier mark since.
+    void Rewind(const Mark& mark);
+
+    /// Releases everything allocated, in constant time, keeping the chunks.
+    void Reset();
+
+    /// Returns the number of bytes handed out since the last reset, counting the unused ends of full chunks.
+    size_t BytesUsed() const;
+
+    /// Returns the number of bytes held in chunks.
+    size_t BytesReserved() const;
+
+    /// Returns the arena of the calling thread, used for the scratch memory of planning.
+    static Arena& ThreadLocal();
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    /// A block of memory allocated from the system.
+    struct Chunk {
+        /// The start of the block.
+        char* data;
+
+        /// The size of the block in bytes.
+        size_t size;
+    };
+
+    /// The chunks, in the order they are filled.
+    std::vector<Chunk> _chunks;
+
+    /// The chunk allocations are made from.
+    size_t _current = 0;
+
+    /// The offset of the first free byte in the current chunk.
+    size_t _offset = 0;
+
+    /// The total size of the chunks before the current one.
+    size_t _used_before = 0;
+
+    /// The size of the first chunk.
+    size_t _chunk_size;
+};
+
+/// Rewinds an arena when it goes out of scope, releasing everything allocated within the scope.
+/// Scopes may nest, such as when a thread pool runs a job while its caller waits.
+class ArenaScope {
+public:
+    /// Marks the current position of an arena.
+    explicit ArenaScope(Arena& arena) : _arena(arena), _mark(arena.GetMark()) {}
+
+    /// Rewinds the arena to the mark.
+    ~ArenaScope() { _arena.Rewind(_mark); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    /// The arena rewound.
+    Arena& _arena;
+
+    /// The position rewound to.
+    Arena::Mark _mark;
+};
+
+#endif
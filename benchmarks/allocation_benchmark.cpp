@@ -0,0 +1,91 @@
+/**
+ * @file allocation_benchmark.cpp
+ * @brief Counts the heap allocations made while performing a day of tasks on a large map.
+ *
+ * Build with the project's CMake build, for example:
+ * <pre>cmake --build build --target allocation_benchmark</pre>
+ *
+ * The day is performed once to fill the shortest path tree cache, then again
+ * with allocation counting switched on. An allocation is graph-sized if it is
+ * at least as large as one int per node. The programme exits with status 1 if
+ * the counted day made any graph-sized allocation.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "../task_queue.h"
+
+using namespace std;
+
+/// True while allocations are being counted.
+static atomic<bool> counting(false);
+
+/// The number of allocations counted.
+static atomic<long long> num_allocations(0);
+
+/// The total number of bytes allocated while counting.
+static atomic<long long> num_bytes(0);
+
+/// The number of counted allocations of at least graph_sized_bytes.
+static atomic<long long> num_graph_sized(0);
+
+/// The allocation size from which an allocation counts as graph-sized.
+static size_t graph_sized_bytes = 0;
+
+void* operator new(size_t size) {
+    if (counting) {
+        num_allocations++;
+        num_bytes += size;
+        if (size >= graph_sized_bytes) {
+            num_graph_sized++;
+        }
+    }
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+/**
+ * @brief Builds a large map, performs one day twice and reports the allocations of the second run.
+ *
+ * @return 0 if the counted day made no graph-sized allocation, 1 otherwise.
+ */
+int main() {
+    const int num_nodes = 100000;
+    const int num_houses_ordering = 60;
+    const Robot robot(101, 3);
+
+    Graph graph = Graph::FromEdgeList(num_nodes, generate_edge_list(num_nodes, 2e-5, 0));
+    graph.SetDistanceCacheCapacity(num_houses_ordering + 1);
+    for (int i=1; i<=num_houses_ordering; i++) {
+        graph.SetNumOrders(i * (num_nodes / (num_houses_ordering + 1)), 1 + i % 2);
+    }
+    vector<pair<int, int>> orders = graph.GetOrderList();
+    graph_sized_bytes = num_nodes * sizeof(int);
+
+    NullReportSink no_report;
+
+    // Warm up: fills the tree cache with the source of every leg
+    TaskQueue warm_up(orders, robot);
+    warm_up.PerformTasks(graph, no_report);
+
+    counting = true;
+    TaskQueue day(orders, robot);
+    day.PerformTasks(graph, no_report);
+    counting = false;
+
+    printf("{\"nodes\": %d, \"edges\": %d, \"orders\": %d, \"allocations\": %lld, "
+           "\"bytes\": %lld, \"graph_sized_allocations\": %lld}\n",
+           graph.NumNodes(), graph.NumEdges(), (int)orders.size(),
+           num_allocations.load(), num_bytes.load(), num_graph_sized.load());
+
+    return num_graph_sized > 0 ? 1 : 0;
+}
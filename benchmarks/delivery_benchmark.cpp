@@ -0,0 +1,328 @@
+/**
+ * @file delivery_benchmark.cpp
+ * @brief Google Benchmark suite for graph construction, routing and task planning.
+ *
+ * Build with the project's CMake build, for example:
+ * <pre>cmake --build build --target delivery_benchmark</pre>
+ *
+ * Most benchmarks sweep the map size and the connectivity passed to
+ * generate_dist_matrix. The connectivity is given in thousandths, so the
+ * arguments 101/100 are a map of 101 nodes with connectivity 0.1. Results are
+ * written as JSON with, for example:
+ * <pre>./delivery_benchmark --benchmark_out=results.json --benchmark_out_format=json</pre>
+ * and two result files can be compared with the compare.py tool shipped
+ * with Google Benchmark.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <benchmark/benchmark.h>
+#include "../all_pairs.h"
+#include "../compact_graph.h"
+#include "../counter_rng.h"
+#include "../schedule.h"
+#include "../static_graph.h"
+#include "../task_queue.h"
+#include "../thread_pool.h"
+
+using namespace std;
+
+/// The connectivity encoded by a benchmark argument in thousandths.
+static double connectivity_arg(const benchmark::State& state) {
+    return state.range(1) / 1000.0;
+}
+
+/// Adds the map arguments swept by every benchmark: node counts and connectivities in thousandths.
+static void map_sizes(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"nodes", "connectivity_milli"});
+    for (int num_nodes : {11, 101, 501, 1001}) {
+        for (int connectivity : {10, 100}) {
+            benchmark->Args({num_nodes, connectivity});
+        }
+    }
+}
+
+/**
+ * @brief Measures building a graph from a distance matrix.
+ *
+ * @param state The benchmark state, with the map size and connectivity as arguments.
+ */
+static void BM_GraphBuild(benchmark::State& state) {
+    const vector<vector<double>> dist_mat = generate_dist_matrix(state.range(0), connectivity_arg(state), 0);
+    for (auto _ : state) {
+        Graph graph(dist_mat);
+        benchmark::DoNotOptimize(graph.NumEdges());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GraphBuild)->Apply(map_sizes);
+
+/**
+ * @brief Measures generating a large random edge list on a pool of threads.
+ *
+ * The edges are the same for every thread count, so the sweep shows the
+ * scaling of the generator alone.
+ *
+ * @param state The benchmark state, with the node count and the number of threads as arguments.
+ */
+static void BM_GenerateEdgeList(benchmark::State& state) {
+    ThreadPool pool(state.range(1));
+    for (auto _ : state) {
+        vector<WeightedEdge> edges = generate_edge_list(state.range(0), 1e-4, 0, &pool);
+        benchmark::DoNotOptimize(edges.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GenerateEdgeList)->ArgNames({"nodes", "threads"})
+    ->Args({100000, 1})->Args({100000, 2})->Args({100000, 4})->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Measures point-to-point ShortestPath queries, reporting latency percentiles.
+ *
+ * Each iteration answers one query between random nodes. The tree cache is
+ * never filled by ShortestPath, so every query runs a search.
+ *
+ * @param state The benchmark state, with the map size and connectivity as arguments.
+ */
+static void BM_ShortestPath(benchmark::State& state) {
+    const int num_nodes = state.range(0);
+    const Graph graph(generate_dist_matrix(num_nodes, connectivity_arg(state), 0));
+    CounterRng rng(1, 0);
+    vector<double> latencies;
+    for (auto _ : state) {
+        int source = rng.Below(num_nodes);
+        int target = rng.Below(num_nodes);
+        auto start = chrono::steady_clock::now();
+        benchmark::DoNotOptimize(graph.ShortestPath(source, target, 0));
+        latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies[min(latencies.size() - 1, (size_t)(p * latencies.size()))];
+    };
+    state.counters["p50_us"] = percentile(0.50);
+    state.counters["p90_us"] = percentile(0.90);
+    state.counters["p99_us"] = percentile(0.99);
+    state.counters["max_us"] = latencies.back();
+}
+BENCHMARK(BM_ShortestPath)->Apply(map_sizes);
+
+/**
+ * @brief Measures point-to-point queries on a StaticGraph of the demo's size, for comparison with BM_ShortestPath.
+ *
+ * @param state The benchmark state, with the connectivity in thousandths as the argument.
+ */
+static void BM_StaticShortestPath(benchmark::State& state) {
+    const int num_nodes = 11;
+    const StaticGraph<num_nodes> graph = StaticGraph<num_nodes>::FromMatrix(
+        generate_dist_matrix(num_nodes, state.range(0) / 1000.0, 0));
+    CounterRng rng(1, 0);
+    for (auto _ : state) {
+        int source = rng.Below(num_nodes);
+        int target = rng.Below(num_nodes);
+        benchmark::DoNotOptimize(graph.ShortestPath(source, target));
+    }
+}
+BENCHMARK(BM_StaticShortestPath)->ArgName("connectivity_milli")->Arg(10)->Arg(100);
+
+/**
+ * @brief Measures point-to-point queries on a large map stored as a Graph or as a CompactGraph.
+ *
+ * @param state The benchmark state, with the storage as the argument: 0 Graph, 1 float km, 2 integer metres.
+ */
+static void BM_CompactShortestPath(benchmark::State& state) {
+    const int num_nodes = 200000;
+    const Graph graph = Graph::FromEdgeList(num_nodes, generate_edge_list(num_nodes, 2.0 / num_nodes, 0));
+    const CompactGraph<float> km(graph.GetAdjacency());
+    const CompactGraph<uint32_t> metres(graph.GetAdjacency());
+    CounterRng rng(1, 0);
+    for (auto _ : state) {
+        int source = rng.Below(num_nodes);
+        int target = rng.Below(num_nodes);
+        if (state.range(0) == 0) {
+            benchmark::DoNotOptimize(graph.ShortestPath(source, target, 0));
+        }
+        else if (state.range(0) == 1) {
+            benchmark::DoNotOptimize(km.ShortestPath(source, target));
+        }
+        else {
+            benchmark::DoNotOptimize(metres.ShortestPath(source, target));
+        }
+    }
+    const size_t graph_bytes = (size_t)graph.NumEdges() * (sizeof(int) + sizeof(double)) +
+                               (size_t)(num_nodes + 1) * sizeof(int);
+    state.counters["edge_bytes"] = state.range(0) == 0 ? graph_bytes :
+                                   state.range(0) == 1 ? km.MemoryBytes() : metres.MemoryBytes();
+}
+BENCHMARK(BM_CompactShortestPath)->ArgName("storage")->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Measures point-to-point queries on a street grid loaded with its junctions in random order.
+ *
+ * The grid is 300 by 300 junctions 100 m apart. The ids are shuffled, as
+ * they might arrive from a map export, and then optionally renumbered.
+ *
+ * @param state The benchmark state, with the ordering as the argument:
+ *              -1 for none, then breadth first, reverse Cuthill-McKee and Hilbert.
+ */
+static void BM_RenumberedShortestPath(benchmark::State& state) {
+    const int width = 300;
+    const int num_nodes = width * width;
+    CounterRng rng(width, 0);
+    vector<int> shuffled(num_nodes);
+    for (int u = 0; u < num_nodes; u++) {
+        shuffled[u] = u;
+    }
+    for (int u = num_nodes - 1; u > 1; u--) {
+        swap(shuffled[u], shuffled[1 + rng.Below(u)]);
+    }
+    vector<Coordinates> coordinates(num_nodes);
+    vector<WeightedEdge> edges;
+    for (int u = 0; u < num_nodes; u++) {
+        coordinates[shuffled[u]] = Coordinates{0.1 * (u % width), 0.1 * (u / width)};
+        for (int v : {u + 1, u + width}) {
+            if (v >= num_nodes || (v == u + 1 && v % width == 0)) {
+                continue;
+            }
+            double length = 0.1 * (1 + rng.Below(100) / 100.0);
+            edges.push_back(WeightedEdge{shuffled[u], shuffled[v], length});
+            edges.push_back(WeightedEdge{shuffled[v], shuffled[u], length});
+        }
+    }
+    Graph graph = Graph::FromEdgeList(num_nodes, edges);
+    graph.SetCoordinates(coordinates);
+    if (state.range(0) >= 0) {
+        graph.Renumber(static_cast<NodeOrdering>(state.range(0)));
+    }
+    CounterRng queries(1, 0);
+    for (auto _ : state) {
+        int source = graph.InternalId(queries.Below(num_nodes));
+        int target = graph.InternalId(queries.Below(num_nodes));
+        benchmark::DoNotOptimize(graph.ShortestPath(source, target, 0));
+    }
+}
+BENCHMARK(BM_RenumberedShortestPath)->ArgName("ordering")->DenseRange(-1, 2)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Measures building a task queue from a day of orders, with or without a route planner.
+ *
+ * @param state The benchmark state, with the map size, connectivity and 1 to plan with savings as arguments.
+ */
+static void BM_TaskQueueBuild(benchmark::State& state) {
+    Graph graph(generate_dist_matrix(state.range(0), connectivity_arg(state), 0));
+    graph.SetDistanceCacheCapacity(state.range(0));
+    graph.UpdateOrders(1);
+    const vector<pair<int,int>> orders = graph.GetOrderList();
+    const Robot robot(101, 3);
+    const SavingsPlanner planner;
+    if (state.range(2)) {
+        // Fill the tree cache outside the timed loop, as it is on every day but the first
+        TaskQueue warm_up(orders, robot, graph, planner);
+    }
+    for (auto _ : state) {
+        if (state.range(2)) {
+            TaskQueue queue(orders, robot, graph, planner);
+            benchmark::DoNotOptimize(queue.GetTasks().data());
+        }
+        else {
+            TaskQueue queue(orders, robot);
+            benchmark::DoNotOptimize(queue.GetTasks().data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * orders.size());
+}
+BENCHMARK(BM_TaskQueueBuild)->Apply([](benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"nodes", "connectivity_milli", "savings"});
+    for (int num_nodes : {11, 101, 501, 1001}) {
+        for (int connectivity : {10, 100}) {
+            for (int savings : {0, 1}) {
+                benchmark->Args({num_nodes, connectivity, savings});
+            }
+        }
+    }
+});
+
+/**
+ * @brief Measures scheduling a day of timed orders onto a fleet by cheapest feasible insertion.
+ *
+ * The distances between the houses are measured once outside the loop, so
+ * this times the insertion checks and the schedule updates alone.
+ *
+ * @param state The benchmark state, with the number of orders and robots as arguments.
+ */
+static void BM_ScheduleTimedOrders(benchmark::State& state) {
+    const int num_nodes = 5000;
+    const Graph graph = Graph::FromEdgeList(num_nodes, generate_edge_list(num_nodes, 3.0 / num_nodes, 0));
+    CounterRng rng(2, 0);
+    vector<TimedOrder> orders;
+    for (int i = 0; i < state.range(0); i++) {
+        const double earliest = rng.Uniform() * 6;
+        orders.push_back(TimedOrder{1 + rng.Below(num_nodes - 1), 1 + rng.Below(2),
+                                    TimeWindow{earliest, earliest + 0.5 + 2 * rng.Uniform()}});
+    }
+    auto timed = make_shared<const TimedOrders>(orders, graph);
+    int unscheduled = 0;
+    for (auto _ : state) {
+        vector<DaySchedule> days;
+        for (int r = 0; r < state.range(1); r++) {
+            days.emplace_back(Robot(r, 4, 20.0, 0.05), TimeWindow{0, 8}, timed);
+        }
+        unscheduled = schedule_orders(*timed, days).size();
+        benchmark::DoNotOptimize(days.data());
+    }
+    state.counters["unscheduled"] = unscheduled;
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ScheduleTimedOrders)->ArgNames({"orders", "robots"})->Args({50, 2})->Args({200, 4})->Args({500, 8});
+
+/**
+ * @brief Measures precomputing every shortest path tree, by Floyd-Warshall or by a search per node.
+ *
+ * @param state The benchmark state, with the map size, the connectivity and 1 for Floyd-Warshall as arguments.
+ */
+static void BM_PrecomputeDistances(benchmark::State& state) {
+    const Graph graph(generate_dist_matrix(state.range(0), connectivity_arg(state), 0));
+    for (auto _ : state) {
+        Graph copy(graph);
+        copy.SetDistanceCacheCapacity(0);
+        copy.SetAllPairsLimit(state.range(2) ? state.range(0) : 0);
+        copy.PrecomputeDistances();
+        benchmark::DoNotOptimize(copy.DistancesFrom(0));
+    }
+    state.SetLabel(state.range(2) ? AllPairsDistances::KernelName() : "dijkstra");
+}
+BENCHMARK(BM_PrecomputeDistances)->Apply([](benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"nodes", "connectivity_milli", "all_pairs"});
+    for (int num_nodes : {11, 101, 501}) {
+        for (int connectivity : {10, 100}) {
+            for (int all_pairs : {0, 1}) {
+                benchmark->Args({num_nodes, connectivity, all_pairs});
+            }
+        }
+    }
+});
+
+/**
+ * @brief Measures a full day: new orders, a task queue and performing every task.
+ *
+ * Reports go to a NullReportSink, so the time is routing and path
+ * reconstruction rather than console output.
+ *
+ * @param state The benchmark state, with the map size and connectivity as arguments.
+ */
+static void BM_PerformTasksDay(benchmark::State& state) {
+    Graph graph(generate_dist_matrix(state.range(0), connectivity_arg(state), 0));
+    graph.SetDistanceCacheCapacity(state.range(0));
+    const Robot robot(101, 3);
+    NullReportSink no_report;
+    int day = 0;
+    for (auto _ : state) {
+        graph.UpdateOrders(++day);
+        TaskQueue queue(graph.GetOrderList(), robot);
+        queue.PerformTasks(graph, no_report);
+    }
+}
+BENCHMARK(BM_PerformTasksDay)->Apply(map_sizes);
+
+BENCHMARK_MAIN();
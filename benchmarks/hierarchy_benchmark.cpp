@@ -0,0 +1,106 @@
+/**
+ * @file hierarchy_benchmark.cpp
+ * @brief Compares point-to-point query times with and without a contraction hierarchy.
+ *
+ * Build with the project's CMake build, for example:
+ * <pre>cmake --build build --target hierarchy_benchmark</pre>
+ *
+ * The maps are square street grids with random block lengths, standing in for
+ * a city road network. For each size the hierarchy is built, saved and loaded
+ * back, then the same random queries are answered by Dijkstra and by the
+ * hierarchy. One JSON object is printed per map size.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "../counter_rng.h"
+#include "../topological_map.h"
+#include "../contraction_hierarchy.h"
+
+using namespace std;
+
+/**
+ * @brief Builds a street grid with two-way streets between neighbouring junctions.
+ *
+ * @param width The number of junctions along each side.
+ * @param seed The seed for the block lengths.
+ * @return The edges of the grid.
+ */
+static vector<WeightedEdge> street_grid(int width, int seed) {
+    CounterRng rng(seed, 0);
+    vector<WeightedEdge> edges;
+    for (int y=0; y<width; y++) {
+        for (int x=0; x<width; x++) {
+            int u = y * width + x;
+            if (x + 1 < width) {
+                double length = 0.1 + rng.Below(10) / 10.0;
+                edges.push_back(WeightedEdge{u, u + 1, length});
+                edges.push_back(WeightedEdge{u + 1, u, length});
+            }
+            if (y + 1 < width) {
+                double length = 0.1 + rng.Below(10) / 10.0;
+                edges.push_back(WeightedEdge{u, u + width, length});
+                edges.push_back(WeightedEdge{u + width, u, length});
+            }
+        }
+    }
+    return edges;
+}
+
+/**
+ * @brief Answers a fixed set of random queries on a graph.
+ *
+ * @param graph The map.
+ * @param num_queries The number of queries.
+ * @param total Set to the sum of the distances found, to check both methods agree.
+ * @return The mean time per query in microseconds.
+ */
+static double time_queries(const Graph& graph, int num_queries, double& total) {
+    CounterRng rng(1, 0);
+    total = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i=0; i<num_queries; i++) {
+        int source = rng.Below(graph.NumNodes());
+        int target = rng.Below(graph.NumNodes());
+        total += graph.ShortestPath(source, target, 0);
+    }
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / num_queries;
+}
+
+/**
+ * @brief Runs the comparison over several map sizes.
+ *
+ * @return 0 on successful execution, 1 if the two methods disagree.
+ */
+int main() {
+    const int num_queries = 500;
+    const string path = "hierarchy_benchmark.ch";
+
+    for (int width : {50, 100, 200}) {
+        Graph graph = Graph::FromEdgeList(width * width, street_grid(width, width));
+        double dijkstra_total;
+        double dijkstra_us = time_queries(graph, num_queries, dijkstra_total);
+
+        auto start = chrono::steady_clock::now();
+        ContractionHierarchy::Build(graph.GetAdjacency()).Save(path);
+        double build_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        auto hierarchy = make_shared<const ContractionHierarchy>(ContractionHierarchy::Load(path));
+        graph.SetContractionHierarchy(hierarchy);
+
+        double hierarchy_total;
+        double hierarchy_us = time_queries(graph, num_queries, hierarchy_total);
+        printf("{\"nodes\": %d, \"edges\": %d, \"shortcuts\": %d, \"build_s\": %.2f, "
+               "\"dijkstra_us\": %.1f, \"hierarchy_us\": %.1f, \"speedup\": %.1f}\n",
+               graph.NumNodes(), graph.NumEdges(), hierarchy->NumShortcuts(), build_s,
+               dijkstra_us, hierarchy_us, dijkstra_us / hierarchy_us);
+        if (fabs(dijkstra_total - hierarchy_total) > 1e-6 * dijkstra_total) {
+            fprintf(stderr, "Distances differ on %d nodes: %f and %f\n",
+                    graph.NumNodes(), dijkstra_total, hierarchy_total);
+            return 1;
+        }
+    }
+    remove(path.c_str());
+
+    return 0;
+}
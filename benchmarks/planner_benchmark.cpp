@@ -0,0 +1,75 @@
+/**
+ * @file planner_benchmark.cpp
+ * @brief Compares the total distance driven under the greedy and savings route planners.
+ *
+ * Build with the project's CMake build, for example:
+ * <pre>cmake --build build --target planner_benchmark</pre>
+ *
+ * For each map size, connectivity and robot capacity, several days of orders
+ * are planned with both planners. Every trip is measured as a closed tour
+ * from the store. One JSON object is printed per configuration.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include "../task_queue.h"
+
+using namespace std;
+
+/**
+ * @brief Plans a day with a planner and measures it.
+ *
+ * @param planner The planner to use.
+ * @param orders The orders of the day.
+ * @param capacity The carrying capacity of the robot.
+ * @param graph The map.
+ * @param km Incremented by the total length of the planned trips.
+ * @param trips Incremented by the number of planned trips.
+ * @param ms Incremented by the planning time in milliseconds.
+ */
+static void run_planner(const RoutePlanner& planner, const vector<pair<int,int>>& orders, int capacity,
+                        const Graph& graph, double& km, int& trips, double& ms) {
+    auto start = chrono::steady_clock::now();
+    vector<Trip> plan = planner.PlanTrips(orders, capacity, graph);
+    ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    trips += plan.size();
+    for (const Trip& trip : plan) {
+        km += trip_distance(trip, graph);
+    }
+}
+
+/**
+ * @brief Runs the comparison over a grid of configurations.
+ *
+ * @return 0 on successful execution.
+ */
+int main() {
+    const int num_days = 5;
+    const GreedyPlanner greedy;
+    const SavingsPlanner savings;
+
+    for (int num_nodes : {11, 101, 501}) {
+        for (double connectivity : {0.01, 0.1}) {
+            Graph graph(generate_dist_matrix(num_nodes, connectivity, 0));
+            graph.SetDistanceCacheCapacity(num_nodes);
+            for (int capacity : {3, 10}) {
+                double greedy_km = 0, savings_km = 0, greedy_ms = 0, savings_ms = 0;
+                int greedy_trips = 0, savings_trips = 0;
+                for (int day=1; day<=num_days; day++) {
+                    graph.UpdateOrders(day);
+                    vector<pair<int,int>> orders = graph.GetOrderList();
+                    run_planner(greedy, orders, capacity, graph, greedy_km, greedy_trips, greedy_ms);
+                    run_planner(savings, orders, capacity, graph, savings_km, savings_trips, savings_ms);
+                }
+                printf("{\"nodes\": %d, \"connectivity\": %.2f, \"capacity\": %d, \"days\": %d, "
+                       "\"greedy_km\": %.3f, \"savings_km\": %.3f, \"reduction_pct\": %.1f, "
+                       "\"greedy_trips\": %d, \"savings_trips\": %d, \"savings_plan_ms\": %.2f}\n",
+                       num_nodes, connectivity, capacity, num_days, greedy_km, savings_km,
+                       100.0 * (greedy_km - savings_km) / greedy_km, greedy_trips, savings_trips,
+                       savings_ms);
+            }
+        }
+    }
+
+    return 0;
+}
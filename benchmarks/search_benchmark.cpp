@@ -0,0 +1,114 @@
+/**
+ * @file search_benchmark.cpp
+ * @brief Compares the nodes settled and time taken by each point-to-point search mode.
+ *
+ * Build with the project's CMake build, for example:
+ * <pre>cmake --build build --target search_benchmark</pre>
+ *
+ * The maps are square street grids with junctions 100 m apart and streets
+ * up to twice as long as the straight line between them. The same random
+ * queries are answered by Dijkstra, A*, bidirectional Dijkstra and ALT with
+ * eight landmarks. One JSON object is printed per map size and mode.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "../counter_rng.h"
+#include "../topological_map.h"
+
+using namespace std;
+
+/**
+ * @brief Runs a fixed set of random queries with one search mode.
+ *
+ * @param name The name of the mode, for the output.
+ * @param graph The map.
+ * @param num_queries The number of queries.
+ * @param search Runs one query and returns its distance and the number of nodes it settled.
+ * @return The sum of the distances found, to check the modes agree.
+ */
+template <typename Search>
+static double run_mode(const char* name, const Graph& graph, int num_queries, Search search) {
+    CounterRng rng(1, 0);
+    double total = 0;
+    long settled = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i=0; i<num_queries; i++) {
+        int source = rng.Below(graph.NumNodes());
+        int target = rng.Below(graph.NumNodes());
+        int query_settled = 0;
+        total += search(source, target, query_settled);
+        settled += query_settled;
+    }
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / num_queries;
+    printf("{\"nodes\": %d, \"mode\": \"%s\", \"settled\": %.0f, \"query_us\": %.1f}\n",
+           graph.NumNodes(), name, (double)settled / num_queries, us);
+    return total;
+}
+
+/**
+ * @brief Runs the comparison over several map sizes.
+ *
+ * @return 0 on successful execution, 1 if the modes disagree.
+ */
+int main() {
+    const int num_queries = 200;
+
+    for (int width : {50, 100, 200}) {
+        CounterRng rng(width, 0);
+        vector<Coordinates> coordinates;
+        for (int y=0; y<width; y++) {
+            for (int x=0; x<width; x++) {
+                coordinates.push_back(Coordinates{0.1 * x, 0.1 * y});
+            }
+        }
+        vector<WeightedEdge> edges;
+        for (int u=0; u<width * width; u++) {
+            for (int v : {u + 1, u + width}) {
+                if (v >= width * width || (v == u + 1 && v % width == 0)) {
+                    continue;
+                }
+                double length = 0.1 * (1 + rng.Below(100) / 100.0);
+                edges.push_back(WeightedEdge{u, v, length});
+                edges.push_back(WeightedEdge{v, u, length});
+            }
+        }
+        Graph graph = Graph::FromEdgeList(width * width, edges);
+        const CsrAdjacency& forward = graph.GetAdjacency();
+        const CsrAdjacency backward = forward.Reversed();
+        const EuclideanHeuristic euclidean(forward, coordinates);
+        const LandmarkHeuristic landmarks(forward, backward, 8);
+        ShortestPathEngine engine;
+        BidirectionalEngine bidirectional;
+
+        double dijkstra = run_mode("dijkstra", graph, num_queries, [&](int s, int t, int& settled) {
+            engine.Run(forward, s, t);
+            settled = engine.NumSettled();
+            return engine.Distance(t);
+        });
+        double astar = run_mode("astar", graph, num_queries, [&](int s, int t, int& settled) {
+            engine.Run(forward, s, t, euclidean);
+            settled = engine.NumSettled();
+            return engine.Distance(t);
+        });
+        double both = run_mode("bidirectional", graph, num_queries, [&](int s, int t, int& settled) {
+            bidirectional.Run(forward, backward, s, t);
+            settled = bidirectional.NumSettled();
+            return bidirectional.Distance();
+        });
+        double alt = run_mode("landmarks", graph, num_queries, [&](int s, int t, int& settled) {
+            engine.Run(forward, s, t, landmarks);
+            settled = engine.NumSettled();
+            return engine.Distance(t);
+        });
+        for (double total : {astar, both, alt}) {
+            if (fabs(total - dijkstra) > 1e-6 * dijkstra) {
+                fprintf(stderr, "Search modes disagree on %d nodes\n", graph.NumNodes());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file server_benchmark.cpp
+ * @brief Measures route query throughput of the server against the number of queries in flight.
+ *
+ * Build with the project's CMake build, for example:
+ * <pre>cmake --build build --target server_benchmark</pre>
+ *
+ * A client keeps a fixed number of route queries in flight on one connection,
+ * each from one of a few sources, as when robots at a handful of depots ask for
+ * routes, to random targets on a street grid. The server is run with batches of
+ * up to 1024 queries per source, and with batches of one query as a baseline.
+ * One JSON object is printed per run, with the throughput and the mean number of
+ * queries answered by each search.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "../counter_rng.h"
+#include "../route_server.h"
+#include "../thread_pool.h"
+
+using namespace std;
+
+/**
+ * @brief Builds a street grid with two-way streets between neighbouring junctions.
+ *
+ * @param width The number of junctions along each side.
+ * @return The edges of the grid.
+ */
+static vector<WeightedEdge> street_grid(int width) {
+    CounterRng rng(width, 0);
+    vector<WeightedEdge> edges;
+    for (int u=0; u<width * width; u++) {
+        for (int v : {u + 1, u + width}) {
+            if (v >= width * width || (v == u + 1 && v % width == 0)) {
+                continue;
+            }
+            double length = 0.1 + rng.Below(10) / 10.0;
+            edges.push_back(WeightedEdge{u, v, length});
+            edges.push_back(WeightedEdge{v, u, length});
+        }
+    }
+    return edges;
+}
+
+/**
+ * @brief Sends queries with a fixed number in flight and prints the throughput.
+ *
+ * @param server The server, already serving.
+ * @param port The port it listens on.
+ * @param max_batch The batch limit the server was made with, for the output.
+ * @param in_flight The number of queries kept in flight.
+ * @param num_nodes The number of nodes of the map.
+ */
+static void run(const RouteServer& server, int port, int max_batch, int in_flight, int num_nodes) {
+    const int num_queries = 2000;
+    const int num_sources = 8;
+    RouteClient client(port);
+    CounterRng rng(in_flight, 1);
+    auto send = [&](uint32_t id) {
+        client.SendRoute(id, (int)rng.Below(num_sources) * (num_nodes / num_sources), rng.Below(num_nodes));
+    };
+
+    const uint64_t queries_before = server.Batcher().NumQueries();
+    const uint64_t batches_before = server.Batcher().NumBatches();
+    auto start = chrono::steady_clock::now();
+    int sent = 0;
+    for (; sent < in_flight && sent < num_queries; sent++) {
+        send(sent);
+    }
+    int unreachable = 0;
+    for (int received = 0; received < num_queries; received++) {
+        Reply reply = client.Receive();
+        unreachable += reply.status != ReplyStatus::Ok;
+        if (sent < num_queries) {
+            send(sent++);
+        }
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const uint64_t queries = server.Batcher().NumQueries() - queries_before;
+    const uint64_t batches = server.Batcher().NumBatches() - batches_before;
+    printf("{\"max_batch\": %d, \"in_flight\": %d, \"queries\": %d, \"failed\": %d, \"queries_per_s\": %.0f, "
+           "\"mean_batch\": %.2f}\n", max_batch, in_flight, num_queries, unreachable, num_queries / seconds,
+           batches == 0 ? 0.0 : (double)queries / batches);
+}
+
+/**
+ * @brief Runs the server with and without batching for several numbers of queries in flight.
+ *
+ * @return 0 on successful execution.
+ */
+int main() {
+    const int width = 100;
+    VersionedGraph graph(Graph::FromEdgeList(width * width, street_grid(width)));
+    ThreadPool pool;
+
+    for (int max_batch : {1, 1024}) {
+        RouteServer server(graph, pool, max_batch);
+        const int port = server.Listen(0);
+        thread serving([&server]() { server.Serve(); });
+        for (int in_flight : {1, 4, 16, 64, 256}) {
+            run(server, port, max_batch, in_flight, width * width);
+        }
+        server.Stop();
+        serving.join();
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file streaming_benchmark.cpp
+ * @brief Measures the time from an order arriving to it being placed in a trip.
+ *
+ * Build with the project's CMake build, for example:
+ * <pre>cmake --build build --target streaming_benchmark</pre>
+ *
+ * A street grid with a contraction hierarchy stands in for a city. Several
+ * customer threads submit orders at random intervals while the planner's
+ * background thread places them, and the robot leaves with the oldest trip
+ * whenever enough trips are waiting. One JSON object is printed per map size.
+ */
+
+#include <cstdio>
+#include <random>
+#include "../counter_rng.h"
+#include "../order_stream.h"
+#include "../contraction_hierarchy.h"
+
+using namespace std;
+
+/**
+ * @brief Builds a street grid with two-way streets between neighbouring junctions.
+ *
+ * @param width The number of junctions along each side.
+ * @return The edges of the grid.
+ */
+static vector<WeightedEdge> street_grid(int width) {
+    CounterRng rng(width, 0);
+    vector<WeightedEdge> edges;
+    for (int u=0; u<width * width; u++) {
+        for (int v : {u + 1, u + width}) {
+            if (v >= width * width || (v == u + 1 && v % width == 0)) {
+                continue;
+            }
+            double length = 0.1 + rng.Below(10) / 10.0;
+            edges.push_back(WeightedEdge{u, v, length});
+            edges.push_back(WeightedEdge{v, u, length});
+        }
+    }
+    return edges;
+}
+
+/**
+ * @brief Streams a day of orders through the planner for several map sizes.
+ *
+ * @return 0 on successful execution, 1 if a trip exceeds the robot's capacity.
+ */
+int main() {
+    const int num_customers = 4;
+    const int orders_per_customer = 250;
+    const int trips_waiting_before_leaving = 4;
+    const Robot robot(101, 6);
+
+    for (int width : {50, 100}) {
+        Graph graph = Graph::FromEdgeList(width * width, street_grid(width));
+        graph.SetContractionHierarchy(
+            make_shared<const ContractionHierarchy>(ContractionHierarchy::Build(graph.GetAdjacency())));
+
+        StreamingPlanner planner(robot, graph);
+        planner.Start();
+        atomic<int> customers_done{0};
+        vector<thread> customers;
+        for (int c=0; c<num_customers; c++) {
+            customers.emplace_back([&planner, &graph, &customers_done, c]() {
+                mt19937 rng(c);
+                for (int i=0; i<orders_per_customer; i++) {
+                    planner.Submit(1 + rng() % (graph.NumNodes() - 1), 1 + rng() % 2);
+                    this_thread::sleep_for(chrono::microseconds(rng() % 2000));
+                }
+                customers_done++;
+            });
+        }
+
+        int trips = 0, packages = 0;
+        bool over_capacity = false;
+        auto leave = [&]() {
+            Trip trip = planner.DispatchNextTrip();
+            int load = 0;
+            for (const auto& order : trip) {
+                load += order.second;
+            }
+            over_capacity |= load > robot.GetCarryingCapacity();
+            packages += load;
+            trips += !trip.empty();
+        };
+        while (customers_done < num_customers) {
+            if ((int)planner.GetQueuedTasks().size() >= trips_waiting_before_leaving) {
+                leave();
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        for (auto& customer : customers) {
+            customer.join();
+        }
+        planner.Stop();
+        while (!planner.GetQueuedTasks().empty()) {
+            leave();
+        }
+
+        StreamStats stats = planner.Stats();
+        printf("{\"nodes\": %d, \"orders\": %d, \"packages\": %d, \"trips\": %d, "
+               "\"mean_latency_ms\": %.3f, \"max_latency_ms\": %.3f}\n",
+               graph.NumNodes(), stats.num_orders, packages, trips,
+               stats.mean_latency_ms, stats.max_latency_ms);
+        if (over_capacity) {
+            fprintf(stderr, "A trip exceeded the robot's capacity\n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
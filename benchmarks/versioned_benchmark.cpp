@@ -0,0 +1,151 @@
+/**
+ * @file versioned_benchmark.cpp
+ * @brief Measures query latency while orders and traffic are applied to the map.
+ *
+ * Build with the project's CMake build, for example:
+ * <pre>cmake --build build --target versioned_benchmark</pre>
+ *
+ * Reader threads answer random point-to-point queries on a street grid while
+ * a writer thread draws new orders and changes the length of random streets.
+ * The graph is shared either behind a readers-writer lock, with the writer
+ * changing it in place, or as a VersionedGraph, with the writer publishing
+ * new versions. One JSON object is printed per mode, with the latency
+ * percentiles of the queries and the number of updates applied.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <shared_mutex>
+#include <thread>
+#include "../counter_rng.h"
+#include "../versioned_graph.h"
+
+using namespace std;
+
+/**
+ * @brief Builds a street grid with two-way streets between neighbouring junctions.
+ *
+ * @param width The number of junctions along each side.
+ * @return The edges of the grid.
+ */
+static vector<WeightedEdge> street_grid(int width) {
+    CounterRng rng(width, 0);
+    vector<WeightedEdge> edges;
+    for (int u=0; u<width * width; u++) {
+        for (int v : {u + 1, u + width}) {
+            if (v >= width * width || (v == u + 1 && v % width == 0)) {
+                continue;
+            }
+            double length = 0.1 + rng.Below(10) / 10.0;
+            edges.push_back(WeightedEdge{u, v, length});
+            edges.push_back(WeightedEdge{v, u, length});
+        }
+    }
+    return edges;
+}
+
+/**
+ * @brief Draws a batch of changes to the lengths of random streets.
+ *
+ * @param graph The map, whose edges the changes keep to.
+ * @param rng The random stream to draw from.
+ * @return Ten changes, each to one direction of a street.
+ */
+static vector<WeightedEdge> traffic(const Graph& graph, CounterRng& rng) {
+    const CsrAdjacency& adjacency = graph.GetAdjacency();
+    vector<WeightedEdge> updates;
+    for (int i=0; i<10; i++) {
+        const int u = rng.Below(graph.NumNodes());
+        const int e = adjacency.Offsets()[u] + rng.Below(adjacency.Offsets()[u + 1] - adjacency.Offsets()[u]);
+        updates.push_back(WeightedEdge{u, adjacency.Targets()[e], 0.1 + rng.Below(20) / 10.0});
+    }
+    return updates;
+}
+
+/**
+ * @brief Runs readers against a writer for a fixed time and prints the query latencies.
+ *
+ * @param name The name of the mode, for the output.
+ * @param num_nodes The number of nodes of the map.
+ * @param query Answers one query between two nodes.
+ * @param update Applies one batch of orders and traffic, drawing from the stream it is given.
+ */
+template <typename Query, typename Update>
+static void run_mode(const char* name, int num_nodes, Query query, Update update) {
+    const int num_readers = 2;
+    const auto end = chrono::steady_clock::now() + chrono::seconds(1);
+    vector<vector<double>> latencies(num_readers);
+    vector<thread> readers;
+    for (int r=0; r<num_readers; r++) {
+        readers.emplace_back([&, r]() {
+            CounterRng rng(r, 1);
+            while (chrono::steady_clock::now() < end) {
+                const int source = rng.Below(num_nodes);
+                const int target = rng.Below(num_nodes);
+                auto start = chrono::steady_clock::now();
+                query(source, target);
+                latencies[r].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+            }
+        });
+    }
+    int updates = 0;
+    CounterRng rng(0, 2);
+    while (chrono::steady_clock::now() < end) {
+        update(rng, updates);
+        updates++;
+        this_thread::sleep_for(chrono::milliseconds(2));
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    vector<double> all;
+    for (const auto& reader : latencies) {
+        all.insert(all.end(), reader.begin(), reader.end());
+    }
+    sort(all.begin(), all.end());
+    auto percentile = [&all](double p) { return all.empty() ? 0.0 : all[(size_t)(p * (all.size() - 1))]; };
+    printf("{\"mode\": \"%s\", \"queries\": %zu, \"updates\": %d, \"p50_ms\": %.3f, \"p99_ms\": %.3f, "
+           "\"max_ms\": %.3f}\n", name, all.size(), updates, percentile(0.5), percentile(0.99), percentile(1.0));
+}
+
+/**
+ * @brief Compares a locked graph with a versioned one.
+ *
+ * @return 0 on successful execution.
+ */
+int main() {
+    const int width = 100;
+    const Graph initial = Graph::FromEdgeList(width * width, street_grid(width));
+
+    Graph locked = initial;
+    shared_mutex lock;
+    run_mode("locked", initial.NumNodes(),
+             [&](int source, int target) {
+                 shared_lock<shared_mutex> read(lock);
+                 locked.ShortestPath(source, target, 0);
+             },
+             [&](CounterRng& rng, int day) {
+                 vector<WeightedEdge> updates = traffic(initial, rng);
+                 unique_lock<shared_mutex> write(lock);
+                 locked.UpdateOrders(day);
+                 locked.UpdateEdges(updates);
+             });
+
+    VersionedGraph versioned(initial);
+    run_mode("versioned", initial.NumNodes(),
+             [&](int source, int target) {
+                 VersionedGraph::ReadGuard graph = versioned.Read();
+                 graph->ShortestPath(source, target, 0);
+             },
+             [&](CounterRng& rng, int day) {
+                 vector<WeightedEdge> updates = traffic(initial, rng);
+                 versioned.Update([&](Graph& graph) {
+                     graph.UpdateOrders(day);
+                     graph.UpdateEdges(updates);
+                 });
+             });
+
+    return 0;
+}
@@ -0,0 +1,277 @@
+/**
+ * @file compact_graph.h
+ * @brief Defines a read-only map with packed edges and narrow weight and index types, for the largest maps.
+ */
+#ifndef COMPACT_GRAPH_H
+#define COMPACT_GRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "metrics.h"
+#include "route_report.h"
+#include "shortest_path.h"
+#include "topological_map.h"
+
+/// Converts edge lengths in km to and from a weight type.
+/// \tparam Weight double or float for km, or uint32_t for whole metres.
+template <typename Weight>
+struct WeightTraits;
+
+/// Lengths in km as doubles, as Graph stores them.
+template <>
+struct WeightTraits<double> {
+    static double FromKm(double km) { return km; }
+    static double ToKm(double weight) { return weight; }
+};
+
+/// Lengths in km as floats, exact to about 0.1 m on maps up to 1000 km across.
+template <>
+struct WeightTraits<float> {
+    static float FromKm(double km) { return static_cast<float>(km); }
+    static double ToKm(float weight) { return weight; }
+};
+
+/// Lengths in whole metres as fixed-point integers, with the largest value for a closed road.
+template <>
+struct WeightTraits<uint32_t> {
+    static uint32_t FromKm(double km) {
+        const double metres = std::round(km * 1000);
+        const uint32_t closed = std::numeric_limits<uint32_t>::max();
+        return metres >= closed ? closed : static_cast<uint32_t>(metres);
+    }
+    static double ToKm(uint32_t weight) {
+        return weight == std::numeric_limits<uint32_t>::max() ? std::numeric_limits<double>::infinity()
+                                                               : weight / 1000.0;
+    }
+};
+
+/// An edge packed with its length, so a relaxation reads one contiguous record.
+/// With 32-bit weight and index types an edge takes 8 bytes, against the 12 bytes
+/// spread over two arrays that CsrAdjacency uses, and a cache line holds 8 edges.
+template <typename Weight, typename Index>
+struct PackedEdge {
+    /// The ID of the node the edge leads to.
+    Index target;
+
+    /// The length of the edge.
+    Weight length;
+};
+
+/// A read-only copy of a map in compressed sparse row form with packed edges.
+/// Routing over large maps is bound by memory bandwidth, so narrowing the weights to
+/// float or fixed-point metres and the node ids to 32 bits halves the bytes each search
+/// streams through. Searches add up the lengths as doubles, so the only loss is the
+/// rounding of each edge. Build one from a Graph's adjacency for routing and keep the
+/// Graph for updates and planning.
+/// \tparam Weight The type of edge lengths: float, uint32_t metres or double.
+/// \tparam Index The unsigned type of node ids and edge offsets.
+template <typename Weight = float, typename Index = uint32_t>
+class CompactGraph {
+    static_assert(std::is_integral<Index>::value && std::is_unsigned<Index>::value,
+                  "Node ids must be an unsigned integer type");
+
+public:
+    /// The packed edge type.
+    using Edge = PackedEdge<Weight, Index>;
+
+    /// Converts a map's edges.
+    /// \param adjacency The edges, in km.
+    /// \throws std::invalid_argument If the map has more nodes or edges than Index can count.
+    explicit CompactGraph(const CsrAdjacency& adjacency) {
+        const int num_nodes = adjacency.NumNodes();
+        if ((uint64_t)adjacency.NumEdges() > std::numeric_limits<Index>::max() ||
+            (uint64_t)num_nodes > std::numeric_limits<Index>::max()) {
+            throw std::invalid_argument("The map has more nodes or edges than the index type can count");
+        }
+        const int* offsets = adjacency.Offsets();
+        const int* targets = adjacency.Targets();
+        const double* distances = adjacency.Distances();
+        _offsets.resize(num_nodes + 1);
+        _edges.resize(adjacency.NumEdges());
+        for (int u = 0; u <= num_nodes; u++) {
+            _offsets[u] = static_cast<Index>(offsets[u]);
+        }
+        for (int e = 0; e < adjacency.NumEdges(); e++) {
+            _edges[e] = Edge{static_cast<Index>(targets[e]), WeightTraits<Weight>::FromKm(distances[e])};
+        }
+    }
+
+    /// Builds a map from a distance matrix, where 0 means no edge, as Graph does.
+    /// \param dist_matrix The distance matrix, in km.
+    static CompactGraph FromMatrix(const std::vector<std::vector<double>>& dist_matrix) {
+        return CompactGraph(Graph(dist_matrix).GetAdjacency());
+    }
+
+    /// Builds a map from an unordered list of directed edges.
+    /// \param num_nodes The number of nodes.
+    /// \param edges The edges, in km.
+    static CompactGraph FromEdgeList(int num_nodes, const std::vector<WeightedEdge>& edges) {
+        return CompactGraph(CsrAdjacency::FromEdgeList(num_nodes, edges));
+    }
+
+    /// Returns the number of nodes.
+    int NumNodes() const { return (int)_offsets.size() - 1; }
+
+    /// Returns the number of edges.
+    int NumEdges() const { return _edges.size(); }
+
+    /// Returns the first edge leaving a node.
+    const Edge* EdgesBegin(int node) const { return _edges.data() + _offsets[node]; }
+
+    /// Returns the position after the last edge leaving a node.
+    const Edge* EdgesEnd(int node) const { return _edges.data() + _offsets[node + 1]; }
+
+    /// Returns the number of bytes the offsets and edges take.
+    size_t MemoryBytes() const { return _offsets.size() * sizeof(Index) + _edges.size() * sizeof(Edge); }
+
+    /// Computes the shortest distance between two nodes, as Graph::ShortestPath does without output.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    /// \return The distance in km, or -1 if the target cannot be reached.
+    double ShortestPath(int source, int target) const;
+
+    /// Finds the shortest route between two nodes, as Graph::Route does.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    RouteResult Route(int source, int target) const;
+
+private:
+    /// The start position of each node's edges, followed by the number of edges.
+    std::vector<Index> _offsets;
+
+    /// The edges of every node, in node order.
+    std::vector<Edge> _edges;
+};
+
+/// Runs Dijkstra searches over a CompactGraph, reusing its buffers across queries,
+/// as ShortestPathEngine does for CsrAdjacency. Distances are kept in km as doubles.
+/// The distance, predecessor and search mark of a node share one 16-byte record, so
+/// relaxing an edge to a node touches one cache line of search state rather than three.
+/// An engine is not safe to share between threads; give each thread its own.
+template <typename Weight = float, typename Index = uint32_t>
+class CompactSearch {
+public:
+    /// Runs a search from a source node.
+    /// \param graph The map to search.
+    /// \param source The node to start from.
+    /// \param target The node at which the search may stop, or -1 to reach every node.
+    void Run(const CompactGraph<Weight, Index>& graph, int source, int target = -1) {
+        const int num_nodes = graph.NumNodes();
+        if ((int)_nodes.size() < num_nodes) {
+            _nodes.resize(num_nodes, NodeState{0, -1, 0});
+        }
+        if (++_search == 0) {
+            // The counter wrapped around, so old marks could be mistaken for current ones
+            for (NodeState& state : _nodes) {
+                state.reached_in = 0;
+            }
+            _search = 1;
+        }
+        _heap.Reset(num_nodes);
+        _num_settled = 0;
+
+        CounterBatch pushes(Counter::HeapPushes);
+        CounterBatch relaxations(Counter::EdgeRelaxations);
+        _nodes[source] = NodeState{0, -1, _search};
+        _heap.PushOrDecrease(source, 0);
+        pushes.Add(1);
+
+        while (!_heap.Empty()) {
+            const int u = _heap.PopMin();
+            _num_settled++;
+            if (u == target) {
+                break;
+            }
+            const double dist_u = _nodes[u].dist;
+            const typename CompactGraph<Weight, Index>::Edge* end = graph.EdgesEnd(u);
+            relaxations.Add(end - graph.EdgesBegin(u));
+            for (auto edge = graph.EdgesBegin(u); edge != end; ++edge) {
+                NodeState& state = _nodes[edge->target];
+                const double alt = dist_u + WeightTraits<Weight>::ToKm(edge->length);
+                if (state.reached_in != _search || alt < state.dist) {
+                    state = NodeState{alt, u, _search};
+                    _heap.PushOrDecrease(edge->target, alt);
+                    pushes.Add(1);
+                }
+            }
+        }
+        count_metric(Counter::HeapPops, _num_settled);
+    }
+
+    /// Returns the distance from the source to a node in km, or infinity if it was not reached.
+    double Distance(int node) const {
+        return Reached(node) ? _nodes[node].dist : std::numeric_limits<double>::infinity();
+    }
+
+    /// Returns the nodes on the shortest path from the source to a node, or an empty list if it was not reached.
+    /// \param node The node to reach.
+    /// \param path Replaced by the nodes on the path.
+    void Path(int node, std::vector<int>& path) const {
+        path.clear();
+        if (!Reached(node) || std::isinf(_nodes[node].dist)) {
+            return;
+        }
+        for (int u = node; u != -1; u = _nodes[u].prev) {
+            path.push_back(u);
+        }
+        std::reverse(path.begin(), path.end());
+    }
+
+    /// Returns the number of nodes taken off the heap by the last search.
+    int NumSettled() const { return _num_settled; }
+
+private:
+    /// Returns true if the node was reached by the current search.
+    bool Reached(int node) const { return node < (int)_nodes.size() && _nodes[node].reached_in == _search; }
+
+    /// What the search knows of a node, kept together so a relaxation touches one cache line.
+    struct NodeState {
+        /// The tentative distance of the node.
+        double dist;
+
+        /// The predecessor of the node.
+        int prev;
+
+        /// The search in which the node was last reached.
+        unsigned reached_in;
+    };
+
+    /// The heap of nodes waiting to be settled.
+    IndexedHeap _heap;
+
+    /// The state of each node.
+    std::vector<NodeState> _nodes;
+
+    /// The counter of the current search.
+    unsigned _search = 0;
+
+    /// The number of nodes settled by the current search.
+    int _num_settled = 0;
+};
+
+template <typename Weight, typename Index>
+double CompactGraph<Weight, Index>::ShortestPath(int source, int target) const {
+    thread_local CompactSearch<Weight, Index> search;
+    search.Run(*this, source, target);
+    const double dist = search.Distance(target);
+    return std::isinf(dist) ? -1 : dist;
+}
+
+template <typename Weight, typename Index>
+RouteResult CompactGraph<Weight, Index>::Route(int source, int target) const {
+    thread_local CompactSearch<Weight, Index> search;
+    search.Run(*this, source, target);
+    RouteResult route{source, target, search.Distance(target), {}};
+    search.Path(target, route.path);
+    if (route.path.empty()) {
+        route.distance = std::numeric_limits<double>::infinity();
+    }
+    return route;
+}
+
+#endif
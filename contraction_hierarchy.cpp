@@ -0,0 +1,1101 @@
+/**
+ * @file contraction_hierarchy.cpp
+ * @brief Implements contraction hierarchy preprocessing, queries and customisation.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include "contraction_hierarchy.h"
+#include "topological_map.h"
+
+using namespace std;
+
+// Implementation of ContractionHierarchy class
+
+/// An arc of the graph while it is being contracted.
+struct ContractionArc {
+    /// The node at the other end of the arc.
+    int node;
+
+    /// The length of the arc.
+    double weight;
+
+    /// The node a shortcut passes through, or -1 for an original edge.
+    int middle;
+};
+
+/// The most nodes a witness search settles before giving up and keeping the shortcut.
+static const int witness_settle_limit = 200;
+
+/// Scratch space for the bounded searches that look for paths avoiding a node being contracted.
+class WitnessSearch {
+public:
+    /// Constructor.
+    /// \param num_nodes The number of nodes in the graph.
+    explicit WitnessSearch(int num_nodes): _dist(num_nodes), _reached_in(num_nodes, 0) {};
+
+    /// Searches from a source through uncontracted nodes other than the one avoided.
+    /// \param out The outgoing arcs of each node.
+    /// \param source The node to start from.
+    /// \param avoid The node being contracted.
+    /// \param max_dist The distance beyond which witnesses are of no use.
+    void Run(const vector<vector<ContractionArc>>& out, int source, int avoid, double max_dist) {
+        _search++;
+        _heap.Reset(_dist.size());
+        _dist[source] = 0;
+        _reached_in[source] = _search;
+        _heap.PushOrDecrease(source, 0);
+        int settled = 0;
+        while (!_heap.Empty() && settled < witness_settle_limit) {
+            if (_heap.MinKey() > max_dist) {
+                break;
+            }
+            int u = _heap.PopMin();
+            settled++;
+            for (const ContractionArc& arc : out[u]) {
+                if (arc.node == avoid) {
+                    continue;
+                }
+                double alt = _dist[u] + arc.weight;
+                if (_reached_in[arc.node] != _search || alt < _dist[arc.node]) {
+                    _dist[arc.node] = alt;
+                    _reached_in[arc.node] = _search;
+                    _heap.PushOrDecrease(arc.node, alt);
+                }
+            }
+        }
+    }
+
+    /// Returns the best distance found to a node by the last search, or infinity if it was not reached.
+    double Distance(int node) const {
+        return _reached_in[node] == _search ? _dist[node] : numeric_limits<double>::infinity();
+    }
+
+private:
+    /// The heap of nodes waiting to be settled.
+    IndexedHeap _heap;
+
+    /// The tentative distance of each reached node.
+    vector<double> _dist;
+
+    /// The search in which each node was last reached.
+    vector<unsigned> _reached_in;
+
+    /// The counter of the current search.
+    unsigned _search = 0;
+};
+
+/**
+ * @brief Finds the shortcuts needed to contract a node.
+ *
+ * For each pair of arcs u -> v -> x, a witness search from u looks for a path
+ * to x that avoids v and is no longer than the pair. If none is found within
+ * the settle limit, the shortcut u -> x is needed. Without witness searches
+ * every pair needs its shortcut.
+ *
+ * @param v The node to contract.
+ * @param out The outgoing arcs of each uncontracted node.
+ * @param in The incoming arcs of each uncontracted node.
+ * @param witness The scratch space for witness searches, or a null pointer to keep every shortcut.
+ * @param shortcuts If not null, the needed shortcuts are appended here as (tail, head arc) pairs.
+ * @return The number of shortcuts needed.
+ */
+static int find_shortcuts(int v, const vector<vector<ContractionArc>>& out,
+                          const vector<vector<ContractionArc>>& in, WitnessSearch* witness,
+                          vector<pair<int, ContractionArc>>* shortcuts) {
+    int count = 0;
+    for (const ContractionArc& arc_in : in[v]) {
+        const int u = arc_in.node;
+        double max_dist = 0;
+        for (const ContractionArc& arc_out : out[v]) {
+            if (arc_out.node != u) {
+                max_dist = max(max_dist, arc_in.weight + arc_out.weight);
+            }
+        }
+        if (witness != nullptr) {
+            witness->Run(out, u, v, max_dist);
+        }
+        for (const ContractionArc& arc_out : out[v]) {
+            const int x = arc_out.node;
+            const double weight = arc_in.weight + arc_out.weight;
+            if (x == u || (witness != nullptr && witness->Distance(x) <= weight)) {
+                continue;
+            }
+            count++;
+            if (shortcuts != nullptr) {
+                shortcuts->push_back(make_pair(u, ContractionArc{x, weight, v}));
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Adds an arc to an arc list, or shortens the existing arc to the same node.
+ *
+ * @param arcs The arc list.
+ * @param arc The arc to add.
+ * @return True if a new arc was added, false if an existing one was kept or shortened.
+ */
+static bool add_or_shorten(vector<ContractionArc>& arcs, const ContractionArc& arc) {
+    for (ContractionArc& existing : arcs) {
+        if (existing.node == arc.node) {
+            if (arc.weight < existing.weight) {
+                existing = arc;
+            }
+            return false;
+        }
+    }
+    arcs.push_back(arc);
+    return true;
+}
+
+/**
+ * @brief Removes the arc to a node from an arc list.
+ *
+ * @param arcs The arc list.
+ * @param node The node whose arc is removed.
+ */
+static void remove_arc(vector<ContractionArc>& arcs, int node) {
+    for (int i=0; i<(int)arcs.size(); i++) {
+        if (arcs[i].node == node) {
+            arcs[i] = arcs.back();
+            arcs.pop_back();
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Constructs an empty hierarchy with no nodes.
+ */
+ContractionHierarchy::ContractionHierarchy(): _up_offsets(1, 0), _down_offsets(1, 0) {};
+
+/// The largest part that nested dissection orders as it is rather than splitting further.
+static const int dissection_leaf_size = 8;
+
+/**
+ * @brief Orders nodes by nested dissection, for contracting a customisable hierarchy.
+ *
+ * Each part of the map is split by a breadth-first search over its edges in
+ * both directions, from a node found by a second search to lie far out. The
+ * level holding the median node separates the nearer nodes from the farther
+ * ones, since edges only join nodes on neighbouring levels. The separator is
+ * ranked above both halves, which are split in turn. A part that the search
+ * does not cover falls apart into the covered nodes and the rest, with no
+ * separator. Small separators keep the shortcuts of a customisable
+ * hierarchy, which has no witness searches to prune them, close to linear
+ * in the size of road networks.
+ *
+ * @param adjacency The edges of the graph.
+ * @return The rank of each node, with separators of larger parts ranked higher.
+ */
+static vector<int> nested_dissection_order(const CsrAdjacency& adjacency) {
+    const int num_nodes = adjacency.NumNodes();
+    vector<vector<int>> neighbours(num_nodes);
+    for (int u=0; u<num_nodes; u++) {
+        for (const Edge& edge : adjacency.EdgesOf(u)) {
+            if (edge.target != u) {
+                neighbours[u].push_back(edge.target);
+                neighbours[edge.target].push_back(u);
+            }
+        }
+    }
+
+    vector<int> rank(num_nodes, -1);
+    vector<int> part_of(num_nodes, 0), level(num_nodes, -1);
+    int next_low = 0, next_high = num_nodes - 1, next_part = 1;
+    vector<pair<int, vector<int>>> parts;
+    vector<int> all(num_nodes);
+    for (int v=0; v<num_nodes; v++) {
+        all[v] = v;
+    }
+    parts.push_back(make_pair(0, move(all)));
+
+    // Returns the nodes of the part reached from a start node, in breadth-first order
+    auto search = [&](int part, int start) {
+        vector<int> reached(1, start);
+        level[start] = 0;
+        for (int i=0; i<(int)reached.size(); i++) {
+            int u = reached[i];
+            for (int v : neighbours[u]) {
+                if (part_of[v] == part && level[v] == -1) {
+                    level[v] = level[u] + 1;
+                    reached.push_back(v);
+                }
+            }
+        }
+        return reached;
+    };
+    auto clear_levels = [&](const vector<int>& nodes) {
+        for (int v : nodes) {
+            level[v] = -1;
+        }
+    };
+
+    while (!parts.empty()) {
+        const int part = parts.back().first;
+        vector<int> nodes = move(parts.back().second);
+        parts.pop_back();
+        if ((int)nodes.size() <= dissection_leaf_size) {
+            for (int v : nodes) {
+                rank[v] = next_low++;
+            }
+            continue;
+        }
+
+        vector<int> reached = search(part, nodes[0]);
+        const int far = reached.back();
+        clear_levels(reached);
+        reached = search(part, far);
+
+        vector<int> near_half, far_half, separator;
+        if (reached.size() < nodes.size()) {
+            // The part is disconnected: split off what was reached
+            near_half = reached;
+            for (int v : nodes) {
+                if (level[v] == -1) {
+                    far_half.push_back(v);
+                }
+            }
+        }
+        else {
+            const int split = level[reached[reached.size() / 2]];
+            for (int v : reached) {
+                (level[v] < split ? near_half : level[v] == split ? separator : far_half).push_back(v);
+            }
+        }
+        clear_levels(reached);
+
+        for (int v : separator) {
+            rank[v] = next_high--;
+            part_of[v] = -1;
+        }
+        for (vector<int>* half : {&near_half, &far_half}) {
+            if (half->empty()) {
+                continue;
+            }
+            for (int v : *half) {
+                part_of[v] = next_part;
+            }
+            parts.push_back(make_pair(next_part++, move(*half)));
+        }
+    }
+    return rank;
+}
+
+/**
+ * @brief Builds the hierarchy over the edges of a graph.
+ *
+ * Nodes are contracted in order of edge difference (shortcuts added minus
+ * arcs removed) plus the number of already contracted neighbours, which
+ * spreads contraction evenly over the map. Priorities are updated lazily: a
+ * node is re-evaluated when it reaches the top of the queue and put back if
+ * it is no longer the best choice. Parallel edges are reduced to the
+ * shortest one and self-loops are dropped.
+ *
+ * A customisable hierarchy skips the witness searches and contracts nodes
+ * in nested dissection order instead, so its order and arcs depend only on
+ * the structure of the map. This suits road networks with their small
+ * separators, but grows quickly on dense random maps.
+ *
+ * @param adjacency The edges of the graph.
+ * @param customisable True to keep every shortcut, so edge lengths can later change.
+ * @return The hierarchy over the graph.
+ */
+ContractionHierarchy ContractionHierarchy::Build(const CsrAdjacency& adjacency, bool customisable) {
+    const int num_nodes = adjacency.NumNodes();
+    vector<vector<ContractionArc>> out(num_nodes), in(num_nodes);
+    for (int u=0; u<num_nodes; u++) {
+        for (const Edge& edge : adjacency.EdgesOf(u)) {
+            if (edge.target != u) {
+                add_or_shorten(out[u], ContractionArc{edge.target, edge.distance, -1});
+            }
+        }
+    }
+    for (int u=0; u<num_nodes; u++) {
+        for (const ContractionArc& arc : out[u]) {
+            in[arc.node].push_back(ContractionArc{u, arc.weight, -1});
+        }
+    }
+
+    WitnessSearch witness_search(num_nodes);
+    WitnessSearch* witness = customisable ? nullptr : &witness_search;
+    const vector<int> dissection_rank = customisable ? nested_dissection_order(adjacency) : vector<int>();
+    vector<int> contracted_neighbours(num_nodes, 0);
+    auto priority = [&](int v) {
+        if (customisable) {
+            return (double)dissection_rank[v];
+        }
+        int edge_difference = find_shortcuts(v, out, in, witness, nullptr) - (int)in[v].size() - (int)out[v].size();
+        return (double)(edge_difference + contracted_neighbours[v]);
+    };
+
+    typedef pair<double, int> QueueEntry;
+    priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> queue;
+    for (int v=0; v<num_nodes; v++) {
+        queue.push(QueueEntry(priority(v), v));
+    }
+
+    ContractionHierarchy hierarchy;
+    hierarchy._customisable = customisable;
+    hierarchy._rank.assign(num_nodes, -1);
+    hierarchy._num_graph_edges = adjacency.NumEdges();
+    vector<vector<ContractionArc>> up(num_nodes), down(num_nodes);
+    vector<pair<int, ContractionArc>> shortcuts;
+    int next_rank = 0;
+    while (!queue.empty()) {
+        const int v = queue.top().second;
+        queue.pop();
+        if (hierarchy._rank[v] != -1) {
+            continue;
+        }
+        const double current = priority(v);
+        if (!queue.empty() && current > queue.top().first) {
+            queue.push(QueueEntry(current, v));
+            continue;
+        }
+
+        shortcuts.clear();
+        find_shortcuts(v, out, in, witness, &shortcuts);
+        for (const auto& shortcut : shortcuts) {
+            const int u = shortcut.first;
+            const ContractionArc& arc = shortcut.second;
+            add_or_shorten(out[u], arc);
+            add_or_shorten(in[arc.node], ContractionArc{u, arc.weight, arc.middle});
+        }
+
+        // The remaining neighbours of v are all ranked above it
+        hierarchy._rank[v] = next_rank++;
+        up[v] = move(out[v]);
+        down[v] = move(in[v]);
+        for (const ContractionArc& arc : up[v]) {
+            remove_arc(in[arc.node], v);
+            contracted_neighbours[arc.node]++;
+        }
+        for (const ContractionArc& arc : down[v]) {
+            remove_arc(out[arc.node], v);
+            contracted_neighbours[arc.node]++;
+        }
+        out[v].clear();
+        in[v].clear();
+    }
+
+    // Flatten the recorded arcs into compressed sparse row arrays, sorted for FindArc
+    hierarchy._up_offsets.assign(1, 0);
+    hierarchy._down_offsets.assign(1, 0);
+    auto by_node = [](const ContractionArc& a, const ContractionArc& b) { return a.node < b.node; };
+    for (int v=0; v<num_nodes; v++) {
+        sort(up[v].begin(), up[v].end(), by_node);
+        sort(down[v].begin(), down[v].end(), by_node);
+        for (const ContractionArc& arc : up[v]) {
+            hierarchy._up_targets.push_back(arc.node);
+            hierarchy._up_weights.push_back(arc.weight);
+            hierarchy._up_middle.push_back(arc.middle);
+            hierarchy._num_shortcuts += (arc.middle != -1);
+        }
+        for (const ContractionArc& arc : down[v]) {
+            hierarchy._down_sources.push_back(arc.node);
+            hierarchy._down_weights.push_back(arc.weight);
+            hierarchy._down_middle.push_back(arc.middle);
+            hierarchy._num_shortcuts += (arc.middle != -1);
+        }
+        hierarchy._up_offsets.push_back(hierarchy._up_targets.size());
+        hierarchy._down_offsets.push_back(hierarchy._down_sources.size());
+    }
+    if (customisable) {
+        hierarchy.IndexTriangles();
+    }
+
+    return hierarchy;
+}
+
+/**
+ * @brief Recomputes the length of every arc from new edge lengths.
+ *
+ * Each arc is first set to the shortest edge it stands for, if any, then
+ * nodes are visited from the lowest rank up. For a node m, every pair of a
+ * downward arc u -> m and an upward arc m -> x offers u -> m -> x as a
+ * length for the arc u -> x. Arcs around m can only be shortened through
+ * nodes ranked below m, which are all visited before it, so each offer is
+ * final when made. The work is one pass over the triangles of the
+ * hierarchy, with no searches.
+ *
+ * @param adjacency The edges the hierarchy was built from, with their new lengths.
+ * @throws logic_error If the hierarchy was not built as customisable.
+ * @throws invalid_argument If the adjacency has a different number of nodes or edges.
+ */
+void ContractionHierarchy::Customise(const CsrAdjacency& adjacency) {
+    if (!_customisable) {
+        throw logic_error("Contraction hierarchy was not built as customisable");
+    }
+    if (adjacency.NumNodes() != NumNodes() || adjacency.NumEdges() != _num_graph_edges) {
+        throw invalid_argument("Contraction hierarchy does not match the graph");
+    }
+    const double infinity = numeric_limits<double>::infinity();
+    fill(_up_weights.begin(), _up_weights.end(), infinity);
+    fill(_up_middle.begin(), _up_middle.end(), -1);
+    fill(_down_weights.begin(), _down_weights.end(), infinity);
+    fill(_down_middle.begin(), _down_middle.end(), -1);
+    for (int u=0; u<NumNodes(); u++) {
+        for (const Edge& edge : adjacency.EdgesOf(u)) {
+            if (edge.target != u) {
+                int arc = FindArc(u, edge.target);
+                double& weight = _rank[u] < _rank[edge.target] ? _up_weights[arc] : _down_weights[arc];
+                weight = min(weight, edge.distance);
+            }
+        }
+    }
+
+    vector<int> by_rank(NumNodes());
+    for (int v=0; v<NumNodes(); v++) {
+        by_rank[_rank[v]] = v;
+    }
+    _num_shortcuts = 0;
+    for (int m : by_rank) {
+        for (int d = _down_offsets[m]; d < _down_offsets[m + 1]; d++) {
+            const int u = _down_sources[d];
+            for (int e = _up_offsets[m]; e < _up_offsets[m + 1]; e++) {
+                const int x = _up_targets[e];
+                if (x == u) {
+                    continue;
+                }
+                const double through = _down_weights[d] + _up_weights[e];
+                const int arc = FindArc(u, x);
+                const bool upward = _rank[u] < _rank[x];
+                double& weight = upward ? _up_weights[arc] : _down_weights[arc];
+                if (through < weight) {
+                    weight = through;
+                    (upward ? _up_middle : _down_middle)[arc] = m;
+                }
+            }
+        }
+    }
+    for (int middle : _up_middle) {
+        _num_shortcuts += (middle != -1);
+    }
+    for (int middle : _down_middle) {
+        _num_shortcuts += (middle != -1);
+    }
+}
+
+/**
+ * @brief Updates only the arcs that some changed edges reach.
+ *
+ * The arcs standing for the changed edges are recomputed first, each from
+ * its edges and its lower triangles u -> m -> x, found by merging the lower
+ * neighbour lists of its two ends. An arc whose length changed queues every
+ * arc it is a side of, which all have a higher ranked lower end. Arcs are
+ * taken in order of their lower end, so each is recomputed after all of
+ * its sides. Only the part of the hierarchy above the changes is visited.
+ *
+ * @param adjacency The edges the hierarchy was built from, with the changes applied.
+ * @param changes The edges whose lengths changed.
+ * @throws logic_error If the hierarchy was not built as customisable.
+ */
+void ContractionHierarchy::Repair(const CsrAdjacency& adjacency, const vector<WeightChange>& changes) {
+    if (!_customisable) {
+        throw logic_error("Contraction hierarchy was not built as customisable");
+    }
+    const int num_up = _up_targets.size();
+    // Arcs are numbered with upward ones first, then downward ones after num_up
+    typedef pair<int, int> QueuedArc;
+    priority_queue<QueuedArc, vector<QueuedArc>, greater<QueuedArc>> queue;
+    vector<char> queued(num_up + _down_sources.size(), 0);
+    auto push = [&](int from, int to) {
+        const int arc = FindArc(from, to);
+        const bool upward = _rank[from] < _rank[to];
+        const int id = upward ? arc : num_up + arc;
+        if (!queued[id]) {
+            queued[id] = 1;
+            queue.push(QueuedArc(min(_rank[from], _rank[to]), id));
+        }
+    };
+    for (const WeightChange& change : changes) {
+        if (change.source != change.target) {
+            push(change.source, change.target);
+        }
+    }
+
+    // The tail and head of each arc, found from its position
+    auto ends = [&](int id, int& from, int& to) {
+        const bool upward = id < num_up;
+        const int arc = upward ? id : id - num_up;
+        const vector<int>& offsets = upward ? _up_offsets : _down_offsets;
+        const int owner = upper_bound(offsets.begin(), offsets.end(), arc) - offsets.begin() - 1;
+        from = upward ? owner : _down_sources[arc];
+        to = upward ? _up_targets[arc] : owner;
+    };
+
+    while (!queue.empty()) {
+        const int id = queue.top().second;
+        queue.pop();
+        queued[id] = 0;
+        int u, x;
+        ends(id, u, x);
+
+        double weight = numeric_limits<double>::infinity();
+        int middle = -1;
+        for (const Edge& edge : adjacency.EdgesOf(u)) {
+            if (edge.target == x) {
+                weight = min(weight, edge.distance);
+            }
+        }
+        int i = _lower_out.offsets[u], i_end = _lower_out.offsets[u + 1];
+        int j = _lower_in.offsets[x], j_end = _lower_in.offsets[x + 1];
+        while (i < i_end && j < j_end) {
+            if (_lower_out.nodes[i] < _lower_in.nodes[j]) {
+                i++;
+            }
+            else if (_lower_out.nodes[i] > _lower_in.nodes[j]) {
+                j++;
+            }
+            else {
+                const double through = _down_weights[_lower_out.arcs[i]] + _up_weights[_lower_in.arcs[j]];
+                if (through < weight) {
+                    weight = through;
+                    middle = _lower_out.nodes[i];
+                }
+                i++;
+                j++;
+            }
+        }
+
+        const bool upward = id < num_up;
+        double& stored_weight = upward ? _up_weights[id] : _down_weights[id - num_up];
+        int& stored_middle = upward ? _up_middle[id] : _down_middle[id - num_up];
+        _num_shortcuts += (middle != -1) - (stored_middle != -1);
+        stored_middle = middle;
+        if (weight == stored_weight) {
+            continue;
+        }
+        stored_weight = weight;
+        if (upward) {
+            // u -> x is the second side of p -> u -> x for every downward arc p -> u
+            for (int d = _down_offsets[u]; d < _down_offsets[u + 1]; d++) {
+                if (_down_sources[d] != x) {
+                    push(_down_sources[d], x);
+                }
+            }
+        }
+        else {
+            // u -> x is the first side of u -> x -> q for every upward arc x -> q
+            for (int e = _up_offsets[x]; e < _up_offsets[x + 1]; e++) {
+                if (_up_targets[e] != u) {
+                    push(u, _up_targets[e]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Builds the lower neighbour lists used by Repair.
+ *
+ * Nodes are visited in id order as the lower end, so each list comes out
+ * sorted by lower node.
+ */
+void ContractionHierarchy::IndexTriangles() {
+    const int num_nodes = NumNodes();
+    for (LowerArcs* lower : {&_lower_out, &_lower_in}) {
+        lower->offsets.assign(num_nodes + 1, 0);
+        lower->nodes.resize(lower == &_lower_out ? _down_sources.size() : _up_targets.size());
+        lower->arcs.resize(lower->nodes.size());
+    }
+    for (int u : _down_sources) {
+        _lower_out.offsets[u + 1]++;
+    }
+    for (int x : _up_targets) {
+        _lower_in.offsets[x + 1]++;
+    }
+    for (int v=0; v<num_nodes; v++) {
+        _lower_out.offsets[v + 1] += _lower_out.offsets[v];
+        _lower_in.offsets[v + 1] += _lower_in.offsets[v];
+    }
+    vector<int> next_out(_lower_out.offsets.begin(), _lower_out.offsets.end() - 1);
+    vector<int> next_in(_lower_in.offsets.begin(), _lower_in.offsets.end() - 1);
+    for (int m=0; m<num_nodes; m++) {
+        for (int d = _down_offsets[m]; d < _down_offsets[m + 1]; d++) {
+            int pos = next_out[_down_sources[d]]++;
+            _lower_out.nodes[pos] = m;
+            _lower_out.arcs[pos] = d;
+        }
+        for (int e = _up_offsets[m]; e < _up_offsets[m + 1]; e++) {
+            int pos = next_in[_up_targets[e]]++;
+            _lower_in.nodes[pos] = m;
+            _lower_in.arcs[pos] = e;
+        }
+    }
+}
+
+/**
+ * @brief Returns true if the hierarchy supports Customise and Repair.
+ *
+ * @return True if it was built as customisable, false otherwise.
+ */
+bool ContractionHierarchy::IsCustomisable() const { return _customisable; }
+
+/**
+ * @brief Finds the arc between two nodes.
+ *
+ * An arc is stored at its lower ranked end: as an upward arc of the tail,
+ * or as a downward arc of the head. Each node's arcs are sorted by the
+ * node at their other end, so the arc is found by binary search.
+ *
+ * @param from The tail of the arc.
+ * @param to The head of the arc.
+ * @return The position of the arc in the upward arrays if from is ranked lower,
+ *         or in the downward arrays otherwise, or -1 if there is no such arc.
+ */
+int ContractionHierarchy::FindArc(int from, int to) const {
+    const bool upward = _rank[from] < _rank[to];
+    const int owner = upward ? from : to;
+    const int other = upward ? to : from;
+    const vector<int>& offsets = upward ? _up_offsets : _down_offsets;
+    const vector<int>& heads = upward ? _up_targets : _down_sources;
+    auto first = heads.begin() + offsets[owner];
+    auto last = heads.begin() + offsets[owner + 1];
+    auto it = lower_bound(first, last, other);
+    return (it != last && *it == other) ? it - heads.begin() : -1;
+}
+
+/**
+ * @brief Returns the number of nodes in the hierarchy.
+ *
+ * @return The number of nodes.
+ */
+int ContractionHierarchy::NumNodes() const { return _rank.size(); }
+
+/**
+ * @brief Returns the number of edges of the graph the hierarchy was built from.
+ *
+ * @return The number of graph edges, used to check that a hierarchy matches a map.
+ */
+int ContractionHierarchy::NumGraphEdges() const { return _num_graph_edges; }
+
+/**
+ * @brief Returns the number of shortcut arcs added by contraction.
+ *
+ * @return The number of shortcuts.
+ */
+int ContractionHierarchy::NumShortcuts() const { return _num_shortcuts; }
+
+/**
+ * @brief Returns the position of a node in the contraction order.
+ *
+ * @param node The ID of the node.
+ * @return The rank of the node, 0 for the first contracted.
+ */
+int ContractionHierarchy::Rank(int node) const { return _rank[node]; }
+
+/**
+ * @brief Returns the shortest distance between two nodes.
+ *
+ * @param source The node to start from.
+ * @param target The node to reach.
+ * @return The shortest distance, or infinity if the target is unreachable.
+ */
+double ContractionHierarchy::Distance(int source, int target) const {
+    return Query(source, target, nullptr);
+}
+
+/**
+ * @brief Returns the shortest path between two nodes, with shortcuts unpacked.
+ *
+ * @param source The node to start from.
+ * @param target The node to reach.
+ * @param distance Set to the length of the path, if not null.
+ * @return The nodes on the path, starting at the source, or an empty list if the target is unreachable.
+ */
+vector<int> ContractionHierarchy::Path(int source, int target, double* distance) const {
+    vector<int> path;
+    double dist = Query(source, target, &path);
+    if (distance != nullptr) {
+        *distance = dist;
+    }
+    return path;
+}
+
+/// Scratch space for the two directions of a hierarchy query, reused by each thread.
+struct HierarchySearch {
+    /// The heap of each direction, forward first.
+    IndexedHeap heap[2];
+
+    /// The tentative distance of each node in each direction.
+    vector<double> dist[2];
+
+    /// The node each node was reached from in each direction.
+    vector<int> parent[2];
+
+    /// The middle node of the arc each node was reached by in each direction.
+    vector<int> parent_middle[2];
+
+    /// The query in which each node was last reached in each direction.
+    vector<unsigned> reached_in[2];
+
+    /// The counter of the current query.
+    unsigned query = 0;
+
+    /// Starts a new query over a hierarchy with the given number of nodes.
+    void Begin(int num_nodes) {
+        for (int side=0; side<2; side++) {
+            if ((int)dist[side].size() < num_nodes) {
+                dist[side].resize(num_nodes);
+                parent[side].resize(num_nodes);
+                parent_middle[side].resize(num_nodes);
+                reached_in[side].resize(num_nodes, 0);
+            }
+            heap[side].Reset(num_nodes);
+        }
+        if (++query == 0) {
+            for (int side=0; side<2; side++) {
+                fill(reached_in[side].begin(), reached_in[side].end(), 0);
+            }
+            query = 1;
+        }
+    }
+
+    /// Returns true if the node was reached in the given direction by the current query.
+    bool Reached(int side, int node) const { return reached_in[side][node] == query; }
+
+    /// Records a node as reached in a direction, queueing it for settling.
+    void Reach(int side, int node, double distance, int from, int middle) {
+        dist[side][node] = distance;
+        parent[side][node] = from;
+        parent_middle[side][node] = middle;
+        reached_in[side][node] = query;
+        heap[side].PushOrDecrease(node, distance);
+    }
+};
+
+/**
+ * @brief Runs a bidirectional upward search between two nodes.
+ *
+ * The forward search follows arcs to higher ranked nodes from the source and
+ * the backward search follows arcs from higher ranked nodes into the target.
+ * The direction with the smaller key is advanced until both keys reach the
+ * best meeting distance found.
+ *
+ * @param source The node to start from.
+ * @param target The node to reach.
+ * @param path If not null, set to the unpacked shortest path.
+ * @return The shortest distance, or infinity if the target is unreachable.
+ */
+double ContractionHierarchy::Query(int source, int target, vector<int>* path) const {
+    const double infinity = numeric_limits<double>::infinity();
+    thread_local HierarchySearch search;
+    search.Begin(NumNodes());
+    search.Reach(0, source, 0, -1, -1);
+    search.Reach(1, target, 0, -1, -1);
+
+    double best = infinity;
+    int meet = -1;
+    while (true) {
+        double forward_key = search.heap[0].Empty() ? infinity : search.heap[0].MinKey();
+        double backward_key = search.heap[1].Empty() ? infinity : search.heap[1].MinKey();
+        if (min(forward_key, backward_key) >= best) {
+            break;
+        }
+        const int side = (forward_key <= backward_key) ? 0 : 1;
+        const int u = search.heap[side].PopMin();
+        const double dist_u = search.dist[side][u];
+        if (search.Reached(1 - side, u) && dist_u + search.dist[1 - side][u] < best) {
+            best = dist_u + search.dist[1 - side][u];
+            meet = u;
+        }
+
+        const vector<int>& offsets = side == 0 ? _up_offsets : _down_offsets;
+        const vector<int>& heads = side == 0 ? _up_targets : _down_sources;
+        const vector<double>& weights = side == 0 ? _up_weights : _down_weights;
+        const vector<int>& middles = side == 0 ? _up_middle : _down_middle;
+        for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+            const int v = heads[e];
+            const double alt = dist_u + weights[e];
+            if (!search.Reached(side, v) || alt < search.dist[side][v]) {
+                search.Reach(side, v, alt, u, middles[e]);
+            }
+        }
+    }
+
+    if (path != nullptr) {
+        path->clear();
+        if (meet != -1) {
+            // Forward arcs run from the source up to the meeting node
+            vector<int> chain;
+            for (int v = meet; v != source; v = search.parent[0][v]) {
+                chain.push_back(v);
+            }
+            path->push_back(source);
+            for (int i = chain.size() - 1; i >= 0; i--) {
+                int v = chain[i];
+                Unpack(search.parent[0][v], v, search.parent_middle[0][v], *path);
+            }
+            // Backward arcs run from the meeting node down to the target
+            for (int v = meet; v != target; v = search.parent[1][v]) {
+                Unpack(v, search.parent[1][v], search.parent_middle[1][v], *path);
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Appends the original nodes of an arc to a path.
+ *
+ * A shortcut from -> to through middle stands for the arc from -> middle,
+ * stored as a downward arc into middle, followed by middle -> to, stored as
+ * an upward arc out of middle. Either may itself be a shortcut.
+ *
+ * @param from The tail of the arc, already on the path.
+ * @param to The head of the arc.
+ * @param middle The node the arc passes through, or -1 for an original edge.
+ * @param path The path to append to, ending at from.
+ */
+void ContractionHierarchy::Unpack(int from, int to, int middle, vector<int>& path) const {
+    struct Pending {
+        int from;
+        int to;
+        int middle;
+    };
+    vector<Pending> stack(1, Pending{from, to, middle});
+    while (!stack.empty()) {
+        Pending arc = stack.back();
+        stack.pop_back();
+        if (arc.middle == -1) {
+            path.push_back(arc.to);
+            continue;
+        }
+        const int m = arc.middle;
+        stack.push_back(Pending{m, arc.to, _up_middle[FindArc(m, arc.to)]});
+        stack.push_back(Pending{arc.from, m, _down_middle[FindArc(arc.from, m)]});
+    }
+}
+
+/// Identifies a contraction hierarchy file.
+static const char hierarchy_file_magic[8] = {'B', '1', '6', 'C', 'H', '\0', '\0', '\0'};
+
+/// The version of the hierarchy format written by ContractionHierarchy::Save.
+static const uint32_t hierarchy_file_version = 2;
+
+/// Written in native byte order to detect files from machines of different endianness.
+static const uint32_t hierarchy_file_byte_order = 0x01020304;
+
+/**
+ * @brief Fixed-size header at the start of a contraction hierarchy file.
+ *
+ * The header is followed by the node ranks (num_nodes int32), then the
+ * upward arcs as offsets (num_nodes + 1 int32), heads (num_up int32),
+ * weights (num_up float64) and middles (num_up int32), then the downward
+ * arcs in the same layout. Values use the byte order of the writer.
+ */
+struct HierarchyFileHeader {
+    /// Set to hierarchy_file_magic.
+    char magic[8];
+
+    /// Set to hierarchy_file_version.
+    uint32_t version;
+
+    /// Set to hierarchy_file_byte_order.
+    uint32_t byte_order;
+
+    /// 1 if the hierarchy is customisable, 0 otherwise.
+    uint32_t customisable;
+
+    /// Unused, set to 0.
+    uint32_t reserved;
+
+    /// The number of nodes.
+    uint64_t num_nodes;
+
+    /// The number of edges of the graph the hierarchy was built from.
+    uint64_t num_graph_edges;
+
+    /// The number of upward arcs.
+    uint64_t num_up;
+
+    /// The number of downward arcs.
+    uint64_t num_down;
+
+    /// The number of shortcut arcs.
+    uint64_t num_shortcuts;
+};
+
+/**
+ * @brief Saves the hierarchy to a binary file.
+ *
+ * @param path The path of the file to write.
+ * @throws runtime_error If the file cannot be written.
+ */
+void ContractionHierarchy::Save(const string& path) const {
+    HierarchyFileHeader header;
+    memcpy(header.magic, hierarchy_file_magic, sizeof(hierarchy_file_magic));
+    header.version = hierarchy_file_version;
+    header.byte_order = hierarchy_file_byte_order;
+    header.num_nodes = _rank.size();
+    header.num_graph_edges = _num_graph_edges;
+    header.num_up = _up_targets.size();
+    header.num_down = _down_sources.size();
+    header.num_shortcuts = _num_shortcuts;
+    header.customisable = _customisable ? 1 : 0;
+    header.reserved = 0;
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file) {
+        throw runtime_error("Cannot create hierarchy file " + path);
+    }
+    auto write = [&file](const void* data, size_t size) {
+        file.write(static_cast<const char*>(data), size);
+    };
+    write(&header, sizeof(header));
+    write(_rank.data(), _rank.size() * sizeof(int32_t));
+    write(_up_offsets.data(), _up_offsets.size() * sizeof(int32_t));
+    write(_up_targets.data(), _up_targets.size() * sizeof(int32_t));
+    write(_up_weights.data(), _up_weights.size() * sizeof(double));
+    write(_up_middle.data(), _up_middle.size() * sizeof(int32_t));
+    write(_down_offsets.data(), _down_offsets.size() * sizeof(int32_t));
+    write(_down_sources.data(), _down_sources.size() * sizeof(int32_t));
+    write(_down_weights.data(), _down_weights.size() * sizeof(double));
+    write(_down_middle.data(), _down_middle.size() * sizeof(int32_t));
+    if (!file) {
+        throw runtime_error("Failed to write hierarchy file " + path);
+    }
+}
+
+/**
+ * @brief Loads a hierarchy saved with Save.
+ *
+ * The counts in the header are checked against the length of the file before
+ * anything is allocated, and the arrays are checked once read, so that a
+ * corrupt file is rejected rather than sending queries outside the arrays:
+ * - the contraction order must be a permutation of the nodes;
+ * - the offsets must start at 0, never decrease and end at the arc counts;
+ * - each arc must join its node to a higher ranked node, listed in order;
+ * - each shortcut must pass through a node ranked below both its ends, by
+ *   arcs the hierarchy holds;
+ * - no arc may have a negative or NaN length.
+ *
+ * @param path The path of the file to read.
+ * @return The hierarchy stored in the file.
+ * @throws runtime_error If the file cannot be read or is not a valid hierarchy file of this version.
+ */
+ContractionHierarchy ContractionHierarchy::Load(const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        throw runtime_error("Cannot open hierarchy file " + path);
+    }
+    HierarchyFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, hierarchy_file_magic, sizeof(hierarchy_file_magic)) != 0) {
+        throw runtime_error(path + " is not a hierarchy file");
+    }
+    if (header.byte_order != hierarchy_file_byte_order) {
+        throw runtime_error("Hierarchy file " + path + " was written with a different byte order");
+    }
+    if (header.version != hierarchy_file_version) {
+        throw runtime_error("Hierarchy file " + path + " has unsupported version " + to_string(header.version));
+    }
+    const uint64_t max_count = numeric_limits<int>::max();
+    if (header.num_nodes >= max_count || header.num_up >= max_count || header.num_down >= max_count ||
+        header.num_graph_edges >= max_count || header.num_shortcuts >= max_count) {
+        throw runtime_error("Hierarchy file " + path + " has an inconsistent header");
+    }
+    // The counts are below 2^31, so the expected length cannot overflow
+    const uint64_t arc_size = 2 * sizeof(int32_t) + sizeof(double);
+    const uint64_t expected_size = sizeof(header) + header.num_nodes * sizeof(int32_t) +
+                                   2 * (header.num_nodes + 1) * sizeof(int32_t) +
+                                   (header.num_up + header.num_down) * arc_size;
+    const streampos body = file.tellg();
+    file.seekg(0, ios::end);
+    const streamoff file_size = file.tellg();
+    file.seekg(body);
+    if (!file || file_size < 0 || (uint64_t)file_size != expected_size) {
+        throw runtime_error("Hierarchy file " + path + " is truncated or inconsistent");
+    }
+
+    ContractionHierarchy hierarchy;
+    auto read = [&file](auto& values, uint64_t count) {
+        values.resize(count);
+        file.read(reinterpret_cast<char*>(values.data()), count * sizeof(values[0]));
+    };
+    read(hierarchy._rank, header.num_nodes);
+    read(hierarchy._up_offsets, header.num_nodes + 1);
+    read(hierarchy._up_targets, header.num_up);
+    read(hierarchy._up_weights, header.num_up);
+    read(hierarchy._up_middle, header.num_up);
+    read(hierarchy._down_offsets, header.num_nodes + 1);
+    read(hierarchy._down_sources, header.num_down);
+    read(hierarchy._down_weights, header.num_down);
+    read(hierarchy._down_middle, header.num_down);
+    if (!file) {
+        throw runtime_error("Hierarchy file " + path + " is truncated or inconsistent");
+    }
+
+    const int num_nodes = header.num_nodes;
+    auto corrupt = [&path](const string& problem) {
+        return runtime_error("Hierarchy file " + path + " " + problem);
+    };
+    vector<bool> ranked(num_nodes, false);
+    for (int rank : hierarchy._rank) {
+        if (rank < 0 || rank >= num_nodes || ranked[rank]) {
+            throw corrupt("has a contraction order that is not a permutation of the nodes");
+        }
+        ranked[rank] = true;
+    }
+    // Checks one direction's arcs, whose ends must all be ranked above the node owning them
+    auto check_arcs = [&](const vector<int>& offsets, const vector<int>& ends, const vector<double>& weights,
+                          uint64_t num_arcs) {
+        if (offsets[0] != 0 || offsets[num_nodes] != (int)num_arcs) {
+            throw corrupt("has inconsistent arc offsets");
+        }
+        for (int u=0; u<num_nodes; u++) {
+            if (offsets[u + 1] < offsets[u]) {
+                throw corrupt("has decreasing arc offsets");
+            }
+            for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+                const int v = ends[e];
+                if (v < 0 || v >= num_nodes || hierarchy._rank[v] <= hierarchy._rank[u] ||
+                    (e > offsets[u] && ends[e - 1] >= v)) {
+                    throw corrupt("has an arc that is out of range, order or rank");
+                }
+                if (!(weights[e] >= 0)) {
+                    throw corrupt("has an arc with a negative or NaN length");
+                }
+            }
+        }
+    };
+    check_arcs(hierarchy._up_offsets, hierarchy._up_targets, hierarchy._up_weights, header.num_up);
+    check_arcs(hierarchy._down_offsets, hierarchy._down_sources, hierarchy._down_weights, header.num_down);
+
+    // A shortcut unpacks into the arcs through its middle node, which must exist and rank below both ends
+    auto check_middle = [&](int from, int to, int middle) {
+        if (middle == -1) {
+            return;
+        }
+        if (middle < 0 || middle >= num_nodes ||
+            hierarchy._rank[middle] >= min(hierarchy._rank[from], hierarchy._rank[to]) ||
+            hierarchy.FindArc(from, middle) == -1 || hierarchy.FindArc(middle, to) == -1) {
+            throw corrupt("has a shortcut that does not unpack");
+        }
+    };
+    for (int u=0; u<num_nodes; u++) {
+        for (int e = hierarchy._up_offsets[u]; e < hierarchy._up_offsets[u + 1]; e++) {
+            check_middle(u, hierarchy._up_targets[e], hierarchy._up_middle[e]);
+        }
+        for (int e = hierarchy._down_offsets[u]; e < hierarchy._down_offsets[u + 1]; e++) {
+            check_middle(hierarchy._down_sources[e], u, hierarchy._down_middle[e]);
+        }
+    }
+    hierarchy._num_graph_edges = header.num_graph_edges;
+    hierarchy._num_shortcuts = header.num_shortcuts;
+    hierarchy._customisable = header.customisable != 0;
+    if (hierarchy._customisable) {
+        hierarchy.IndexTriangles();
+    }
+    return hierarchy;
+}
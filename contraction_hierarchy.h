@@ -0,0 +1,145 @@
+/**
+ * @file contraction_hierarchy.h
+ * @brief Defines a contraction hierarchy for fast point-to-point shortest path queries.
+ */
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include <string>
+#include <vector>
+#include "shortest_path.h"
+
+class CsrAdjacency;
+
+/// A contraction hierarchy over a directed graph.
+/// Nodes are contracted one at a time, least important first, adding shortcut arcs
+/// that preserve shortest path distances between the remaining nodes. A query then
+/// searches only upwards in the hierarchy from both ends, settling a small fraction
+/// of the nodes a plain Dijkstra search would.
+/// A customisable hierarchy keeps every shortcut the contraction order implies rather
+/// than only those needed by the current edge lengths. It has more shortcuts, but its
+/// arcs stay valid for any lengths, so new lengths only need a Customise pass.
+class ContractionHierarchy {
+public:
+    /// Constructs an empty hierarchy with no nodes.
+    ContractionHierarchy();
+
+    /// Builds the hierarchy over the edges of a graph.
+    /// \param adjacency The edges of the graph.
+    /// \param customisable True to keep every shortcut, so edge lengths can later change.
+    static ContractionHierarchy Build(const CsrAdjacency& adjacency, bool customisable = false);
+
+    /// Recomputes the length of every arc from new edge lengths, keeping the contraction order.
+    /// \param adjacency The edges the hierarchy was built from, with their new lengths.
+    void Customise(const CsrAdjacency& adjacency);
+
+    /// Updates only the arcs that some changed edges reach, keeping the contraction order.
+    /// \param adjacency The edges the hierarchy was built from, with the changes applied.
+    /// \param changes The edges whose lengths changed.
+    void Repair(const CsrAdjacency& adjacency, const std::vector<WeightChange>& changes);
+
+    /// Returns true if the hierarchy keeps every shortcut and so supports Customise and Repair.
+    bool IsCustomisable() const;
+
+    /// Loads a hierarchy saved with Save, checking its arrays before any query can use them.
+    /// \param path The path of the file to read.
+    /// \throws std::runtime_error If the file cannot be read, is truncated or holds an inconsistent hierarchy.
+    static ContractionHierarchy Load(const std::string& path);
+
+    /// Saves the hierarchy to a binary file, to be shipped alongside the map it was built from.
+    /// \param path The path of the file to write.
+    void Save(const std::string& path) const;
+
+    /// Returns the number of nodes.
+    int NumNodes() const;
+
+    /// Returns the number of edges of the graph the hierarchy was built from.
+    int NumGraphEdges() const;
+
+    /// Returns the number of shortcut arcs added by contraction.
+    int NumShortcuts() const;
+
+    /// Returns the position of a node in the contraction order, 0 for the first contracted.
+    int Rank(int node) const;
+
+    /// Returns the shortest distance between two nodes, or infinity if the second is unreachable.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    double Distance(int source, int target) const;
+
+    /// Returns the shortest path between two nodes, or an empty list if the second is unreachable.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    /// \param distance Set to the length of the path, if not null.
+    std::vector<int> Path(int source, int target, double* distance = nullptr) const;
+
+private:
+    /// Runs a bidirectional upward search and optionally unpacks the path it finds.
+    double Query(int source, int target, std::vector<int>* path) const;
+
+    /// Appends the original nodes of an arc to a path, replacing shortcuts by the arcs they stand for.
+    void Unpack(int from, int to, int middle, std::vector<int>& path) const;
+
+    /// Returns the position of the arc between two nodes in the upward arrays if the first
+    /// is ranked lower, or in the downward arrays if it is ranked higher, or -1 if there is none.
+    int FindArc(int from, int to) const;
+
+    /// Builds the lower neighbour lists used by Repair.
+    void IndexTriangles();
+
+    /// For each node, its arcs to or from lower ranked nodes, sorted by the lower node.
+    struct LowerArcs {
+        /// The start of each node's arcs.
+        std::vector<int> offsets;
+
+        /// The lower ranked node of each arc.
+        std::vector<int> nodes;
+
+        /// The position of each arc in the arrays of the lower node.
+        std::vector<int> arcs;
+    };
+
+    /// True if every shortcut of the contraction order is kept.
+    bool _customisable = false;
+
+    /// For each node u, the downward arcs u -> m into lower ranked nodes m.
+    LowerArcs _lower_out;
+
+    /// For each node x, the upward arcs m -> x from lower ranked nodes m.
+    LowerArcs _lower_in;
+
+    /// The position of each node in the contraction order.
+    std::vector<int> _rank;
+
+    /// The number of edges of the graph the hierarchy was built from.
+    int _num_graph_edges = 0;
+
+    /// The number of shortcut arcs.
+    int _num_shortcuts = 0;
+
+    /// For each node u, the start of its arcs u -> v to higher ranked nodes, sorted by v.
+    std::vector<int> _up_offsets;
+
+    /// The head v of each upward arc.
+    std::vector<int> _up_targets;
+
+    /// The length of each upward arc.
+    std::vector<double> _up_weights;
+
+    /// The node a shortcut upward arc passes through, or -1 for an original edge.
+    std::vector<int> _up_middle;
+
+    /// For each node v, the start of its arcs u -> v from higher ranked nodes, sorted by u.
+    std::vector<int> _down_offsets;
+
+    /// The tail u of each downward arc.
+    std::vector<int> _down_sources;
+
+    /// The length of each downward arc.
+    std::vector<double> _down_weights;
+
+    /// The node a shortcut downward arc passes through, or -1 for an original edge.
+    std::vector<int> _down_middle;
+};
+
+#endif
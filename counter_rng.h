@@ -0,0 +1,53 @@
+/**
+ * @file counter_rng.h
+ * @brief Defines a counter-based random number generator for reproducible parallel instance generation.
+ */
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <cstdint>
+
+/// A counter-based random number generator in the style of SplitMix64.
+/// The n-th value of a stream is a hash of the seed, the stream and n, so there
+/// is no shared state: each node, row or day can have a stream of its own and
+/// streams can be drawn on any thread in any order with the same results.
+/// Generators are cheap to construct, so one is made per stream where needed.
+class CounterRng {
+public:
+    /// Constructor.
+    /// \param seed The seed shared by related streams, such as the seed of a map.
+    /// \param stream The stream within the seed, such as a node id.
+    CounterRng(uint64_t seed, uint64_t stream):
+        _key(Mix(Mix(seed ^ 0x243f6a8885a308d3ull) + stream * 0x9e3779b97f4a7c15ull)) {}
+
+    /// Returns the value at a position of the stream, without moving along it.
+    /// \param counter The position.
+    uint64_t At(uint64_t counter) const { return Mix(_key + counter * 0xd1b54a32d192ed03ull); }
+
+    /// Returns the next value of the stream.
+    uint64_t Next() { return At(_counter++); }
+
+    /// Returns the next value of the stream as a uniform double in (0, 1].
+    /// Zero is excluded so the value can be used as a distance or passed to log.
+    double Uniform() { return ((Next() >> 11) + 1) * 0x1.0p-53; }
+
+    /// Returns the next value of the stream as a uniform integer in [0, bound).
+    /// \param bound The number of possible values, which must be positive.
+    int Below(int bound) { return (int)(((Next() >> 32) * (uint64_t)bound) >> 32); }
+
+private:
+    /// The finaliser of SplitMix64, which spreads every input bit over the output.
+    static uint64_t Mix(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    /// The seed and stream, hashed together.
+    uint64_t _key;
+
+    /// The position of the next value.
+    uint64_t _counter = 0;
+};
+
+#endif
@@ -0,0 +1,37 @@
+/**
+ * @file delivery.h
+ * @brief Includes the whole C++ interface of the delivery system library.
+ *
+ * Programmes embedding the library can include this header alone: it brings
+ * in map loading and routing (Graph), contraction hierarchies, trip planning
+ * and task queues, route reporting, fleet dispatch and its simulation,
+ * streaming orders and the route query server.
+ * None of the headers bring namespace std into scope.
+ */
+#ifndef DELIVERY_H
+#define DELIVERY_H
+
+#include "topological_map.h"
+#include "versioned_graph.h"
+#include "static_graph.h"
+#include "compact_graph.h"
+#include "shortest_path.h"
+#include "all_pairs.h"
+#include "node_ordering.h"
+#include "contraction_hierarchy.h"
+#include "route_planner.h"
+#include "route_report.h"
+#include "task_queue.h"
+#include "schedule.h"
+#include "thread_pool.h"
+#include "fleet.h"
+#include "simulation.h"
+#include "order_stream.h"
+#ifndef _WIN32
+#include "route_server.h"
+#endif
+#include "metrics.h"
+#include "arena.h"
+#include "counter_rng.h"
+
+#endif
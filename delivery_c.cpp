@@ -0,0 +1,243 @@
+/**
+ * @file delivery_c.cpp
+ * @brief Implements the C interface to the delivery system.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "delivery_c.h"
+#include "topological_map.h"
+#include "route_planner.h"
+
+using namespace std;
+
+/// A graph handed out through the C interface.
+struct b16_graph {
+    /// The graph.
+    Graph graph;
+};
+
+/// The description of the last failed call on each thread.
+static thread_local string last_error;
+
+/**
+ * @brief Runs the body of a C call, turning the exceptions it throws into status codes.
+ *
+ * @param body A callable returning the status of a successful call.
+ * @return The status returned by the body, or the status matching the exception it threw.
+ */
+template <typename Body>
+static b16_status guarded(Body body) noexcept {
+    try {
+        last_error.clear();
+        return body();
+    }
+    catch (const invalid_argument& e) {
+        last_error = e.what();
+        return B16_INVALID_ARGUMENT;
+    }
+    catch (const out_of_range& e) {
+        last_error = e.what();
+        return B16_INVALID_ARGUMENT;
+    }
+    catch (const bad_alloc&) {
+        last_error = "Out of memory";
+        return B16_OUT_OF_MEMORY;
+    }
+    catch (const runtime_error& e) {
+        last_error = e.what();
+        return B16_RUNTIME_ERROR;
+    }
+    catch (const exception& e) {
+        last_error = e.what();
+        return B16_INTERNAL_ERROR;
+    }
+    catch (...) {
+        last_error = "Unknown error";
+        return B16_INTERNAL_ERROR;
+    }
+}
+
+/**
+ * @brief Hands a graph out to the caller.
+ *
+ * @param graph The graph.
+ * @param out Set to the handle of the graph.
+ * @return B16_OK.
+ */
+static b16_status hand_out(Graph graph, b16_graph** out) {
+    *out = new b16_graph{move(graph)};
+    return B16_OK;
+}
+
+/**
+ * @brief Checks that a node belongs to a graph.
+ *
+ * @param graph The graph.
+ * @param node The node.
+ * @throws invalid_argument If the node is outside the graph.
+ */
+static void check_node(const Graph& graph, int node) {
+    if (node < 0 || node >= graph.NumNodes()) {
+        throw invalid_argument("Node " + to_string(node) + " is outside the graph");
+    }
+}
+
+const char* b16_last_error(void) {
+    return last_error.c_str();
+}
+
+b16_status b16_graph_from_matrix(const double* distances, int num_nodes, b16_graph** graph) {
+    return guarded([&]() {
+        if (distances == nullptr || graph == nullptr || num_nodes <= 0) {
+            throw invalid_argument("b16_graph_from_matrix needs a matrix, a graph to set and at least one node");
+        }
+        vector<vector<double>> matrix(num_nodes);
+        for (int i = 0; i < num_nodes; i++) {
+            matrix[i].assign(distances + (size_t)i * num_nodes, distances + (size_t)(i + 1) * num_nodes);
+        }
+        return hand_out(Graph(matrix), graph);
+    });
+}
+
+b16_status b16_graph_from_edges(int num_nodes, const int* sources, const int* targets,
+                                const double* distances, int num_edges, b16_graph** graph) {
+    return guarded([&]() {
+        if (graph == nullptr || num_nodes < 0 || num_edges < 0 ||
+            (num_edges > 0 && (sources == nullptr || targets == nullptr || distances == nullptr))) {
+            throw invalid_argument("b16_graph_from_edges needs the edge arrays and a graph to set");
+        }
+        vector<WeightedEdge> edges;
+        edges.reserve(num_edges);
+        for (int i = 0; i < num_edges; i++) {
+            edges.push_back(WeightedEdge{sources[i], targets[i], distances[i]});
+        }
+        return hand_out(Graph::FromEdgeList(num_nodes, edges), graph);
+    });
+}
+
+b16_status b16_graph_load(const char* path, b16_graph** graph) {
+    return guarded([&]() {
+        if (path == nullptr || graph == nullptr) {
+            throw invalid_argument("b16_graph_load needs a path and a graph to set");
+        }
+        return hand_out(Graph::FromFile(path), graph);
+    });
+}
+
+b16_status b16_graph_open_binary(const char* path, b16_graph** graph) {
+    return guarded([&]() {
+        if (path == nullptr || graph == nullptr) {
+            throw invalid_argument("b16_graph_open_binary needs a path and a graph to set");
+        }
+        return hand_out(Graph::OpenBinary(path), graph);
+    });
+}
+
+void b16_graph_free(b16_graph* graph) {
+    delete graph;
+}
+
+int b16_graph_num_nodes(const b16_graph* graph) {
+    return graph == nullptr ? 0 : graph->graph.NumNodes();
+}
+
+b16_status b16_graph_update_edge(b16_graph* graph, int source, int target, double distance) {
+    return guarded([&]() {
+        if (graph == nullptr) {
+            throw invalid_argument("b16_graph_update_edge needs a graph");
+        }
+        graph->graph.UpdateEdge(source, target, distance);
+        return B16_OK;
+    });
+}
+
+b16_status b16_route(const b16_graph* graph, int source, int target, double* distance,
+                     int* path, int path_capacity, int* path_length) {
+    return guarded([&]() {
+        if (graph == nullptr || path_capacity < 0 || (path == nullptr && path_capacity > 0)) {
+            throw invalid_argument("b16_route needs a graph and a path buffer matching its capacity");
+        }
+        check_node(graph->graph, source);
+        check_node(graph->graph, target);
+
+        if (path == nullptr && path_length == nullptr) {
+            // Only the distance is wanted, so skip reconstructing the path
+            double found = graph->graph.ShortestPath(source, target, 0);
+            const bool reachable = found >= 0;
+            if (distance) {
+                *distance = reachable ? found : numeric_limits<double>::infinity();
+            }
+            return reachable ? B16_OK : B16_UNREACHABLE;
+        }
+
+        RouteResult route = graph->graph.Route(source, target);
+        if (distance) {
+            *distance = route.distance;
+        }
+        if (path_length) {
+            *path_length = route.path.size();
+        }
+        if (!route.Reachable()) {
+            return B16_UNREACHABLE;
+        }
+        if (path == nullptr) {
+            return B16_OK;
+        }
+        if ((int)route.path.size() > path_capacity) {
+            last_error = "The route has " + to_string(route.path.size()) + " nodes, more than the path buffer holds";
+            return B16_BUFFER_TOO_SMALL;
+        }
+        copy(route.path.begin(), route.path.end(), path);
+        return B16_OK;
+    });
+}
+
+b16_status b16_plan_trips(const b16_graph* graph, const int* houses, const int* packages, int num_orders,
+                          int capacity, b16_planner planner, int* trip_offsets, int* trip_houses,
+                          int* trip_packages, int* num_trips) {
+    return guarded([&]() {
+        if (graph == nullptr || num_orders < 0 || trip_offsets == nullptr || num_trips == nullptr ||
+            (num_orders > 0 && (houses == nullptr || packages == nullptr ||
+                                trip_houses == nullptr || trip_packages == nullptr))) {
+            throw invalid_argument("b16_plan_trips needs a graph, the order arrays and the trip arrays");
+        }
+        if (capacity <= 0) {
+            throw invalid_argument("The carrying capacity must be positive");
+        }
+        vector<pair<int,int>> orders;
+        orders.reserve(num_orders);
+        for (int i = 0; i < num_orders; i++) {
+            check_node(graph->graph, houses[i]);
+            orders.emplace_back(houses[i], packages[i]);
+        }
+
+        vector<Trip> trips;
+        if (planner == B16_PLANNER_GREEDY) {
+            trips = GreedyPlanner().PlanTrips(orders, capacity, graph->graph);
+        }
+        else if (planner == B16_PLANNER_SAVINGS) {
+            trips = SavingsPlanner().PlanTrips(orders, capacity, graph->graph);
+        }
+        else {
+            throw invalid_argument("Unknown planner " + to_string((int)planner));
+        }
+
+        int position = 0;
+        for (int i = 0; i < (int)trips.size(); i++) {
+            trip_offsets[i] = position;
+            for (const pair<int,int>& order : trips[i]) {
+                trip_houses[position] = order.first;
+                trip_packages[position] = order.second;
+                position++;
+            }
+        }
+        trip_offsets[trips.size()] = position;
+        *num_trips = trips.size();
+        return B16_OK;
+    });
+}
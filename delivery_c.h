@@ -0,0 +1,128 @@
+/**
+ * @file delivery_c.h
+ * @brief Defines a C interface to the delivery system, for embedding it in other programmes.
+ *
+ * Every function reports failure through its return value rather than
+ * throwing, and b16_last_error then describes the failure on the calling
+ * thread. Queries on one graph may run on several threads at once, but a
+ * graph must not be changed or freed while it is being queried.
+ */
+#ifndef DELIVERY_C_H
+#define DELIVERY_C_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A map of the delivery area, owned by the caller and released with b16_graph_free.
+typedef struct b16_graph b16_graph;
+
+/// The result of a call.
+typedef enum b16_status {
+    /// The call succeeded.
+    B16_OK = 0,
+
+    /// An argument was out of range or null where a value was needed.
+    B16_INVALID_ARGUMENT = 1,
+
+    /// A file could not be read or written, or held malformed data.
+    B16_RUNTIME_ERROR = 2,
+
+    /// The target of a route cannot be reached from its source.
+    B16_UNREACHABLE = 3,
+
+    /// An output buffer was too small, and the size needed has been written out.
+    B16_BUFFER_TOO_SMALL = 4,
+
+    /// Memory ran out.
+    B16_OUT_OF_MEMORY = 5,
+
+    /// Any other failure.
+    B16_INTERNAL_ERROR = 6
+} b16_status;
+
+/// The planner used to group orders into trips.
+typedef enum b16_planner {
+    /// Fills trips in the order the orders are listed.
+    B16_PLANNER_GREEDY = 0,
+
+    /// Clarke-Wright savings followed by 2-opt and Or-opt improvement.
+    B16_PLANNER_SAVINGS = 1
+} b16_planner;
+
+/// Returns a description of the last failed call on the calling thread, or an empty string.
+/// The text stays valid until the next call on the same thread.
+const char* b16_last_error(void);
+
+/// Builds a graph from a row-major distance matrix, where 0 means no edge.
+/// \param distances num_nodes * num_nodes distances.
+/// \param num_nodes The number of nodes.
+/// \param graph Set to the new graph.
+b16_status b16_graph_from_matrix(const double* distances, int num_nodes, b16_graph** graph);
+
+/// Builds a graph from parallel arrays of directed edges.
+/// \param num_nodes The number of nodes.
+/// \param sources The node each edge leaves.
+/// \param targets The node each edge leads to.
+/// \param distances The length of each edge.
+/// \param num_edges The number of edges.
+/// \param graph Set to the new graph.
+b16_status b16_graph_from_edges(int num_nodes, const int* sources, const int* targets,
+                                const double* distances, int num_edges, b16_graph** graph);
+
+/// Loads a graph from a text edge list file.
+/// \param path The path of the file.
+/// \param graph Set to the new graph.
+b16_status b16_graph_load(const char* path, b16_graph** graph);
+
+/// Opens a graph saved in the binary map format, mapping it into memory.
+/// \param path The path of the file.
+/// \param graph Set to the new graph.
+b16_status b16_graph_open_binary(const char* path, b16_graph** graph);
+
+/// Releases a graph. Passing null does nothing.
+void b16_graph_free(b16_graph* graph);
+
+/// Returns the number of nodes of a graph.
+int b16_graph_num_nodes(const b16_graph* graph);
+
+/// Changes the length of the edges from one node to another, or closes them with an infinite length.
+/// \param graph The graph.
+/// \param source The node the edges leave.
+/// \param target The node the edges lead to.
+/// \param distance The new length.
+b16_status b16_graph_update_edge(b16_graph* graph, int source, int target, double distance);
+
+/// Finds the shortest route between two nodes.
+/// \param graph The graph.
+/// \param source The node to start from.
+/// \param target The node to reach.
+/// \param distance Set to the length of the route, or infinity if it is unreachable. May be null.
+/// \param path Filled with the nodes on the route, starting at the source. May be null to skip the path.
+/// \param path_capacity The number of nodes path can hold.
+/// \param path_length Set to the number of nodes on the route, even if path is too small. May be null.
+b16_status b16_route(const b16_graph* graph, int source, int target, double* distance,
+                     int* path, int path_capacity, int* path_length);
+
+/// Groups orders into trips that each fit a robot's carrying capacity.
+/// Orders with no packages are skipped, so the trips may hold fewer than num_orders orders.
+/// Trip i holds the orders trip_offsets[i] to trip_offsets[i + 1] - 1 of trip_houses and trip_packages.
+/// \param graph The graph the trips are driven on.
+/// \param houses The house of each order.
+/// \param packages The number of packages of each order.
+/// \param num_orders The number of orders.
+/// \param capacity The carrying capacity of the robot.
+/// \param planner The planner to use.
+/// \param trip_offsets Filled with num_trips + 1 offsets. Must hold num_orders + 1 values.
+/// \param trip_houses Filled with the house of each planned order. Must hold num_orders values.
+/// \param trip_packages Filled with the packages of each planned order. Must hold num_orders values.
+/// \param num_trips Set to the number of trips.
+b16_status b16_plan_trips(const b16_graph* graph, const int* houses, const int* packages, int num_orders,
+                          int capacity, b16_planner planner, int* trip_offsets, int* trip_houses,
+                          int* trip_packages, int* num_trips);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
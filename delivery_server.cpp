@@ -0,0 +1,98 @@
+/**
+ * @file delivery_server.cpp
+ * @brief Programme serving route and plan requests over TCP from a map held in memory.
+ *
+ * Usage:
+ * <pre>delivery_server [--port N] [--address A] [--threads N] [--map FILE | --binary FILE]</pre>
+ * The map is read from a text edge list with --map, or opened from the binary
+ * map format with --binary. Without either, the demo's generated neighbourhood
+ * is served. The server runs until it receives SIGINT or SIGTERM.
+ */
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "route_server.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+/// The server to stop when a signal arrives.
+static RouteServer* running_server = nullptr;
+
+/**
+ * @brief Stops the running server, which only sets a flag and writes to a pipe.
+ *
+ * @param signal The signal received.
+ */
+static void stop_server(int) {
+    if (running_server) {
+        running_server->Stop();
+    }
+}
+
+/**
+ * @brief The main function of the server.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 once the server has stopped, 1 if it could not start.
+ */
+int main(int argc, char* argv[]) {
+    int port = 7016;
+    int threads = 0;
+    string address = "127.0.0.1";
+    string map_path;
+    bool binary = false;
+    for (int i=1; i<argc; i++) {
+        const string option = argv[i];
+        if (i + 1 == argc) {
+            cerr << "Usage: " << argv[0] << " [--port N] [--address A] [--threads N] [--map FILE | --binary FILE]\n";
+            return 1;
+        }
+        const string value = argv[++i];
+        if (option == "--port") {
+            port = atoi(value.c_str());
+        }
+        else if (option == "--address") {
+            address = value;
+        }
+        else if (option == "--threads") {
+            threads = atoi(value.c_str());
+        }
+        else if (option == "--map" || option == "--binary") {
+            map_path = value;
+            binary = option == "--binary";
+        }
+        else {
+            cerr << "Unknown option " << option << '\n';
+            return 1;
+        }
+    }
+
+    try {
+        Graph graph = map_path.empty() ? Graph(generate_dist_matrix(11, 0.1, 0))
+                      : binary ? Graph::OpenBinary(map_path) : Graph::FromFile(map_path);
+        VersionedGraph versioned(move(graph));
+        ThreadPool pool(threads);
+        RouteServer server(versioned, pool);
+        port = server.Listen(port, address);
+        cerr << "Serving " << versioned.Read()->NumNodes() << " nodes on " << address << ":" << port
+             << " with " << pool.NumThreads() << " threads\n";
+
+        running_server = &server;
+        signal(SIGINT, stop_server);
+        signal(SIGTERM, stop_server);
+        server.Serve();
+        running_server = nullptr;
+
+        cerr << "Answered " << server.Batcher().NumQueries() << " route queries in "
+             << server.Batcher().NumBatches() << " batches\n";
+    }
+    catch (const exception& e) {
+        cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
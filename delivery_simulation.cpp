@@ -0,0 +1,151 @@
+/**
+ * @file delivery_simulation.cpp
+ * @brief Programme replaying simulated days over grids of map sizes and fleets, for capacity planning.
+ *
+ * Usage:
+ * <pre>delivery_simulation [--nodes 11,100,1000] [--connectivity 0.1] [--fleet 3 --fleet 3,3,5]
+ *                     [--days 1000] [--block 50] [--seeds 1] [--planner greedy|savings]
+ *                     [--format csv|json] [--threads N]</pre>
+ * Every map size is run with every fleet, each fleet given as the capacities of
+ * its robots. The days of a configuration are split into blocks of --block days,
+ * each an independent scenario, and the scenarios run one per worker thread.
+ * The report goes to standard output and a summary to standard error.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "simulation.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+/**
+ * @brief Splits a comma-separated list of integers.
+ *
+ * @param list The list, such as "3,3,5".
+ * @return The integers.
+ */
+static vector<int> parse_list(const string& list) {
+    vector<int> values;
+    stringstream items(list);
+    string item;
+    while (getline(items, item, ',')) {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+/**
+ * @brief The main function of the simulation.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return 0 on successful execution, 1 for malformed arguments or a failed scenario.
+ */
+int main(int argc, char* argv[]) {
+    vector<int> sizes{11};
+    vector<vector<int>> fleets;
+    double connectivity = 0.1;
+    int num_days = 100;
+    int block = 50;
+    int num_seeds = 1;
+    int threads = 0;
+    bool savings = false;
+    bool json = false;
+    for (int i=1; i<argc; i++) {
+        const string option = argv[i];
+        if (i + 1 == argc) {
+            cerr << "Missing value for " << option << '\n';
+            return 1;
+        }
+        const string value = argv[++i];
+        if (option == "--nodes") {
+            sizes = parse_list(value);
+        }
+        else if (option == "--connectivity") {
+            connectivity = atof(value.c_str());
+        }
+        else if (option == "--fleet") {
+            fleets.push_back(parse_list(value));
+        }
+        else if (option == "--days") {
+            num_days = atoi(value.c_str());
+        }
+        else if (option == "--block") {
+            block = atoi(value.c_str());
+        }
+        else if (option == "--seeds") {
+            num_seeds = atoi(value.c_str());
+        }
+        else if (option == "--planner" && (value == "greedy" || value == "savings")) {
+            savings = value == "savings";
+        }
+        else if (option == "--format" && (value == "csv" || value == "json")) {
+            json = value == "json";
+        }
+        else if (option == "--threads") {
+            threads = atoi(value.c_str());
+        }
+        else {
+            cerr << "Unknown option " << option << ' ' << value << '\n';
+            return 1;
+        }
+    }
+    if (fleets.empty()) {
+        // The demo's single robot
+        fleets.push_back({3});
+    }
+    if (block < 1) {
+        cerr << "--block must be positive\n";
+        return 1;
+    }
+
+    vector<Scenario> scenarios;
+    for (int size : sizes) {
+        for (const vector<int>& capacities : fleets) {
+            vector<Robot> fleet;
+            for (int capacity : capacities) {
+                fleet.emplace_back(101 + (int)fleet.size(), capacity);
+            }
+            for (int seed=0; seed<num_seeds; seed++) {
+                for (int first_day=1; first_day<=num_days; first_day+=block) {
+                    Scenario scenario{"", size, connectivity, seed, first_day, min(block, num_days - first_day + 1),
+                                      fleet, savings};
+                    scenario.name = "n" + to_string(size) + "-r" + to_string(fleet.size()) + "-s"
+                                    + to_string(seed) + "-d" + to_string(first_day);
+                    scenarios.push_back(scenario);
+                }
+            }
+        }
+    }
+
+    try {
+        ThreadPool pool(threads);
+        auto start = chrono::steady_clock::now();
+        vector<ScenarioResult> results = run_scenarios(scenarios, &pool);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (json) {
+            write_json(cout, results);
+        }
+        else {
+            write_csv(cout, results);
+        }
+        long long orders = 0;
+        double distance = 0.0;
+        for (const ScenarioResult& result : results) {
+            orders += result.orders;
+            distance += result.distance;
+        }
+        cerr << scenarios.size() << " scenarios on " << pool.NumThreads() << " threads in " << seconds << " s: "
+             << orders << " orders (" << orders / seconds << "/s), " << distance << " km\n";
+    }
+    catch (const exception& e) {
+        cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file fleet.cpp
+ * @brief Implements the fleet dispatcher.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "fleet.h"
+
+using namespace std;
+
+// Implementation of Dispatcher class
+
+/**
+ * @brief Constructs a dispatcher for a fleet.
+ *
+ * @param fleet The robots available for the day.
+ * @param planner The planner used to build each robot's trips.
+ * @param pool The threads the robots' queues are planned on.
+ */
+Dispatcher::Dispatcher(vector<Robot> fleet, const RoutePlanner& planner, ThreadPool& pool):
+    _fleet(move(fleet)), _planner(planner), _pool(pool) {};
+
+/**
+ * @brief Plans the queues of the given robots concurrently, one job per robot.
+ *
+ * @param plans The plans of the fleet, whose queues and distances are replaced.
+ * @param robots The positions in plans of the robots to replan.
+ * @param graph The map the robots drive on.
+ */
+void Dispatcher::Replan(vector<RobotPlan>& plans, const vector<int>& robots, const Graph& graph) const {
+    vector<future<void>> jobs;
+    for (int r : robots) {
+        RobotPlan* plan = &plans[r];
+        jobs.push_back(_pool.Submit([this, plan, &graph]() {
+            plan->queue = TaskQueue(plan->orders, plan->robot, graph, _planner);
+            plan->distance = plan->queue.TotalDistance(graph);
+        }));
+    }
+    for (auto& job : jobs) {
+        _pool.Await(job);
+    }
+}
+
+/**
+ * @brief Assigns a day's orders to the robots of the fleet and plans each robot's queue.
+ *
+ * Each order is estimated to cost its round trip from the store, shared with
+ * the other packages of a full load: 2 * d(store, house) * weight / capacity.
+ * Orders are handed out largest estimate first, each to the robot that would
+ * finish earliest with it, so larger robots take proportionally more work.
+ * The robots' queues are then planned concurrently. While the longest
+ * robot's distance can be cut, the order of the busiest robot whose estimate
+ * is closest to half the gap to the least busy robot is moved between them
+ * and both are replanned.
+ *
+ * @param orders The orders, as pairs of house IDs and package weights.
+ * @param graph The map the robots drive on.
+ * @return One plan per robot, in fleet order.
+ */
+vector<RobotPlan> Dispatcher::Dispatch(const vector<pair<int,int>>& orders, const Graph& graph) const {
+    vector<RobotPlan> plans;
+    for (const Robot& robot : _fleet) {
+        plans.push_back(RobotPlan{robot, {}, TaskQueue({}, robot), 0});
+    }
+    if (plans.empty()) {
+        return plans;
+    }
+
+    shared_ptr<const ShortestPathTree> store_tree = graph.DistancesFrom(store_id);
+    auto estimate = [&](const pair<int,int>& order, const Robot& robot) {
+        return 2 * store_tree->Distance(order.first) * order.second / max(robot.GetCarryingCapacity(), 1);
+    };
+
+    vector<pair<int,int>> pending;
+    for (const auto& order : orders) {
+        if (order.second != 0) {
+            pending.push_back(order);
+        }
+    }
+    stable_sort(pending.begin(), pending.end(), [&](const pair<int,int>& a, const pair<int,int>& b) {
+        return store_tree->Distance(a.first) * a.second > store_tree->Distance(b.first) * b.second;
+    });
+
+    vector<double> load(plans.size(), 0);
+    for (const auto& order : pending) {
+        int best = 0;
+        for (int r=1; r<(int)plans.size(); r++) {
+            if (load[r] + estimate(order, plans[r].robot) < load[best] + estimate(order, plans[best].robot)) {
+                best = r;
+            }
+        }
+        load[best] += estimate(order, plans[best].robot);
+        plans[best].orders.push_back(order);
+    }
+    for (auto& plan : plans) {
+        // Keep each robot's orders in house order, as the planners expect from GetOrderList
+        sort(plan.orders.begin(), plan.orders.end());
+    }
+
+    vector<int> all_robots;
+    for (int r=0; r<(int)plans.size(); r++) {
+        all_robots.push_back(r);
+    }
+    Replan(plans, all_robots, graph);
+
+    const int max_moves = pending.size();
+    for (int move_count=0; move_count<max_moves; move_count++) {
+        int busiest = 0, idlest = 0;
+        for (int r=1; r<(int)plans.size(); r++) {
+            if (plans[r].distance > plans[busiest].distance) {
+                busiest = r;
+            }
+            if (plans[r].distance < plans[idlest].distance) {
+                idlest = r;
+            }
+        }
+        if (busiest == idlest || plans[busiest].orders.empty()) {
+            break;
+        }
+
+        const double target = (plans[busiest].distance - plans[idlest].distance) / 2;
+        int moved = 0;
+        for (int i=1; i<(int)plans[busiest].orders.size(); i++) {
+            const Robot& robot = plans[busiest].robot;
+            if (fabs(estimate(plans[busiest].orders[i], robot) - target) <
+                fabs(estimate(plans[busiest].orders[moved], robot) - target)) {
+                moved = i;
+            }
+        }
+
+        const double makespan = Makespan(plans);
+        RobotPlan busiest_before = plans[busiest];
+        RobotPlan idlest_before = plans[idlest];
+        vector<pair<int,int>>& from = plans[busiest].orders;
+        vector<pair<int,int>>& to = plans[idlest].orders;
+        to.insert(lower_bound(to.begin(), to.end(), from[moved]), from[moved]);
+        from.erase(from.begin() + moved);
+        Replan(plans, {busiest, idlest}, graph);
+
+        if (Makespan(plans) >= makespan) {
+            // Robots cannot be reassigned, so restore everything else of the two plans
+            auto restore = [](RobotPlan& plan, const RobotPlan& before) {
+                plan.orders = before.orders;
+                plan.queue = before.queue;
+                plan.distance = before.distance;
+            };
+            restore(plans[busiest], busiest_before);
+            restore(plans[idlest], idlest_before);
+            break;
+        }
+    }
+
+    return plans;
+}
+
+/**
+ * @brief Schedules a day's timed orders over the fleet.
+ *
+ * Each order, earliest closing first, goes to the robot and place where it
+ * adds the least distance while every window, capacity and shift still
+ * holds, so no move needs the robots' days to be simulated again.
+ *
+ * @param orders The orders of the day.
+ * @param graph The map the robots drive on.
+ * @param shift The period every robot works.
+ * @param unscheduled Set to the indices of the orders no robot can deliver in time, if not null.
+ * @return One day per robot, in fleet order.
+ */
+vector<DaySchedule> Dispatcher::DispatchTimed(vector<TimedOrder> orders, const Graph& graph, TimeWindow shift,
+                                              vector<int>* unscheduled) const {
+    auto timed = make_shared<const TimedOrders>(move(orders), graph, &_pool);
+    vector<DaySchedule> days;
+    days.reserve(_fleet.size());
+    for (const Robot& robot : _fleet) {
+        days.emplace_back(robot, shift, timed);
+    }
+    vector<int> left = schedule_orders(*timed, days);
+    if (unscheduled) {
+        *unscheduled = move(left);
+    }
+    return days;
+}
+
+/**
+ * @brief Returns the longest distance driven by any robot of a dispatch.
+ *
+ * @param plans The plans of the fleet.
+ * @return The largest planned distance, in km.
+ */
+double Dispatcher::Makespan(const vector<RobotPlan>& plans) {
+    double makespan = 0;
+    for (const auto& plan : plans) {
+        makespan = max(makespan, plan.distance);
+    }
+    return makespan;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file fleet.h
+ * @brief Defines the dispatcher that shares a day's orders across a fleet of robots.
+ */
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <utility>
+#include <vector>
+#include "schedule.h"
+#include "task_queue.h"
+#include "thread_pool.h"
+
+/// The deliveries assigned to one robot of a fleet.
+struct RobotPlan {
+    /// The robot making the deliveries.
+    Robot robot;
+
+    /// The orders assigned to the robot, as pairs of house IDs and package weights.
+    std::vector<std::pair<int,int>> orders;
+
+    /// The tasks of the robot, in the order they are performed.
+    TaskQueue queue;
+
+    /// The total distance the robot drives, in km.
+    double distance;
+};
+
+/// Splits a day's orders across a fleet of robots with different capacities and plans
+/// every robot's task queue concurrently, balancing the distance each robot drives.
+class Dispatcher {
+public:
+    /// Constructor.
+    /// \param fleet The robots available for the day.
+    /// \param planner The planner used to build each robot's trips.
+    /// \param pool The threads the robots' queues are planned on.
+    Dispatcher(std::vector<Robot> fleet, const RoutePlanner& planner, ThreadPool& pool);
+
+    /// Assigns and plans a day's orders.
+    /// \param orders The orders, as pairs of house IDs and package weights.
+    /// \param graph The map the robots drive on.
+    /// \return One plan per robot, in fleet order.
+    std::vector<RobotPlan> Dispatch(const std::vector<std::pair<int,int>>& orders, const Graph& graph) const;
+
+    /// Schedules a day's timed orders over the fleet, so that every delivery starts within its window.
+    /// The distances between the houses are measured once on the pool, and every candidate place
+    /// for an order on every robot is checked in constant time against the robots' time slack.
+    /// \param orders The orders of the day.
+    /// \param graph The map the robots drive on.
+    /// \param shift The period every robot works, leaving and returning to the store within it.
+    /// \param unscheduled Set to the indices of the orders no robot can deliver in time, if not null.
+    /// \return One day per robot, in fleet order.
+    std::vector<DaySchedule> DispatchTimed(std::vector<TimedOrder> orders, const Graph& graph, TimeWindow shift,
+                                           std::vector<int>* unscheduled = nullptr) const;
+
+    /// Returns the longest distance driven by any robot of a dispatch.
+    static double Makespan(const std::vector<RobotPlan>& plans);
+
+private:
+    /// Plans the queues of the given robots concurrently.
+    void Replan(std::vector<RobotPlan>& plans, const std::vector<int>& robots, const Graph& graph) const;
+
+    /// The robots available for the day.
+    std::vector<Robot> _fleet;
+
+    /// The planner used to build each robot's trips.
+    const RoutePlanner& _planner;
+
+    /// The threads the robots' queues are planned on.
+    ThreadPool& _pool;
+};
+
+#endif
@@ -0,0 +1,369 @@
+/**
+ * @file metrics.cpp
+ * @brief Implements the metrics registry and its Prometheus and Chrome trace output.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <vector>
+#include "metrics.h"
+
+using namespace std;
+
+// Implementation of LatencyHistogram struct
+
+/**
+ * @brief Returns the upper bound of a bucket.
+ *
+ * @param bucket The index of the bucket.
+ * @return The bound in nanoseconds, 2^(bucket+1), or infinity for the last bucket.
+ */
+double LatencyHistogram::UpperBound(int bucket) {
+    if (bucket >= num_buckets - 1) {
+        return numeric_limits<double>::infinity();
+    }
+    return (double)(uint64_t(1) << (bucket + 1));
+}
+
+/**
+ * @brief Returns an upper bound on a percentile of the recorded durations.
+ *
+ * The bound is the upper edge of the bucket the percentile falls in, so it
+ * overestimates by less than a factor of two.
+ *
+ * @param fraction The percentile as a fraction between 0 and 1.
+ * @return The bound in nanoseconds, or 0 if nothing was recorded.
+ */
+double LatencyHistogram::Percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = max<uint64_t>(1, (uint64_t)(fraction * count + 0.5));
+    uint64_t seen = 0;
+    for (int b = 0; b < num_buckets; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return b == num_buckets - 1 ? UpperBound(b - 1) : UpperBound(b);
+        }
+    }
+    return UpperBound(num_buckets - 2);
+}
+
+// Implementation of Metrics class
+
+/// The names of the counters, indexed by Counter.
+static const char* const counter_names[(int)Counter::Count] = {
+    "shortest_path_queries", "tree_cache_hits", "hierarchy_queries", "trees_built",
+    "heap_pushes", "heap_pops", "edge_relaxations", "deliveries"};
+
+/// The Prometheus help text of the counters, indexed by Counter.
+static const char* const counter_help[(int)Counter::Count] = {
+    "Point-to-point shortest path queries.",
+    "Point-to-point queries answered from a cached shortest path tree.",
+    "Point-to-point queries answered by a contraction hierarchy.",
+    "Shortest path trees built.",
+    "Nodes pushed into or lowered in a search heap.",
+    "Nodes popped from a search heap.",
+    "Edges scanned from settled nodes.",
+    "Deliveries reported."};
+
+/// The names of the spans, indexed by Span.
+static const char* const span_names[(int)Span::Count] = {
+    "shortest_path", "distances_from", "plan_trips", "task_queue_build", "perform_tasks", "display_path"};
+
+const char* Metrics::Name(Counter counter) { return counter_names[(int)counter]; }
+
+const char* Metrics::Name(Span span) { return span_names[(int)span]; }
+
+/**
+ * @brief Returns the time of the steady clock.
+ *
+ * @return Nanoseconds since the clock's epoch.
+ */
+int64_t Metrics::Now() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if DELIVERY_METRICS
+
+/// A span recorded for the trace.
+struct TraceEvent {
+    /// The span.
+    Span span;
+
+    /// The start of the span, in nanoseconds of the steady clock.
+    int64_t start_ns;
+
+    /// The length of the span in nanoseconds.
+    int64_t duration_ns;
+};
+
+/// The most trace events kept per thread, to bound the memory a forgotten trace can take.
+static const size_t max_trace_events = 1 << 20;
+
+/// The metrics recorded by one thread.
+/// Only the owning thread writes the counters, so relaxed loads and stores are
+/// enough and no read-modify-write is needed. Readers may see a value a few
+/// updates old, which is fine for scraping.
+struct ThreadMetrics {
+    /// Registers the block of the calling thread.
+    ThreadMetrics();
+
+    /// Folds the block into the totals of exited threads and unregisters it.
+    ~ThreadMetrics();
+
+    /// The counters, indexed by Counter.
+    atomic<uint64_t> counters[(int)Counter::Count] = {};
+
+    /// The histogram buckets of each span.
+    atomic<uint64_t> buckets[(int)Span::Count][LatencyHistogram::num_buckets] = {};
+
+    /// The number of durations recorded for each span.
+    atomic<uint64_t> span_counts[(int)Span::Count] = {};
+
+    /// The total duration of each span in nanoseconds.
+    atomic<uint64_t> span_ns[(int)Span::Count] = {};
+
+    /// The ID of the thread in the trace.
+    int trace_id;
+
+    /// Guards trace, which the writer of the trace drains from another thread.
+    mutex trace_lock;
+
+    /// The trace events recorded and not yet written.
+    vector<TraceEvent> trace;
+};
+
+/// Guards the registry of live blocks and the totals of exited threads.
+static mutex registry_lock;
+
+/// The blocks of the live threads.
+static vector<ThreadMetrics*> live_blocks;
+
+/// The totals left by exited threads.
+static MetricsSnapshot retired;
+
+/// The trace events left by exited threads, with their thread IDs.
+static vector<pair<int, TraceEvent>> retired_trace;
+
+/// The next thread ID handed out for the trace.
+static int next_trace_id = 1;
+
+/// True while spans are also recorded as trace events.
+static atomic<bool> tracing(false);
+
+ThreadMetrics::ThreadMetrics() {
+    lock_guard<mutex> guard(registry_lock);
+    trace_id = next_trace_id++;
+    live_blocks.push_back(this);
+}
+
+ThreadMetrics::~ThreadMetrics() {
+    lock_guard<mutex> guard(registry_lock);
+    for (int c = 0; c < (int)Counter::Count; c++) {
+        retired.counters[c] += counters[c].load(memory_order_relaxed);
+    }
+    for (int s = 0; s < (int)Span::Count; s++) {
+        for (int b = 0; b < LatencyHistogram::num_buckets; b++) {
+            retired.spans[s].buckets[b] += buckets[s][b].load(memory_order_relaxed);
+        }
+        retired.spans[s].count += span_counts[s].load(memory_order_relaxed);
+        retired.spans[s].total_ns += span_ns[s].load(memory_order_relaxed);
+    }
+    {
+        lock_guard<mutex> trace_guard(trace_lock);
+        for (const TraceEvent& event : trace) {
+            retired_trace.emplace_back(trace_id, event);
+        }
+    }
+    live_blocks.erase(find(live_blocks.begin(), live_blocks.end(), this));
+}
+
+/**
+ * @brief Returns the block of the calling thread, registering it on first use.
+ */
+static ThreadMetrics& thread_metrics() {
+    thread_local ThreadMetrics block;
+    return block;
+}
+
+/**
+ * @brief Adds to a counter owned by the calling thread.
+ */
+static inline void bump(atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+void Metrics::Add(Counter counter, uint64_t amount) {
+    bump(thread_metrics().counters[(int)counter], amount);
+}
+
+/**
+ * @brief Records a span in the calling thread's histogram, and in its trace while tracing.
+ */
+void Metrics::Record(Span span, int64_t start_ns, int64_t duration_ns) {
+    ThreadMetrics& block = thread_metrics();
+    const uint64_t duration = duration_ns > 0 ? duration_ns : 0;
+    int bucket = 0;
+    for (uint64_t d = duration >> 1; d != 0 && bucket < LatencyHistogram::num_buckets - 1; d >>= 1) {
+        bucket++;
+    }
+    bump(block.buckets[(int)span][bucket], 1);
+    bump(block.span_counts[(int)span], 1);
+    bump(block.span_ns[(int)span], duration);
+
+    if (tracing.load(memory_order_relaxed)) {
+        lock_guard<mutex> guard(block.trace_lock);
+        if (block.trace.size() < max_trace_events) {
+            block.trace.push_back(TraceEvent{span, start_ns, duration_ns});
+        }
+    }
+}
+
+/**
+ * @brief Sums the blocks of every live thread with the totals of exited threads.
+ */
+MetricsSnapshot Metrics::Snapshot() {
+    lock_guard<mutex> guard(registry_lock);
+    MetricsSnapshot snapshot = retired;
+    for (ThreadMetrics* block : live_blocks) {
+        for (int c = 0; c < (int)Counter::Count; c++) {
+            snapshot.counters[c] += block->counters[c].load(memory_order_relaxed);
+        }
+        for (int s = 0; s < (int)Span::Count; s++) {
+            for (int b = 0; b < LatencyHistogram::num_buckets; b++) {
+                snapshot.spans[s].buckets[b] += block->buckets[s][b].load(memory_order_relaxed);
+            }
+            snapshot.spans[s].count += block->span_counts[s].load(memory_order_relaxed);
+            snapshot.spans[s].total_ns += block->span_ns[s].load(memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+/**
+ * @brief Zeroes every block. Updates racing with the reset may survive it.
+ */
+void Metrics::Reset() {
+    lock_guard<mutex> guard(registry_lock);
+    retired = MetricsSnapshot();
+    for (ThreadMetrics* block : live_blocks) {
+        for (auto& value : block->counters) {
+            value.store(0, memory_order_relaxed);
+        }
+        for (auto& span : block->buckets) {
+            for (auto& value : span) {
+                value.store(0, memory_order_relaxed);
+            }
+        }
+        for (int s = 0; s < (int)Span::Count; s++) {
+            block->span_counts[s].store(0, memory_order_relaxed);
+            block->span_ns[s].store(0, memory_order_relaxed);
+        }
+    }
+}
+
+void Metrics::StartTrace() { tracing.store(true, memory_order_relaxed); }
+
+void Metrics::StopTrace() { tracing.store(false, memory_order_relaxed); }
+
+/**
+ * @brief Writes and discards the trace events of every thread as complete ("X") events.
+ */
+void Metrics::WriteChromeTrace(ostream& out) {
+    vector<pair<int, TraceEvent>> events;
+    {
+        lock_guard<mutex> guard(registry_lock);
+        events.swap(retired_trace);
+        for (ThreadMetrics* block : live_blocks) {
+            lock_guard<mutex> trace_guard(block->trace_lock);
+            for (const TraceEvent& event : block->trace) {
+                events.emplace_back(block->trace_id, event);
+            }
+            block->trace.clear();
+        }
+    }
+    sort(events.begin(), events.end(), [](const pair<int, TraceEvent>& a, const pair<int, TraceEvent>& b) {
+        return a.second.start_ns < b.second.start_ns;
+    });
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char line[160];
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& event = events[i].second;
+        snprintf(line, sizeof(line),
+                 "%s\n{\"name\":\"%s\",\"cat\":\"delivery\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                 "\"ts\":%.3f,\"dur\":%.3f}",
+                 i == 0 ? "" : ",", span_names[(int)event.span], events[i].first,
+                 event.start_ns / 1000.0, event.duration_ns / 1000.0);
+        out << line;
+    }
+    out << "\n]}\n";
+}
+
+/**
+ * @brief Writes every counter as a Prometheus counter and every span as a histogram in seconds.
+ */
+void Metrics::WritePrometheus(ostream& out) {
+    const MetricsSnapshot snapshot = Snapshot();
+    char line[256];
+    for (int c = 0; c < (int)Counter::Count; c++) {
+        snprintf(line, sizeof(line), "# HELP b16_%s_total %s\n# TYPE b16_%s_total counter\nb16_%s_total %llu\n",
+                 counter_names[c], counter_help[c], counter_names[c], counter_names[c],
+                 (unsigned long long)snapshot.counters[c]);
+        out << line;
+    }
+
+    out << "# HELP b16_span_seconds Time spent in each instrumented section.\n"
+        << "# TYPE b16_span_seconds histogram\n";
+    for (int s = 0; s < (int)Span::Count; s++) {
+        const LatencyHistogram& histogram = snapshot.spans[s];
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LatencyHistogram::num_buckets - 1; b++) {
+            cumulative += histogram.buckets[b];
+            snprintf(line, sizeof(line), "b16_span_seconds_bucket{span=\"%s\",le=\"%g\"} %llu\n",
+                     span_names[s], LatencyHistogram::UpperBound(b) * 1e-9, (unsigned long long)cumulative);
+            out << line;
+        }
+        snprintf(line, sizeof(line),
+                 "b16_span_seconds_bucket{span=\"%s\",le=\"+Inf\"} %llu\n"
+                 "b16_span_seconds_sum{span=\"%s\"} %.9f\nb16_span_seconds_count{span=\"%s\"} %llu\n",
+                 span_names[s], (unsigned long long)histogram.count, span_names[s],
+                 histogram.total_ns * 1e-9, span_names[s], (unsigned long long)histogram.count);
+        out << line;
+    }
+}
+
+#else
+
+void Metrics::Add(Counter, uint64_t) {}
+
+void Metrics::Record(Span, int64_t, int64_t) {}
+
+MetricsSnapshot Metrics::Snapshot() { return MetricsSnapshot(); }
+
+void Metrics::Reset() {}
+
+void Metrics::StartTrace() {}
+
+void Metrics::StopTrace() {}
+
+/**
+ * @brief Writes an empty trace, as recording is compiled out.
+ */
+void Metrics::WriteChromeTrace(ostream& out) {
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}\n";
+}
+
+/**
+ * @brief Writes only a comment, as recording is compiled out and every total would read zero.
+ */
+void Metrics::WritePrometheus(ostream& out) {
+    out << "# b16 delivery metrics were disabled at build time (DELIVERY_METRICS=0)\n";
+}
+
+#endif
@@ -0,0 +1,233 @@
+/**
+ * @file metrics.h
+ * @brief Defines the counters, latency histograms and trace spans recorded on the routing and planning paths.
+ *
+ * Recording is compiled in only when DELIVERY_METRICS is defined to 1, as the
+ * CMake option of the same name does. Otherwise SpanTimer and CounterBatch are
+ * empty and vanish from the code that uses them, and the reporting functions
+ * return nothing, so the hooks cost nothing in production builds that do not
+ * want them.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdint>
+#include <ostream>
+
+#ifndef DELIVERY_METRICS
+#define DELIVERY_METRICS 0
+#endif
+
+/// A quantity counted on the hot paths.
+enum class Counter {
+    /// Point-to-point queries answered by Graph::ShortestPath or Graph::Route.
+    ShortestPathQueries,
+
+    /// Point-to-point queries answered from a cached shortest path tree.
+    TreeCacheHits,
+
+    /// Point-to-point queries answered by a contraction hierarchy.
+    HierarchyQueries,
+
+    /// Shortest path trees built by Graph::DistancesFrom.
+    TreesBuilt,
+
+    /// Nodes pushed into a search heap, or lowered in it.
+    HeapPushes,
+
+    /// Nodes popped from a search heap, and so settled.
+    HeapPops,
+
+    /// Edges scanned from settled nodes.
+    EdgeRelaxations,
+
+    /// Deliveries reported by Task::DisplayPath.
+    Deliveries,
+
+    /// The number of counters.
+    Count
+};
+
+/// A timed section of the routing and planning paths.
+enum class Span {
+    /// A point-to-point query in Graph::ShortestPath or Graph::Route.
+    ShortestPath,
+
+    /// Building the shortest path tree of a source.
+    DistancesFrom,
+
+    /// Planning trips with a route planner.
+    PlanTrips,
+
+    /// Constructing a task queue.
+    TaskQueueBuild,
+
+    /// Performing every task in a queue.
+    PerformTasks,
+
+    /// Reporting the deliveries of one task.
+    DisplayPath,
+
+    /// The number of spans.
+    Count
+};
+
+/// A histogram of span durations with power-of-two buckets.
+struct LatencyHistogram {
+    /// The number of buckets. Bucket b counts durations below 2^(b+1) ns and at least 2^b ns,
+    /// except that bucket 0 also counts shorter ones and the last bucket also counts longer ones.
+    static const int num_buckets = 40;
+
+    /// The number of durations in each bucket.
+    uint64_t buckets[num_buckets] = {};
+
+    /// The number of durations recorded.
+    uint64_t count = 0;
+
+    /// The sum of the durations recorded, in nanoseconds.
+    uint64_t total_ns = 0;
+
+    /// Returns the upper bound of a bucket in nanoseconds.
+    static double UpperBound(int bucket);
+
+    /// Returns an upper bound on a percentile of the durations in nanoseconds, or 0 if none were recorded.
+    /// \param fraction The percentile as a fraction, such as 0.99.
+    double Percentile(double fraction) const;
+};
+
+/// The totals of every counter and span across all threads.
+struct MetricsSnapshot {
+    /// The total of each counter, indexed by Counter.
+    uint64_t counters[(int)Counter::Count] = {};
+
+    /// The durations of each span, indexed by Span.
+    LatencyHistogram spans[(int)Span::Count];
+};
+
+/// The process-wide metrics registry.
+/// Each thread records into a block of its own, so recording takes no locks and
+/// causes no cache line sharing. Reading sums the blocks of every live thread
+/// with the totals left by threads that have exited.
+class Metrics {
+public:
+    /// Returns true if recording was compiled in.
+    static constexpr bool Enabled() { return DELIVERY_METRICS != 0; }
+
+    /// Returns the totals recorded so far.
+    static MetricsSnapshot Snapshot();
+
+    /// Sets every counter and histogram back to zero.
+    static void Reset();
+
+    /// Writes the totals in the Prometheus text exposition format, for a scrape endpoint.
+    /// \param out The stream to write to.
+    static void WritePrometheus(std::ostream& out);
+
+    /// Starts recording each span as a trace event, in addition to its histogram.
+    static void StartTrace();
+
+    /// Stops recording trace events, keeping those recorded.
+    static void StopTrace();
+
+    /// Writes the trace events recorded so far in the Chrome trace event format, and discards them.
+    /// The output opens in chrome://tracing and in Perfetto.
+    /// \param out The stream to write to.
+    static void WriteChromeTrace(std::ostream& out);
+
+    /// Returns the name of a counter, as used in the Prometheus output.
+    static const char* Name(Counter counter);
+
+    /// Returns the name of a span, as used in the Prometheus and trace output.
+    static const char* Name(Span span);
+
+    /// Adds to a counter of the calling thread.
+    /// \param counter The counter.
+    /// \param amount The amount to add.
+    static void Add(Counter counter, uint64_t amount);
+
+    /// Records a span of the calling thread.
+    /// \param span The span.
+    /// \param start_ns The start of the span, in nanoseconds of the steady clock.
+    /// \param duration_ns The length of the span in nanoseconds.
+    static void Record(Span span, int64_t start_ns, int64_t duration_ns);
+
+    /// Returns the time of the steady clock in nanoseconds.
+    static int64_t Now();
+};
+
+#if DELIVERY_METRICS
+
+/// Times a section from its construction to the end of its scope.
+class SpanTimer {
+public:
+    /// Starts timing a span.
+    explicit SpanTimer(Span span) : _span(span), _start(Metrics::Now()) {}
+
+    /// Records the span.
+    ~SpanTimer() { Metrics::Record(_span, _start, Metrics::Now() - _start); }
+
+    SpanTimer(const SpanTimer&) = delete;
+    SpanTimer& operator=(const SpanTimer&) = delete;
+
+private:
+    /// The span timed.
+    Span _span;
+
+    /// The start of the span.
+    int64_t _start;
+};
+
+/// Accumulates a counter in a local variable and adds it to the thread's total once, at the end of its scope.
+/// Used in inner loops, where even a thread-local add per iteration shows up.
+class CounterBatch {
+public:
+    /// Starts a batch for a counter.
+    explicit CounterBatch(Counter counter) : _counter(counter) {}
+
+    /// Adds the batch to the thread's total.
+    ~CounterBatch() {
+        if (_value != 0) {
+            Metrics::Add(_counter, _value);
+        }
+    }
+
+    CounterBatch(const CounterBatch&) = delete;
+    CounterBatch& operator=(const CounterBatch&) = delete;
+
+    /// Adds to the batch.
+    void Add(uint64_t amount) { _value += amount; }
+
+private:
+    /// The counter added to.
+    Counter _counter;
+
+    /// The amount accumulated.
+    uint64_t _value = 0;
+};
+
+/// Adds to a counter of the calling thread.
+/// \param counter The counter.
+/// \param amount The amount to add.
+inline void count_metric(Counter counter, uint64_t amount = 1) { Metrics::Add(counter, amount); }
+
+#else
+
+/// Adds to a counter. Recording is compiled out, so this does nothing.
+inline void count_metric(Counter, uint64_t = 1) {}
+
+/// Times a section. Recording is compiled out, so this does nothing.
+class SpanTimer {
+public:
+    explicit SpanTimer(Span) {}
+};
+
+/// Accumulates a counter. Recording is compiled out, so this does nothing.
+class CounterBatch {
+public:
+    explicit CounterBatch(Counter) {}
+    void Add(uint64_t) {}
+};
+
+#endif
+
+#endif
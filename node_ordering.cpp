@@ -0,0 +1,398 @@
+/**
+ * @file node_ordering.cpp
+ * @brief Implements the breadth-first, reverse Cuthill-McKee and Hilbert curve node orderings.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include "node_ordering.h"
+#include "topological_map.h"
+
+using namespace std;
+
+/// The most breadth-first searches spent looking for a peripheral node to start reverse Cuthill-McKee from.
+static const int max_peripheral_rounds = 8;
+
+/// The number of cells along each side of the grid the Hilbert curve is drawn over.
+static const uint32_t hilbert_grid = 1u << 16;
+
+/**
+ * @brief Moves the store to the front of an order, keeping the other nodes in place.
+ *
+ * Route planning starts and ends every trip at node 0, so the store keeps its id.
+ *
+ * @param order The external id of each internal id.
+ */
+static void keep_store_first(vector<int>& order) {
+    auto store = find(order.begin(), order.end(), 0);
+    rotate(order.begin(), store, store + 1);
+}
+
+/**
+ * @brief Orders the nodes breadth first from the store.
+ *
+ * Nodes the store cannot reach are ordered breadth first from the lowest id left.
+ *
+ * @param adjacency The edges of the map.
+ * @return The external id of each internal id.
+ */
+static vector<int> breadth_first_order(const CsrAdjacency& adjacency) {
+    const int num_nodes = adjacency.NumNodes();
+    const int* offsets = adjacency.Offsets();
+    const int* targets = adjacency.Targets();
+    vector<char> placed(num_nodes, 0);
+    vector<int> order;
+    order.reserve(num_nodes);
+    for (int start = 0; start < num_nodes; start++) {
+        if (placed[start]) {
+            continue;
+        }
+        placed[start] = 1;
+        size_t head = order.size();
+        order.push_back(start);
+        while (head < order.size()) {
+            const int u = order[head++];
+            for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+                if (!placed[targets[e]]) {
+                    placed[targets[e]] = 1;
+                    order.push_back(targets[e]);
+                }
+            }
+        }
+    }
+    return order;
+}
+
+/**
+ * @brief Finds a node far from the centre of a component, by George and Liu's method.
+ *
+ * Each round searches breadth first from the candidate and moves to the
+ * lowest degree node of the last level, until the number of levels stops growing.
+ *
+ * @param adjacency The edges of the map.
+ * @param start A node of the component.
+ * @param placed Marks the nodes of earlier components, which are skipped.
+ * @param seen A mark per node, all clear, left clear on return.
+ * @param queue Scratch storage for the search.
+ * @return A node of the component with a large eccentricity.
+ */
+static int peripheral_node(const CsrAdjacency& adjacency, int start, const vector<char>& placed,
+                           vector<char>& seen, vector<int>& queue) {
+    const int* offsets = adjacency.Offsets();
+    const int* targets = adjacency.Targets();
+    queue.clear();
+    int best = start;
+    int candidate = start;
+    int eccentricity = -1;
+    for (int round = 0; round < max_peripheral_rounds; round++) {
+        for (int u : queue) {
+            seen[u] = 0;
+        }
+        queue.assign(1, candidate);
+        seen[candidate] = 1;
+        int depth = 0;
+        size_t level_begin = 0;
+        size_t level_end = 1;
+        while (true) {
+            for (size_t i = level_begin; i < level_end; i++) {
+                const int u = queue[i];
+                for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+                    const int v = targets[e];
+                    if (!seen[v] && !placed[v]) {
+                        seen[v] = 1;
+                        queue.push_back(v);
+                    }
+                }
+            }
+            if (queue.size() == level_end) {
+                break;
+            }
+            level_begin = level_end;
+            level_end = queue.size();
+            depth++;
+        }
+        if (depth <= eccentricity) {
+            break;
+        }
+        best = candidate;
+        eccentricity = depth;
+        candidate = *min_element(queue.begin() + level_begin, queue.end(), [offsets](int a, int b) {
+            return offsets[a + 1] - offsets[a] < offsets[b + 1] - offsets[b];
+        });
+    }
+    for (int u : queue) {
+        seen[u] = 0;
+    }
+    return best;
+}
+
+/**
+ * @brief Orders the nodes by reverse Cuthill-McKee.
+ *
+ * Each component is searched breadth first from a peripheral node, taking
+ * the neighbours of each node in order of increasing degree, and the whole
+ * order is then reversed.
+ *
+ * @param adjacency The edges of the map.
+ * @return The external id of each internal id.
+ */
+static vector<int> reverse_cuthill_mckee_order(const CsrAdjacency& adjacency) {
+    const int num_nodes = adjacency.NumNodes();
+    const int* offsets = adjacency.Offsets();
+    const int* targets = adjacency.Targets();
+    auto degree = [offsets](int u) { return offsets[u + 1] - offsets[u]; };
+    vector<char> placed(num_nodes, 0);
+    vector<char> seen(num_nodes, 0);
+    vector<int> queue;
+    vector<int> order;
+    order.reserve(num_nodes);
+    for (int start = 0; start < num_nodes; start++) {
+        if (placed[start]) {
+            continue;
+        }
+        const int root = peripheral_node(adjacency, start, placed, seen, queue);
+        placed[root] = 1;
+        size_t head = order.size();
+        order.push_back(root);
+        while (head < order.size()) {
+            const int u = order[head++];
+            const size_t first = order.size();
+            for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+                if (!placed[targets[e]]) {
+                    placed[targets[e]] = 1;
+                    order.push_back(targets[e]);
+                }
+            }
+            sort(order.begin() + first, order.end(), [&degree](int a, int b) {
+                return degree(a) != degree(b) ? degree(a) < degree(b) : a < b;
+            });
+        }
+    }
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+/**
+ * @brief Returns the position of a grid cell along the Hilbert curve that fills the grid.
+ *
+ * @param x The column of the cell, below hilbert_grid.
+ * @param y The row of the cell, below hilbert_grid.
+ * @return The number of cells the curve passes before the cell.
+ */
+static uint64_t hilbert_index(uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+    for (uint32_t half = hilbert_grid / 2; half > 0; half /= 2) {
+        const uint32_t right = (x & half) ? 1 : 0;
+        const uint32_t top = (y & half) ? 1 : 0;
+        index += (uint64_t)half * half * ((3 * right) ^ top);
+        // Turn the quadrant so the curve inside it runs the same way as the whole
+        if (top == 0) {
+            if (right == 1) {
+                x = hilbert_grid - 1 - x;
+                y = hilbert_grid - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return index;
+}
+
+/**
+ * @brief Orders the nodes along a Hilbert curve over their positions.
+ *
+ * The positions are scaled onto a square grid over the map's bounding box,
+ * and nodes in the same cell are ordered by id.
+ *
+ * @param coordinates The position of each node.
+ * @return The external id of each internal id.
+ */
+static vector<int> hilbert_order(const vector<Coordinates>& coordinates) {
+    const int num_nodes = coordinates.size();
+    double min_x = coordinates[0].x, max_x = coordinates[0].x;
+    double min_y = coordinates[0].y, max_y = coordinates[0].y;
+    for (const Coordinates& position : coordinates) {
+        min_x = min(min_x, position.x);
+        max_x = max(max_x, position.x);
+        min_y = min(min_y, position.y);
+        max_y = max(max_y, position.y);
+    }
+    const double span = max(max_x - min_x, max_y - min_y);
+    const double scale = (span > 0) ? (hilbert_grid - 1) / span : 0;
+
+    vector<pair<uint64_t, int>> keys(num_nodes);
+    for (int u = 0; u < num_nodes; u++) {
+        const uint32_t x = (uint32_t)((coordinates[u].x - min_x) * scale);
+        const uint32_t y = (uint32_t)((coordinates[u].y - min_y) * scale);
+        keys[u] = make_pair(hilbert_index(x, y), u);
+    }
+    sort(keys.begin(), keys.end());
+    vector<int> order(num_nodes);
+    for (int i = 0; i < num_nodes; i++) {
+        order[i] = keys[i].second;
+    }
+    return order;
+}
+
+// Implementation of NodeRenumbering class
+
+/**
+ * @brief Constructs a renumbering from the external id of each internal id.
+ *
+ * @param external_ids The external id of each internal id.
+ * @throws invalid_argument If the ids are not a permutation of 0 to n - 1.
+ */
+NodeRenumbering::NodeRenumbering(vector<int> external_ids) {
+    const int num_nodes = external_ids.size();
+    vector<int> internal_ids(num_nodes, -1);
+    bool identity = true;
+    for (int i = 0; i < num_nodes; i++) {
+        const int id = external_ids[i];
+        if (id < 0 || id >= num_nodes || internal_ids[id] != -1) {
+            throw invalid_argument("A renumbering must list every node id exactly once");
+        }
+        internal_ids[id] = i;
+        identity = identity && (id == i);
+    }
+    if (!identity) {
+        _external_ids = move(external_ids);
+        _internal_ids = move(internal_ids);
+    }
+}
+
+/**
+ * @brief Computes a renumbering of a map's nodes.
+ *
+ * @param adjacency The edges of the map.
+ * @param ordering The order to give the nodes.
+ * @param coordinates The position of each node, needed only by the Hilbert ordering.
+ * @return The renumbering, which keeps the store at id 0.
+ * @throws invalid_argument If the Hilbert ordering is asked for without one position per node.
+ */
+NodeRenumbering NodeRenumbering::Compute(const CsrAdjacency& adjacency, NodeOrdering ordering,
+                                         const vector<Coordinates>& coordinates) {
+    if (ordering == NodeOrdering::Hilbert && (int)coordinates.size() != adjacency.NumNodes()) {
+        throw invalid_argument("The Hilbert ordering needs one position per node");
+    }
+    if (adjacency.NumNodes() == 0) {
+        return NodeRenumbering();
+    }
+    vector<int> order;
+    switch (ordering) {
+    case NodeOrdering::BreadthFirst:
+        order = breadth_first_order(adjacency);
+        break;
+    case NodeOrdering::ReverseCuthillMcKee:
+        order = reverse_cuthill_mckee_order(adjacency);
+        break;
+    case NodeOrdering::Hilbert:
+        order = hilbert_order(coordinates);
+        break;
+    }
+    keep_store_first(order);
+    return NodeRenumbering(move(order));
+}
+
+/**
+ * @brief Returns true if every id maps to itself.
+ *
+ * @return True for the identity renumbering.
+ */
+bool NodeRenumbering::IsIdentity() const { return _external_ids.empty(); }
+
+/**
+ * @brief Returns the external id of a node.
+ *
+ * @param internal_id The id the node is stored under.
+ * @return The id the node was loaded with.
+ */
+int NodeRenumbering::ToExternal(int internal_id) const {
+    return _external_ids.empty() ? internal_id : _external_ids[internal_id];
+}
+
+/**
+ * @brief Returns the internal id of a node.
+ *
+ * @param external_id The id the node was loaded with.
+ * @return The id the node is stored under.
+ */
+int NodeRenumbering::ToInternal(int external_id) const {
+    return _internal_ids.empty() ? external_id : _internal_ids[external_id];
+}
+
+/**
+ * @brief Rewrites the nodes of a route from internal to external ids.
+ *
+ * @param route The route to rewrite.
+ */
+void NodeRenumbering::ToExternal(RouteResult& route) const {
+    if (_external_ids.empty()) {
+        return;
+    }
+    route.source = _external_ids[route.source];
+    route.target = _external_ids[route.target];
+    for (int& node : route.path) {
+        node = _external_ids[node];
+    }
+}
+
+/**
+ * @brief Returns the renumbering that applies this one and then another.
+ *
+ * @param next A renumbering of the internal ids of this one.
+ * @return The combined renumbering, from this one's external ids to next's internal ids.
+ */
+NodeRenumbering NodeRenumbering::Then(const NodeRenumbering& next) const {
+    if (next.IsIdentity()) {
+        return *this;
+    }
+    vector<int> external_ids(next._external_ids.size());
+    for (int i = 0; i < (int)external_ids.size(); i++) {
+        external_ids[i] = ToExternal(next._external_ids[i]);
+    }
+    return NodeRenumbering(move(external_ids));
+}
+
+/**
+ * @brief Returns the edges of a map under the internal ids.
+ *
+ * Each node's edges are sorted by their new target, as a map built from a
+ * distance matrix has them, keeping parallel edges in their original order.
+ *
+ * @param adjacency The edges under the external ids.
+ * @return The renumbered edges.
+ */
+CsrAdjacency NodeRenumbering::Apply(const CsrAdjacency& adjacency) const {
+    if (IsIdentity()) {
+        return adjacency;
+    }
+    const int num_nodes = adjacency.NumNodes();
+    const int* old_offsets = adjacency.Offsets();
+    const int* old_targets = adjacency.Targets();
+    const double* old_distances = adjacency.Distances();
+    vector<int> offsets;
+    vector<int> targets;
+    vector<double> distances;
+    offsets.reserve(num_nodes + 1);
+    targets.reserve(adjacency.NumEdges());
+    distances.reserve(adjacency.NumEdges());
+    offsets.push_back(0);
+    vector<pair<int, double>> row;
+    for (int u = 0; u < num_nodes; u++) {
+        const int old = _external_ids[u];
+        row.clear();
+        for (int e = old_offsets[old]; e < old_offsets[old + 1]; e++) {
+            row.emplace_back(_internal_ids[old_targets[e]], old_distances[e]);
+        }
+        stable_sort(row.begin(), row.end(), [](const pair<int, double>& a, const pair<int, double>& b) {
+            return a.first < b.first;
+        });
+        for (const pair<int, double>& edge : row) {
+            targets.push_back(edge.first);
+            distances.push_back(edge.second);
+        }
+        offsets.push_back(targets.size());
+    }
+    return CsrAdjacency(move(offsets), move(targets), move(distances));
+}
@@ -0,0 +1,92 @@
+/**
+ * @file node_ordering.h
+ * @brief Defines node renumberings that place nearby nodes at nearby ids, for cache locality.
+ */
+#ifndef NODE_ORDERING_H
+#define NODE_ORDERING_H
+
+#include <vector>
+#include "route_report.h"
+#include "shortest_path.h"
+
+class CsrAdjacency;
+
+/// The order Graph::Renumber gives the nodes.
+enum class NodeOrdering {
+    /// Breadth-first order from the store, so each node's neighbours take nearby ids.
+    BreadthFirst,
+
+    /// Reverse Cuthill-McKee, which narrows the band of ids each node's edges span.
+    ReverseCuthillMcKee,
+
+    /// Order along a Hilbert curve over the node coordinates, which needs coordinates.
+    Hilbert
+};
+
+/// A one-to-one translation between the ids a map was loaded with and the ids it is stored under.
+/// Searches index their distance, predecessor and edge arrays by node id, so numbering nodes that
+/// are close on the map with close ids keeps those accesses within a few cache lines. The external
+/// ids are the ones houses are known by; the internal ids are the positions in the arrays.
+/// The store, node 0, keeps its id under every renumbering.
+class NodeRenumbering {
+public:
+    /// Constructs the identity renumbering, which keeps every id.
+    NodeRenumbering() = default;
+
+    /// Constructor.
+    /// \param external_ids The external id of each internal id.
+    /// \throws std::invalid_argument If the ids are not a permutation of 0 to n - 1.
+    explicit NodeRenumbering(std::vector<int> external_ids);
+
+    /// Computes a renumbering of a map's nodes.
+    /// \param adjacency The edges of the map.
+    /// \param ordering The order to give the nodes.
+    /// \param coordinates The position of each node, needed only by the Hilbert ordering.
+    /// \throws std::invalid_argument If the Hilbert ordering is asked for without one position per node.
+    static NodeRenumbering Compute(const CsrAdjacency& adjacency, NodeOrdering ordering,
+                                   const std::vector<Coordinates>& coordinates = {});
+
+    /// Returns true if every id maps to itself.
+    bool IsIdentity() const;
+
+    /// Returns the external id of a node.
+    int ToExternal(int internal_id) const;
+
+    /// Returns the internal id of a node.
+    int ToInternal(int external_id) const;
+
+    /// Rewrites the nodes of a route from internal to external ids.
+    void ToExternal(RouteResult& route) const;
+
+    /// Returns the renumbering that applies this one and then another.
+    /// \param next A renumbering of the internal ids of this one.
+    NodeRenumbering Then(const NodeRenumbering& next) const;
+
+    /// Returns the edges of a map under the internal ids, each node's edges sorted by target.
+    /// \param adjacency The edges under the external ids.
+    CsrAdjacency Apply(const CsrAdjacency& adjacency) const;
+
+    /// Returns a list of per-node values reordered by internal id.
+    /// \param values The value of each node, indexed by external id.
+    template <typename T>
+    std::vector<T> Apply(const std::vector<T>& values) const {
+        if (IsIdentity()) {
+            return values;
+        }
+        std::vector<T> reordered;
+        reordered.reserve(values.size());
+        for (int external_id : _external_ids) {
+            reordered.push_back(values[external_id]);
+        }
+        return reordered;
+    }
+
+private:
+    /// The external id of each internal id, or empty for the identity.
+    std::vector<int> _external_ids;
+
+    /// The internal id of each external id, or empty for the identity.
+    std::vector<int> _internal_ids;
+};
+
+#endif
@@ -0,0 +1,203 @@
+/**
+ * @file order_stream.cpp
+ * @brief Implements the order inbox and the streaming planner.
+ */
+
+#include <stdexcept>
+#include "order_stream.h"
+
+using namespace std;
+
+// Implementation of OrderInbox class
+
+/**
+ * @brief Constructs an empty inbox holding only its placeholder entry.
+ */
+OrderInbox::OrderInbox() {
+    Entry* placeholder = new Entry();
+    _head.store(placeholder, memory_order_relaxed);
+    _tail = placeholder;
+}
+
+/**
+ * @brief Frees every entry, including orders not yet taken.
+ */
+OrderInbox::~OrderInbox() {
+    Entry* entry = _tail;
+    while (entry != nullptr) {
+        Entry* next = entry->next.load(memory_order_relaxed);
+        delete entry;
+        entry = next;
+    }
+}
+
+/**
+ * @brief Adds an order to the inbox.
+ *
+ * The exchange makes the new entry the head, then the previous head is
+ * pointed at it. Between the two steps the consumer simply sees the inbox
+ * as ending at the previous head.
+ *
+ * @param order The order to add.
+ */
+void OrderInbox::Push(const IncomingOrder& order) {
+    Entry* entry = new Entry();
+    entry->order = order;
+    Entry* prev = _head.exchange(entry, memory_order_acq_rel);
+    prev->next.store(entry, memory_order_release);
+}
+
+/**
+ * @brief Takes the oldest order, if one is ready.
+ *
+ * The entry holding the taken order becomes the new placeholder, and the
+ * old placeholder is freed.
+ *
+ * @param order Set to the order taken.
+ * @return True if an order was taken, false if the inbox was empty.
+ */
+bool OrderInbox::TryPop(IncomingOrder& order) {
+    Entry* next = _tail->next.load(memory_order_acquire);
+    if (next == nullptr) {
+        return false;
+    }
+    order = next->order;
+    delete _tail;
+    _tail = next;
+    return true;
+}
+
+// Implementation of StreamingPlanner class
+
+/**
+ * @brief Constructs a planner with no trips queued.
+ *
+ * @param robot The robot that performs the trips.
+ * @param graph The map the trips are driven on, which must outlive the planner.
+ */
+StreamingPlanner::StreamingPlanner(const Robot& robot, const Graph& graph):
+    _robot(robot), _graph(graph), _queue(vector<pair<int,int>>(), robot) {};
+
+/**
+ * @brief Stops the background thread if it is running.
+ */
+StreamingPlanner::~StreamingPlanner() {
+    Stop();
+}
+
+/**
+ * @brief Stamps an order with its arrival time and queues it for placement.
+ *
+ * @param house The ID of the house to deliver to.
+ * @param packages The number of packages ordered.
+ */
+void StreamingPlanner::Submit(int house, int packages) {
+    _inbox.Push(IncomingOrder{house, packages, chrono::steady_clock::now()});
+}
+
+/**
+ * @brief Places every order waiting in the inbox on the calling thread.
+ *
+ * @return The number of orders placed.
+ */
+int StreamingPlanner::ProcessPending() {
+    int placed = 0;
+    IncomingOrder order;
+    while (_inbox.TryPop(order)) {
+        Place(order);
+        placed++;
+    }
+    return placed;
+}
+
+/**
+ * @brief Starts a background thread that places orders as soon as they arrive.
+ */
+void StreamingPlanner::Start() {
+    if (_running.exchange(true)) {
+        return;
+    }
+    _worker = thread([this]() { WorkerLoop(); });
+}
+
+/**
+ * @brief Stops the background thread after it has placed the orders already queued.
+ */
+void StreamingPlanner::Stop() {
+    if (!_running.exchange(false)) {
+        return;
+    }
+    _worker.join();
+    ProcessPending();
+}
+
+/**
+ * @brief Places orders until Stop is called.
+ *
+ * The thread polls the inbox, yielding while it is briefly empty and
+ * sleeping in short naps once it has been idle for a while, so an order
+ * arriving on a busy day is picked up within microseconds.
+ */
+void StreamingPlanner::WorkerLoop() {
+    const int spins_before_napping = 1000;
+    int idle = 0;
+    while (_running.load(memory_order_acquire)) {
+        if (ProcessPending() > 0) {
+            idle = 0;
+        }
+        else if (++idle < spins_before_napping) {
+            this_thread::yield();
+        }
+        else {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+    }
+}
+
+/**
+ * @brief Places one order into the queued trips and records its latency.
+ *
+ * @param order The order to place.
+ */
+void StreamingPlanner::Place(const IncomingOrder& order) {
+    lock_guard<mutex> lock(_mutex);
+    _queue.InsertOrder(make_pair(order.house, order.packages), _robot, _graph);
+    double latency_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - order.arrival).count();
+    _num_orders++;
+    _total_latency_ms += latency_ms;
+    _max_latency_ms = max(_max_latency_ms, latency_ms);
+}
+
+/**
+ * @brief Hands the next queued trip to the robot as it leaves the store.
+ *
+ * @return The orders of the trip in visiting order, or an empty trip if none is queued.
+ */
+Trip StreamingPlanner::DispatchNextTrip() {
+    lock_guard<mutex> lock(_mutex);
+    if (_queue.Empty()) {
+        return Trip();
+    }
+    return _queue.PopNextTask().GetDeliveryOrders();
+}
+
+/**
+ * @brief Returns a copy of the trips still waiting at the store.
+ *
+ * @return The queued tasks, in the order they are performed.
+ */
+vector<Task> StreamingPlanner::GetQueuedTasks() const {
+    lock_guard<mutex> lock(_mutex);
+    return _queue.GetTasks();
+}
+
+/**
+ * @brief Returns the latency figures of the orders placed so far.
+ *
+ * @return The number of orders placed and their mean and longest latency.
+ */
+StreamStats StreamingPlanner::Stats() const {
+    lock_guard<mutex> lock(_mutex);
+    double mean = _num_orders > 0 ? _total_latency_ms / _num_orders : 0;
+    return StreamStats{_num_orders, mean, _max_latency_ms};
+}
@@ -0,0 +1,160 @@
+/**
+ * @file order_stream.h
+ * @brief Defines the inbox and planner stage that place orders into trips as they arrive.
+ */
+#ifndef ORDER_STREAM_H
+#define ORDER_STREAM_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "task_queue.h"
+
+/// An order as it arrives from a customer.
+struct IncomingOrder {
+    /// The ID of the house to deliver to.
+    int house;
+
+    /// The number of packages ordered.
+    int packages;
+
+    /// When the order arrived, for measuring how long it took to place.
+    std::chrono::steady_clock::time_point arrival;
+};
+
+/// A lock-free queue of orders with many producers and a single consumer.
+/// Producers link a new entry onto the head with one atomic exchange; the consumer
+/// unlinks entries from the tail, so neither side ever waits on the other.
+class OrderInbox {
+public:
+    /// Constructs an empty inbox.
+    OrderInbox();
+
+    /// Destructor. Discards any orders not yet taken.
+    ~OrderInbox();
+
+    OrderInbox(const OrderInbox&) = delete;
+    OrderInbox& operator=(const OrderInbox&) = delete;
+
+    /// Adds an order. Safe to call from any number of threads at once.
+    /// \param order The order to add.
+    void Push(const IncomingOrder& order);
+
+    /// Takes the oldest order, if one is ready. Only one thread may take orders.
+    /// \param order Set to the order taken.
+    /// \return True if an order was taken, false if the inbox was empty.
+    bool TryPop(IncomingOrder& order);
+
+private:
+    /// An entry of the inbox.
+    struct Entry {
+        /// The next newer entry, or a null pointer if this is the newest.
+        std::atomic<Entry*> next{nullptr};
+
+        /// The order held by the entry.
+        IncomingOrder order;
+    };
+
+    /// The newest entry, where producers link new ones.
+    std::atomic<Entry*> _head;
+
+    /// The entry before the oldest order, owned by the consumer.
+    Entry* _tail;
+};
+
+/// Latency figures of a streaming planner.
+struct StreamStats {
+    /// The number of orders placed into trips.
+    int num_orders;
+
+    /// The mean time from arrival to placement, in milliseconds.
+    double mean_latency_ms;
+
+    /// The longest time from arrival to placement, in milliseconds.
+    double max_latency_ms;
+};
+
+/// Places orders into a robot's queued trips as they arrive, by cheapest insertion.
+/// Trips the robot has already left on are handed out by DispatchNextTrip and never
+/// touched again; new orders only join trips still waiting at the store or start new ones.
+/// Orders can be placed on a background thread started with Start, or on the calling
+/// thread with ProcessPending.
+class StreamingPlanner {
+public:
+    /// Constructor.
+    /// \param robot The robot that performs the trips.
+    /// \param graph The map the trips are driven on, which must outlive the planner.
+    StreamingPlanner(const Robot& robot, const Graph& graph);
+
+    /// Destructor. Stops the background thread if it is running.
+    ~StreamingPlanner();
+
+    StreamingPlanner(const StreamingPlanner&) = delete;
+    StreamingPlanner& operator=(const StreamingPlanner&) = delete;
+
+    /// Queues an order for placement. Safe to call from any number of threads at once.
+    /// \param house The ID of the house to deliver to.
+    /// \param packages The number of packages ordered.
+    void Submit(int house, int packages);
+
+    /// Places every order waiting in the inbox on the calling thread.
+    /// Must not be called while the background thread is running.
+    /// \return The number of orders placed.
+    int ProcessPending();
+
+    /// Starts a background thread that places orders as soon as they arrive.
+    void Start();
+
+    /// Stops the background thread after it has placed the orders already queued.
+    void Stop();
+
+    /// Hands the next queued trip to the robot as it leaves the store.
+    /// \return The orders of the trip in visiting order, or an empty trip if none is queued.
+    Trip DispatchNextTrip();
+
+    /// Returns a copy of the trips still waiting at the store.
+    std::vector<Task> GetQueuedTasks() const;
+
+    /// Returns the latency figures of the orders placed so far.
+    StreamStats Stats() const;
+
+private:
+    /// Places one order into the trips and records its latency.
+    void Place(const IncomingOrder& order);
+
+    /// Places orders until Stop is called.
+    void WorkerLoop();
+
+    /// The robot performing the trips.
+    Robot _robot;
+
+    /// The map the trips are driven on.
+    const Graph& _graph;
+
+    /// The orders waiting to be placed.
+    OrderInbox _inbox;
+
+    /// Guards _queue and the latency figures.
+    mutable std::mutex _mutex;
+
+    /// The trips waiting at the store.
+    TaskQueue _queue;
+
+    /// The number of orders placed.
+    int _num_orders = 0;
+
+    /// The total time from arrival to placement, in milliseconds.
+    double _total_latency_ms = 0;
+
+    /// The longest time from arrival to placement, in milliseconds.
+    double _max_latency_ms = 0;
+
+    /// The background thread placing orders.
+    std::thread _worker;
+
+    /// True while the background thread should keep running.
+    std::atomic<bool> _running{false};
+};
+
+#endif
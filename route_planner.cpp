@@ -0,0 +1,295 @@
+/**
+ * @file route_planner.cpp
+ * @brief Implements the route planners.
+ */
+
+#include <algorithm>
+#include <limits>
+#include "route_planner.h"
+#include "topological_map.h"
+#include "metrics.h"
+#include "arena.h"
+
+using namespace std;
+
+// Implementation of route planners
+
+/**
+ * @brief Splits orders into trips in the order they are listed.
+ *
+ * @param orders The orders, as pairs of house IDs and package weights.
+ * @param capacity The carrying capacity of the robot.
+ * @return The trips, each holding consecutive orders that fit the capacity.
+ */
+vector<Trip> greedy_trips(const vector<pair<int,int>>& orders, int capacity) {
+    vector<Trip> trips;
+
+    // Split orders into delivery groups that do not exceed robot's carrying capacity
+    Trip group;
+    int total_weight = 0;
+    for (const pair<int,int>& order : orders) {
+        if (order.second != 0) {
+            if (total_weight + order.second > capacity && !group.empty()) {
+                trips.push_back(move(group));
+                group.clear();
+                total_weight = 0;
+            }
+            group.push_back(order);
+            total_weight += order.second;
+        }
+    }
+    if (!group.empty()) {
+        trips.push_back(move(group));
+    }
+
+    return trips;
+}
+
+/**
+ * @brief Plans trips by filling them in the order the orders are listed.
+ *
+ * @param orders The orders, as pairs of house IDs and package weights.
+ * @param capacity The carrying capacity of the robot.
+ * @param graph The map the trips are driven on, which this planner ignores.
+ * @return The planned trips.
+ */
+vector<Trip> GreedyPlanner::PlanTrips(const vector<pair<int,int>>& orders, int capacity,
+                                      const Graph& /*graph*/) const {
+    SpanTimer timer(Span::PlanTrips);
+    return greedy_trips(orders, capacity);
+}
+
+/// The shortest path distances between the stops of a day, as one row-major block.
+struct StopDistances {
+    /// The number of stops.
+    int num_stops;
+
+    /// Entry i * num_stops + j is the distance from stop i to stop j.
+    pmr::vector<double> values;
+
+    /// Returns the distance from stop i to stop j.
+    double operator()(int i, int j) const { return values[i * num_stops + j]; }
+};
+
+/**
+ * @brief Computes the shortest path distance between every pair of stops.
+ *
+ * @param stops The node IDs of the stops.
+ * @param graph The map to measure distances on.
+ * @param arena The arena the matrix is allocated from.
+ * @return The distances between the stops.
+ */
+static StopDistances stop_distances(const vector<int>& stops, const Graph& graph, Arena& arena) {
+    DistanceTable table = graph.DistancesBetween(stops, stops);
+    const int num_stops = stops.size();
+    StopDistances dist{num_stops, pmr::vector<double>((size_t)num_stops * num_stops, &arena)};
+    for (int i=0; i<num_stops; i++) {
+        for (int j=0; j<num_stops; j++) {
+            dist.values[i * num_stops + j] = table.At(i, j);
+        }
+    }
+    return dist;
+}
+
+/**
+ * @brief Returns the length of a closed tour through stops, starting and ending at stop 0.
+ *
+ * @param route The stops visited after leaving stop 0, in order.
+ * @param dist The distances between stops.
+ * @return The length of the tour.
+ */
+static double tour_length(const pmr::vector<int>& route, const StopDistances& dist) {
+    double length = 0;
+    int prev = 0;
+    for (int stop : route) {
+        length += dist(prev, stop);
+        prev = stop;
+    }
+    return length + dist(prev, 0);
+}
+
+/**
+ * @brief Shortens a tour with 2-opt and Or-opt moves until neither improves it.
+ *
+ * A 2-opt move reverses a run of stops; an Or-opt move relocates a run of up
+ * to three stops elsewhere in the tour. Each candidate is measured in full,
+ * which keeps the moves correct when distances are asymmetric. Trips are
+ * bounded by the carrying capacity, so tours are short. Candidates are built
+ * in buffers taken from the arena once and refilled for every move.
+ *
+ * @param route The stops visited after leaving stop 0, improved in place.
+ * @param dist The distances between stops.
+ * @param arena The arena the move buffers are allocated from.
+ */
+static void improve_tour(pmr::vector<int>& route, const StopDistances& dist, Arena& arena) {
+    const double min_gain = 1e-9;
+    const int size = route.size();
+    double best = tour_length(route, dist);
+    pmr::vector<int> rest(&arena);
+    pmr::vector<int> candidate(&arena);
+    rest.reserve(size);
+    candidate.reserve(size);
+    bool improved = true;
+    while (improved) {
+        improved = false;
+
+        // 2-opt
+        for (int i=0; i<size - 1; i++) {
+            for (int j=i + 1; j<size; j++) {
+                reverse(route.begin() + i, route.begin() + j + 1);
+                double length = tour_length(route, dist);
+                if (length < best - min_gain) {
+                    best = length;
+                    improved = true;
+                }
+                else {
+                    reverse(route.begin() + i, route.begin() + j + 1);
+                }
+            }
+        }
+
+        // Or-opt
+        for (int len=1; len<=3 && len<size; len++) {
+            for (int i=0; i + len <= size; i++) {
+                rest.assign(route.begin(), route.begin() + i);
+                rest.insert(rest.end(), route.begin() + i + len, route.end());
+                for (int pos=0; pos<=(int)rest.size(); pos++) {
+                    if (pos == i) {
+                        continue;
+                    }
+                    candidate.assign(rest.begin(), rest.begin() + pos);
+                    candidate.insert(candidate.end(), route.begin() + i, route.begin() + i + len);
+                    candidate.insert(candidate.end(), rest.begin() + pos, rest.end());
+                    double length = tour_length(candidate, dist);
+                    if (length < best - min_gain) {
+                        best = length;
+                        route.swap(candidate);
+                        improved = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Plans trips with the Clarke-Wright savings algorithm and local search.
+ *
+ * Every order starts in a trip of its own. Joining the end i of one trip to
+ * the start j of another saves d(i, store) + d(store, j) - d(i, j), so pairs
+ * are considered from the largest saving down and joined whenever the
+ * combined load fits the capacity. Each resulting trip is then shortened with
+ * improve_tour. The scratch memory of the day is drawn from the thread's
+ * arena and released in one step when planning finishes.
+ *
+ * @param orders The orders, as pairs of house IDs and package weights.
+ * @param capacity The carrying capacity of the robot.
+ * @param graph The map the trips are driven on.
+ * @return The planned trips.
+ */
+vector<Trip> SavingsPlanner::PlanTrips(const vector<pair<int,int>>& orders, int capacity,
+                                       const Graph& graph) const {
+    SpanTimer timer(Span::PlanTrips);
+    Arena& arena = Arena::ThreadLocal();
+    ArenaScope scope(arena);
+
+    // Stop 0 is the store, stops 1..k are the orders with packages
+    pmr::vector<pair<int,int>> stop_orders(1, make_pair(store_id, 0), &arena);
+    for (const pair<int,int>& order : orders) {
+        if (order.second != 0) {
+            stop_orders.push_back(order);
+        }
+    }
+    const int num_stops = stop_orders.size();
+    vector<int> stops;
+    stops.reserve(num_stops);
+    for (const auto& order : stop_orders) {
+        stops.push_back(order.first);
+    }
+    const StopDistances dist = stop_distances(stops, graph, arena);
+
+    struct Saving {
+        double value;
+        int from;
+        int to;
+    };
+    // Reserved up front, as the arena cannot reuse the buffers a growing vector leaves behind
+    pmr::vector<Saving> savings(&arena);
+    savings.reserve((size_t)(num_stops - 1) * (num_stops - 1));
+    for (int i=1; i<num_stops; i++) {
+        for (int j=1; j<num_stops; j++) {
+            double value = dist(i, 0) + dist(0, j) - dist(i, j);
+            if (i != j && value > 0 && value < numeric_limits<double>::infinity()) {
+                savings.push_back(Saving{value, i, j});
+            }
+        }
+    }
+    // Ties keep the order they were found in, as a stable sort would, without its temporary buffer
+    sort(savings.begin(), savings.end(), [](const Saving& a, const Saving& b) {
+        if (a.value != b.value) {
+            return a.value > b.value;
+        }
+        return a.from != b.from ? a.from < b.from : a.to < b.to;
+    });
+
+    pmr::vector<pmr::vector<int>> routes(num_stops, &arena);
+    pmr::vector<int> load(num_stops, 0, &arena);
+    pmr::vector<int> route_of(num_stops, 0, &arena);
+    for (int i=1; i<num_stops; i++) {
+        routes[i].push_back(i);
+        load[i] = stop_orders[i].second;
+        route_of[i] = i;
+    }
+    for (const Saving& saving : savings) {
+        int a = route_of[saving.from];
+        int b = route_of[saving.to];
+        if (a == b || routes[a].back() != saving.from || routes[b].front() != saving.to ||
+            load[a] + load[b] > capacity) {
+            continue;
+        }
+        for (int stop : routes[b]) {
+            route_of[stop] = a;
+        }
+        routes[a].insert(routes[a].end(), routes[b].begin(), routes[b].end());
+        load[a] += load[b];
+        routes[b].clear();
+    }
+
+    vector<Trip> trips;
+    for (auto& route : routes) {
+        if (route.empty()) {
+            continue;
+        }
+        improve_tour(route, dist, arena);
+        Trip trip;
+        trip.reserve(route.size());
+        for (int stop : route) {
+            trip.push_back(stop_orders[stop]);
+        }
+        trips.push_back(move(trip));
+    }
+    return trips;
+}
+
+/**
+ * @brief Returns the length of a closed trip from the store through its houses.
+ *
+ * @param trip The orders of the trip in visiting order.
+ * @param graph The map the trip is driven on.
+ * @return The length of the trip, or infinity if some leg is unreachable.
+ */
+double trip_distance(const Trip& trip, const Graph& graph) {
+    double length = 0;
+    int prev = store_id;
+    for (int i=0; i<=(int)trip.size(); i++) {
+        int next = (i < (int)trip.size()) ? trip[i].first : store_id;
+        double leg = graph.ShortestPath(prev, next, 0);
+        if (leg < 0) {
+            return numeric_limits<double>::infinity();
+        }
+        length += leg;
+        prev = next;
+    }
+    return length;
+}
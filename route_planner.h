@@ -0,0 +1,64 @@
+/**
+ * @file route_planner.h
+ * @brief Defines the planners that group a day's orders into trips.
+ */
+#ifndef ROUTE_PLANNER_H
+#define ROUTE_PLANNER_H
+
+#include <utility>
+#include <vector>
+
+class Graph;
+
+/// A trip is the list of orders delivered between leaving the store and returning to it,
+/// as pairs of house IDs and package weights in visiting order.
+typedef std::vector<std::pair<int,int>> Trip;
+
+/// The ID of the store, the node every trip starts from and returns to.
+const int store_id = 0;
+
+/// Groups a day's orders into trips that each fit a robot's carrying capacity.
+class RoutePlanner {
+public:
+    /// Destructor.
+    virtual ~RoutePlanner() = default;
+
+    /// Plans the trips for a day.
+    /// Orders with no packages are skipped. An order heavier than the capacity is given a trip of its own.
+    /// \param orders The orders, as pairs of house IDs and package weights.
+    /// \param capacity The carrying capacity of the robot.
+    /// \param graph The map the trips are driven on.
+    virtual std::vector<Trip> PlanTrips(const std::vector<std::pair<int,int>>& orders, int capacity,
+                                   const Graph& graph) const = 0;
+};
+
+/// Fills trips in the order the orders are listed, starting a new trip whenever the next order does not fit.
+/// Distances play no part, so this is only a baseline.
+class GreedyPlanner : public RoutePlanner {
+public:
+    /// Plans the trips for a day.
+    std::vector<Trip> PlanTrips(const std::vector<std::pair<int,int>>& orders, int capacity,
+                           const Graph& graph) const override;
+};
+
+/// Builds trips with the Clarke-Wright savings algorithm, then shortens each trip with
+/// 2-opt and Or-opt moves. Distances are shortest path distances on the map, and may be asymmetric.
+class SavingsPlanner : public RoutePlanner {
+public:
+    /// Plans the trips for a day.
+    std::vector<Trip> PlanTrips(const std::vector<std::pair<int,int>>& orders, int capacity,
+                           const Graph& graph) const override;
+};
+
+/// Splits orders into trips in the order they are listed, starting a new trip whenever the next order does not fit.
+/// Orders with no packages are skipped. An order heavier than the capacity is given a trip of its own.
+/// \param orders The orders, as pairs of house IDs and package weights.
+/// \param capacity The carrying capacity of the robot.
+std::vector<Trip> greedy_trips(const std::vector<std::pair<int,int>>& orders, int capacity);
+
+/// Returns the length of a trip that starts at the store, visits its houses in order and returns to the store.
+/// \param trip The orders of the trip in visiting order.
+/// \param graph The map the trip is driven on.
+double trip_distance(const Trip& trip, const Graph& graph);
+
+#endif
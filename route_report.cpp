@@ -0,0 +1,334 @@
+/**
+ * @file route_report.cpp
+ * @brief Implements the report sinks.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include "route_report.h"
+
+using namespace std;
+
+// Implementation of report sinks
+
+/**
+ * @brief Checks whether the route reaches its target.
+ * @return True if the target can be reached from the source.
+ */
+bool RouteResult::Reachable() const {
+    return distance != numeric_limits<double>::infinity();
+}
+
+void NullReportSink::Route(const RouteResult&, bool) {}
+
+void NullReportSink::TaskStarted(int) {}
+
+void NullReportSink::Delivery(const DeliveryLeg&) {}
+
+void NullReportSink::ReturnLeg(int, const RouteResult&) {}
+
+void NullReportSink::Text(const string&) {}
+
+void NullReportSink::Flush() {}
+
+/**
+ * @brief Constructs a sink that buffers its reports before writing them to a stream.
+ * @param out The stream to write to, which must outlive the sink.
+ * @param capacity The number of bytes buffered before writing to the stream.
+ */
+BufferedReportSink::BufferedReportSink(ostream& out, size_t capacity)
+    : _out(out), _capacity(capacity) {
+    _buffer.reserve(capacity);
+}
+
+/**
+ * @brief Writes out anything still buffered.
+ */
+BufferedReportSink::~BufferedReportSink() {
+    Flush();
+}
+
+/**
+ * @brief Writes the buffer to the stream and flushes the stream.
+ */
+void BufferedReportSink::Flush() {
+    if (!_buffer.empty()) {
+        _out.write(_buffer.data(), _buffer.size());
+        _buffer.clear();
+    }
+    _out.flush();
+}
+
+/**
+ * @brief Writes the buffer to the stream once it has grown past its capacity.
+ */
+void BufferedReportSink::Commit() {
+    if (_buffer.size() >= _capacity) {
+        _out.write(_buffer.data(), _buffer.size());
+        _buffer.clear();
+    }
+}
+
+/**
+ * @brief Appends a path to a string as a sequence of node ids.
+ *
+ * @param path The nodes on the path.
+ * @param out The string to append to.
+ */
+static void append_path(const vector<int>& path, string& out) {
+    for (int i = 0; i < (int)path.size(); i++) {
+        out += to_string(path[i]);
+
+        if (i < (int)path.size() - 1) {
+            out += " -> ";
+        }
+    }
+}
+
+/**
+ * @brief Appends a distance to a string, formatted as a stream would by default.
+ *
+ * @param distance The distance.
+ * @param out The string to append to.
+ */
+static void append_distance(double distance, string& out) {
+    char text[32];
+    snprintf(text, sizeof(text), "%g", distance);
+    out += text;
+}
+
+/**
+ * @brief Reports a route as its path, preceded by its end nodes and followed by its length if a summary is asked for.
+ * @param route The route found.
+ * @param summary True to report the end nodes and length as well as the path.
+ */
+void TextReportSink::Route(const RouteResult& route, bool summary) {
+    if (summary) {
+        _buffer += "The shortest path between nodes " + to_string(route.source) + " and "
+            + to_string(route.target) + ":\n";
+    }
+    append_path(route.path, _buffer);
+    if (summary) {
+        _buffer += "\nPath distance: ";
+        append_distance(route.distance, _buffer);
+        _buffer += '\n';
+    }
+    Commit();
+}
+
+/**
+ * @brief Reports the start of a task as a heading.
+ * @param number The number of the task in its queue.
+ */
+void TextReportSink::TaskStarted(int number) {
+    _buffer += "Task " + to_string(number) + ":\n";
+    Commit();
+}
+
+/**
+ * @brief Reports a delivery as a sentence ending with the path driven.
+ * @param leg The delivery.
+ */
+void TextReportSink::Delivery(const DeliveryLeg& leg) {
+    _buffer += "Robot " + to_string(leg.robot_id) + " delivers " + to_string(leg.packages)
+        + (leg.packages == 1 ? " package" : " packages") + " to house " + to_string(leg.house) + ", via: ";
+    append_path(leg.route.path, _buffer);
+    _buffer += '\n';
+    Commit();
+}
+
+/**
+ * @brief Reports the return to the store as a sentence ending with the path driven.
+ * @param robot_id The ID of the robot returning.
+ * @param route The route from the last house to the store.
+ */
+void TextReportSink::ReturnLeg(int robot_id, const RouteResult& route) {
+    _buffer += "Robot " + to_string(robot_id) + " returns to the store, via: ";
+    append_path(route.path, _buffer);
+    _buffer += '\n';
+    Commit();
+}
+
+/**
+ * @brief Reports a line of text as it is.
+ * @param text The text.
+ */
+void TextReportSink::Text(const string& text) {
+    _buffer += text;
+    _buffer += '\n';
+    Commit();
+}
+
+/**
+ * @brief Appends the JSON fields of a route to a string, without enclosing braces.
+ *
+ * @param route The route.
+ * @param out The string to append to.
+ */
+static void append_json_route(const RouteResult& route, string& out) {
+    out += "\"source\":" + to_string(route.source) + ",\"target\":" + to_string(route.target)
+        + ",\"distance\":";
+    if (route.Reachable()) {
+        char text[32];
+        snprintf(text, sizeof(text), "%.17g", route.distance);
+        out += text;
+    }
+    else {
+        out += "null";
+    }
+    out += ",\"path\":[";
+    for (int i = 0; i < (int)route.path.size(); i++) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += to_string(route.path[i]);
+    }
+    out += ']';
+}
+
+/**
+ * @brief Reports a route as a JSON object of type route.
+ * @param route The route found.
+ */
+void JsonLinesReportSink::Route(const RouteResult& route, bool) {
+    _buffer += "{\"type\":\"route\",";
+    append_json_route(route, _buffer);
+    _buffer += "}\n";
+    Commit();
+}
+
+/**
+ * @brief Reports the start of a task as a JSON object of type task.
+ * @param number The number of the task in its queue.
+ */
+void JsonLinesReportSink::TaskStarted(int number) {
+    _buffer += "{\"type\":\"task\",\"number\":" + to_string(number) + "}\n";
+    Commit();
+}
+
+/**
+ * @brief Reports a delivery as a JSON object of type delivery.
+ * @param leg The delivery.
+ */
+void JsonLinesReportSink::Delivery(const DeliveryLeg& leg) {
+    _buffer += "{\"type\":\"delivery\",\"robot\":" + to_string(leg.robot_id) + ",\"house\":"
+        + to_string(leg.house) + ",\"packages\":" + to_string(leg.packages) + ',';
+    append_json_route(leg.route, _buffer);
+    _buffer += "}\n";
+    Commit();
+}
+
+/**
+ * @brief Reports the return to the store as a JSON object of type return.
+ * @param robot_id The ID of the robot returning.
+ * @param route The route from the last house to the store.
+ */
+void JsonLinesReportSink::ReturnLeg(int robot_id, const RouteResult& route) {
+    _buffer += "{\"type\":\"return\",\"robot\":" + to_string(robot_id) + ',';
+    append_json_route(route, _buffer);
+    _buffer += "}\n";
+    Commit();
+}
+
+/**
+ * @brief Reports a line of text as a JSON object of type text, escaping it as a JSON string.
+ * @param text The text.
+ */
+void JsonLinesReportSink::Text(const string& text) {
+    _buffer += "{\"type\":\"text\",\"text\":\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            _buffer += '\\';
+            _buffer += (char)c;
+        }
+        else if (c == '\n') {
+            _buffer += "\\n";
+        }
+        else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            _buffer += escape;
+        }
+        else {
+            _buffer += (char)c;
+        }
+    }
+    _buffer += "\"}\n";
+    Commit();
+}
+
+template <typename T>
+void BinaryReportSink::Put(const T& value) {
+    _buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * @brief Appends the fields of a route record to the buffer.
+ * @param route The route.
+ */
+void BinaryReportSink::PutRoute(const RouteResult& route) {
+    Put<int32_t>(route.source);
+    Put<int32_t>(route.target);
+    Put<double>(route.distance);
+    Put<uint32_t>((uint32_t)route.path.size());
+    for (int node : route.path) {
+        Put<int32_t>(node);
+    }
+}
+
+/**
+ * @brief Reports a route as a record of type 1.
+ * @param route The route found.
+ */
+void BinaryReportSink::Route(const RouteResult& route, bool) {
+    Put<uint8_t>(1);
+    PutRoute(route);
+    Commit();
+}
+
+/**
+ * @brief Reports the start of a task as a record of type 2.
+ * @param number The number of the task in its queue.
+ */
+void BinaryReportSink::TaskStarted(int number) {
+    Put<uint8_t>(2);
+    Put<int32_t>(number);
+    Commit();
+}
+
+/**
+ * @brief Reports a delivery as a record of type 3.
+ * @param leg The delivery.
+ */
+void BinaryReportSink::Delivery(const DeliveryLeg& leg) {
+    Put<uint8_t>(3);
+    Put<int32_t>(leg.robot_id);
+    Put<int32_t>(leg.house);
+    Put<int32_t>(leg.packages);
+    PutRoute(leg.route);
+    Commit();
+}
+
+/**
+ * @brief Reports the return to the store as a record of type 5.
+ * @param robot_id The ID of the robot returning.
+ * @param route The route from the last house to the store.
+ */
+void BinaryReportSink::ReturnLeg(int robot_id, const RouteResult& route) {
+    Put<uint8_t>(5);
+    Put<int32_t>(robot_id);
+    PutRoute(route);
+    Commit();
+}
+
+/**
+ * @brief Reports a line of text as a record of type 4.
+ * @param text The text.
+ */
+void BinaryReportSink::Text(const string& text) {
+    Put<uint8_t>(4);
+    Put<uint32_t>((uint32_t)text.size());
+    _buffer += text;
+    Commit();
+}
@@ -0,0 +1,175 @@
+/**
+ * @file route_report.h
+ * @brief Defines route results and the sinks that report them.
+ */
+#ifndef ROUTE_REPORT_H
+#define ROUTE_REPORT_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// The shortest route found between two nodes.
+struct RouteResult {
+    /// The node the route starts from.
+    int source;
+
+    /// The node the route leads to.
+    int target;
+
+    /// The length of the route, infinity if the target is unreachable.
+    double distance;
+
+    /// The nodes on the route, starting at the source, or an empty list if the target is unreachable.
+    std::vector<int> path;
+
+    /// Returns true if the target can be reached from the source.
+    bool Reachable() const;
+};
+
+/// One delivery of a task: the packages left at a house and the route driven to it.
+struct DeliveryLeg {
+    /// The ID of the robot making the delivery.
+    int robot_id;
+
+    /// The ID of the house delivered to.
+    int house;
+
+    /// The number of packages delivered.
+    int packages;
+
+    /// The route from the previous stop to the house.
+    RouteResult route;
+};
+
+/// Receives the results of routing and task execution for reporting.
+/// Routing code hands its results to a sink instead of writing to the console, so the
+/// same run can print text, log JSON, write binary records or report nothing at all.
+class ReportSink {
+public:
+    /// Destructor.
+    virtual ~ReportSink() = default;
+
+    /// Reports a point-to-point route.
+    /// \param route The route found.
+    /// \param summary True to report which nodes were asked for and the length, false for just the path.
+    virtual void Route(const RouteResult& route, bool summary) = 0;
+
+    /// Reports that a task is starting.
+    /// \param number The number of the task in its queue, starting from 1.
+    virtual void TaskStarted(int number) = 0;
+
+    /// Reports a delivery made during a task.
+    /// \param leg The delivery.
+    virtual void Delivery(const DeliveryLeg& leg) = 0;
+
+    /// Reports the drive back to the store that ends a task.
+    /// \param robot_id The ID of the robot returning.
+    /// \param route The route from the last house to the store.
+    virtual void ReturnLeg(int robot_id, const RouteResult& route) = 0;
+
+    /// Reports a line of free text, such as a heading.
+    /// \param text The text, without a line break.
+    virtual void Text(const std::string& text) = 0;
+
+    /// Writes out anything still buffered.
+    virtual void Flush() = 0;
+};
+
+/// Discards every report, for headless runs where only the results matter.
+class NullReportSink : public ReportSink {
+public:
+    void Route(const RouteResult& route, bool summary) override;
+    void TaskStarted(int number) override;
+    void Delivery(const DeliveryLeg& leg) override;
+    void ReturnLeg(int robot_id, const RouteResult& route) override;
+    void Text(const std::string& text) override;
+    void Flush() override;
+};
+
+/// A sink that formats reports into a buffer and writes it to a stream in large blocks.
+/// The buffer is written when it grows past its capacity, on Flush and on destruction,
+/// so a run writes to the stream a handful of times rather than once per line.
+class BufferedReportSink : public ReportSink {
+public:
+    /// Constructor.
+    /// \param out The stream to write to, which must outlive the sink.
+    /// \param capacity The number of bytes buffered before writing to the stream.
+    explicit BufferedReportSink(std::ostream& out, size_t capacity = 1 << 16);
+
+    /// Destructor. Writes out anything still buffered.
+    ~BufferedReportSink() override;
+
+    BufferedReportSink(const BufferedReportSink&) = delete;
+    BufferedReportSink& operator=(const BufferedReportSink&) = delete;
+
+    /// Writes the buffer to the stream and flushes the stream.
+    void Flush() override;
+
+protected:
+    /// Writes the buffer to the stream if it has grown past its capacity.
+    void Commit();
+
+    /// The formatted reports not yet written.
+    std::string _buffer;
+
+private:
+    /// The stream written to.
+    std::ostream& _out;
+
+    /// The number of bytes buffered before writing to the stream.
+    size_t _capacity;
+};
+
+/// Reports in the human-readable text the demo programme prints.
+class TextReportSink : public BufferedReportSink {
+public:
+    using BufferedReportSink::BufferedReportSink;
+
+    void Route(const RouteResult& route, bool summary) override;
+    void TaskStarted(int number) override;
+    void Delivery(const DeliveryLeg& leg) override;
+    void ReturnLeg(int robot_id, const RouteResult& route) override;
+    void Text(const std::string& text) override;
+};
+
+/// Reports one JSON object per line, with a "type" of route, task, delivery, return or text.
+/// Unreachable distances are written as null.
+class JsonLinesReportSink : public BufferedReportSink {
+public:
+    using BufferedReportSink::BufferedReportSink;
+
+    void Route(const RouteResult& route, bool summary) override;
+    void TaskStarted(int number) override;
+    void Delivery(const DeliveryLeg& leg) override;
+    void ReturnLeg(int robot_id, const RouteResult& route) override;
+    void Text(const std::string& text) override;
+};
+
+/// Reports fixed-layout binary records in the byte order of the writer.
+/// Each record starts with a one-byte type:
+/// 1 route: int32 source, int32 target, float64 distance, uint32 path length, int32 path nodes;
+/// 2 task: int32 number;
+/// 3 delivery: int32 robot ID, int32 house, int32 packages, then the fields of a route record;
+/// 4 text: uint32 length, then the bytes of the text;
+/// 5 return: int32 robot ID, then the fields of a route record.
+class BinaryReportSink : public BufferedReportSink {
+public:
+    using BufferedReportSink::BufferedReportSink;
+
+    void Route(const RouteResult& route, bool summary) override;
+    void TaskStarted(int number) override;
+    void Delivery(const DeliveryLeg& leg) override;
+    void ReturnLeg(int robot_id, const RouteResult& route) override;
+    void Text(const std::string& text) override;
+
+private:
+    /// Appends the bytes of a value to the buffer.
+    template <typename T>
+    void Put(const T& value);
+
+    /// Appends the fields of a route record to the buffer.
+    void PutRoute(const RouteResult& route);
+};
+
+#endif
@@ -0,0 +1,998 @@
+/**
+ * @file route_server.cpp
+ * @brief Implements the route query batcher, the TCP route server and its client.
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "route_server.h"
+#include "thread_pool.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace std;
+
+/// The largest message body accepted, so a corrupt length cannot exhaust memory.
+static const uint32_t max_message_size = 1u << 24;
+
+/// The reply bytes a connection may have waiting before its requests stop being read.
+static const size_t max_output_backlog = 1u << 22;
+
+/// Appends an unsigned byte to a message.
+static void put_u8(string& out, uint8_t value) { out.push_back((char)value); }
+
+/// Appends an unsigned 32-bit integer to a message, little-endian.
+static void put_u32(string& out, uint32_t value) {
+    for (int i=0; i<4; i++) {
+        out.push_back((char)(value >> (8 * i)));
+    }
+}
+
+/// Appends a signed 32-bit integer to a message, little-endian.
+static void put_i32(string& out, int value) { put_u32(out, (uint32_t)value); }
+
+/// Appends a double to a message, little-endian.
+static void put_f64(string& out, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i=0; i<8; i++) {
+        out.push_back((char)(bits >> (8 * i)));
+    }
+}
+
+/// Starts a message, leaving room for its length.
+static string begin_message() { return string(4, '\0'); }
+
+/// Writes the length of a message's body into its first four bytes.
+static void end_message(string& message) {
+    const uint32_t length = (uint32_t)(message.size() - 4);
+    for (int i=0; i<4; i++) {
+        message[i] = (char)(length >> (8 * i));
+    }
+}
+
+/// Reads little-endian fields from a message body, noting whether it ran out of bytes.
+class MessageReader {
+public:
+    /// Constructor.
+    /// \param data The body.
+    /// \param size The number of bytes of the body.
+    MessageReader(const char* data, size_t size): _data((const unsigned char*)data), _size(size) {}
+
+    /// Reads an unsigned byte.
+    uint8_t U8() { return Has(1) ? _data[_pos++] : 0; }
+
+    /// Reads an unsigned 32-bit integer.
+    uint32_t U32() {
+        if (!Has(4)) {
+            return 0;
+        }
+        uint32_t value = 0;
+        for (int i=0; i<4; i++) {
+            value |= (uint32_t)_data[_pos++] << (8 * i);
+        }
+        return value;
+    }
+
+    /// Reads a signed 32-bit integer.
+    int I32() { return (int)U32(); }
+
+    /// Reads a double.
+    double F64() {
+        if (!Has(8)) {
+            return 0.0;
+        }
+        uint64_t bits = 0;
+        for (int i=0; i<8; i++) {
+            bits |= (uint64_t)_data[_pos++] << (8 * i);
+        }
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /// Reads a string of a given length.
+    string Text(uint32_t length) {
+        if (!Has(length)) {
+            return string();
+        }
+        string text((const char*)_data + _pos, length);
+        _pos += length;
+        return text;
+    }
+
+    /// Returns true if a count of items of a given size fits in the bytes left, so it is safe to reserve.
+    bool Fits(uint32_t count, size_t item_size) { return _ok && count <= (_size - _pos) / item_size; }
+
+    /// Returns true if every read so far found its bytes.
+    bool Ok() const { return _ok; }
+
+    /// Returns true if every read found its bytes and the whole body has been read.
+    bool Finished() const { return _ok && _pos == _size; }
+
+private:
+    /// Returns true if the given number of bytes are left, and marks the body short otherwise.
+    bool Has(size_t bytes) {
+        if (!_ok || _size - _pos < bytes) {
+            _ok = false;
+            return false;
+        }
+        return true;
+    }
+
+    /// The body.
+    const unsigned char* _data;
+
+    /// The number of bytes of the body.
+    size_t _size;
+
+    /// The number of bytes read.
+    size_t _pos = 0;
+
+    /// False once a read ran out of bytes.
+    bool _ok = true;
+};
+
+/**
+ * @brief Builds a reply reporting a failure.
+ *
+ * @param type The kind of the request.
+ * @param id The id of the request.
+ * @param status The outcome.
+ * @param text The description of the failure.
+ * @return The framed reply.
+ */
+static string failure_reply(RequestType type, uint32_t id, ReplyStatus status, const string& text) {
+    string reply = begin_message();
+    put_u8(reply, (uint8_t)type);
+    put_u32(reply, id);
+    put_u8(reply, (uint8_t)status);
+    put_u32(reply, (uint32_t)text.size());
+    reply += text;
+    end_message(reply);
+    return reply;
+}
+
+/**
+ * @brief Builds a reply reporting the exception a request failed with.
+ *
+ * @param type The kind of the request.
+ * @param id The id of the request.
+ * @param error The exception.
+ * @return The framed reply, with InvalidArgument for std::invalid_argument and InternalError otherwise.
+ */
+static string exception_reply(RequestType type, uint32_t id, exception_ptr error) {
+    try {
+        rethrow_exception(error);
+    }
+    catch (const invalid_argument& e) {
+        return failure_reply(type, id, ReplyStatus::InvalidArgument, e.what());
+    }
+    catch (const exception& e) {
+        return failure_reply(type, id, ReplyStatus::InternalError, e.what());
+    }
+    catch (...) {
+        return failure_reply(type, id, ReplyStatus::InternalError, "Unknown error");
+    }
+}
+
+/**
+ * @brief Builds the reply to a route request.
+ *
+ * @param id The id of the request.
+ * @param route The route found.
+ * @param error The exception the query failed with, or a null pointer.
+ * @return The framed reply.
+ */
+static string route_reply(uint32_t id, const RouteResult& route, exception_ptr error) {
+    if (error) {
+        return exception_reply(RequestType::Route, id, error);
+    }
+    if (!route.Reachable()) {
+        return failure_reply(RequestType::Route, id, ReplyStatus::Unreachable,
+                             "The target cannot be reached from the source");
+    }
+    string reply = begin_message();
+    put_u8(reply, (uint8_t)RequestType::Route);
+    put_u32(reply, id);
+    put_u8(reply, (uint8_t)ReplyStatus::Ok);
+    put_f64(reply, route.distance);
+    put_u32(reply, (uint32_t)route.path.size());
+    for (int node : route.path) {
+        put_i32(reply, node);
+    }
+    end_message(reply);
+    return reply;
+}
+
+/**
+ * @brief Builds the reply to a plan request.
+ *
+ * @param id The id of the request.
+ * @param distance The total length of the trips.
+ * @param trips The trips planned.
+ * @return The framed reply.
+ */
+static string plan_reply(uint32_t id, double distance, const vector<Trip>& trips) {
+    string reply = begin_message();
+    put_u8(reply, (uint8_t)RequestType::Plan);
+    put_u32(reply, id);
+    put_u8(reply, (uint8_t)ReplyStatus::Ok);
+    put_f64(reply, distance);
+    put_u32(reply, (uint32_t)trips.size());
+    for (const Trip& trip : trips) {
+        put_u32(reply, (uint32_t)trip.size());
+        for (const auto& order : trip) {
+            put_i32(reply, order.first);
+            put_i32(reply, order.second);
+        }
+    }
+    end_message(reply);
+    return reply;
+}
+
+/**
+ * @brief Makes a socket non-blocking.
+ *
+ * @param fd The socket.
+ * @throws runtime_error If the flags cannot be changed.
+ */
+static void set_non_blocking(int fd) {
+    const int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw runtime_error(string("Cannot make socket non-blocking: ") + strerror(errno));
+    }
+}
+
+/**
+ * @brief Builds an IPv4 socket address.
+ *
+ * @param port The TCP port.
+ * @param address The dotted IPv4 address.
+ * @return The socket address.
+ * @throws runtime_error If the address is malformed.
+ */
+static sockaddr_in socket_address(int port, const string& address) {
+    sockaddr_in socket_address{};
+    socket_address.sin_family = AF_INET;
+    socket_address.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1) {
+        throw runtime_error("Malformed IPv4 address: " + address);
+    }
+    return socket_address;
+}
+
+// Implementation of RouteBatcher class
+
+/**
+ * @brief Constructs a batcher.
+ *
+ * @param graph The graph to route on.
+ * @param pool The threads to run the searches on.
+ * @param max_batch The most queries of one source answered by one search.
+ * @param tree_threshold The number of queries of one source at which its tree is memoised.
+ * @throws invalid_argument If max_batch or tree_threshold is not positive.
+ */
+RouteBatcher::RouteBatcher(const VersionedGraph& graph, ThreadPool& pool, int max_batch, int tree_threshold):
+    _graph(graph), _pool(pool), _max_batch(max_batch), _tree_threshold(tree_threshold) {
+    if (max_batch <= 0 || tree_threshold <= 0) {
+        throw invalid_argument("Batch sizes must be positive");
+    }
+}
+
+/**
+ * @brief Waits for every query to be answered.
+ */
+RouteBatcher::~RouteBatcher() { Wait(); }
+
+/**
+ * @brief Queues a query, and a drain job if no drain is being answered.
+ *
+ * @param source The node to start from.
+ * @param target The node to reach.
+ * @param handler Receives the route.
+ */
+void RouteBatcher::Route(int source, int target, Handler handler) {
+    bool queue_drain;
+    {
+        lock_guard<mutex> lock(_mutex);
+        _pending[source].push_back(Query{target, move(handler)});
+        _outstanding++;
+        queue_drain = !_draining;
+        _draining = true;
+    }
+    if (queue_drain) {
+        _pool.Submit([this]() { Drain(); });
+    }
+}
+
+/**
+ * @brief Waits until every query queued so far has been answered.
+ *
+ * Must not be called from a handler or a worker of the pool, which answers the queries.
+ */
+void RouteBatcher::Wait() {
+    unique_lock<mutex> lock(_mutex);
+    _idle.wait(lock, [this]() { return _outstanding == 0; });
+}
+
+/**
+ * @brief Returns the number of queries answered.
+ *
+ * @return The number of queries.
+ */
+uint64_t RouteBatcher::NumQueries() const { return _num_queries.load(); }
+
+/**
+ * @brief Returns the number of batches the queries were answered in.
+ *
+ * @return The number of batches. NumQueries() / NumBatches() is the mean batch size.
+ */
+uint64_t RouteBatcher::NumBatches() const { return _num_batches.load(); }
+
+/**
+ * @brief Takes every waiting query and answers it.
+ *
+ * Every batch of the drain routes on the same version of the graph. The batches
+ * of all but the last source are queued as jobs of their own, for idle workers
+ * to steal, and the last is answered on this thread.
+ */
+void RouteBatcher::Drain() {
+    unordered_map<int, vector<Query>> pending;
+    vector<pair<int, vector<Query>>> batches;
+    {
+        lock_guard<mutex> lock(_mutex);
+        pending.swap(_pending);
+        for (auto& source : pending) {
+            vector<Query>& queries = source.second;
+            for (size_t first = 0; first < queries.size(); first += _max_batch) {
+                const size_t last = min(queries.size(), first + (size_t)_max_batch);
+                batches.emplace_back(source.first, vector<Query>(make_move_iterator(queries.begin() + first),
+                                                                 make_move_iterator(queries.begin() + last)));
+            }
+        }
+        _batches_left = (int)batches.size();
+    }
+    pending.clear();
+
+    auto version = make_shared<const VersionedGraph::ReadGuard>(_graph.Read());
+    for (size_t i=0; i+1<batches.size(); i++) {
+        _pool.Submit([this, version, source = batches[i].first, queries = move(batches[i].second)]() mutable {
+            Answer(move(version), source, move(queries));
+        });
+    }
+    Answer(move(version), batches.back().first, move(batches.back().second));
+}
+
+/**
+ * @brief Answers the queries of one source with one search.
+ *
+ * Queries naming nodes outside the graph are answered with an
+ * invalid_argument, and the rest share a search from the source that stops
+ * at their last target. A batch of at least the tree threshold grows the
+ * source's whole tree instead, which the graph memoises for later batches.
+ * Ids are translated to and from the graph's internal numbering.
+ *
+ * @param version The version of the graph to route on, released once the routes are found.
+ * @param source The node to start from.
+ * @param queries The queries.
+ */
+void RouteBatcher::Answer(shared_ptr<const VersionedGraph::ReadGuard> version, int source, vector<Query> queries) {
+    const Graph& graph = **version;
+    const int num_nodes = graph.NumNodes();
+    const bool valid_source = source >= 0 && source < num_nodes;
+    vector<int> targets;
+    vector<Query*> routed;
+    targets.reserve(queries.size());
+    routed.reserve(queries.size());
+    for (Query& query : queries) {
+        if (valid_source && query.target >= 0 && query.target < num_nodes) {
+            targets.push_back(graph.InternalId(query.target));
+            routed.push_back(&query);
+        }
+        else {
+            const RouteResult route{source, query.target, numeric_limits<double>::infinity(), {}};
+            query.handler(route, make_exception_ptr(invalid_argument("Route refers to a node outside the graph")));
+        }
+    }
+
+    if (!targets.empty()) {
+        vector<RouteResult> routes;
+        exception_ptr error;
+        try {
+            const int internal_source = graph.InternalId(source);
+            if ((int)targets.size() >= _tree_threshold) {
+                graph.DistancesFrom(internal_source);
+            }
+            routes = graph.RoutesFrom(internal_source, targets);
+            for (RouteResult& route : routes) {
+                graph.GetRenumbering().ToExternal(route);
+            }
+        }
+        catch (...) {
+            error = current_exception();
+        }
+        version.reset();
+        for (size_t i=0; i<routed.size(); i++) {
+            if (error) {
+                routed[i]->handler(RouteResult{source, routed[i]->target, numeric_limits<double>::infinity(), {}},
+                                   error);
+            }
+            else {
+                routed[i]->handler(move(routes[i]), nullptr);
+            }
+        }
+    }
+    version.reset();
+
+    const int num_queries = (int)queries.size();
+    queries.clear();
+    _num_queries += num_queries;
+    _num_batches++;
+    Finish(num_queries);
+}
+
+/**
+ * @brief Marks the queries of a batch answered.
+ *
+ * The last batch of a drain queues the next drain if queries arrived while it
+ * was being answered. Those queries keep Wait blocked, so the batcher is still
+ * alive while the drain is queued.
+ *
+ * @param num_queries The number of queries of the batch.
+ */
+void RouteBatcher::Finish(int num_queries) {
+    bool queue_drain = false;
+    {
+        lock_guard<mutex> lock(_mutex);
+        _outstanding -= num_queries;
+        if (--_batches_left == 0) {
+            queue_drain = !_pending.empty();
+            _draining = queue_drain;
+        }
+        if (_outstanding == 0) {
+            _idle.notify_all();
+        }
+    }
+    if (queue_drain) {
+        _pool.Submit([this]() { Drain(); });
+    }
+}
+
+/// A client connection of the server.
+struct RouteServer::Connection {
+    /// Constructor.
+    /// \param fd The connected socket, which the connection closes.
+    explicit Connection(int fd): fd(fd) {}
+
+    /// Destructor. Closes the socket.
+    ~Connection() { close(fd); }
+
+    /// The connected socket.
+    int fd;
+
+    /// Bytes received and not yet parsed, used only by the polling thread.
+    string input;
+
+    /// Guards output, sent and closed.
+    mutex lock;
+
+    /// Replies waiting to be sent.
+    string output;
+
+    /// The number of bytes of output already sent.
+    size_t sent = 0;
+
+    /// True once the connection has been dropped, after which replies are discarded.
+    bool closed = false;
+};
+
+// Implementation of RouteServer class
+
+/**
+ * @brief Constructs a server, not yet listening.
+ *
+ * @param graph The graph to answer requests on.
+ * @param pool The threads to route and plan on.
+ * @param max_batch The most route queries of one source answered by one search.
+ * @throws runtime_error If the wake-up pipe cannot be made.
+ */
+RouteServer::RouteServer(const VersionedGraph& graph, ThreadPool& pool, int max_batch):
+    _graph(graph), _pool(pool), _batcher(graph, pool, max_batch) {
+    if (pipe(_wake_fds) != 0) {
+        throw runtime_error(string("Cannot make pipe: ") + strerror(errno));
+    }
+    set_non_blocking(_wake_fds[0]);
+    set_non_blocking(_wake_fds[1]);
+}
+
+/**
+ * @brief Waits for every request being answered, then closes the sockets.
+ */
+RouteServer::~RouteServer() {
+    Stop();
+    {
+        unique_lock<mutex> lock(_mutex);
+        _idle.wait(lock, [this]() { return _in_flight == 0; });
+    }
+    if (_listen_fd >= 0) {
+        close(_listen_fd);
+    }
+    close(_wake_fds[0]);
+    close(_wake_fds[1]);
+}
+
+/**
+ * @brief Starts listening for connections.
+ *
+ * @param port The TCP port, or 0 to take any free port.
+ * @param address The IPv4 address to listen on.
+ * @return The port listened on.
+ * @throws runtime_error If the socket cannot be opened or bound.
+ */
+int RouteServer::Listen(int port, const string& address) {
+    const sockaddr_in bind_address = socket_address(port, address);
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw runtime_error(string("Cannot open socket: ") + strerror(errno));
+    }
+    const int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in bound{};
+    socklen_t bound_size = sizeof(bound);
+    if (bind(fd, (const sockaddr*)&bind_address, sizeof(bind_address)) != 0 || listen(fd, SOMAXCONN) != 0
+        || getsockname(fd, (sockaddr*)&bound, &bound_size) != 0) {
+        const string error = strerror(errno);
+        close(fd);
+        throw runtime_error("Cannot listen on " + address + ":" + to_string(port) + ": " + error);
+    }
+    try {
+        set_non_blocking(fd);
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+    if (_listen_fd >= 0) {
+        close(_listen_fd);
+    }
+    _listen_fd = fd;
+    return ntohs(bound.sin_port);
+}
+
+/**
+ * @brief Serves connections until Stop is called.
+ *
+ * Each round polls the listening socket, the wake-up pipe and every
+ * connection, reads whatever has arrived, dispatches the complete requests,
+ * and sends whatever replies are waiting. A connection with a large backlog
+ * of unsent replies is not read from until its client catches up.
+ *
+ * @throws logic_error If Listen has not been called.
+ * @throws runtime_error If polling fails.
+ */
+void RouteServer::Serve() {
+    if (_listen_fd < 0) {
+        throw logic_error("The server must listen before it can serve");
+    }
+    vector<shared_ptr<Connection>> connections;
+    vector<pollfd> fds;
+    char buffer[1 << 16];
+    while (!_stopping.load()) {
+        fds.clear();
+        fds.push_back(pollfd{_listen_fd, POLLIN, 0});
+        fds.push_back(pollfd{_wake_fds[0], POLLIN, 0});
+        for (const auto& connection : connections) {
+            lock_guard<mutex> lock(connection->lock);
+            const size_t backlog = connection->output.size() - connection->sent;
+            short events = backlog < max_output_backlog ? POLLIN : 0;
+            if (backlog > 0) {
+                events |= POLLOUT;
+            }
+            fds.push_back(pollfd{connection->fd, events, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error(string("Cannot poll sockets: ") + strerror(errno));
+        }
+        if (fds[1].revents & POLLIN) {
+            while (read(_wake_fds[0], buffer, sizeof(buffer)) > 0) {}
+        }
+
+        for (size_t i=0; i<connections.size(); i++) {
+            Connection& connection = *connections[i];
+            bool open = true;
+            if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+                const ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+                if (received > 0) {
+                    connection.input.append(buffer, received);
+                    open = HandleInput(connections[i]);
+                }
+                else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    open = false;
+                }
+            }
+
+            // Send eagerly, since replies queued since the last poll are likely to fit
+            lock_guard<mutex> lock(connection.lock);
+            while (open && connection.sent < connection.output.size()) {
+                const ssize_t written = send(connection.fd, connection.output.data() + connection.sent,
+                                             connection.output.size() - connection.sent, MSG_NOSIGNAL);
+                if (written > 0) {
+                    connection.sent += written;
+                }
+                else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                else if (written >= 0 || errno != EINTR) {
+                    open = false;
+                }
+            }
+            if (connection.sent == connection.output.size()) {
+                connection.output.clear();
+                connection.sent = 0;
+            }
+            connection.closed = !open;
+        }
+        auto dropped = remove_if(connections.begin(), connections.end(),
+                                 [](const shared_ptr<Connection>& connection) { return connection->closed; });
+        connections.erase(dropped, connections.end());
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(_listen_fd, nullptr, nullptr)) >= 0) {
+                auto connection = make_shared<Connection>(fd);
+                const int no_delay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+                set_non_blocking(fd);
+                connections.push_back(move(connection));
+            }
+        }
+    }
+
+    for (const auto& connection : connections) {
+        lock_guard<mutex> lock(connection->lock);
+        connection->closed = true;
+    }
+}
+
+/**
+ * @brief Makes Serve return.
+ */
+void RouteServer::Stop() {
+    _stopping = true;
+    const char wake = 0;
+    if (write(_wake_fds[1], &wake, 1) < 0) {
+        // The pipe is full, so the polling thread is already due to wake
+    }
+}
+
+/**
+ * @brief Returns the route batcher.
+ *
+ * @return The batcher answering the route queries.
+ */
+const RouteBatcher& RouteServer::Batcher() const { return _batcher; }
+
+/**
+ * @brief Parses and dispatches every complete request a connection has received.
+ *
+ * Requests of an unknown type or with malformed fields are answered with
+ * InvalidArgument. A frame too long to be a request cannot be skipped safely,
+ * so it closes the connection.
+ *
+ * @param connection The connection.
+ * @return False if the connection should be closed.
+ */
+bool RouteServer::HandleInput(const shared_ptr<Connection>& connection) {
+    const string& input = connection->input;
+    size_t pos = 0;
+    while (input.size() - pos >= 4) {
+        MessageReader header(input.data() + pos, 4);
+        const uint32_t length = header.U32();
+        if (length > max_message_size) {
+            return false;
+        }
+        if (input.size() - pos - 4 < length) {
+            break;
+        }
+        MessageReader body(input.data() + pos + 4, length);
+        pos += 4 + length;
+
+        const RequestType type = (RequestType)body.U8();
+        const uint32_t id = body.U32();
+        if (type == RequestType::Route) {
+            const int source = body.I32();
+            const int target = body.I32();
+            if (!body.Finished()) {
+                Send(*connection, failure_reply(type, id, ReplyStatus::InvalidArgument, "Malformed route request"));
+                continue;
+            }
+            {
+                lock_guard<mutex> lock(_mutex);
+                _in_flight++;
+            }
+            _batcher.Route(source, target, [this, connection, id](RouteResult route, exception_ptr error) {
+                Send(*connection, route_reply(id, route, error));
+                Finish();
+            });
+        }
+        else if (type == RequestType::Plan) {
+            const int capacity = body.I32();
+            const int planner = body.U8();
+            const uint32_t num_orders = body.U32();
+            vector<pair<int,int>> orders;
+            if (body.Fits(num_orders, 8)) {
+                orders.reserve(num_orders);
+                for (uint32_t i=0; i<num_orders; i++) {
+                    const int house = body.I32();
+                    orders.emplace_back(house, body.I32());
+                }
+            }
+            if (!body.Finished()) {
+                Send(*connection, failure_reply(type, id, ReplyStatus::InvalidArgument, "Malformed plan request"));
+                continue;
+            }
+            Plan(connection, id, move(orders), capacity, planner);
+        }
+        else {
+            Send(*connection, failure_reply(type, id, ReplyStatus::InvalidArgument, "Unknown request type"));
+        }
+    }
+    connection->input.erase(0, pos);
+    return true;
+}
+
+/**
+ * @brief Plans trips for a list of orders on the pool and replies with them.
+ *
+ * The plan is made on the current version of the graph, with houses
+ * translated to its internal numbering and back.
+ *
+ * @param connection The connection to reply on.
+ * @param id The id of the request.
+ * @param orders The orders, as pairs of house IDs and package weights.
+ * @param capacity The carrying capacity of the robot.
+ * @param planner 0 for GreedyPlanner, 1 for SavingsPlanner.
+ */
+void RouteServer::Plan(const shared_ptr<Connection>& connection, uint32_t id, vector<pair<int,int>> orders,
+                       int capacity, int planner) {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _in_flight++;
+    }
+    _pool.Submit([this, connection, id, orders = move(orders), capacity, planner]() mutable {
+        string reply;
+        try {
+            if (capacity <= 0) {
+                throw invalid_argument("Capacity must be positive");
+            }
+            if (planner != 0 && planner != 1) {
+                throw invalid_argument("Unknown planner");
+            }
+            VersionedGraph::ReadGuard graph = _graph.Read();
+            for (auto& order : orders) {
+                if (order.first < 0 || order.first >= graph->NumNodes() || order.second < 0) {
+                    throw invalid_argument("Order refers to a node outside the graph or has negative packages");
+                }
+                order.first = graph->InternalId(order.first);
+            }
+            vector<Trip> trips = planner == 0 ? GreedyPlanner().PlanTrips(orders, capacity, *graph)
+                                              : SavingsPlanner().PlanTrips(orders, capacity, *graph);
+            double distance = 0.0;
+            for (Trip& trip : trips) {
+                distance += trip_distance(trip, *graph);
+                for (auto& order : trip) {
+                    order.first = graph->ExternalId(order.first);
+                }
+            }
+            reply = plan_reply(id, distance, trips);
+        }
+        catch (...) {
+            reply = exception_reply(RequestType::Plan, id, current_exception());
+        }
+        Send(*connection, reply);
+        Finish();
+    });
+}
+
+/**
+ * @brief Queues a reply on a connection and wakes the polling thread.
+ *
+ * @param connection The connection.
+ * @param reply The framed reply, discarded if the connection has been dropped.
+ */
+void RouteServer::Send(Connection& connection, const string& reply) {
+    {
+        lock_guard<mutex> lock(connection.lock);
+        if (connection.closed) {
+            return;
+        }
+        connection.output += reply;
+    }
+    const char wake = 0;
+    if (write(_wake_fds[1], &wake, 1) < 0) {
+        // The pipe is full, so the polling thread is already due to wake
+    }
+}
+
+/**
+ * @brief Marks a request answered.
+ */
+void RouteServer::Finish() {
+    lock_guard<mutex> lock(_mutex);
+    if (--_in_flight == 0) {
+        _idle.notify_all();
+    }
+}
+
+// Implementation of RouteClient class
+
+/**
+ * @brief Connects to a server.
+ *
+ * @param port The TCP port of the server.
+ * @param address The IPv4 address of the server.
+ * @throws runtime_error If the connection fails.
+ */
+RouteClient::RouteClient(int port, const string& address) {
+    const sockaddr_in server_address = socket_address(port, address);
+    _fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_fd < 0) {
+        throw runtime_error(string("Cannot open socket: ") + strerror(errno));
+    }
+    if (connect(_fd, (const sockaddr*)&server_address, sizeof(server_address)) != 0) {
+        const string error = strerror(errno);
+        close(_fd);
+        throw runtime_error("Cannot connect to " + address + ":" + to_string(port) + ": " + error);
+    }
+    const int no_delay = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+}
+
+/**
+ * @brief Closes the connection.
+ */
+RouteClient::~RouteClient() { close(_fd); }
+
+/**
+ * @brief Sends a route request.
+ *
+ * @param id The id the reply will carry.
+ * @param source The node to start from.
+ * @param target The node to reach.
+ */
+void RouteClient::SendRoute(uint32_t id, int source, int target) {
+    string request = begin_message();
+    put_u8(request, (uint8_t)RequestType::Route);
+    put_u32(request, id);
+    put_i32(request, source);
+    put_i32(request, target);
+    end_message(request);
+    SendAll(request);
+}
+
+/**
+ * @brief Sends a plan request.
+ *
+ * @param id The id the reply will carry.
+ * @param orders The orders, as pairs of house IDs and package weights.
+ * @param capacity The carrying capacity of the robot.
+ * @param savings True to plan with SavingsPlanner, false for GreedyPlanner.
+ */
+void RouteClient::SendPlan(uint32_t id, const vector<pair<int,int>>& orders, int capacity, bool savings) {
+    string request = begin_message();
+    put_u8(request, (uint8_t)RequestType::Plan);
+    put_u32(request, id);
+    put_i32(request, capacity);
+    put_u8(request, savings ? 1 : 0);
+    put_u32(request, (uint32_t)orders.size());
+    for (const auto& order : orders) {
+        put_i32(request, order.first);
+        put_i32(request, order.second);
+    }
+    end_message(request);
+    SendAll(request);
+}
+
+/**
+ * @brief Waits for the next reply and parses it.
+ *
+ * @return The reply.
+ * @throws runtime_error If the connection closes or the reply is malformed.
+ */
+Reply RouteClient::Receive() {
+    char buffer[1 << 16];
+    uint32_t length = 0;
+    while (true) {
+        if (_input.size() >= 4) {
+            length = MessageReader(_input.data(), 4).U32();
+            if (_input.size() - 4 >= length) {
+                break;
+            }
+        }
+        const ssize_t received = recv(_fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            throw runtime_error("The server closed the connection");
+        }
+        _input.append(buffer, received);
+    }
+
+    MessageReader body(_input.data() + 4, length);
+    Reply reply;
+    reply.type = (RequestType)body.U8();
+    reply.id = body.U32();
+    reply.status = (ReplyStatus)body.U8();
+    if (reply.status != ReplyStatus::Ok) {
+        reply.message = body.Text(body.U32());
+    }
+    else if (reply.type == RequestType::Route) {
+        reply.distance = body.F64();
+        const uint32_t num_nodes = body.U32();
+        if (body.Fits(num_nodes, 4)) {
+            reply.path.reserve(num_nodes);
+            for (uint32_t i=0; i<num_nodes; i++) {
+                reply.path.push_back(body.I32());
+            }
+        }
+    }
+    else {
+        reply.distance = body.F64();
+        const uint32_t num_trips = body.U32();
+        if (body.Fits(num_trips, 4)) {
+            reply.trips.resize(num_trips);
+            for (Trip& trip : reply.trips) {
+                const uint32_t num_orders = body.U32();
+                if (!body.Fits(num_orders, 8)) {
+                    break;
+                }
+                for (uint32_t i=0; i<num_orders; i++) {
+                    const int house = body.I32();
+                    trip.emplace_back(house, body.I32());
+                }
+            }
+        }
+    }
+    _input.erase(0, 4 + length);
+    if (!body.Finished()) {
+        throw runtime_error("Malformed reply");
+    }
+    return reply;
+}
+
+/**
+ * @brief Sends a whole message, however many writes it takes.
+ *
+ * @param message The framed message.
+ * @throws runtime_error If the connection fails.
+ */
+void RouteClient::SendAll(const string& message) {
+    size_t sent = 0;
+    while (sent < message.size()) {
+        const ssize_t written = send(_fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            throw runtime_error(string("Cannot send request: ") + strerror(errno));
+        }
+        sent += written;
+    }
+}
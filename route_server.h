@@ -0,0 +1,316 @@
+/**
+ * @file route_server.h
+ * @brief Defines a route and plan query service over TCP, which batches route queries by source.
+ *
+ * Requests and replies are framed in a simple binary protocol. Every integer is
+ * little-endian and every distance an IEEE 754 double, also little-endian. Each
+ * message is a u32 byte length followed by that many bytes of body.
+ *
+ * A request body is a u8 RequestType, a u32 id chosen by the client, and then
+ * - for RequestType::Route, an i32 source and an i32 target;
+ * - for RequestType::Plan, an i32 capacity, a u8 planner (0 for greedy, 1 for savings),
+ *   a u32 number of orders and that many pairs of an i32 house and an i32 number of packages.
+ *
+ * A reply body is the u8 type and u32 id of its request, a u8 ReplyStatus, and then
+ * - for a status other than ReplyStatus::Ok, a u32 length and that many bytes of message;
+ * - for a route, the f64 distance, a u32 number of nodes and that many i32 nodes;
+ * - for a plan, the f64 total distance, a u32 number of trips and, for each trip, a u32
+ *   number of orders and that many pairs of an i32 house and an i32 number of packages.
+ *
+ * Replies are sent as soon as they are ready, which need not be in the order of the
+ * requests, so clients may send many requests on one connection without waiting.
+ * Nodes are numbered as the map was loaded, whatever order the graph stores them in.
+ */
+#ifndef ROUTE_SERVER_H
+#define ROUTE_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "route_planner.h"
+#include "route_report.h"
+#include "versioned_graph.h"
+
+class ThreadPool;
+
+/// Answers route queries asynchronously, coalescing queries that share a source.
+/// Queries wait in a table keyed by source. A drain job takes every waiting query at once,
+/// pins the current version of the graph, and answers all the queries of each source with
+/// one search that stops once their last target is settled, the sources running as jobs of
+/// their own. Queries arriving while a drain is being answered wait for the next drain, which
+/// is queued once the last search of the current one finishes, so batches grow with the load
+/// and a lone query waits for no more than the searches already running.
+class RouteBatcher {
+public:
+    /// Receives the answer to a query: the route, or the exception that stopped it.
+    using Handler = std::function<void(RouteResult route, std::exception_ptr error)>;
+
+    /// Constructor.
+    /// \param graph The graph to route on, the latest version of which answers each batch.
+    /// \param pool The threads to run the searches on.
+    /// \param max_batch The most queries of one source answered by one search.
+    /// \param tree_threshold The number of queries of one source at which its whole shortest
+    /// path tree is grown and memoised, so later queries from it are lookups.
+    /// \throws std::invalid_argument If max_batch or tree_threshold is not positive.
+    RouteBatcher(const VersionedGraph& graph, ThreadPool& pool, int max_batch = 1024, int tree_threshold = 64);
+
+    /// Destructor. Waits for every query to be answered.
+    ~RouteBatcher();
+
+    RouteBatcher(const RouteBatcher&) = delete;
+    RouteBatcher& operator=(const RouteBatcher&) = delete;
+
+    /// Queues a query. The handler is called on a pool thread once the route is found, or with
+    /// a std::invalid_argument if either node is not on the map.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    /// \param handler Receives the route.
+    void Route(int source, int target, Handler handler);
+
+    /// Waits until every query queued so far has been answered.
+    void Wait();
+
+    /// Returns the number of queries answered.
+    uint64_t NumQueries() const;
+
+    /// Returns the number of batches the queries were answered in, one per source per drain.
+    uint64_t NumBatches() const;
+
+private:
+    /// A query waiting for its batch.
+    struct Query {
+        /// The node to reach.
+        int target;
+
+        /// Receives the route.
+        Handler handler;
+    };
+
+    /// Takes every waiting query and answers it, one job per source.
+    void Drain();
+
+    /// Answers the queries of one source on a version of the graph, releasing the version
+    /// and the queries before marking them answered.
+    void Answer(std::shared_ptr<const VersionedGraph::ReadGuard> version, int source, std::vector<Query> queries);
+
+    /// Marks the queries of a batch answered, queuing the next drain after the last batch of
+    /// a drain and waking Wait once no queries are left.
+    void Finish(int num_queries);
+
+    /// The graph to route on.
+    const VersionedGraph& _graph;
+
+    /// The threads to run the searches on.
+    ThreadPool& _pool;
+
+    /// The most queries of one source answered by one search.
+    int _max_batch;
+
+    /// The number of queries of one source at which its tree is memoised.
+    int _tree_threshold;
+
+    /// Guards _pending, _draining, _batches_left and _outstanding.
+    std::mutex _mutex;
+
+    /// Signalled when _outstanding falls to 0.
+    std::condition_variable _idle;
+
+    /// The waiting queries of each source.
+    std::unordered_map<int, std::vector<Query>> _pending;
+
+    /// True from when a drain is queued until its last batch is answered.
+    bool _draining = false;
+
+    /// The batches of the current drain not yet answered.
+    int _batches_left = 0;
+
+    /// The number of queries queued and not yet answered.
+    int _outstanding = 0;
+
+    /// The number of queries answered.
+    std::atomic<uint64_t> _num_queries{0};
+
+    /// The number of batches answered.
+    std::atomic<uint64_t> _num_batches{0};
+};
+
+/// The kinds of request.
+enum class RequestType : uint8_t {
+    /// The shortest route between two nodes.
+    Route = 1,
+
+    /// Trips grouping orders for a robot of a given capacity.
+    Plan = 2
+};
+
+/// The outcome of a request, numbered as the b16_status codes of the C interface.
+enum class ReplyStatus : uint8_t {
+    /// The request was answered.
+    Ok = 0,
+
+    /// The request was malformed or referred to nodes not on the map.
+    InvalidArgument = 1,
+
+    /// The target of a route cannot be reached from its source.
+    Unreachable = 3,
+
+    /// Any other failure.
+    InternalError = 6
+};
+
+/// A reply, as read by RouteClient.
+struct Reply {
+    /// The kind of the request.
+    RequestType type;
+
+    /// The id of the request.
+    uint32_t id;
+
+    /// The outcome.
+    ReplyStatus status;
+
+    /// The description of a failure, or empty.
+    std::string message;
+
+    /// The length of the route, or the total length of the trips.
+    double distance = 0.0;
+
+    /// The nodes of the route, starting at the source.
+    std::vector<int> path;
+
+    /// The trips of the plan.
+    std::vector<Trip> trips;
+};
+
+/// Serves route and plan requests over TCP from a graph kept in memory.
+/// One thread polls every connection and parses the requests; route queries go to a
+/// RouteBatcher and plans to the pool, and each reply is queued on its connection as soon
+/// as it is found. The graph, its memoised trees and its routing state stay warm across
+/// requests, and changes published to the graph apply to the requests that follow.
+class RouteServer {
+public:
+    /// Constructor.
+    /// \param graph The graph to answer requests on.
+    /// \param pool The threads to route and plan on.
+    /// \param max_batch The most route queries of one source answered by one search.
+    RouteServer(const VersionedGraph& graph, ThreadPool& pool, int max_batch = 1024);
+
+    /// Destructor. Waits for every request being answered, once Serve has returned.
+    ~RouteServer();
+
+    RouteServer(const RouteServer&) = delete;
+    RouteServer& operator=(const RouteServer&) = delete;
+
+    /// Starts listening for connections.
+    /// \param port The TCP port, or 0 to take any free port.
+    /// \param address The IPv4 address to listen on.
+    /// \return The port listened on.
+    /// \throws std::runtime_error If the socket cannot be opened or bound.
+    int Listen(int port, const std::string& address = "127.0.0.1");
+
+    /// Serves connections on the calling thread until Stop is called.
+    /// \throws std::logic_error If Listen has not been called.
+    void Serve();
+
+    /// Makes Serve return. Safe to call from any thread.
+    void Stop();
+
+    /// Returns the route batcher, for its statistics.
+    const RouteBatcher& Batcher() const;
+
+private:
+    struct Connection;
+
+    /// Parses and dispatches every complete request a connection has received.
+    /// \return False if the connection sent a malformed frame and should be closed.
+    bool HandleInput(const std::shared_ptr<Connection>& connection);
+
+    /// Answers a plan request on the pool.
+    void Plan(const std::shared_ptr<Connection>& connection, uint32_t id, std::vector<std::pair<int,int>> orders,
+              int capacity, int planner);
+
+    /// Queues a reply on a connection and wakes the polling thread to send it.
+    void Send(Connection& connection, const std::string& reply);
+
+    /// Marks a request answered, waking the destructor once none are left.
+    void Finish();
+
+    /// The graph to answer requests on.
+    const VersionedGraph& _graph;
+
+    /// The threads to route and plan on.
+    ThreadPool& _pool;
+
+    /// The listening socket, or -1.
+    int _listen_fd = -1;
+
+    /// The pipe that wakes the polling thread: read end, then write end.
+    int _wake_fds[2] = {-1, -1};
+
+    /// True once Stop has been called.
+    std::atomic<bool> _stopping{false};
+
+    /// Guards _in_flight.
+    std::mutex _mutex;
+
+    /// Signalled when _in_flight falls to 0.
+    std::condition_variable _idle;
+
+    /// The number of requests dispatched and not yet answered.
+    int _in_flight = 0;
+
+    /// Coalesces the route queries.
+    RouteBatcher _batcher;
+};
+
+/// A blocking client of RouteServer, which may send many requests before reading replies.
+class RouteClient {
+public:
+    /// Connects to a server.
+    /// \param port The TCP port of the server.
+    /// \param address The IPv4 address of the server.
+    /// \throws std::runtime_error If the connection fails.
+    explicit RouteClient(int port, const std::string& address = "127.0.0.1");
+
+    /// Destructor. Closes the connection.
+    ~RouteClient();
+
+    RouteClient(const RouteClient&) = delete;
+    RouteClient& operator=(const RouteClient&) = delete;
+
+    /// Sends a route request.
+    /// \param id The id the reply will carry.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    void SendRoute(uint32_t id, int source, int target);
+
+    /// Sends a plan request.
+    /// \param id The id the reply will carry.
+    /// \param orders The orders, as pairs of house IDs and package weights.
+    /// \param capacity The carrying capacity of the robot.
+    /// \param savings True to plan with SavingsPlanner, false for GreedyPlanner.
+    void SendPlan(uint32_t id, const std::vector<std::pair<int,int>>& orders, int capacity, bool savings);
+
+    /// Waits for the next reply.
+    /// \throws std::runtime_error If the connection closes or the reply is malformed.
+    Reply Receive();
+
+private:
+    /// Sends a whole message.
+    void SendAll(const std::string& message);
+
+    /// The connected socket.
+    int _fd;
+
+    /// Bytes received and not yet parsed.
+    std::string _input;
+};
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * @file schedule.cpp
+ * @brief Implements time-window scheduling with forward time slack.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include "schedule.h"
+#include "topological_map.h"
+
+using namespace std;
+
+/**
+ * @brief Measures the distances between the store and the house of each order.
+ *
+ * @param orders The orders.
+ * @param graph The map the orders are delivered on.
+ * @param pool The threads to run the searches on, or a null pointer.
+ * @return The table, with the store in row and column 0 and order i in row and column i + 1.
+ * @throws invalid_argument If an order is for a node outside the map.
+ */
+static DistanceTable stop_distances(const vector<TimedOrder>& orders, const Graph& graph, ThreadPool* pool) {
+    vector<int> nodes(1, store_id);
+    nodes.reserve(orders.size() + 1);
+    for (const TimedOrder& order : orders) {
+        if (order.house < 0 || order.house >= graph.NumNodes()) {
+            throw invalid_argument("Order for node " + to_string(order.house) + " outside the map");
+        }
+        nodes.push_back(order.house);
+    }
+    return graph.DistancesBetween(nodes, nodes, pool);
+}
+
+// Implementation of TimedOrders class
+
+/**
+ * @brief Measures the distances between the store and the houses of the orders.
+ *
+ * @param orders The orders of the day.
+ * @param graph The map the orders are delivered on.
+ * @param pool The threads to run the searches on, or a null pointer to run them on the calling thread.
+ * @throws invalid_argument If an order is for a node outside the map.
+ */
+TimedOrders::TimedOrders(vector<TimedOrder> orders, const Graph& graph, ThreadPool* pool):
+    _orders(move(orders)),
+    _distances(stop_distances(_orders, graph, pool)) {}
+
+/**
+ * @brief Returns the number of orders.
+ *
+ * @return The number of orders.
+ */
+int TimedOrders::Size() const { return _orders.size(); }
+
+/**
+ * @brief Returns an order.
+ *
+ * @param order The index of the order.
+ * @return The order.
+ */
+const TimedOrder& TimedOrders::Order(int order) const { return _orders[order]; }
+
+/**
+ * @brief Returns the shortest distance between two stops.
+ *
+ * @param from The order driven from, or -1 for the store.
+ * @param to The order driven to, or -1 for the store.
+ * @return The distance in km, or infinity if it cannot be driven.
+ */
+double TimedOrders::Distance(int from, int to) const { return _distances.At(from + 1, to + 1); }
+
+// Implementation of DaySchedule class
+
+/**
+ * @brief Constructs an empty day, in which the robot stays at the store.
+ *
+ * @param robot The robot, whose speed, service time and capacity the schedule keeps to.
+ * @param shift The period the robot works.
+ * @param orders The orders the schedule may deliver.
+ * @throws invalid_argument If the robot's speed is not positive.
+ */
+DaySchedule::DaySchedule(const Robot& robot, TimeWindow shift, shared_ptr<const TimedOrders> orders):
+    _robot(robot), _shift(shift), _orders(move(orders)) {
+    if (!(robot.GetSpeed() > 0)) {
+        throw invalid_argument("A robot's speed must be positive to schedule its day");
+    }
+    _stops.push_back(ScheduledStop{-1, 0, 0, 0});
+    Update();
+}
+
+/**
+ * @brief Returns the robot.
+ *
+ * @return The robot the day is scheduled for.
+ */
+const Robot& DaySchedule::GetRobot() const { return _robot; }
+
+/**
+ * @brief Returns the stops.
+ *
+ * @return The stops in visiting order, starting and ending at the store.
+ */
+const vector<ScheduledStop>& DaySchedule::Stops() const { return _stops; }
+
+/**
+ * @brief Returns the forward time slack of a stop.
+ *
+ * @param stop The index of the stop.
+ * @return How many hours the start of the stop could be delayed without a later stop missing its window.
+ */
+double DaySchedule::Slack(int stop) const { return _slack[stop]; }
+
+/**
+ * @brief Returns the time the robot is back at the store for the last time.
+ *
+ * @return The time in hours from the start of the day.
+ */
+double DaySchedule::EndTime() const { return _stops.back().arrival; }
+
+/**
+ * @brief Returns the distance driven over the day.
+ *
+ * @return The distance in km.
+ */
+double DaySchedule::TotalDistance() const {
+    double distance = 0;
+    for (int i = 1; i < (int)_stops.size(); i++) {
+        distance += _orders->Distance(_stops[i - 1].order, _stops[i].order);
+    }
+    return distance;
+}
+
+/**
+ * @brief Returns the trips of the day.
+ *
+ * @return The trips in the order they are driven, as pairs of house IDs and package weights.
+ */
+vector<Trip> DaySchedule::Trips() const {
+    vector<Trip> trips;
+    Trip trip;
+    for (const ScheduledStop& stop : _stops) {
+        if (stop.order != -1) {
+            const TimedOrder& order = _orders->Order(stop.order);
+            trip.emplace_back(order.house, order.packages);
+        }
+        else if (!trip.empty()) {
+            trips.push_back(move(trip));
+            trip.clear();
+        }
+    }
+    return trips;
+}
+
+/**
+ * @brief Returns the cost of inserting an order at a place, checking its feasibility.
+ *
+ * The delivery is timed from the departure of the stop before it, and the
+ * delay it causes to the start of the stop after it is compared with that
+ * stop's forward time slack. A trip of its own also returns to the store
+ * before the next stop. The check reads three stops and so takes constant time.
+ *
+ * @param order The index of the order.
+ * @param after The stop the order would be delivered after.
+ * @param new_trip True to deliver the order on a trip of its own, which needs the stop to be the store.
+ * @return The insertion, with an infinite distance if it is infeasible.
+ */
+DaySchedule::Insertion DaySchedule::Cost(int order, int after, bool new_trip) const {
+    Insertion insertion{after, new_trip, numeric_limits<double>::infinity()};
+    const int last = _stops.size() - 1;
+    if (after < 0 || after > last) {
+        return insertion;
+    }
+    const ScheduledStop& prev = _stops[after];
+    if (new_trip ? (prev.order != -1) : (after == last)) {
+        return insertion;
+    }
+    const TimedOrder& timed = _orders->Order(order);
+    const int load = new_trip ? 0 : _load[after];
+    if (load + timed.packages > _robot.GetCarryingCapacity()) {
+        return insertion;
+    }
+
+    double time = max(prev.departure + TravelTime(prev.order, order), timed.window.earliest);
+    if (!(time <= timed.window.latest)) {
+        return insertion;
+    }
+    time += ServiceTime(order);
+
+    double added;
+    if (new_trip) {
+        // The trip returns to the store before the robot carries on to the stop that followed
+        time += TravelTime(order, -1);
+        if (!(time <= _shift.latest)) {
+            return insertion;
+        }
+        added = _orders->Distance(-1, order) + _orders->Distance(order, -1);
+        if (after == last) {
+            insertion.added_distance = added;
+            return insertion;
+        }
+        time += TravelTime(-1, _stops[after + 1].order);
+    }
+    else {
+        const int next = _stops[after + 1].order;
+        time += TravelTime(order, next);
+        added = _orders->Distance(prev.order, order) + _orders->Distance(order, next) -
+                _orders->Distance(prev.order, next);
+    }
+
+    const ScheduledStop& following = _stops[after + 1];
+    const double delay = max(time, Window(following.order).earliest) - following.start;
+    if (!(delay <= _slack[after + 1])) {
+        return insertion;
+    }
+    insertion.added_distance = added;
+    return insertion;
+}
+
+/**
+ * @brief Returns the cheapest feasible insertion of an order.
+ *
+ * Every place between two stops is tried, and a trip of its own after every
+ * visit to the store. Ties go to the earliest place.
+ *
+ * @param order The index of the order.
+ * @return The insertion, with an infinite distance if the order fits nowhere.
+ */
+DaySchedule::Insertion DaySchedule::BestInsertion(int order) const {
+    Insertion best{-1, false, numeric_limits<double>::infinity()};
+    for (int after = 0; after < (int)_stops.size(); after++) {
+        for (bool new_trip : {false, true}) {
+            Insertion insertion = Cost(order, after, new_trip);
+            if (insertion.added_distance < best.added_distance) {
+                best = insertion;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Inserts an order and updates the times of the day.
+ *
+ * @param order The index of the order.
+ * @param insertion Where to insert it.
+ * @throws invalid_argument If the insertion is infeasible.
+ */
+void DaySchedule::Insert(int order, const Insertion& insertion) {
+    if (Cost(order, insertion.after, insertion.new_trip).added_distance == numeric_limits<double>::infinity()) {
+        throw invalid_argument("Order " + to_string(order) + " does not fit after stop " +
+                               to_string(insertion.after));
+    }
+    auto position = _stops.insert(_stops.begin() + insertion.after + 1, ScheduledStop{order, 0, 0, 0});
+    if (insertion.new_trip) {
+        _stops.insert(position + 1, ScheduledStop{-1, 0, 0, 0});
+    }
+    Update();
+}
+
+/**
+ * @brief Returns the driving time between two stops.
+ *
+ * @param from The order driven from, or -1 for the store.
+ * @param to The order driven to, or -1 for the store.
+ * @return The time in hours, or infinity if the way cannot be driven.
+ */
+double DaySchedule::TravelTime(int from, int to) const {
+    return _orders->Distance(from, to) / _robot.GetSpeed();
+}
+
+/**
+ * @brief Returns the window of a stop.
+ *
+ * @param order The order of the stop, or -1 for the store.
+ * @return The window of the order, or the shift for the store.
+ */
+TimeWindow DaySchedule::Window(int order) const {
+    return order == -1 ? _shift : _orders->Order(order).window;
+}
+
+/**
+ * @brief Returns the time a delivery takes once started.
+ *
+ * @param order The order of the stop, or -1 for the store.
+ * @return The robot's service time, or 0 at the store.
+ */
+double DaySchedule::ServiceTime(int order) const {
+    return order == -1 ? 0 : _robot.GetServiceTime();
+}
+
+/**
+ * @brief Recomputes the times, loads and slack of every stop.
+ *
+ * Times run forwards from the start of the shift. The slack runs backwards:
+ * a stop's start can be delayed up to its own closing time, and up to the
+ * next stop's slack plus the time the robot would have waited there.
+ */
+void DaySchedule::Update() {
+    const int num_stops = _stops.size();
+    _stops[0].arrival = _stops[0].start = _stops[0].departure = _shift.earliest;
+    for (int i = 1; i < num_stops; i++) {
+        ScheduledStop& stop = _stops[i];
+        stop.arrival = _stops[i - 1].departure + TravelTime(_stops[i - 1].order, stop.order);
+        stop.start = max(stop.arrival, Window(stop.order).earliest);
+        stop.departure = stop.start + ServiceTime(stop.order);
+    }
+
+    _slack.resize(num_stops);
+    _slack[num_stops - 1] = Window(_stops[num_stops - 1].order).latest - _stops[num_stops - 1].start;
+    for (int i = num_stops - 2; i >= 0; i--) {
+        const double wait = _stops[i + 1].start - _stops[i + 1].arrival;
+        _slack[i] = min(Window(_stops[i].order).latest - _stops[i].start, wait + _slack[i + 1]);
+    }
+
+    _load.assign(num_stops - 1, 0);
+    int trip_start = 0;
+    int load = 0;
+    for (int i = 1; i < num_stops; i++) {
+        if (_stops[i].order != -1) {
+            load += _orders->Order(_stops[i].order).packages;
+            continue;
+        }
+        fill(_load.begin() + trip_start, _load.begin() + i, load);
+        trip_start = i;
+        load = 0;
+    }
+}
+
+/**
+ * @brief Schedules timed orders onto robots' days by cheapest feasible insertion.
+ *
+ * Orders that close earlier are placed first, as they have the fewest
+ * places to go. Each costs O(s) constant-time checks over the s stops of
+ * every day, and an accepted insertion updates its day in O(s).
+ *
+ * @param orders The orders to schedule.
+ * @param days The days of the robots, which the orders are added to.
+ * @return The indices of the orders that fit in no day.
+ */
+vector<int> schedule_orders(const TimedOrders& orders, vector<DaySchedule>& days) {
+    vector<int> sequence(orders.Size());
+    iota(sequence.begin(), sequence.end(), 0);
+    stable_sort(sequence.begin(), sequence.end(), [&orders](int a, int b) {
+        const TimeWindow& first = orders.Order(a).window;
+        const TimeWindow& second = orders.Order(b).window;
+        return first.latest != second.latest ? first.latest < second.latest : first.earliest < second.earliest;
+    });
+
+    vector<int> unscheduled;
+    for (int order : sequence) {
+        int best_day = -1;
+        DaySchedule::Insertion best{-1, false, numeric_limits<double>::infinity()};
+        for (int d = 0; d < (int)days.size(); d++) {
+            DaySchedule::Insertion insertion = days[d].BestInsertion(order);
+            if (insertion.added_distance < best.added_distance) {
+                best = insertion;
+                best_day = d;
+            }
+        }
+        if (best_day == -1) {
+            unscheduled.push_back(order);
+            continue;
+        }
+        days[best_day].Insert(order, best);
+    }
+    return unscheduled;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file schedule.h
+ * @brief Defines time-window scheduling of deliveries, with arrival times and forward time slack.
+ */
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <memory>
+#include <vector>
+#include "route_planner.h"
+#include "shortest_path.h"
+#include "task_queue.h"
+
+class Graph;
+class ThreadPool;
+
+/// A period of the day, in hours from its start.
+struct TimeWindow {
+    /// The earliest time.
+    double earliest;
+
+    /// The latest time.
+    double latest;
+};
+
+/// An order that must be delivered within a time window.
+struct TimedOrder {
+    /// The ID of the house.
+    int house;
+
+    /// The number of packages.
+    int packages;
+
+    /// The period in which the delivery may start. A robot arriving early waits.
+    TimeWindow window;
+};
+
+/// A day's timed orders together with the shortest path distances between the store and
+/// every house, measured once so schedules can be costed and checked without searches.
+/// Stops are numbered by order, with -1 for the store.
+class TimedOrders {
+public:
+    /// Measures the distances between the store and the houses of the orders.
+    /// \param orders The orders of the day.
+    /// \param graph The map the orders are delivered on.
+    /// \param pool The threads to run the searches on, or a null pointer to run them on the calling thread.
+    TimedOrders(std::vector<TimedOrder> orders, const Graph& graph, ThreadPool* pool = nullptr);
+
+    /// Returns the number of orders.
+    int Size() const;
+
+    /// Returns an order.
+    /// \param order The index of the order.
+    const TimedOrder& Order(int order) const;
+
+    /// Returns the shortest distance between two stops, or infinity if it cannot be driven.
+    /// \param from The order driven from, or -1 for the store.
+    /// \param to The order driven to, or -1 for the store.
+    double Distance(int from, int to) const;
+
+private:
+    /// The orders.
+    std::vector<TimedOrder> _orders;
+
+    /// The distances between the store, in row and column 0, and the house of each order.
+    DistanceTable _distances;
+};
+
+/// A stop of a robot's day, with its times as scheduled.
+struct ScheduledStop {
+    /// The order delivered, or -1 for a visit to the store.
+    int order;
+
+    /// The time the robot arrives.
+    double arrival;
+
+    /// The time the delivery starts, after any wait for the window to open.
+    double start;
+
+    /// The time the robot leaves.
+    double departure;
+};
+
+/// The trips of one robot over a day, as a sequence of stops with arrival times.
+/// The day starts and ends at the store, and every visit to the store ends one trip and
+/// starts the next. Each stop keeps its forward time slack: how far its start could be
+/// pushed back without any later stop missing its window. An insertion that delays the
+/// stop after it by no more than that stop's slack is feasible, so each candidate
+/// insertion is checked in constant time, and only accepted insertions update the times.
+class DaySchedule {
+public:
+    /// A place an order could be inserted, and what it costs.
+    struct Insertion {
+        /// The stop the order is delivered after.
+        int after;
+
+        /// True if the order goes on a trip of its own, after a visit to the store.
+        bool new_trip;
+
+        /// The distance added to the day, in km, or infinity if the insertion is infeasible.
+        double added_distance;
+    };
+
+    /// Constructs an empty day.
+    /// \param robot The robot, whose speed, service time and capacity the schedule keeps to.
+    /// \param shift The period the robot works, which it must leave and return to the store within.
+    /// \param orders The orders the schedule may deliver.
+    /// \throws std::invalid_argument If the robot's speed is not positive.
+    DaySchedule(const Robot& robot, TimeWindow shift, std::shared_ptr<const TimedOrders> orders);
+
+    /// Returns the robot.
+    const Robot& GetRobot() const;
+
+    /// Returns the stops, starting and ending at the store.
+    const std::vector<ScheduledStop>& Stops() const;
+
+    /// Returns the forward time slack of a stop, in hours.
+    /// \param stop The index of the stop.
+    double Slack(int stop) const;
+
+    /// Returns the time the robot is back at the store for the last time.
+    double EndTime() const;
+
+    /// Returns the distance driven over the day, in km.
+    double TotalDistance() const;
+
+    /// Returns the trips, with houses in visiting order.
+    std::vector<Trip> Trips() const;
+
+    /// Returns the cost of inserting an order at a place, checking its feasibility in constant time.
+    /// \param order The index of the order.
+    /// \param after The stop the order would be delivered after.
+    /// \param new_trip True to deliver the order on a trip of its own, which needs the stop to be the store.
+    /// \return The insertion, with an infinite distance if it is infeasible.
+    Insertion Cost(int order, int after, bool new_trip) const;
+
+    /// Returns the cheapest feasible insertion of an order, trying every place in the day.
+    /// \param order The index of the order.
+    /// \return The insertion, with an infinite distance if the order fits nowhere.
+    Insertion BestInsertion(int order) const;
+
+    /// Inserts an order and updates the times of the day.
+    /// \param order The index of the order.
+    /// \param insertion Where to insert it.
+    /// \throws std::invalid_argument If the insertion is infeasible.
+    void Insert(int order, const Insertion& insertion);
+
+private:
+    /// Returns the driving time between two stops, in hours.
+    double TravelTime(int from, int to) const;
+
+    /// Returns the window of a stop.
+    TimeWindow Window(int order) const;
+
+    /// Returns the time a delivery of a stop takes once started.
+    double ServiceTime(int order) const;
+
+    /// Recomputes the times, loads and slack of every stop.
+    void Update();
+
+    /// The robot.
+    Robot _robot;
+
+    /// The period the robot works.
+    TimeWindow _shift;
+
+    /// The orders the schedule may deliver.
+    std::shared_ptr<const TimedOrders> _orders;
+
+    /// The stops of the day.
+    std::vector<ScheduledStop> _stops;
+
+    /// The forward time slack of each stop.
+    std::vector<double> _slack;
+
+    /// The packages carried on the trip leaving each stop, for every stop but the last.
+    std::vector<int> _load;
+};
+
+/// Schedules timed orders onto robots' days by cheapest feasible insertion.
+/// The orders are taken in order of their closing times, and each goes where it adds the
+/// least distance over every day and place that keeps every window and capacity.
+/// \param orders The orders to schedule.
+/// \param days The days of the robots, which the orders are added to.
+/// \return The indices of the orders that fit in no day.
+std::vector<int> schedule_orders(const TimedOrders& orders, std::vector<DaySchedule>& days);
+
+#endif
@@ -0,0 +1,1033 @@
+/**
+ * @file shortest_path.cpp
+ * @brief Implements the shortest path engines, heuristics and the shortest path tree cache.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "shortest_path.h"
+#include "all_pairs.h"
+#include "topological_map.h"
+#include "metrics.h"
+
+using namespace std;
+
+// Implementation of IndexedHeap class
+
+/**
+ * @brief Empties the heap and makes room for node ids in [0, num_nodes).
+ *
+ * Only the entries still in the heap are cleared, so resetting after a search
+ * that stopped early costs as much as the heap that was left over.
+ *
+ * @param num_nodes The number of nodes that may be pushed.
+ */
+void IndexedHeap::Reset(int num_nodes) {
+    for (const auto& entry : _entries) {
+        _position[entry.node] = -1;
+    }
+    _entries.clear();
+    if ((int)_position.size() < num_nodes) {
+        _position.resize(num_nodes, -1);
+    }
+}
+
+/**
+ * @brief Returns true if the heap holds no nodes.
+ *
+ * @return True if the heap is empty, false otherwise.
+ */
+bool IndexedHeap::Empty() const { return _entries.empty(); }
+
+/**
+ * @brief Returns the number of nodes in the heap.
+ *
+ * @return The number of nodes in the heap.
+ */
+int IndexedHeap::Size() const { return _entries.size(); }
+
+/**
+ * @brief Returns true if the node is currently in the heap.
+ *
+ * @param node The ID of the node.
+ * @return True if the node is waiting in the heap, false otherwise.
+ */
+bool IndexedHeap::Contains(int node) const { return _position[node] != -1; }
+
+/**
+ * @brief Inserts a node, or lowers its key if it is already in the heap.
+ *
+ * @param node The node to insert.
+ * @param key The distance of the node. Keys larger than the current one are ignored.
+ */
+void IndexedHeap::PushOrDecrease(int node, double key) {
+    int pos = _position[node];
+    if (pos == -1) {
+        pos = _entries.size();
+        _entries.push_back(Entry{key, node});
+        _position[node] = pos;
+    }
+    else if (key < _entries[pos].key) {
+        _entries[pos].key = key;
+    }
+    else {
+        return;
+    }
+    SiftUp(pos);
+}
+
+/**
+ * @brief Returns the smallest key in the heap.
+ *
+ * @return The key at the root of the heap.
+ */
+double IndexedHeap::MinKey() const { return _entries.front().key; }
+
+/**
+ * @brief Removes and returns the node with the smallest key.
+ *
+ * @return The ID of the removed node.
+ */
+int IndexedHeap::PopMin() {
+    const int node = _entries.front().node;
+    _position[node] = -1;
+
+    const Entry last = _entries.back();
+    _entries.pop_back();
+    if (!_entries.empty()) {
+        _entries[0] = last;
+        _position[last.node] = 0;
+        SiftDown(0);
+    }
+    return node;
+}
+
+/**
+ * @brief Moves an entry towards the root until its parent's key is not larger.
+ *
+ * @param pos The position of the entry to move.
+ */
+void IndexedHeap::SiftUp(int pos) {
+    const Entry entry = _entries[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / arity;
+        if (_entries[parent].key <= entry.key) {
+            break;
+        }
+        _entries[pos] = _entries[parent];
+        _position[_entries[pos].node] = pos;
+        pos = parent;
+    }
+    _entries[pos] = entry;
+    _position[entry.node] = pos;
+}
+
+/**
+ * @brief Moves an entry towards the leaves until no child has a smaller key.
+ *
+ * @param pos The position of the entry to move.
+ */
+void IndexedHeap::SiftDown(int pos) {
+    const int size = _entries.size();
+    const Entry entry = _entries[pos];
+    while (true) {
+        int first = pos * arity + 1;
+        if (first >= size) {
+            break;
+        }
+        int last = min(first + arity, size);
+        int best = first;
+        for (int child = first + 1; child < last; child++) {
+            if (_entries[child].key < _entries[best].key) {
+                best = child;
+            }
+        }
+        if (entry.key <= _entries[best].key) {
+            break;
+        }
+        _entries[pos] = _entries[best];
+        _position[_entries[pos].node] = pos;
+        pos = best;
+    }
+    _entries[pos] = entry;
+    _position[entry.node] = pos;
+}
+
+// Implementation of ShortestPathEngine class
+
+/**
+ * @brief Runs a Dijkstra search from a source node.
+ *
+ * Every node is pushed at most once and lowered in place, so each node is
+ * settled exactly once. With non-negative edge distances a settled node can
+ * never be improved again, so no separate settled check is needed.
+ *
+ * @param adjacency The edges to search over.
+ * @param source The node to start from.
+ * @param target The node at which the search stops once settled, or -1 to reach every node.
+ */
+void ShortestPathEngine::Run(const CsrAdjacency& adjacency, int source, int target) {
+    const int num_nodes = adjacency.NumNodes();
+    if ((int)_dist.size() < num_nodes) {
+        _dist.resize(num_nodes);
+        _prev.resize(num_nodes);
+        _reached_in.resize(num_nodes, 0);
+    }
+    if (++_search == 0) {
+        // The counter wrapped around, so old marks could be mistaken for current ones
+        fill(_reached_in.begin(), _reached_in.end(), 0);
+        _search = 1;
+    }
+    _heap.Reset(num_nodes);
+    _source = source;
+    _num_settled = 0;
+
+    const int* offsets = adjacency.Offsets();
+    const int* targets = adjacency.Targets();
+    const double* distances = adjacency.Distances();
+
+    CounterBatch pushes(Counter::HeapPushes);
+    CounterBatch relaxations(Counter::EdgeRelaxations);
+    _dist[source] = 0;
+    _prev[source] = -1;
+    _reached_in[source] = _search;
+    _heap.PushOrDecrease(source, 0);
+    pushes.Add(1);
+
+    while (!_heap.Empty()) {
+        const int u = _heap.PopMin();
+        _num_settled++;
+        if (u == target) {
+            break;
+        }
+        if (_remaining_targets != nullptr && _target_in[u] == _target_search && --*_remaining_targets == 0) {
+            break;
+        }
+
+        const double dist_u = _dist[u];
+        relaxations.Add(offsets[u + 1] - offsets[u]);
+        for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+            const int v = targets[e];
+            const double alt = dist_u + distances[e];
+            if (!Reached(v) || alt < _dist[v]) {
+                double key = alt;
+                if (_heuristic != nullptr) {
+                    double bound = _heuristic->LowerBound(v, target);
+                    if (isinf(bound)) {
+                        continue;
+                    }
+                    key += bound;
+                }
+                _dist[v] = alt;
+                _prev[v] = u;
+                _reached_in[v] = _search;
+                _heap.PushOrDecrease(v, key);
+                pushes.Add(1);
+            }
+        }
+    }
+    count_metric(Counter::HeapPops, _num_settled);
+}
+
+/**
+ * @brief Runs an A* search from a source node towards a target.
+ *
+ * Nodes are keyed by their distance plus the heuristic's bound on the
+ * distance left. A consistent bound keeps settled distances final, so the
+ * search still stops as soon as the target is settled. Nodes the heuristic
+ * reports as unable to reach the target are never queued.
+ *
+ * @param adjacency The edges to search over.
+ * @param source The node to start from.
+ * @param target The node to reach.
+ * @param heuristic A consistent lower bound on the distance to the target.
+ */
+void ShortestPathEngine::Run(const CsrAdjacency& adjacency, int source, int target,
+                             const SearchHeuristic& heuristic) {
+    _heuristic = &heuristic;
+    Run(adjacency, source, target);
+    _heuristic = nullptr;
+}
+
+/**
+ * @brief Runs a Dijkstra search from a source node until every target is settled.
+ *
+ * @param adjacency The edges to search over.
+ * @param source The node to start from.
+ * @param targets The nodes whose distances are needed.
+ */
+void ShortestPathEngine::Run(const CsrAdjacency& adjacency, int source, const vector<int>& targets) {
+    const int num_nodes = adjacency.NumNodes();
+    if ((int)_target_in.size() < num_nodes) {
+        _target_in.resize(num_nodes, 0);
+    }
+    if (++_target_search == 0) {
+        fill(_target_in.begin(), _target_in.end(), 0);
+        _target_search = 1;
+    }
+    int remaining = 0;
+    for (int target : targets) {
+        if (_target_in[target] != _target_search) {
+            _target_in[target] = _target_search;
+            remaining++;
+        }
+    }
+    if (remaining == 0) {
+        // Nothing to wait for, so settle just the source
+        Run(adjacency, source, source);
+        return;
+    }
+    _remaining_targets = &remaining;
+    Run(adjacency, source, -1);
+    _remaining_targets = nullptr;
+}
+
+/**
+ * @brief Returns the source of the last search.
+ *
+ * @return The ID of the source node, or -1 if no search has run.
+ */
+int ShortestPathEngine::Source() const { return _source; }
+
+/**
+ * @brief Returns true if the node was reached by the current search.
+ *
+ * @param node The ID of the node.
+ * @return True if the node has a tentative or final distance, false otherwise.
+ */
+bool ShortestPathEngine::Reached(int node) const {
+    return node < (int)_reached_in.size() && _reached_in[node] == _search;
+}
+
+/**
+ * @brief Returns the distance found from the source to a node.
+ *
+ * The distance is final for nodes that were settled, and for every reached
+ * node when the search was run without a target.
+ *
+ * @param node The ID of the node.
+ * @return The distance to the node, or infinity if it was not reached.
+ */
+double ShortestPathEngine::Distance(int node) const {
+    return Reached(node) ? _dist[node] : numeric_limits<double>::infinity();
+}
+
+/**
+ * @brief Returns the node before the given one on its shortest path.
+ *
+ * @param node The ID of the node.
+ * @return The predecessor of the node, or -1 for the source and unreached nodes.
+ */
+int ShortestPathEngine::Predecessor(int node) const {
+    return Reached(node) && !isinf(_dist[node]) ? _prev[node] : -1;
+}
+
+/**
+ * @brief Reconstructs the shortest path from the source to a node.
+ *
+ * @param node The ID of the destination node.
+ * @return The nodes on the path, starting at the source, or an empty list if the node was not reached.
+ */
+vector<int> ShortestPathEngine::Path(int node) const {
+    vector<int> path;
+    if (!Reached(node) || isinf(_dist[node])) {
+        // Nodes reached only over closed roads are unreachable
+        return path;
+    }
+    for (int u = node; u != -1; u = _prev[u]) {
+        path.push_back(u);
+    }
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+/**
+ * @brief Returns the number of nodes settled by the last search.
+ *
+ * @return The number of nodes taken off the heap.
+ */
+int ShortestPathEngine::NumSettled() const { return _num_settled; }
+
+/**
+ * @brief Copies the result of the last search into a tree covering every node.
+ *
+ * The tree is only complete if the search was run without a target.
+ *
+ * @param num_nodes The number of nodes in the searched adjacency.
+ * @return The distances and predecessors found by the last search.
+ */
+ShortestPathTree ShortestPathEngine::Tree(int num_nodes) const {
+    vector<double> dist(num_nodes);
+    vector<int> prev(num_nodes);
+    for (int v = 0; v < num_nodes; v++) {
+        dist[v] = Distance(v);
+        prev[v] = Predecessor(v);
+    }
+    return ShortestPathTree(_source, move(dist), move(prev));
+}
+
+// Implementation of BidirectionalEngine class
+
+/**
+ * @brief Runs a bidirectional Dijkstra search between two nodes.
+ *
+ * The direction with the smaller heap key is advanced. Each relaxed edge
+ * that reaches a node seen by the other direction offers a path, and the
+ * search stops once the two smallest keys add up to no less than the best
+ * path found, since any shorter path would have to pass through a node
+ * still queued in both directions.
+ *
+ * @param forward The edges to search over.
+ * @param backward The same edges reversed.
+ * @param source The node to start from.
+ * @param target The node to reach.
+ */
+void BidirectionalEngine::Run(const CsrAdjacency& forward, const CsrAdjacency& backward,
+                              int source, int target) {
+    const int num_nodes = forward.NumNodes();
+    for (int side=0; side<2; side++) {
+        if ((int)_dist[side].size() < num_nodes) {
+            _dist[side].resize(num_nodes);
+            _prev[side].resize(num_nodes);
+            _reached_in[side].resize(num_nodes, 0);
+        }
+        _heap[side].Reset(num_nodes);
+    }
+    if (++_search == 0) {
+        for (int side=0; side<2; side++) {
+            fill(_reached_in[side].begin(), _reached_in[side].end(), 0);
+        }
+        _search = 1;
+    }
+    _source = source;
+    _target = target;
+    _num_settled = 0;
+    _best = numeric_limits<double>::infinity();
+    _meet = -1;
+
+    CounterBatch pushes(Counter::HeapPushes);
+    CounterBatch relaxations(Counter::EdgeRelaxations);
+    const CsrAdjacency* adjacency[2] = {&forward, &backward};
+    const int ends[2] = {source, target};
+    for (int side=0; side<2; side++) {
+        _dist[side][ends[side]] = 0;
+        _prev[side][ends[side]] = -1;
+        _reached_in[side][ends[side]] = _search;
+        _heap[side].PushOrDecrease(ends[side], 0);
+    }
+    pushes.Add(2);
+    if (source == target) {
+        _best = 0;
+        _meet = source;
+        return;
+    }
+
+    while (!_heap[0].Empty() && !_heap[1].Empty()) {
+        const double forward_key = _heap[0].MinKey();
+        const double backward_key = _heap[1].MinKey();
+        if (forward_key + backward_key >= _best) {
+            break;
+        }
+        const int side = (forward_key <= backward_key) ? 0 : 1;
+        const int other = 1 - side;
+        const int u = _heap[side].PopMin();
+        _num_settled++;
+
+        const double dist_u = _dist[side][u];
+        const int* offsets = adjacency[side]->Offsets();
+        const int* targets = adjacency[side]->Targets();
+        const double* distances = adjacency[side]->Distances();
+        relaxations.Add(offsets[u + 1] - offsets[u]);
+        for (int e = offsets[u]; e < offsets[u + 1]; e++) {
+            const int v = targets[e];
+            const double alt = dist_u + distances[e];
+            if (_reached_in[side][v] != _search || alt < _dist[side][v]) {
+                _dist[side][v] = alt;
+                _prev[side][v] = u;
+                _reached_in[side][v] = _search;
+                _heap[side].PushOrDecrease(v, alt);
+                pushes.Add(1);
+            }
+            if (_reached_in[other][v] == _search && alt + _dist[other][v] < _best) {
+                _best = alt + _dist[other][v];
+                _meet = v;
+            }
+        }
+    }
+    count_metric(Counter::HeapPops, _num_settled);
+}
+
+/**
+ * @brief Returns the distance found by the last search.
+ *
+ * @return The distance from the source to the target, or infinity if it is unreachable.
+ */
+double BidirectionalEngine::Distance() const { return _best; }
+
+/**
+ * @brief Reconstructs the shortest path found by the last search.
+ *
+ * The forward predecessors lead from the meeting node back to the source,
+ * and the backward ones lead from it on to the target.
+ *
+ * @return The nodes on the path, starting at the source, or an empty list if the target is unreachable.
+ */
+vector<int> BidirectionalEngine::Path() const {
+    vector<int> path;
+    if (_meet == -1) {
+        return path;
+    }
+    for (int u = _meet; u != -1; u = _prev[0][u]) {
+        path.push_back(u);
+    }
+    reverse(path.begin(), path.end());
+    for (int u = _prev[1][_meet]; u != -1; u = _prev[1][u]) {
+        path.push_back(u);
+    }
+    return path;
+}
+
+/**
+ * @brief Returns the number of nodes settled by the last search.
+ *
+ * @return The number of nodes taken off either heap.
+ */
+int BidirectionalEngine::NumSettled() const { return _num_settled; }
+
+// Implementation of EuclideanHeuristic class
+
+/**
+ * @brief Constructs the heuristic, scaling it so that no edge is shorter than its bound.
+ *
+ * With s the smallest ratio of edge length to straight-line length, every
+ * edge u -> v has length at least s * |uv|, so by the triangle inequality
+ * s * |ut| <= length(u -> v) + s * |vt| and the bound is consistent.
+ *
+ * @param adjacency The edges the heuristic must bound.
+ * @param coordinates The position of each node.
+ * @throws invalid_argument If there is not one position per node.
+ */
+EuclideanHeuristic::EuclideanHeuristic(const CsrAdjacency& adjacency, vector<Coordinates> coordinates):
+    _coordinates(move(coordinates)) {
+    if ((int)_coordinates.size() != adjacency.NumNodes()) {
+        throw invalid_argument("Expected one position per node");
+    }
+    double scale = numeric_limits<double>::infinity();
+    for (int u=0; u<adjacency.NumNodes(); u++) {
+        for (const Edge& edge : adjacency.EdgesOf(u)) {
+            double gap = hypot(_coordinates[u].x - _coordinates[edge.target].x,
+                               _coordinates[u].y - _coordinates[edge.target].y);
+            if (gap > 0) {
+                scale = min(scale, edge.distance / gap);
+            }
+        }
+    }
+    // With no edge between distinct positions any scale would do, so turn the bound off
+    _scale = isinf(scale) ? 0 : scale;
+}
+
+/**
+ * @brief Returns the scaled straight-line distance from a node to the target.
+ *
+ * @param node The node to bound the distance from.
+ * @param target The node to reach.
+ * @return A lower bound on the shortest distance.
+ */
+double EuclideanHeuristic::LowerBound(int node, int target) const {
+    return _scale * hypot(_coordinates[node].x - _coordinates[target].x,
+                          _coordinates[node].y - _coordinates[target].y);
+}
+
+/**
+ * @brief Returns the position of a node.
+ *
+ * @param node The ID of the node.
+ * @return The position of the node.
+ */
+const Coordinates& EuclideanHeuristic::Position(int node) const { return _coordinates[node]; }
+
+/**
+ * @brief Returns the factor applied to straight-line distances.
+ *
+ * @return The scale, 1 when no edge is shorter than the gap between its ends.
+ */
+double EuclideanHeuristic::Scale() const { return _scale; }
+
+// Implementation of LandmarkHeuristic class
+
+/**
+ * @brief Picks landmarks far apart from each other and computes their distances.
+ *
+ * Landmarks are picked farthest first: the first is the node farthest from
+ * node 0, and each next one is the node farthest from its closest landmark
+ * picked so far. Landmarks on the edge of the map give the tightest bounds.
+ * Each landmark costs one search over the edges and one over the reversed
+ * edges.
+ *
+ * @param forward The edges of the map.
+ * @param backward The edges of the map reversed.
+ * @param num_landmarks The number of landmarks to pick, at most the number of nodes.
+ */
+LandmarkHeuristic::LandmarkHeuristic(const CsrAdjacency& forward, const CsrAdjacency& backward,
+                                     int num_landmarks) {
+    const int num_nodes = forward.NumNodes();
+    num_landmarks = max(0, min(num_landmarks, num_nodes));
+    _from.assign((size_t)num_nodes * num_landmarks, 0);
+    _to.assign((size_t)num_nodes * num_landmarks, 0);
+
+    ShortestPathEngine engine;
+    auto farthest = [num_nodes](const vector<double>& closest) {
+        int best = 0;
+        for (int v=1; v<num_nodes; v++) {
+            if (!isinf(closest[v]) && (isinf(closest[best]) || closest[v] > closest[best])) {
+                best = v;
+            }
+        }
+        return best;
+    };
+
+    vector<double> closest(num_nodes, numeric_limits<double>::infinity());
+    if (num_landmarks > 0) {
+        engine.Run(forward, 0);
+        for (int v=0; v<num_nodes; v++) {
+            closest[v] = engine.Distance(v);
+        }
+    }
+    for (int i=0; i<num_landmarks; i++) {
+        int landmark = farthest(closest);
+        if (i > 0 && closest[landmark] == 0) {
+            // Every reachable node is a landmark already
+            break;
+        }
+        _landmarks.push_back(landmark);
+        if (i == 0) {
+            fill(closest.begin(), closest.end(), numeric_limits<double>::infinity());
+        }
+        engine.Run(forward, landmark);
+        for (int v=0; v<num_nodes; v++) {
+            _from[(size_t)v * num_landmarks + i] = engine.Distance(v);
+            closest[v] = min(closest[v], engine.Distance(v));
+        }
+        engine.Run(backward, landmark);
+        for (int v=0; v<num_nodes; v++) {
+            _to[(size_t)v * num_landmarks + i] = engine.Distance(v);
+        }
+    }
+
+    if ((int)_landmarks.size() < num_landmarks) {
+        // Pack the rows down to the landmarks actually picked
+        const int kept = _landmarks.size();
+        for (int v=0; v<num_nodes; v++) {
+            for (int i=0; i<kept; i++) {
+                _from[(size_t)v * kept + i] = _from[(size_t)v * num_landmarks + i];
+                _to[(size_t)v * kept + i] = _to[(size_t)v * num_landmarks + i];
+            }
+        }
+        _from.resize((size_t)num_nodes * kept);
+        _to.resize((size_t)num_nodes * kept);
+    }
+}
+
+/**
+ * @brief Returns the best triangle inequality bound from a node to the target.
+ *
+ * Terms with an unreachable landmark are skipped. If the target reaches a
+ * landmark the node cannot, or a landmark reaches the node but not the
+ * target, the node cannot reach the target at all.
+ *
+ * @param node The node to bound the distance from.
+ * @param target The node to reach.
+ * @return A lower bound on the shortest distance, or infinity if the node cannot reach the target.
+ */
+double LandmarkHeuristic::LowerBound(int node, int target) const {
+    const double infinity = numeric_limits<double>::infinity();
+    const int k = _landmarks.size();
+    const double* from_node = &_from[(size_t)node * k];
+    const double* to_node = &_to[(size_t)node * k];
+    const double* from_target = &_from[(size_t)target * k];
+    const double* to_target = &_to[(size_t)target * k];
+    double bound = 0;
+    for (int i=0; i<k; i++) {
+        if (!isinf(to_target[i])) {
+            if (isinf(to_node[i])) {
+                return infinity;
+            }
+            bound = max(bound, to_node[i] - to_target[i]);
+        }
+        if (!isinf(from_node[i])) {
+            if (isinf(from_target[i])) {
+                return infinity;
+            }
+            bound = max(bound, from_target[i] - from_node[i]);
+        }
+    }
+    return bound;
+}
+
+/**
+ * @brief Returns the landmark nodes.
+ *
+ * @return The landmarks, in the order they were picked.
+ */
+const vector<int>& LandmarkHeuristic::Landmarks() const { return _landmarks; }
+
+// Implementation of ShortestPathTree class
+
+/**
+ * @brief Constructs a tree from its distance and predecessor arrays.
+ *
+ * @param source The source of the tree.
+ * @param dist The distance to each node, infinity for unreachable nodes.
+ * @param prev The predecessor of each node, -1 for the source and unreachable nodes.
+ */
+ShortestPathTree::ShortestPathTree(int source, vector<double> dist, vector<int> prev):
+    _source(source), _dist(move(dist)), _prev(move(prev)) {};
+
+/**
+ * @brief Returns the source of the tree.
+ *
+ * @return The ID of the source node.
+ */
+int ShortestPathTree::Source() const { return _source; }
+
+/**
+ * @brief Returns the distance from the source to a node.
+ *
+ * @param node The ID of the node.
+ * @return The shortest distance, or infinity if the node is unreachable.
+ */
+double ShortestPathTree::Distance(int node) const { return _dist[node]; }
+
+/**
+ * @brief Returns the node before the given one on its shortest path.
+ *
+ * @param node The ID of the node.
+ * @return The predecessor of the node, or -1 for the source and unreachable nodes.
+ */
+int ShortestPathTree::Predecessor(int node) const { return _prev[node]; }
+
+/**
+ * @brief Reconstructs the shortest path from the source to a node.
+ *
+ * @param node The ID of the destination node.
+ * @return The nodes on the path, starting at the source, or an empty list if the node is unreachable.
+ */
+vector<int> ShortestPathTree::Path(int node) const {
+    vector<int> path;
+    Path(node, path);
+    return path;
+}
+
+/**
+ * @brief Reconstructs the shortest path to a node into an existing list.
+ *
+ * Callers that reconstruct many paths keep one list, so its storage is only
+ * allocated until it is as long as the longest path.
+ *
+ * @param node The ID of the node.
+ * @param path Replaced by the nodes on the path, starting at the source, or emptied if the node is unreachable.
+ */
+void ShortestPathTree::Path(int node, vector<int>& path) const {
+    path.clear();
+    if (_dist[node] == numeric_limits<double>::infinity()) {
+        return;
+    }
+    for (int u = node; u != -1; u = _prev[u]) {
+        path.push_back(u);
+    }
+    reverse(path.begin(), path.end());
+}
+
+/**
+ * @brief Returns true if a change to an edge's length could change the tree.
+ *
+ * A longer edge only matters if the tree uses it, and a shorter edge only
+ * if it now offers a shorter way to the node it leads to. Whether the tree
+ * uses an edge is read from the predecessor alone: the distances of a tree
+ * summed by Floyd-Warshall round differently from the edge lengths, so
+ * comparing them would miss edges the tree does use. A parallel edge the
+ * tree does not use then discards the tree too, which is merely wasteful.
+ *
+ * @param change The change to the edge.
+ * @return True if the tree could be out of date after the change, false if it stays exact.
+ */
+bool ShortestPathTree::AffectedBy(const WeightChange& change) const {
+    const double dist_source = _dist[change.source];
+    if (isinf(dist_source)) {
+        return false;
+    }
+    if (change.new_distance > change.old_distance) {
+        return _prev[change.target] == change.source;
+    }
+    return dist_source + change.new_distance < _dist[change.target];
+}
+
+// Implementation of DistanceCache class
+
+/// The largest map precomputed with Floyd-Warshall unless set otherwise.
+static const int default_all_pairs_limit = 512;
+
+/**
+ * @brief Constructs an empty cache.
+ *
+ * @param max_sources The largest number of trees kept at once.
+ */
+DistanceCache::DistanceCache(int max_sources):
+    _max_sources(max(max_sources, 0)), _all_pairs_limit(default_all_pairs_limit) {};
+
+/**
+ * @brief Constructs a cache holding the same trees as another.
+ *
+ * The trees themselves are shared, since they are never modified.
+ *
+ * @param other The cache to copy.
+ */
+DistanceCache::DistanceCache(const DistanceCache& other) {
+    lock_guard<mutex> lock(other._mutex);
+    _max_sources = other._max_sources;
+    _all_pairs_limit = other._all_pairs_limit;
+    for (auto it = other._recency.rbegin(); it != other._recency.rend(); ++it) {
+        _recency.push_front(*it);
+        _trees[*it] = Slot{other._trees.at(*it).tree, _recency.begin()};
+    }
+}
+
+/**
+ * @brief Returns the tree for a source, computing and storing it on a miss.
+ *
+ * The search runs outside the lock, so threads missing on different sources
+ * compute their trees concurrently. If two threads miss on the same source,
+ * both compute it and the first stored tree is kept.
+ *
+ * @param adjacency The edges the cached trees were computed over.
+ * @param source The source of the tree.
+ * @return The shortest path tree from the source.
+ */
+shared_ptr<const ShortestPathTree> DistanceCache::Get(const CsrAdjacency& adjacency, int source) {
+    shared_ptr<const ShortestPathTree> tree = Find(source);
+    if (tree) {
+        return tree;
+    }
+
+    {
+        SpanTimer timer(Span::DistancesFrom);
+        thread_local ShortestPathEngine engine;
+        engine.Run(adjacency, source);
+        tree = make_shared<const ShortestPathTree>(engine.Tree(adjacency.NumNodes()));
+    }
+    count_metric(Counter::TreesBuilt);
+
+    Insert(tree);
+    return tree;
+}
+
+/**
+ * @brief Returns the tree for a source if it is cached, marking it as recently used.
+ *
+ * @param source The source of the tree.
+ * @return The cached tree, or a null pointer if there is none.
+ */
+shared_ptr<const ShortestPathTree> DistanceCache::Find(int source) {
+    lock_guard<mutex> lock(_mutex);
+    auto it = _trees.find(source);
+    if (it == _trees.end()) {
+        return nullptr;
+    }
+    _recency.splice(_recency.begin(), _recency, it->second.recency);
+    return it->second.tree;
+}
+
+/**
+ * @brief Computes and stores the tree of every node.
+ *
+ * The capacity is raised to the number of nodes so that no tree is evicted.
+ * Small maps are solved by the blocked Floyd-Warshall of AllPairsDistances,
+ * whose vectorised O(n^3) sweep beats n searches once the map is small and
+ * dense, as maps given by distance matrices usually are. Larger maps run
+ * one search per node, skipping sources already cached.
+ *
+ * @param adjacency The edges to compute the trees over.
+ */
+void DistanceCache::PrecomputeAll(const CsrAdjacency& adjacency) {
+    const int num_nodes = adjacency.NumNodes();
+    int all_pairs_limit;
+    {
+        lock_guard<mutex> lock(_mutex);
+        _max_sources = max(_max_sources, num_nodes);
+        all_pairs_limit = _all_pairs_limit;
+    }
+    if (num_nodes > all_pairs_limit) {
+        for (int source = 0; source < num_nodes; source++) {
+            Get(adjacency, source);
+        }
+        return;
+    }
+
+    AllPairsDistances all_pairs(adjacency);
+    for (int source = 0; source < num_nodes; source++) {
+        Insert(make_shared<const ShortestPathTree>(all_pairs.Tree(source)));
+    }
+    count_metric(Counter::TreesBuilt, num_nodes);
+}
+
+/**
+ * @brief Sets the largest map PrecomputeAll solves with Floyd-Warshall.
+ *
+ * @param max_nodes The number of nodes, or 0 to always run one search per node.
+ */
+void DistanceCache::SetAllPairsLimit(int max_nodes) {
+    lock_guard<mutex> lock(_mutex);
+    _all_pairs_limit = max(max_nodes, 0);
+}
+
+/**
+ * @brief Returns the largest map PrecomputeAll solves with Floyd-Warshall.
+ *
+ * @return The number of nodes.
+ */
+int DistanceCache::AllPairsLimit() const {
+    lock_guard<mutex> lock(_mutex);
+    return _all_pairs_limit;
+}
+
+/**
+ * @brief Sets the largest number of trees kept at once.
+ *
+ * @param max_sources The number of trees to keep. Excess trees are evicted, least recently used first.
+ */
+void DistanceCache::SetCapacity(int max_sources) {
+    lock_guard<mutex> lock(_mutex);
+    _max_sources = max(max_sources, 0);
+    Shrink();
+}
+
+/**
+ * @brief Returns the number of trees currently cached.
+ *
+ * @return The number of cached trees.
+ */
+int DistanceCache::Size() const {
+    lock_guard<mutex> lock(_mutex);
+    return _trees.size();
+}
+
+/**
+ * @brief Discards every cached tree.
+ */
+void DistanceCache::Clear() {
+    lock_guard<mutex> lock(_mutex);
+    _trees.clear();
+    _recency.clear();
+}
+
+/**
+ * @brief Discards the trees that a set of edge changes could affect.
+ *
+ * @param changes The changes applied to the edges.
+ * @return The number of trees discarded.
+ */
+int DistanceCache::Invalidate(const vector<WeightChange>& changes) {
+    lock_guard<mutex> lock(_mutex);
+    int discarded = 0;
+    for (auto it = _trees.begin(); it != _trees.end(); ) {
+        const ShortestPathTree& tree = *it->second.tree;
+        bool affected = any_of(changes.begin(), changes.end(),
+                               [&tree](const WeightChange& change) { return tree.AffectedBy(change); });
+        if (affected) {
+            _recency.erase(it->second.recency);
+            it = _trees.erase(it);
+            discarded++;
+        }
+        else {
+            ++it;
+        }
+    }
+    return discarded;
+}
+
+/**
+ * @brief Stores a tree as the most recently used one.
+ *
+ * @param tree The tree to store. It is dropped if its source is already cached.
+ */
+void DistanceCache::Insert(shared_ptr<const ShortestPathTree> tree) {
+    lock_guard<mutex> lock(_mutex);
+    const int source = tree->Source();
+    if (_max_sources == 0 || _trees.count(source) > 0) {
+        return;
+    }
+    _recency.push_front(source);
+    _trees[source] = Slot{move(tree), _recency.begin()};
+    Shrink();
+}
+
+/**
+ * @brief Evicts the least recently used trees until the cache fits its capacity.
+ *
+ * The caller must hold the lock.
+ */
+void DistanceCache::Shrink() {
+    while ((int)_trees.size() > _max_sources) {
+        _trees.erase(_recency.back());
+        _recency.pop_back();
+    }
+}
+
+// Implementation of DistanceTable class
+
+/**
+ * @brief Constructs a table with every distance set to infinity.
+ *
+ * @param sources The nodes the rows of the table start from.
+ * @param targets The nodes the columns of the table lead to.
+ */
+DistanceTable::DistanceTable(vector<int> sources, vector<int> targets):
+    _sources(move(sources)), _targets(move(targets)),
+    _distances(_sources.size() * _targets.size(), numeric_limits<double>::infinity()) {};
+
+/**
+ * @brief Returns the number of rows of the table.
+ *
+ * @return The number of sources.
+ */
+int DistanceTable::NumSources() const { return _sources.size(); }
+
+/**
+ * @brief Returns the number of columns of the table.
+ *
+ * @return The number of targets.
+ */
+int DistanceTable::NumTargets() const { return _targets.size(); }
+
+/**
+ * @brief Returns the nodes the rows of the table start from.
+ *
+ * @return The source node IDs.
+ */
+const vector<int>& DistanceTable::Sources() const { return _sources; }
+
+/**
+ * @brief Returns the nodes the columns of the table lead to.
+ *
+ * @return The target node IDs.
+ */
+const vector<int>& DistanceTable::Targets() const { return _targets; }
+
+/**
+ * @brief Returns an entry of the table.
+ *
+ * @param i The row of the source.
+ * @param j The column of the target.
+ * @return The shortest distance from Sources()[i] to Targets()[j], or infinity if it is unreachable.
+ */
+double DistanceTable::At(int i, int j) const { return _distances[i * _targets.size() + j]; }
+
+/**
+ * @brief Returns a row of the table.
+ *
+ * @param i The row of the source.
+ * @return A pointer to the NumTargets() distances from Sources()[i].
+ */
+double* DistanceTable::Row(int i) { return _distances.data() + i * _targets.size(); }
@@ -0,0 +1,463 @@
+/**
+ * @file shortest_path.h
+ * @brief Defines the heap, search engine and tree cache used for shortest path queries.
+ */
+#ifndef SHORTEST_PATH_H
+#define SHORTEST_PATH_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class CsrAdjacency;
+class ShortestPathTree;
+
+/// A change to the length of one edge, as applied by Graph::UpdateEdges.
+struct WeightChange {
+    /// The ID of the node the edge leaves.
+    int source;
+
+    /// The ID of the node the edge leads to.
+    int target;
+
+    /// The length of the edge before the change.
+    double old_distance;
+
+    /// The length of the edge after the change, infinity for a closed road.
+    double new_distance;
+};
+
+/// The position of a node on the plane, in km.
+struct Coordinates {
+    /// The east-west position.
+    double x;
+
+    /// The north-south position.
+    double y;
+};
+
+/// A lower bound on the remaining distance to the target of a search, used to guide A* search.
+/// Bounds must be consistent: for every edge u -> v of length d, LowerBound(u, t) <= d + LowerBound(v, t).
+class SearchHeuristic {
+public:
+    /// Destructor.
+    virtual ~SearchHeuristic() = default;
+
+    /// Returns a lower bound on the shortest distance from a node to the target,
+    /// or infinity if the node cannot reach the target.
+    /// \param node The node to bound the distance from.
+    /// \param target The node to reach.
+    virtual double LowerBound(int node, int target) const = 0;
+};
+
+/// Bounds distances by the straight-line distance between node coordinates.
+/// The straight-line distance is scaled down by the smallest ratio of edge length to
+/// straight-line length over the map, so the bound holds even when edges are shorter
+/// than the gap between their ends.
+class EuclideanHeuristic : public SearchHeuristic {
+public:
+    /// Constructor.
+    /// \param adjacency The edges the heuristic must bound.
+    /// \param coordinates The position of each node.
+    EuclideanHeuristic(const CsrAdjacency& adjacency, std::vector<Coordinates> coordinates);
+
+    /// Returns the scaled straight-line distance from a node to the target.
+    double LowerBound(int node, int target) const override;
+
+    /// Returns the position of a node.
+    const Coordinates& Position(int node) const;
+
+    /// Returns the factor applied to straight-line distances.
+    double Scale() const;
+
+private:
+    /// The position of each node.
+    std::vector<Coordinates> _coordinates;
+
+    /// The factor applied to straight-line distances.
+    double _scale;
+};
+
+/// Bounds distances with the triangle inequality over a few landmark nodes (ALT).
+/// For a landmark L, d(v, t) >= d(v, L) - d(t, L) and d(v, t) >= d(L, t) - d(L, v);
+/// the bound is the largest of these over all landmarks.
+class LandmarkHeuristic : public SearchHeuristic {
+public:
+    /// Picks landmarks far apart from each other and computes their distances to and from every node.
+    /// \param forward The edges of the map.
+    /// \param backward The edges of the map reversed.
+    /// \param num_landmarks The number of landmarks to pick.
+    LandmarkHeuristic(const CsrAdjacency& forward, const CsrAdjacency& backward, int num_landmarks);
+
+    /// Returns the best triangle inequality bound from a node to the target.
+    double LowerBound(int node, int target) const override;
+
+    /// Returns the landmark nodes.
+    const std::vector<int>& Landmarks() const;
+
+private:
+    /// The landmark nodes.
+    std::vector<int> _landmarks;
+
+    /// The distance from each landmark to each node, node-major so a bound reads one block per node.
+    std::vector<double> _from;
+
+    /// The distance from each node to each landmark, node-major.
+    std::vector<double> _to;
+};
+
+/// A 4-ary min-heap of node ids keyed by distance, supporting decrease-key.
+/// Each node appears at most once; its position in the heap is tracked so that
+/// lowering its key moves the existing entry instead of pushing a duplicate.
+class IndexedHeap {
+public:
+    /// Empties the heap and makes room for node ids in [0, num_nodes).
+    /// \param num_nodes The number of nodes that may be pushed.
+    void Reset(int num_nodes);
+
+    /// Returns true if the heap holds no nodes.
+    bool Empty() const;
+
+    /// Returns the number of nodes in the heap.
+    int Size() const;
+
+    /// Returns true if the node is currently in the heap.
+    bool Contains(int node) const;
+
+    /// Inserts a node, or lowers its key if it is already in the heap with a larger one.
+    /// \param node The node to insert.
+    /// \param key The distance of the node.
+    void PushOrDecrease(int node, double key);
+
+    /// Returns the smallest key in the heap, which must not be empty.
+    double MinKey() const;
+
+    /// Removes and returns the node with the smallest key, which must exist.
+    int PopMin();
+
+private:
+    /// An entry of the heap.
+    struct Entry {
+        /// The distance of the node.
+        double key;
+
+        /// The ID of the node.
+        int node;
+    };
+
+    /// Moves the entry at the given position towards the root until the heap order holds.
+    void SiftUp(int pos);
+
+    /// Moves the entry at the given position towards the leaves until the heap order holds.
+    void SiftDown(int pos);
+
+    /// The number of children of each heap entry.
+    static const int arity = 4;
+
+    /// The heap entries, with the smallest key at the front.
+    std::vector<Entry> _entries;
+
+    /// The position of each node in _entries, or -1 if it is not in the heap.
+    std::vector<int> _position;
+};
+
+/// Runs Dijkstra searches over an adjacency, reusing its buffers across queries.
+/// Distances from the previous search are invalidated in O(1) by bumping a search
+/// counter, so a query only touches the nodes it reaches.
+/// An engine is not safe to share between threads; give each thread its own.
+class ShortestPathEngine {
+public:
+    /// Runs a search from a source node.
+    /// \param adjacency The edges to search over.
+    /// \param source The node to start from.
+    /// \param target The node at which the search may stop, or -1 to reach every node.
+    void Run(const CsrAdjacency& adjacency, int source, int target = -1);
+
+    /// Runs an A* search from a source node, settling nodes in order of distance plus heuristic bound.
+    /// Only the distance and path to the target are final afterwards.
+    /// \param adjacency The edges to search over.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    /// \param heuristic A consistent lower bound on the distance to the target.
+    void Run(const CsrAdjacency& adjacency, int source, int target, const SearchHeuristic& heuristic);
+
+    /// Runs a search from a source node that stops once every target is settled.
+    /// \param adjacency The edges to search over.
+    /// \param source The node to start from.
+    /// \param targets The nodes whose distances are needed.
+    void Run(const CsrAdjacency& adjacency, int source, const std::vector<int>& targets);
+
+    /// Returns the source of the last search.
+    int Source() const;
+
+    /// Returns the distance from the source to a node, or infinity if it was not reached.
+    double Distance(int node) const;
+
+    /// Returns the node before the given one on its shortest path, or -1 for the source and unreached nodes.
+    int Predecessor(int node) const;
+
+    /// Returns the nodes on the shortest path from the source to a node, or an empty list if it was not reached.
+    std::vector<int> Path(int node) const;
+
+    /// Returns the number of nodes taken off the heap by the last search.
+    int NumSettled() const;
+
+    /// Copies the result of the last search into a tree covering every node.
+    /// \param num_nodes The number of nodes in the searched adjacency.
+    ShortestPathTree Tree(int num_nodes) const;
+
+private:
+    /// Returns true if the node was reached by the current search.
+    bool Reached(int node) const;
+
+    /// The heap of nodes waiting to be settled.
+    IndexedHeap _heap;
+
+    /// The tentative distance of each node reached by the current search.
+    std::vector<double> _dist;
+
+    /// The predecessor of each node reached by the current search.
+    std::vector<int> _prev;
+
+    /// The search in which each node was last reached.
+    std::vector<unsigned> _reached_in;
+
+    /// The counter of the current search.
+    unsigned _search = 0;
+
+    /// The source of the current search.
+    int _source = -1;
+
+    /// The number of nodes settled by the current search.
+    int _num_settled = 0;
+
+    /// The search with targets in which each node was last marked as a target.
+    std::vector<unsigned> _target_in;
+
+    /// The counter of the current search with targets.
+    unsigned _target_search = 0;
+
+    /// The number of targets not yet settled, or a null pointer if the search has a single target.
+    int* _remaining_targets = nullptr;
+
+    /// The heuristic guiding the current search, or a null pointer for a plain Dijkstra search.
+    const SearchHeuristic* _heuristic = nullptr;
+};
+
+/// Runs bidirectional Dijkstra searches between two nodes, reusing its buffers across queries.
+/// One search grows forward from the source and the other backward from the target over
+/// the reversed edges, until no shorter meeting point can exist. Each search covers roughly
+/// a ball of half the radius, settling far fewer nodes on large maps.
+/// An engine is not safe to share between threads; give each thread its own.
+class BidirectionalEngine {
+public:
+    /// Runs a search between two nodes.
+    /// \param forward The edges to search over.
+    /// \param backward The same edges reversed.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    void Run(const CsrAdjacency& forward, const CsrAdjacency& backward, int source, int target);
+
+    /// Returns the distance from the source to the target, or infinity if it is unreachable.
+    double Distance() const;
+
+    /// Returns the nodes on the shortest path from the source to the target, or an empty list if it is unreachable.
+    std::vector<int> Path() const;
+
+    /// Returns the number of nodes taken off either heap by the last search.
+    int NumSettled() const;
+
+private:
+    /// The heap of each direction, forward first.
+    IndexedHeap _heap[2];
+
+    /// The tentative distance of each node in each direction.
+    std::vector<double> _dist[2];
+
+    /// The neighbour each node was reached from in each direction.
+    std::vector<int> _prev[2];
+
+    /// The search in which each node was last reached in each direction.
+    std::vector<unsigned> _reached_in[2];
+
+    /// The counter of the current search.
+    unsigned _search = 0;
+
+    /// The source and target of the current search.
+    int _source = -1, _target = -1;
+
+    /// The node where the best paths of the two directions meet, or -1 if they have not met.
+    int _meet = -1;
+
+    /// The length of the best path found.
+    double _best = 0;
+
+    /// The number of nodes settled by the current search.
+    int _num_settled = 0;
+};
+
+/// The shortest distances and predecessors from one source to every node.
+class ShortestPathTree {
+public:
+    /// Constructor.
+    /// \param source The source of the tree.
+    /// \param dist The distance to each node, infinity for unreachable nodes.
+    /// \param prev The predecessor of each node, -1 for the source and unreachable nodes.
+    ShortestPathTree(int source, std::vector<double> dist, std::vector<int> prev);
+
+    /// Returns the source of the tree.
+    int Source() const;
+
+    /// Returns the distance from the source to a node, or infinity if it is unreachable.
+    double Distance(int node) const;
+
+    /// Returns the node before the given one on its shortest path, or -1 for the source and unreachable nodes.
+    int Predecessor(int node) const;
+
+    /// Returns the nodes on the shortest path from the source to a node, or an empty list if it is unreachable.
+    std::vector<int> Path(int node) const;
+
+    /// Fills a list with the nodes on the shortest path from the source to a node, reusing its storage.
+    /// \param node The node to reach.
+    /// \param path Replaced by the nodes on the path, or emptied if the node is unreachable.
+    void Path(int node, std::vector<int>& path) const;
+
+    /// Returns true if a change to an edge's length could change any distance or path in the tree.
+    /// \param change The change to the edge.
+    bool AffectedBy(const WeightChange& change) const;
+
+private:
+    /// The source of the tree.
+    int _source;
+
+    /// The distance to each node.
+    std::vector<double> _dist;
+
+    /// The predecessor of each node.
+    std::vector<int> _prev;
+};
+
+/// A dense table of shortest path distances from a list of sources to a list of targets.
+class DistanceTable {
+public:
+    /// Constructs a table with every distance set to infinity.
+    /// \param sources The nodes the rows of the table start from.
+    /// \param targets The nodes the columns of the table lead to.
+    DistanceTable(std::vector<int> sources, std::vector<int> targets);
+
+    /// Returns the number of rows of the table.
+    int NumSources() const;
+
+    /// Returns the number of columns of the table.
+    int NumTargets() const;
+
+    /// Returns the nodes the rows of the table start from.
+    const std::vector<int>& Sources() const;
+
+    /// Returns the nodes the columns of the table lead to.
+    const std::vector<int>& Targets() const;
+
+    /// Returns the distance from Sources()[i] to Targets()[j], or infinity if it is unreachable.
+    double At(int i, int j) const;
+
+    /// Returns the NumTargets() distances from Sources()[i].
+    double* Row(int i);
+
+private:
+    /// The nodes the rows of the table start from.
+    std::vector<int> _sources;
+
+    /// The nodes the columns of the table lead to.
+    std::vector<int> _targets;
+
+    /// The distances in row-major order.
+    std::vector<double> _distances;
+};
+
+/// Memoised one-to-all shortest path trees, keyed by source.
+/// Once full, the least recently used tree is evicted. Trees are handed out as shared
+/// pointers, so an evicted tree stays valid for as long as a caller holds it.
+/// The cache may be used from several threads at once.
+class DistanceCache {
+public:
+    /// Constructor.
+    /// \param max_sources The largest number of trees kept at once.
+    explicit DistanceCache(int max_sources = 32);
+
+    /// Constructs a cache holding the same trees as another.
+    /// \param other The cache to copy.
+    DistanceCache(const DistanceCache& other);
+
+    DistanceCache& operator=(const DistanceCache&) = delete;
+
+    /// Returns the tree for a source, computing and storing it on a miss.
+    /// \param adjacency The edges the cached trees were computed over.
+    /// \param source The source of the tree.
+    std::shared_ptr<const ShortestPathTree> Get(const CsrAdjacency& adjacency, int source);
+
+    /// Returns the tree for a source if it is cached, or a null pointer otherwise.
+    /// \param source The source of the tree.
+    std::shared_ptr<const ShortestPathTree> Find(int source);
+
+    /// Computes and stores the tree of every node, raising the capacity to fit them all.
+    /// Maps of up to AllPairsLimit() nodes are solved at once by Floyd-Warshall, larger ones
+    /// by a search from each node.
+    /// \param adjacency The edges to compute the trees over.
+    void PrecomputeAll(const CsrAdjacency& adjacency);
+
+    /// Sets the largest map PrecomputeAll solves with Floyd-Warshall rather than one search per node.
+    /// \param max_nodes The number of nodes, or 0 to always search.
+    void SetAllPairsLimit(int max_nodes);
+
+    /// Returns the largest map PrecomputeAll solves with Floyd-Warshall.
+    int AllPairsLimit() const;
+
+    /// Sets the largest number of trees kept at once, evicting trees if needed.
+    void SetCapacity(int max_sources);
+
+    /// Returns the number of trees currently cached.
+    int Size() const;
+
+    /// Discards every cached tree.
+    void Clear();
+
+    /// Discards the trees that a set of edge changes could affect, keeping the rest.
+    /// \param changes The changes applied to the edges.
+    /// \return The number of trees discarded.
+    int Invalidate(const std::vector<WeightChange>& changes);
+
+private:
+    /// Stores a tree as the most recently used one, evicting the least recently used ones if full.
+    void Insert(std::shared_ptr<const ShortestPathTree> tree);
+
+    /// Evicts trees until the cache fits its capacity.
+    void Shrink();
+
+    /// A cached tree and its place in the recency list.
+    struct Slot {
+        /// The cached tree.
+        std::shared_ptr<const ShortestPathTree> tree;
+
+        /// The position of the source in _recency.
+        std::list<int>::iterator recency;
+    };
+
+    /// Guards every member below.
+    mutable std::mutex _mutex;
+
+    /// The largest number of trees kept at once.
+    int _max_sources;
+
+    /// The largest map precomputed with Floyd-Warshall.
+    int _all_pairs_limit;
+
+    /// Cached sources, most recently used first.
+    std::list<int> _recency;
+
+    /// The cached trees, keyed by source.
+    std::unordered_map<int, Slot> _trees;
+};
+
+#endif
@@ -0,0 +1,294 @@
+/**
+ * @file simulation.cpp
+ * @brief Implements the simulation driver and its CSV and JSON reports.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include "fleet.h"
+#include "simulation.h"
+#include "thread_pool.h"
+#include "topological_map.h"
+
+using namespace std;
+
+/// The clock the simulation is timed with.
+typedef chrono::steady_clock sim_clock;
+
+/**
+ * @brief Returns the seconds elapsed since a time.
+ *
+ * @param start The time.
+ * @return The seconds since it.
+ */
+static double seconds_since(sim_clock::time_point start) {
+    return chrono::duration<double>(sim_clock::now() - start).count();
+}
+
+/// A sink that discards the reports but times each leg and totals what was delivered.
+/// A leg is reported as soon as it is routed, so the time between one leg's report and
+/// the next, or since its task started, is the time taken to route it.
+class LegTimingSink : public ReportSink {
+public:
+    void Route(const RouteResult&, bool) override {}
+
+    void TaskStarted(int) override {
+        trips++;
+        _last = sim_clock::now();
+    }
+
+    void Delivery(const DeliveryLeg& leg) override {
+        orders++;
+        packages += leg.packages;
+        Leg(leg.route);
+    }
+
+    void ReturnLeg(int, const RouteResult& route) override { Leg(route); }
+
+    void Text(const string&) override {}
+
+    void Flush() override {}
+
+    /// The time taken to route each leg, in ms.
+    vector<double> leg_ms;
+
+    /// The total length of the legs, in km.
+    double distance = 0.0;
+
+    /// The number of tasks started.
+    int trips = 0;
+
+    /// The number of deliveries.
+    int orders = 0;
+
+    /// The number of packages delivered.
+    int packages = 0;
+
+private:
+    /// Records a leg, timed since the last report.
+    void Leg(const RouteResult& route) {
+        const sim_clock::time_point now = sim_clock::now();
+        leg_ms.push_back(chrono::duration<double, milli>(now - _last).count());
+        _last = now;
+        distance += route.distance;
+    }
+
+    /// The time of the last report.
+    sim_clock::time_point _last = sim_clock::now();
+};
+
+/**
+ * @brief Returns the planning throughput.
+ *
+ * @return The orders planned per second of planning, or 0 if nothing was planned.
+ */
+double ScenarioResult::OrdersPerSecond() const {
+    return planning_seconds > 0 ? orders / planning_seconds : 0.0;
+}
+
+/**
+ * @brief Runs one scenario.
+ *
+ * The map is generated from the scenario's seed, and each day's orders from
+ * its day number, so a scenario gives the same deliveries and distances on
+ * any machine and in any order. Only the dispatch is timed as planning and
+ * only the performed tasks as routing; drawing orders is neither.
+ *
+ * @param scenario The scenario.
+ * @param pool The threads the fleet's queues are planned on, or a null pointer to plan them on one worker of the scenario's own.
+ * @return What the scenario delivered and how long it took.
+ * @throws invalid_argument If the scenario has no nodes, no days or no robots.
+ */
+ScenarioResult run_scenario(const Scenario& scenario, ThreadPool* pool) {
+    if (scenario.num_nodes < 1 || scenario.num_days < 1 || scenario.fleet.empty()) {
+        throw invalid_argument("A scenario needs nodes, days and robots");
+    }
+    ScenarioResult result{scenario};
+
+    sim_clock::time_point start = sim_clock::now();
+    Graph graph = Graph::FromEdgeList(scenario.num_nodes,
+                                      generate_edge_list(scenario.num_nodes, scenario.connectivity, scenario.map_seed));
+    result.setup_seconds = seconds_since(start);
+
+    // The dispatcher plans on a pool, so a serial run gives it one worker of its own
+    unique_ptr<ThreadPool> own_pool;
+    if (pool == nullptr) {
+        own_pool = make_unique<ThreadPool>(1);
+        pool = own_pool.get();
+    }
+    const GreedyPlanner greedy;
+    const SavingsPlanner savings;
+    const RoutePlanner& planner = scenario.savings ? (const RoutePlanner&)savings : greedy;
+    const Dispatcher dispatcher(scenario.fleet, planner, *pool);
+
+    LegTimingSink sink;
+    for (int day = scenario.first_day; day < scenario.first_day + scenario.num_days; day++) {
+        graph.UpdateOrders(day);
+        const vector<pair<int,int>> orders = graph.GetOrderList();
+
+        start = sim_clock::now();
+        vector<RobotPlan> plans = dispatcher.Dispatch(orders, graph);
+        result.planning_seconds += seconds_since(start);
+
+        start = sim_clock::now();
+        // The whole fleet leaves from and returns to the store, so it shares the store's trees
+        const DepotTrees depot(graph);
+        for (RobotPlan& plan : plans) {
+            plan.queue.PerformTasks(graph, sink, depot);
+        }
+        result.routing_seconds += seconds_since(start);
+    }
+
+    result.orders = sink.orders;
+    result.packages = sink.packages;
+    result.trips = sink.trips;
+    result.legs = sink.leg_ms.size();
+    result.distance = sink.distance;
+    vector<double>& leg_ms = sink.leg_ms;
+    if (!leg_ms.empty()) {
+        double total = 0.0;
+        for (double ms : leg_ms) {
+            total += ms;
+        }
+        result.leg_mean_ms = total / leg_ms.size();
+        auto percentile = [&leg_ms](double p) {
+            auto nth = leg_ms.begin() + (size_t)(p * (leg_ms.size() - 1));
+            nth_element(leg_ms.begin(), nth, leg_ms.end());
+            return *nth;
+        };
+        result.leg_p50_ms = percentile(0.5);
+        result.leg_p99_ms = percentile(0.99);
+        result.leg_max_ms = *max_element(leg_ms.begin(), leg_ms.end());
+    }
+    return result;
+}
+
+/**
+ * @brief Runs scenarios independently.
+ *
+ * Each scenario builds its own map, so scenarios share nothing and run one
+ * per worker. A scenario's dispatcher plans on the same pool, whose workers
+ * run queued jobs while waiting, so planning fills any workers left idle
+ * once fewer scenarios than workers remain.
+ *
+ * @param scenarios The scenarios.
+ * @param pool The threads to run the scenarios on, or a null pointer to run them one after another.
+ * @return One result per scenario, in the order of the scenarios.
+ */
+vector<ScenarioResult> run_scenarios(const vector<Scenario>& scenarios, ThreadPool* pool) {
+    vector<ScenarioResult> results;
+    results.reserve(scenarios.size());
+    if (pool == nullptr) {
+        for (const Scenario& scenario : scenarios) {
+            results.push_back(run_scenario(scenario));
+        }
+        return results;
+    }
+
+    vector<future<ScenarioResult>> jobs;
+    jobs.reserve(scenarios.size());
+    for (const Scenario& scenario : scenarios) {
+        jobs.push_back(pool->Submit([&scenario, pool]() { return run_scenario(scenario, pool); }));
+    }
+    for (auto& job : jobs) {
+        results.push_back(pool->Await(job));
+    }
+    return results;
+}
+
+/**
+ * @brief Returns the capacities of a fleet's robots, joined by '+'.
+ *
+ * @param fleet The robots.
+ * @return The capacities, such as "3+3+5".
+ */
+static string fleet_capacities(const vector<Robot>& fleet) {
+    string capacities;
+    for (const Robot& robot : fleet) {
+        capacities += (capacities.empty() ? "" : "+") + to_string(robot.GetCarryingCapacity());
+    }
+    return capacities;
+}
+
+/**
+ * @brief Returns a string escaped for a JSON string literal or a quoted CSV field.
+ *
+ * @param text The string.
+ * @param csv True to double quotes for CSV, false to backslash-escape quotes and backslashes for JSON.
+ * @return The escaped string, without surrounding quotes.
+ */
+static string escape(const string& text, bool csv) {
+    string escaped;
+    for (char c : text) {
+        if (c == '"') {
+            escaped += csv ? "\"\"" : "\\\"";
+        }
+        else if (c == '\\' && !csv) {
+            escaped += "\\\\";
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+/**
+ * @brief Formats the fields of a result shared by the CSV and JSON reports.
+ *
+ * @param result The result.
+ * @param format The printf format taking every field in the order of the CSV header.
+ * @param csv True to escape the name for CSV, false for JSON.
+ * @return The formatted fields.
+ */
+static string format_result(const ScenarioResult& result, const char* format, bool csv) {
+    const Scenario& scenario = result.scenario;
+    char line[1024];
+    snprintf(line, sizeof(line), format, escape(scenario.name, csv).c_str(), scenario.num_nodes,
+             scenario.connectivity, scenario.map_seed, (int)scenario.fleet.size(),
+             fleet_capacities(scenario.fleet).c_str(), scenario.savings ? "savings" : "greedy", scenario.first_day,
+             scenario.num_days, result.orders, result.packages, result.trips, result.legs, result.distance,
+             result.setup_seconds, result.planning_seconds, result.OrdersPerSecond(), result.routing_seconds,
+             result.leg_mean_ms, result.leg_p50_ms, result.leg_p99_ms, result.leg_max_ms);
+    return line;
+}
+
+/**
+ * @brief Writes results as CSV.
+ *
+ * @param out The stream to write to.
+ * @param results The results.
+ */
+void write_csv(ostream& out, const vector<ScenarioResult>& results) {
+    out << "name,nodes,connectivity,map_seed,robots,capacities,planner,first_day,days,orders,packages,trips,legs,"
+           "km,setup_s,planning_s,orders_per_s,routing_s,leg_mean_ms,leg_p50_ms,leg_p99_ms,leg_max_ms\n";
+    for (const ScenarioResult& result : results) {
+        out << format_result(result, "\"%s\",%d,%g,%d,%d,%s,%s,%d,%d,%d,%d,%d,%d,%.3f,%.6f,%.6f,%.1f,%.6f,"
+                             "%.6f,%.6f,%.6f,%.6f\n", true);
+    }
+}
+
+/**
+ * @brief Writes results as a JSON array.
+ *
+ * @param out The stream to write to.
+ * @param results The results.
+ */
+void write_json(ostream& out, const vector<ScenarioResult>& results) {
+    out << "[";
+    for (size_t i=0; i<results.size(); i++) {
+        out << (i == 0 ? "\n  " : ",\n  ")
+            << format_result(results[i], "{\"name\": \"%s\", \"nodes\": %d, \"connectivity\": %g, "
+                             "\"map_seed\": %d, \"robots\": %d, \"capacities\": \"%s\", \"planner\": \"%s\", "
+                             "\"first_day\": %d, \"days\": %d, \"orders\": %d, \"packages\": %d, \"trips\": %d, "
+                             "\"legs\": %d, \"km\": %.3f, \"setup_s\": %.6f, \"planning_s\": %.6f, "
+                             "\"orders_per_s\": %.1f, \"routing_s\": %.6f, \"leg_mean_ms\": %.6f, "
+                             "\"leg_p50_ms\": %.6f, \"leg_p99_ms\": %.6f, \"leg_max_ms\": %.6f}", false);
+    }
+    out << (results.empty() ? "]\n" : "\n]\n");
+}
@@ -0,0 +1,111 @@
+/**
+ * @file simulation.h
+ * @brief Defines a driver replaying many simulated days over maps and fleets, for capacity planning.
+ */
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "task_queue.h"
+
+class ThreadPool;
+
+/// One independent simulation: a generated map, a fleet and a run of days on them.
+struct Scenario {
+    /// The name of the scenario in reports.
+    std::string name;
+
+    /// The number of nodes of the map, the store included.
+    int num_nodes;
+
+    /// The probability of a random edge between two nodes, as for generate_edge_list.
+    double connectivity;
+
+    /// The seed the map is generated from.
+    int map_seed;
+
+    /// The first day, whose number seeds the day's orders as for Graph::UpdateOrders.
+    int first_day;
+
+    /// The number of days.
+    int num_days;
+
+    /// The robots delivering the orders.
+    std::vector<Robot> fleet;
+
+    /// True to plan trips with SavingsPlanner, false for GreedyPlanner.
+    bool savings;
+};
+
+/// What one scenario delivered and how long it took.
+struct ScenarioResult {
+    /// The scenario.
+    Scenario scenario;
+
+    /// The number of orders delivered, one per house and day with packages.
+    int orders = 0;
+
+    /// The number of packages delivered.
+    int packages = 0;
+
+    /// The number of trips driven.
+    int trips = 0;
+
+    /// The number of legs driven, to a house or back to the store.
+    int legs = 0;
+
+    /// The total distance driven, in km.
+    double distance = 0.0;
+
+    /// The time taken to build the map, in seconds.
+    double setup_seconds = 0.0;
+
+    /// The time taken to dispatch and plan the orders, in seconds.
+    double planning_seconds = 0.0;
+
+    /// The time taken to route and report the trips, in seconds.
+    double routing_seconds = 0.0;
+
+    /// The mean time to route one leg, in ms.
+    double leg_mean_ms = 0.0;
+
+    /// The median time to route one leg, in ms.
+    double leg_p50_ms = 0.0;
+
+    /// The 99th percentile of the time to route one leg, in ms.
+    double leg_p99_ms = 0.0;
+
+    /// The longest time to route one leg, in ms.
+    double leg_max_ms = 0.0;
+
+    /// Returns the planning throughput, in orders per second.
+    double OrdersPerSecond() const;
+};
+
+/// Runs one scenario. Each day draws its orders with Graph::UpdateOrders, shares them
+/// across the fleet with a Dispatcher, and performs every robot's TaskQueue, timing each
+/// leg as it is reported.
+/// \param scenario The scenario.
+/// \param pool The threads the fleet's queues are planned on, or a null pointer to plan them on one worker of the scenario's own.
+/// \throws std::invalid_argument If the scenario has no nodes, no days or no robots.
+ScenarioResult run_scenario(const Scenario& scenario, ThreadPool* pool = nullptr);
+
+/// Runs scenarios independently, each on its own map, as one job per scenario.
+/// \param scenarios The scenarios.
+/// \param pool The threads to run the scenarios on, or a null pointer to run them one after another.
+/// \return One result per scenario, in the order of the scenarios.
+std::vector<ScenarioResult> run_scenarios(const std::vector<Scenario>& scenarios, ThreadPool* pool = nullptr);
+
+/// Writes results as CSV, with a header row and one row per scenario.
+/// \param out The stream to write to.
+/// \param results The results.
+void write_csv(std::ostream& out, const std::vector<ScenarioResult>& results);
+
+/// Writes results as a JSON array, with one object per scenario.
+/// \param out The stream to write to.
+/// \param results The results.
+void write_json(std::ostream& out, const std::vector<ScenarioResult>& results);
+
+#endif
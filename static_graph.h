@@ -0,0 +1,238 @@
+/**
+ * @file static_graph.h
+ * @brief Defines a map whose node count is fixed at compile time, for small delivery zones.
+ */
+#ifndef STATIC_GRAPH_H
+#define STATIC_GRAPH_H
+
+#include <array>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "route_report.h"
+#include "topological_map.h"
+
+/// A map of N nodes held entirely in fixed-size arrays.
+/// Construction builds the adjacency and then every shortest distance and predecessor
+/// with Floyd-Warshall, and can run at compile time. Every loop is bounded by N, so the
+/// compiler can unroll them, and nothing is allocated on the heap, so a zone of a dozen
+/// nodes lives in a few KB of L1 cache and a query is a table lookup.
+/// The member functions mirror those of Graph, so code templated on the map type can
+/// pick either. Edges are only set at construction; orders can change at any time.
+/// \tparam N The number of nodes.
+/// \tparam Weight The type of edge lengths, such as double, float or integer metres.
+template <int N, typename Weight = double>
+class StaticGraph {
+    static_assert(N > 0, "A map needs at least one node");
+    static_assert(std::is_arithmetic<Weight>::value, "Edge lengths must be numbers");
+
+public:
+    /// A distance matrix, where lengths not above the edge threshold mean no edge.
+    using Matrix = std::array<std::array<Weight, N>, N>;
+
+    /// Constructor.
+    /// \param distances The length of the edge from each node to each other, as taken by Graph.
+    constexpr explicit StaticGraph(const Matrix& distances) {
+        int num_edges = 0;
+        for (int u = 0; u < N; u++) {
+            _offsets[u] = num_edges;
+            for (int v = 0; v < N; v++) {
+                if (distances[u][v] > edge_threshold) {
+                    _targets[num_edges] = v;
+                    _lengths[num_edges] = distances[u][v];
+                    num_edges++;
+                }
+            }
+        }
+        _offsets[N] = num_edges;
+
+        for (int u = 0; u < N; u++) {
+            for (int v = 0; v < N; v++) {
+                _dist[u][v] = (u == v) ? Weight(0) : Unreachable();
+                _pred[u][v] = -1;
+            }
+            for (int e = _offsets[u]; e < _offsets[u + 1]; e++) {
+                if (_lengths[e] < _dist[u][_targets[e]]) {
+                    _dist[u][_targets[e]] = _lengths[e];
+                    _pred[u][_targets[e]] = u;
+                }
+            }
+        }
+        for (int k = 0; k < N; k++) {
+            for (int i = 0; i < N; i++) {
+                if (_dist[i][k] == Unreachable()) {
+                    continue;
+                }
+                for (int j = 0; j < N; j++) {
+                    if (_dist[k][j] != Unreachable() && _dist[i][k] + _dist[k][j] < _dist[i][j]) {
+                        _dist[i][j] = _dist[i][k] + _dist[k][j];
+                        _pred[i][j] = _pred[k][j];
+                    }
+                }
+            }
+        }
+    }
+
+    /// Builds a map from a distance matrix made at run time, such as by generate_dist_matrix.
+    /// \param distances An N by N distance matrix.
+    /// \throws std::invalid_argument If the matrix is not N by N.
+    static StaticGraph FromMatrix(const std::vector<std::vector<double>>& distances) {
+        if ((int)distances.size() != N) {
+            throw std::invalid_argument("Expected a matrix of " + std::to_string(N) + " rows, got " +
+                                        std::to_string(distances.size()));
+        }
+        Matrix matrix{};
+        for (int u = 0; u < N; u++) {
+            if ((int)distances[u].size() != N) {
+                throw std::invalid_argument("Row " + std::to_string(u) + " of the matrix does not have " +
+                                            std::to_string(N) + " columns");
+            }
+            for (int v = 0; v < N; v++) {
+                matrix[u][v] = static_cast<Weight>(distances[u][v]);
+            }
+        }
+        return StaticGraph(matrix);
+    }
+
+    /// Returns the length standing for an unreachable node: infinity, or the largest value for integer lengths.
+    static constexpr Weight Unreachable() {
+        return std::numeric_limits<Weight>::has_infinity ? std::numeric_limits<Weight>::infinity()
+                                                         : std::numeric_limits<Weight>::max();
+    }
+
+    /// Returns the number of nodes in the graph.
+    static constexpr int NumNodes() { return N; }
+
+    /// Returns the number of edges in the graph.
+    constexpr int NumEdges() const { return _offsets[N]; }
+
+    /// Returns the number of edges leaving a node.
+    constexpr int Degree(int node) const { return _offsets[node + 1] - _offsets[node]; }
+
+    /// Returns the node an edge leads to.
+    /// \param node The node the edge leaves.
+    /// \param index The position of the edge among those leaving the node, below Degree(node).
+    constexpr int Neighbour(int node, int index) const { return _targets[_offsets[node] + index]; }
+
+    /// Returns the length of an edge.
+    /// \param node The node the edge leaves.
+    /// \param index The position of the edge among those leaving the node, below Degree(node).
+    constexpr Weight EdgeLength(int node, int index) const { return _lengths[_offsets[node] + index]; }
+
+    /// Returns the shortest distance from one node to another, or Unreachable().
+    constexpr Weight Distance(int source, int target) const { return _dist[source][target]; }
+
+    /// Fills a fixed-size list with the nodes on the shortest path, starting at the source.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    /// \param path Filled with the nodes on the path.
+    /// \return The number of nodes on the path, or 0 if the target is unreachable.
+    constexpr int Path(int source, int target, std::array<int, N>& path) const {
+        if (_dist[source][target] == Unreachable()) {
+            return 0;
+        }
+        int length = 0;
+        for (int v = target; v != source; v = _pred[source][v]) {
+            path[length++] = v;
+        }
+        path[length++] = source;
+        for (int i = 0; i < length / 2; i++) {
+            const int node = path[i];
+            path[i] = path[length - 1 - i];
+            path[length - 1 - i] = node;
+        }
+        return length;
+    }
+
+    /// Returns the shortest route between two nodes, as Graph::Route does.
+    RouteResult Route(int source, int target) const {
+        RouteResult route{source, target, std::numeric_limits<double>::infinity(), {}};
+        std::array<int, N> path{};
+        const int length = Path(source, target, path);
+        if (length > 0) {
+            route.distance = static_cast<double>(_dist[source][target]);
+            route.path.assign(path.begin(), path.begin() + length);
+        }
+        return route;
+    }
+
+    /// Computes the shortest path between two nodes, as Graph::ShortestPath does.
+    /// \param nodeIndex1 The node to start from.
+    /// \param nodeIndex2 The node to reach.
+    /// \param verbose 1 to print the path, more than 1 to print the path and distance, 0 to print nothing.
+    /// \return The shortest distance, or -1 if the second node cannot be reached from the first.
+    double ShortestPath(int nodeIndex1, int nodeIndex2, int verbose = 0) const {
+        if (_dist[nodeIndex1][nodeIndex2] == Unreachable()) {
+            return -1;
+        }
+        if (verbose > 0) {
+            TextReportSink console(std::cout);
+            console.Route(Route(nodeIndex1, nodeIndex2), verbose > 1);
+        }
+        return static_cast<double>(_dist[nodeIndex1][nodeIndex2]);
+    }
+
+    /// Sets the number of orders for a node.
+    constexpr void SetNumOrders(int id, int orders) { _num_orders[id] = orders; }
+
+    /// Returns the number of orders for a node.
+    constexpr int GetNumOrders(int id) const { return _num_orders[id]; }
+
+    /// Returns the number of nodes with at least one order.
+    constexpr int NumActiveOrders() const {
+        int active = 0;
+        for (int id = 0; id < N; id++) {
+            active += (_num_orders[id] != 0);
+        }
+        return active;
+    }
+
+    /// Updates the number of orders assigned to each node, drawing the same orders as Graph::UpdateOrders.
+    /// \param seed A random seed to use for generating the number of orders, such as the day.
+    void UpdateOrders(int seed) {
+        // Exclude the first node that is the store
+        for (int id = 1; id < N; id++) {
+            _num_orders[id] = random_orders(seed, id);
+        }
+    }
+
+    /// Returns a vector of node id and order count pairs for each node with orders, sorted by node id.
+    std::vector<std::pair<int, int>> GetOrderList() const {
+        std::vector<std::pair<int, int>> order_list;
+        order_list.reserve(NumActiveOrders());
+        for (int id = 0; id < N; id++) {
+            if (_num_orders[id] != 0) {
+                order_list.emplace_back(id, _num_orders[id]);
+            }
+        }
+        return order_list;
+    }
+
+private:
+    /// Lengths above this are edges, matching the threshold Graph applies to distance matrices.
+    static constexpr Weight edge_threshold = std::is_floating_point<Weight>::value ? Weight(1e-6) : Weight(0);
+
+    /// The start position of each node's edges, followed by the number of edges.
+    std::array<int, N + 1> _offsets{};
+
+    /// The neighbour id of each edge.
+    std::array<int, N * N> _targets{};
+
+    /// The length of each edge.
+    std::array<Weight, N * N> _lengths{};
+
+    /// The shortest distance from each node to each other.
+    std::array<std::array<Weight, N>, N> _dist{};
+
+    /// The node before each target on the shortest path from each source, -1 for none.
+    std::array<std::array<int, N>, N> _pred{};
+
+    /// The number of orders for each node.
+    std::array<int, N> _num_orders{};
+};
+
+#endif
@@ -0,0 +1,374 @@
+/**
+ * @file task_queue.cpp
+ * @brief Implements robots, tasks and the task queue.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include "task_queue.h"
+#include "metrics.h"
+
+using namespace std;
+
+// Implementation of Robot class
+
+/**
+  * @brief Constructor for Robot class.
+  * @param id The unique ID of the robot.
+  * @param carrying_capacity The maximum weight the robot can carry.
+  * @param speed The speed the robot drives at, in km/h.
+  * @param service_time The time the robot takes to hand over a delivery, in hours.
+  */
+Robot::Robot(int id, int carrying_capacity, double speed, double service_time):
+    _id(id), _carrying_capacity(carrying_capacity), _speed(speed), _service_time(service_time) {};
+
+/**
+  * @brief Getter for robot ID.
+  * @return The unique ID of the robot.
+  */
+int Robot::GetId() const { return _id; }
+
+/**
+  * @brief Getter for robot carrying capacity.
+  * @return The maximum weight the robot can carry.
+  */
+int Robot::GetCarryingCapacity() const { return _carrying_capacity; }
+
+/**
+  * @brief Getter for robot speed.
+  * @return The speed the robot drives at, in km/h.
+  */
+double Robot::GetSpeed() const { return _speed; }
+
+/**
+  * @brief Getter for robot service time.
+  * @return The time the robot takes to hand over a delivery, in hours.
+  */
+double Robot::GetServiceTime() const { return _service_time; }
+
+// Implementation of DepotTrees struct
+
+/**
+  * @brief Takes the shortest path trees from the store and back to it from the graph's caches.
+  * @param graph The graph representing the delivery area.
+  */
+DepotTrees::DepotTrees(const Graph& graph):
+    outbound(graph.DistancesFrom(store_id)), inbound(graph.DistancesTo(store_id)) {};
+
+// Implementation of Task class
+
+/**
+  * @brief Constructor for Task class.
+  * @param robot_id The ID of the robot that will perform the task.
+  * @param delivery_orders A vector of delivery orders, represented as pairs of house IDs and package weights.
+  */
+Task::Task(int robot_id, vector<pair<int, int>> delivery_orders): 
+    _robot_id(robot_id), _delivery_orders(move(delivery_orders)) {};
+
+/**
+ * @brief Getter for the robot ID associated with the task.
+ * @return The ID of the robot that will perform the task.
+ */
+int Task::GetRobotId() const { return _robot_id; }
+
+/**
+  * @brief Getter for the vector of delivery orders associated with the task.
+  * @return A reference to the delivery orders, represented as pairs of house IDs and package weights.
+  */
+const vector<pair<int,int>>& Task::GetDeliveryOrders() const { return _delivery_orders; }
+
+/**
+  * @brief Getter for the total number of packages carried on the task.
+  * @return The sum of the package weights of the delivery orders.
+  */
+int Task::GetLoad() const {
+    int load = 0;
+    for (const auto& order : _delivery_orders) {
+        load += order.second;
+    }
+    return load;
+}
+
+/**
+  * @brief Inserts an order into the task.
+  * @param position The number of orders delivered before the new one.
+  * @param order The order, as a pair of house ID and package weight.
+  */
+void Task::InsertOrder(int position, const pair<int,int>& order) {
+    _delivery_orders.insert(_delivery_orders.begin() + position, order);
+}
+
+/**
+  * @brief Display the shortest path for the robot to complete the delivery orders associated with the task.
+  * @param graph The graph representing the delivery area.
+  */
+void Task::DisplayPath(const Graph& graph) const {
+    TextReportSink console(cout);
+    DisplayPath(graph, console);
+}
+
+/**
+  * @brief Report the route of each delivery made on the task, and the return to the store.
+  * @param graph The graph representing the delivery area.
+  * @param sink The sink the deliveries are reported to.
+  */
+void Task::DisplayPath(const Graph& graph, ReportSink& sink) const {
+    DisplayPath(graph, sink, DepotTrees(graph));
+}
+
+/**
+  * @brief Report the route of each delivery made on the task, and the return to the store.
+  *
+  * The trip is a closed tour: the leg out of the store is a path of the
+  * store's tree and the leg back is a path of the tree to the store, so of
+  * the k + 1 legs of a trip to k houses only the k - 1 between houses need
+  * trees of their own. Houses and paths are reported under the ids the map
+  * was loaded with, even if the graph has been renumbered.
+  *
+  * @param graph The graph representing the delivery area.
+  * @param sink The sink the deliveries are reported to.
+  * @param depot The trees from and to the store on the same graph.
+  */
+void Task::DisplayPath(const Graph& graph, ReportSink& sink, const DepotTrees& depot) const {
+    SpanTimer timer(Span::DisplayPath);
+    DeliveryLeg leg{GetRobotId(), 0, 0, RouteResult{store_id, store_id, 0.0, {}}};
+    int prev_node = store_id;
+    for (const pair<int,int>& order : GetDeliveryOrders()) {
+        // Legs often start from the same node, so reuse the cached tree of the start node
+        shared_ptr<const ShortestPathTree> tree =
+            (prev_node == store_id) ? depot.outbound : graph.DistancesFrom(prev_node);
+        leg.house = graph.ExternalId(order.first);
+        leg.packages = order.second;
+        leg.route.source = prev_node;
+        leg.route.target = order.first;
+        leg.route.distance = tree->Distance(order.first);
+        tree->Path(order.first, leg.route.path);
+        graph.GetRenumbering().ToExternal(leg.route);
+        sink.Delivery(leg);
+        prev_node = order.first;
+    }
+    count_metric(Counter::Deliveries, GetDeliveryOrders().size());
+
+    if (GetDeliveryOrders().empty()) {
+        return;
+    }
+    // The tree to the store lists each path from the store backwards
+    RouteResult& back = leg.route;
+    back.source = prev_node;
+    back.target = store_id;
+    back.distance = depot.inbound->Distance(prev_node);
+    depot.inbound->Path(prev_node, back.path);
+    reverse(back.path.begin(), back.path.end());
+    graph.GetRenumbering().ToExternal(back);
+    sink.ReturnLeg(GetRobotId(), back);
+}
+
+// Implementation of TaskQueue class
+/**
+  * @brief Constructor for TaskQueue class.
+  * @param orders A vector of delivery orders, represented as pairs of house IDs and package weights.
+  * @param robot The robot that will perform the delivery tasks in the queue.
+  */
+TaskQueue::TaskQueue(const vector<pair<int, int>>& orders, const Robot& robot) {
+    SpanTimer timer(Span::TaskQueueBuild);
+    // Create a task for each delivery group
+    vector<Trip> delivery_groups = greedy_trips(orders, robot.GetCarryingCapacity());
+    _queue.reserve(delivery_groups.size());
+    for (auto& group : delivery_groups) {
+        _queue.emplace_back(robot.GetId(), move(group));
+    }
+}
+
+/**
+  * @brief Constructor for TaskQueue class that plans the trips with a route planner.
+  * @param orders A vector of delivery orders, represented as pairs of house IDs and package weights.
+  * @param robot The robot that will perform the delivery tasks in the queue.
+  * @param graph The graph representing the delivery area.
+  * @param planner The planner used to group the orders into trips.
+  */
+TaskQueue::TaskQueue(const vector<pair<int, int>>& orders, const Robot& robot,
+                     const Graph& graph, const RoutePlanner& planner) {
+    SpanTimer timer(Span::TaskQueueBuild);
+    vector<Trip> trips = planner.PlanTrips(orders, robot.GetCarryingCapacity(), graph);
+    _queue.reserve(trips.size());
+    for (auto& trip : trips) {
+        _queue.emplace_back(robot.GetId(), move(trip));
+    }
+}
+
+/**
+  * @brief Perform all the tasks in the queue.
+  * @param graph The graph representing the delivery area.
+  */
+void TaskQueue::PerformTasks(const Graph& graph) {
+    TextReportSink console(cout);
+    PerformTasks(graph, console);
+}
+
+/**
+  * @brief Builds a queue holding one task per trip.
+  * @param trips The trips, with houses in visiting order.
+  * @param robot The robot that will perform the tasks.
+  * @return The queue, with the tasks in the order of the trips.
+  */
+TaskQueue TaskQueue::FromTrips(vector<Trip> trips, const Robot& robot) {
+    TaskQueue queue({}, robot);
+    queue._queue.reserve(trips.size());
+    for (Trip& trip : trips) {
+        queue._queue.emplace_back(robot.GetId(), move(trip));
+    }
+    return queue;
+}
+
+/**
+  * @brief Perform all the tasks in the queue, reporting them to a sink.
+  * @param graph The graph representing the delivery area.
+  * @param sink The sink the tasks, their deliveries and their returns to the store are reported to.
+  */
+void TaskQueue::PerformTasks(const Graph& graph, ReportSink& sink) {
+    if (_queue.empty()) {
+        _leg_lengths.clear();
+        return;
+    }
+    // Every task leaves from and returns to the store, so its trees are looked up once for the day
+    PerformTasks(graph, sink, DepotTrees(graph));
+}
+
+/**
+  * @brief Perform all the tasks in the queue, reporting them to a sink, with trees of the store shared by the fleet.
+  * @param graph The graph representing the delivery area.
+  * @param sink The sink the tasks, their deliveries and their returns to the store are reported to.
+  * @param depot The trees from and to the store on the same graph.
+  */
+void TaskQueue::PerformTasks(const Graph& graph, ReportSink& sink, const DepotTrees& depot) {
+    SpanTimer timer(Span::PerformTasks);
+    for (int i=0; i<(int)_queue.size(); i++) {
+        sink.TaskStarted(i+1);
+        _queue[i].DisplayPath(graph, sink, depot);
+    }
+    _queue.clear();
+    _leg_lengths.clear();
+}
+
+/**
+  * @brief Getter for the tasks in the queue.
+  * @return A reference to the tasks, in the order they are performed.
+  */
+const vector<Task>& TaskQueue::GetTasks() const { return _queue; }
+
+/**
+  * @brief Computes the distance driven to perform all the tasks in the queue.
+  * @param graph The graph representing the delivery area.
+  * @return The total length of the trips, each measured as a closed tour from the store.
+  */
+double TaskQueue::TotalDistance(const Graph& graph) const {
+    double distance = 0;
+    for (const Task& task : _queue) {
+        distance += trip_distance(task.GetDeliveryOrders(), graph);
+    }
+    return distance;
+}
+
+/**
+  * @brief Inserts an order where it adds the least distance.
+  *
+  * Every position of every task with room for the order is tried, costing
+  * the detour d(prev, house) + d(house, next) - d(prev, next), against a new
+  * task of its own. The distances to and from the house are measured once
+  * per stop, and the length of each leg is remembered between insertions
+  * on the same edges, so an insertion costs two queries per queued stop.
+  * The remembered lengths are dropped when the graph's EdgesStamp changes. Distances come from
+  * Graph::ShortestPath, so they are fast when trees are cached or a
+  * contraction hierarchy is attached.
+  *
+  * @param order The order, as a pair of house ID and package weight.
+  * @param robot The robot that will perform the tasks.
+  * @param graph The map the tasks are driven on.
+  * @return The index of the task the order joined, or -1 if it was skipped.
+  */
+int TaskQueue::InsertOrder(const pair<int,int>& order, const Robot& robot, const Graph& graph) {
+    if (order.second == 0) {
+        return -1;
+    }
+    auto distance = [&graph](int from, int to) {
+        double dist = graph.ShortestPath(from, to, 0);
+        return dist < 0 ? numeric_limits<double>::infinity() : dist;
+    };
+    const int house = order.first;
+    const double from_store = distance(store_id, house);
+    const double to_store = distance(house, store_id);
+    if (_leg_lengths_stamp != graph.EdgesStamp()) {
+        // Lengths measured on another graph, or before its edges changed, no longer hold
+        _leg_lengths.clear();
+        _leg_lengths_stamp = graph.EdgesStamp();
+    }
+    _leg_lengths.resize(_queue.size());
+
+    // A new task of its own is the fallback for every order
+    int best_task = -1, best_position = 0;
+    double best_cost = from_store + to_store, best_in = from_store, best_out = to_store;
+    for (int t=0; t<(int)_queue.size(); t++) {
+        if (_queue[t].GetLoad() + order.second > robot.GetCarryingCapacity()) {
+            continue;
+        }
+        const vector<pair<int,int>>& stops = _queue[t].GetDeliveryOrders();
+        vector<double>& legs = _leg_lengths[t];
+        if (legs.size() != stops.size() + 1) {
+            legs.resize(stops.size() + 1);
+            int prev = store_id;
+            for (int p=0; p<=(int)stops.size(); p++) {
+                int next = (p < (int)stops.size()) ? stops[p].first : store_id;
+                legs[p] = distance(prev, next);
+                prev = next;
+            }
+        }
+        // The detour at position p enters the house from the stop before and leaves to the stop after
+        double in = from_store;
+        for (int p=0; p<=(int)stops.size(); p++) {
+            double out = (p < (int)stops.size()) ? distance(house, stops[p].first) : to_store;
+            double cost = in + out - legs[p];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_task = t;
+                best_position = p;
+                best_in = in;
+                best_out = out;
+            }
+            if (p < (int)stops.size()) {
+                in = distance(stops[p].first, house);
+            }
+        }
+    }
+
+    if (best_task == -1) {
+        _queue.emplace_back(robot.GetId(), vector<pair<int,int>>(1, order));
+        _leg_lengths.push_back(vector<double>{from_store, to_store});
+        return _queue.size() - 1;
+    }
+    _queue[best_task].InsertOrder(best_position, order);
+    vector<double>& legs = _leg_lengths[best_task];
+    legs[best_position] = best_out;
+    legs.insert(legs.begin() + best_position, best_in);
+    return best_task;
+}
+
+/**
+  * @brief Checks whether any tasks are listed.
+  * @return True if the queue is empty, false otherwise.
+  */
+bool TaskQueue::Empty() const { return _queue.empty(); }
+
+/**
+  * @brief Removes and returns the first listed task.
+  * @return The task performed next.
+  */
+Task TaskQueue::PopNextTask() {
+    Task task = move(_queue.front());
+    _queue.erase(_queue.begin());
+    if (!_leg_lengths.empty()) {
+        _leg_lengths.erase(_leg_lengths.begin());
+    }
+    return task;
+}
@@ -2,42 +2,83 @@
  * @file task_queue.h
  * @brief Defines classes and functions for a task queue.
  */
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
 
 #include <iostream>
 #include <queue>
 #include <vector>
 #include "topological_map.h"
+#include "route_planner.h"
+#include "route_report.h"
 
-using namespace std;
+/// The shortest path trees from the store and back to it, computed once and shared by every task of a day.
+/// Every trip leaves the store and ends there, so its first and last legs are prefixes of these trees.
+struct DepotTrees {
+    /// Takes both trees from the graph, which memoises them.
+    /// \param graph The map the tasks are driven on.
+    explicit DepotTrees(const Graph& graph);
+
+    /// The tree from the store to every node, whose paths are the outbound legs.
+    std::shared_ptr<const ShortestPathTree> outbound;
+
+    /// The tree from every node to the store, whose reversed paths are the return legs.
+    std::shared_ptr<const ShortestPathTree> inbound;
+};
 
 /// A task performed by the delivery robot.
 class Task {
 public:
     /// A constructor.
-    Task(int robot_id, vector<pair<int,int>> delivery_orders);
+    Task(int robot_id, std::vector<std::pair<int,int>> delivery_orders);
 
     /// Returns the ID of the robot.
     int GetRobotId() const;
 
     /// Returns the list of delivery orders.
-    vector<pair<int,int>> GetDeliveryOrders() const;
+    const std::vector<std::pair<int,int>>& GetDeliveryOrders() const;
+
+    /// Returns the total number of packages carried on the task.
+    int GetLoad() const;
+
+    /// Inserts an order into the task.
+    /// \param position The number of orders delivered before the new one.
+    /// \param order The order, as a pair of house ID and package weight.
+    void InsertOrder(int position, const std::pair<int,int>& order);
 
     /// Display the path taken by the robot in completing tasks.
-    void DisplayPath(Graph graph);
+    void DisplayPath(const Graph& graph) const;
+
+    /// Reports the route of each delivery on the task, and the return to the store,
+    /// taking the first and last legs from the graph's memoised trees of the store.
+    /// \param graph The map the task is driven on.
+    /// \param sink The sink the deliveries are reported to.
+    void DisplayPath(const Graph& graph, ReportSink& sink) const;
+
+    /// Reports the route of each delivery on the task, and the return to the store,
+    /// taking the first and last legs from trees shared with other tasks.
+    /// \param graph The map the task is driven on.
+    /// \param sink The sink the deliveries are reported to.
+    /// \param depot The trees from and to the store on the same map.
+    void DisplayPath(const Graph& graph, ReportSink& sink, const DepotTrees& depot) const;
 
 private:
     /// The ID of the robot.
     int _robot_id;
 
     /// The list of orders for each node.
-    vector<pair<int,int>> _delivery_orders;
+    std::vector<std::pair<int,int>> _delivery_orders;
 };
 
-/// A robot with fixed id and carrying capacity.
+/// A robot with fixed id, carrying capacity, speed and service time.
 class Robot {
 public:
     /// A constructor. 
-    Robot(int id, int carrying_capacity);
+    /// \param id The ID of the robot.
+    /// \param carrying_capacity The number of packages the robot can carry.
+    /// \param speed The speed the robot drives at, in km/h.
+    /// \param service_time The time the robot takes to hand over a delivery, in hours.
+    Robot(int id, int carrying_capacity, double speed = 5.0, double service_time = 0.0);
 
     /// Returns the id of the robot.
     int GetId() const;
@@ -45,24 +86,91 @@ public:
     /// Returns the carrying capacity of the robot.
     int GetCarryingCapacity() const;
 
+    /// Returns the speed of the robot, in km/h.
+    double GetSpeed() const;
+
+    /// Returns the time the robot takes to hand over a delivery, in hours.
+    double GetServiceTime() const;
+
 private:
     /// The ID of the robot.
     const int _id;
     
     /// The carrying capacity of the robot.
     const int _carrying_capacity;
+
+    /// The speed of the robot.
+    const double _speed;
+
+    /// The time the robot takes at each house.
+    const double _service_time;
 };
 
 /// A queue that represents the list of tasks to be performed by the robot.
 class TaskQueue {
 public:
-    /// A constructor.
-    TaskQueue(vector<pair<int, int>> orders, Robot robot);
+    /// A constructor that fills trips in the order the orders are listed.
+    TaskQueue(const std::vector<std::pair<int, int>>& orders, const Robot& robot);
+
+    /// A constructor that plans the trips with a route planner.
+    /// \param orders The orders, as pairs of house IDs and package weights.
+    /// \param robot The robot that will perform the tasks.
+    /// \param graph The map the trips are driven on.
+    /// \param planner The planner used to group the orders into trips.
+    TaskQueue(const std::vector<std::pair<int, int>>& orders, const Robot& robot,
+              const Graph& graph, const RoutePlanner& planner);
+
+    /// Builds a queue holding one task per trip, in the order given, such as the trips of a DaySchedule.
+    /// \param trips The trips, with houses in visiting order.
+    /// \param robot The robot that will perform the tasks.
+    static TaskQueue FromTrips(std::vector<Trip> trips, const Robot& robot);
 
     /// Perform the listed tasks and output to console. 
-    void PerformTasks(Graph graph);
+    void PerformTasks(const Graph& graph);
+
+    /// Perform the listed tasks, reporting each task and delivery to a sink.
+    /// \param graph The map the tasks are driven on.
+    /// \param sink The sink the tasks are reported to.
+    void PerformTasks(const Graph& graph, ReportSink& sink);
+
+    /// Perform the listed tasks, reporting each task and delivery to a sink, with the trees
+    /// from and to the store shared with the other robots of the day.
+    /// \param graph The map the tasks are driven on.
+    /// \param sink The sink the tasks are reported to.
+    /// \param depot The trees from and to the store on the same map.
+    void PerformTasks(const Graph& graph, ReportSink& sink, const DepotTrees& depot);
+
+    /// Returns the listed tasks.
+    const std::vector<Task>& GetTasks() const;
+
+    /// Returns the total distance driven to perform the listed tasks, returning to the store after each one.
+    double TotalDistance(const Graph& graph) const;
+
+    /// Inserts an order where it adds the least distance, starting a new task if that is cheaper
+    /// or no task has room. Orders with no packages are skipped.
+    /// \param order The order, as a pair of house ID and package weight.
+    /// \param robot The robot that will perform the tasks.
+    /// \param graph The map the tasks are driven on. The leg lengths kept between calls are
+    /// measured again whenever the graph's EdgesStamp differs from the last call's.
+    /// \return The index of the task the order joined, or -1 if it was skipped.
+    int InsertOrder(const std::pair<int,int>& order, const Robot& robot, const Graph& graph);
+
+    /// Returns true if no tasks are listed.
+    bool Empty() const;
+
+    /// Removes and returns the first listed task, which must exist.
+    Task PopNextTask();
 
 private:
     /// List of tasks to carry out.
-    vector<Task> _queue;
+    std::vector<Task> _queue;
+
+    /// The length of each leg of each task, from the store through its houses and back,
+    /// kept by InsertOrder. An entry of the wrong size has not been measured yet.
+    std::vector<std::vector<double>> _leg_lengths;
+
+    /// The EdgesStamp of the graph _leg_lengths were measured on, or 0 before any were.
+    uint64_t _leg_lengths_stamp = 0;
 };
+
+#endif
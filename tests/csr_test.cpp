@@ -0,0 +1,262 @@
+/**
+ * @file csr_test.cpp
+ * @brief Tests building compressed sparse row adjacency from edge lists and distance matrices.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include "test_support.h"
+
+using namespace std;
+
+/**
+ * @brief Lists the edges of an adjacency, sorted.
+ *
+ * @param adjacency The adjacency.
+ * @return The edges as (source, target, length) tuples.
+ */
+static vector<tuple<int, int, double>> sorted_edges(const CsrAdjacency& adjacency) {
+    vector<tuple<int, int, double>> edges;
+    for (int u=0; u<adjacency.NumNodes(); u++) {
+        for (const Edge& edge : adjacency.EdgesOf(u)) {
+            edges.emplace_back(u, edge.target, edge.distance);
+        }
+    }
+    sort(edges.begin(), edges.end());
+    return edges;
+}
+
+/**
+ * @brief Checks that the offsets of an adjacency start at 0, never decrease and end at the edge count.
+ *
+ * @param adjacency The adjacency.
+ */
+static void check_offsets(const CsrAdjacency& adjacency) {
+    const int* offsets = adjacency.Offsets();
+    CHECK(offsets[0] == 0);
+    for (int u=0; u<adjacency.NumNodes(); u++) {
+        CHECK(offsets[u] <= offsets[u + 1]);
+    }
+    CHECK(offsets[adjacency.NumNodes()] == adjacency.NumEdges());
+}
+
+/**
+ * @brief Checks that an edge list is bucketed by source, keeping the order of each source's edges.
+ */
+static void test_edge_list() {
+    const vector<WeightedEdge> edges{{2, 0, 1.5}, {0, 1, 2.0}, {2, 1, 0.5}, {0, 2, 4.0}, {3, 3, 0.0}};
+    const CsrAdjacency adjacency = CsrAdjacency::FromEdgeList(5, edges);
+    CHECK(adjacency.NumNodes() == 5);
+    CHECK(adjacency.NumEdges() == 5);
+    check_offsets(adjacency);
+
+    CHECK(adjacency.EdgesOf(0).size() == 2);
+    CHECK(adjacency.EdgesOf(0)[0].target == 1 && adjacency.EdgesOf(0)[1].target == 2);
+    CHECK(adjacency.EdgesOf(1).size() == 0);
+    CHECK(adjacency.EdgesOf(2)[0].target == 0 && adjacency.EdgesOf(2)[0].distance == 1.5);
+    CHECK(adjacency.EdgesOf(2)[1].target == 1 && adjacency.EdgesOf(2)[1].distance == 0.5);
+    CHECK(adjacency.EdgesOf(3).size() == 1);
+    CHECK(adjacency.EdgesOf(4).size() == 0);
+}
+
+/**
+ * @brief Checks that edge lists with edges outside the graph or negative lengths are rejected.
+ */
+static void test_invalid_edges() {
+    bool rejected = false;
+    try {
+        CsrAdjacency::FromEdgeList(2, {{0, 2, 1.0}});
+    }
+    catch (const invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+
+    rejected = false;
+    try {
+        CsrAdjacency::FromEdgeList(2, {{0, 1, -1.0}});
+    }
+    catch (const invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+/**
+ * @brief Checks that a graph built from a distance matrix has the same edges as one built from its edge list.
+ */
+static void test_matrix_matches_edge_list() {
+    const int num_nodes = 40;
+    const vector<vector<double>> matrix = generate_dist_matrix(num_nodes, 0.2, 7);
+    vector<WeightedEdge> edges;
+    for (int u=0; u<num_nodes; u++) {
+        for (int v=0; v<num_nodes; v++) {
+            if (matrix[u][v] > 0) {
+                edges.push_back(WeightedEdge{u, v, matrix[u][v]});
+            }
+        }
+    }
+    reverse(edges.begin(), edges.end());
+
+    const Graph from_matrix(matrix);
+    const Graph from_edges = Graph::FromEdgeList(num_nodes, edges);
+    check_offsets(from_matrix.GetAdjacency());
+    check_offsets(from_edges.GetAdjacency());
+    CHECK(from_matrix.NumEdges() == (int)edges.size());
+    CHECK(sorted_edges(from_matrix.GetAdjacency()) == sorted_edges(from_edges.GetAdjacency()));
+}
+
+/**
+ * @brief Checks that reversing an adjacency turns each edge around and that reversing twice restores it.
+ */
+static void test_reversed() {
+    const int num_nodes = 60;
+    const CsrAdjacency adjacency = CsrAdjacency::FromEdgeList(num_nodes, generate_edge_list(num_nodes, 0.1, 3));
+    const CsrAdjacency reversed = adjacency.Reversed();
+    CHECK(reversed.NumNodes() == num_nodes);
+    CHECK(reversed.NumEdges() == adjacency.NumEdges());
+    check_offsets(reversed);
+
+    vector<tuple<int, int, double>> turned;
+    for (const auto& edge : sorted_edges(adjacency)) {
+        turned.emplace_back(get<1>(edge), get<0>(edge), get<2>(edge));
+    }
+    sort(turned.begin(), turned.end());
+    CHECK(sorted_edges(reversed) == turned);
+    CHECK(sorted_edges(reversed.Reversed()) == sorted_edges(adjacency));
+}
+
+/**
+ * @brief Checks that writing the distances of a copy leaves the original untouched.
+ */
+static void test_copy_on_write() {
+    const CsrAdjacency original = CsrAdjacency::FromEdgeList(3, {{0, 1, 1.0}, {1, 2, 2.0}});
+    CsrAdjacency copy = original;
+    CHECK(!copy.OwnsDistances());
+    copy.MutableDistances()[0] = 5.0;
+    CHECK(copy.OwnsDistances());
+    CHECK(copy.Distances()[0] == 5.0);
+    CHECK(original.Distances()[0] == 1.0);
+    CHECK(copy.Targets() == original.Targets());
+}
+
+/**
+ * @brief Returns true if reading a text map file is rejected with a runtime_error.
+ *
+ * @param text The contents of the file.
+ * @return True if FromFile threw a runtime_error.
+ */
+static bool read_rejected(const string& text) {
+    const string path = "csr_test_map.txt";
+    ofstream(path) << text;
+    bool rejected = false;
+    try {
+        Graph::FromFile(path);
+    }
+    catch (const runtime_error&) {
+        rejected = true;
+    }
+    remove(path.c_str());
+    return rejected;
+}
+
+/**
+ * @brief Checks that a text map file is read edge by edge, and that malformed lines are rejected.
+ */
+static void test_from_file() {
+    const string path = "csr_test_map.txt";
+    ofstream(path) << "# A small map\n3\n0 1 1.5\n\n1 2 2.5 \r\n";
+    const Graph graph = Graph::FromFile(path);
+    remove(path.c_str());
+    CHECK(graph.NumNodes() == 3);
+    CHECK(sorted_edges(graph.GetAdjacency()) ==
+          (vector<tuple<int, int, double>>{make_tuple(0, 1, 1.5), make_tuple(1, 2, 2.5)}));
+
+    CHECK(read_rejected("3\n0 1\n"));
+    CHECK(read_rejected("3\n0 1 1.5 7\n"));
+    CHECK(read_rejected("3 4\n0 1 1.5\n"));
+    CHECK(read_rejected("3\n0 3 1.5\n"));
+    CHECK(read_rejected("3\n-1 2 1.5\n"));
+    CHECK(read_rejected("3\n0 1 -1.5\n"));
+}
+
+/**
+ * @brief Returns true if opening a binary map file is rejected with a runtime_error.
+ *
+ * @param bytes The contents of the file.
+ * @return True if OpenBinary threw a runtime_error.
+ */
+static bool open_rejected(const string& bytes) {
+    const string path = "csr_test_corrupt.bin";
+    ofstream(path, ios::binary) << bytes;
+    bool rejected = false;
+    try {
+        Graph::OpenBinary(path);
+    }
+    catch (const runtime_error&) {
+        rejected = true;
+    }
+    remove(path.c_str());
+    return rejected;
+}
+
+/**
+ * @brief Checks that a saved map opens with the same edges, and that corrupt map files are rejected.
+ */
+static void test_open_binary() {
+    const Graph graph(generate_dist_matrix(20, 0.2, 1));
+    const string path = "csr_test.bin";
+    graph.SaveBinary(path);
+    string bytes;
+    {
+        ifstream file(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    CHECK(sorted_edges(Graph::OpenBinary(path).GetAdjacency()) == sorted_edges(graph.GetAdjacency()));
+    remove(path.c_str());
+
+    // The header holds the section positions of the offsets, targets and distances at bytes 32, 40 and 48
+    auto section = [&bytes](size_t field) {
+        uint64_t pos;
+        memcpy(&pos, &bytes[field], sizeof(pos));
+        return (size_t)pos;
+    };
+    auto patched = [&bytes](size_t position, auto value) {
+        string copy = bytes;
+        memcpy(&copy[position], &value, sizeof(value));
+        return copy;
+    };
+    const size_t offsets = section(32);
+    const size_t targets = section(40);
+    const size_t distances = section(48);
+    CHECK(!open_rejected(bytes));
+    CHECK(open_rejected(bytes.substr(0, bytes.size() - 1)));
+    CHECK(open_rejected(patched(offsets + 5 * 4, int32_t(graph.NumEdges() + 1))));
+    CHECK(open_rejected(patched(targets + 3 * 4, int32_t(20))));
+    CHECK(open_rejected(patched(targets, int32_t(-1))));
+    CHECK(open_rejected(patched(distances + 2 * 8, -1.0)));
+    CHECK(open_rejected(patched(distances, numeric_limits<double>::quiet_NaN())));
+    // An aligned position that wraps around 2^64 once the section length is added
+    CHECK(open_rejected(patched(40, uint64_t(0) - 64)));
+}
+
+/**
+ * @brief Runs the CSR tests.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+    test_edge_list();
+    test_invalid_edges();
+    test_matrix_matches_edge_list();
+    test_reversed();
+    test_copy_on_write();
+    test_from_file();
+    test_open_binary();
+    return test_result();
+}
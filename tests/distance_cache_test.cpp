@@ -0,0 +1,169 @@
+/**
+ * @file distance_cache_test.cpp
+ * @brief Tests the memoised shortest path trees: eviction, precomputation and repair after edge changes.
+ */
+
+#include "../counter_rng.h"
+#include "test_support.h"
+
+using namespace std;
+
+/**
+ * @brief Checks that a tree holds the reference distances and paths that add up to them.
+ *
+ * @param tree The tree.
+ * @param edges The edges it was grown over.
+ * @param num_nodes The number of nodes.
+ */
+static void check_tree(const ShortestPathTree& tree, const vector<WeightedEdge>& edges, int num_nodes) {
+    const vector<double> expected = reference_distances(num_nodes, edges, tree.Source());
+    for (int v=0; v<num_nodes; v++) {
+        CHECK_DISTANCE(tree.Distance(v), expected[v]);
+        const vector<int> path = tree.Path(v);
+        CHECK(path.empty() == isinf(expected[v]));
+        if (path.empty()) {
+            continue;
+        }
+        CHECK(path.front() == tree.Source() && path.back() == v);
+    }
+}
+
+/**
+ * @brief Checks that trees are memoised and the least recently used one is evicted first.
+ */
+static void test_eviction() {
+    const int num_nodes = 30;
+    const CsrAdjacency adjacency = CsrAdjacency::FromEdgeList(num_nodes, generate_edge_list(num_nodes, 0.2, 1));
+    DistanceCache cache(2);
+    shared_ptr<const ShortestPathTree> first = cache.Get(adjacency, 0);
+    CHECK(cache.Get(adjacency, 0) == first);
+    cache.Get(adjacency, 1);
+    CHECK(cache.Size() == 2);
+
+    // 0 was used after 1, so 1 is evicted
+    CHECK(cache.Find(0) == first);
+    cache.Get(adjacency, 2);
+    CHECK(cache.Size() == 2);
+    CHECK(cache.Find(0) == first);
+    CHECK(cache.Find(1) == nullptr);
+    CHECK(cache.Find(2) != nullptr);
+
+    cache.SetCapacity(1);
+    CHECK(cache.Size() == 1);
+    cache.Clear();
+    CHECK(cache.Size() == 0);
+}
+
+/**
+ * @brief Checks that Floyd-Warshall and one search per node precompute the same, correct trees.
+ */
+static void test_precompute_all() {
+    const int num_nodes = 50;
+    const vector<WeightedEdge> edges = generate_edge_list(num_nodes, 0.08, 2);
+    const CsrAdjacency adjacency = CsrAdjacency::FromEdgeList(num_nodes, edges);
+    for (int limit : {num_nodes, 0}) {
+        DistanceCache cache;
+        cache.SetAllPairsLimit(limit);
+        cache.PrecomputeAll(adjacency);
+        CHECK(cache.Size() == num_nodes);
+        for (int source=0; source<num_nodes; source++) {
+            shared_ptr<const ShortestPathTree> tree = cache.Find(source);
+            CHECK(tree != nullptr);
+            if (tree) {
+                check_tree(*tree, edges, num_nodes);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Checks that the trees kept after edge changes, in both directions, still hold shortest distances.
+ */
+static void test_update_edges() {
+    const int num_nodes = 80;
+    vector<WeightedEdge> edges = generate_edge_list(num_nodes, 0.05, 4);
+    Graph graph = Graph::FromEdgeList(num_nodes, edges);
+    CounterRng rng(4, 1);
+    for (int round=0; round<50; round++) {
+        for (int source=0; source<num_nodes; source+=7) {
+            graph.DistancesFrom(source);
+            graph.DistancesTo(source);
+        }
+        WeightedEdge& edge = edges[rng.Below((int)edges.size())];
+        edge.distance = (round % 2 == 0) ? edge.distance * 3 : edge.distance / 3;
+        graph.UpdateEdge(edge.source, edge.target, edge.distance);
+
+        vector<WeightedEdge> reversed;
+        for (const WeightedEdge& e : edges) {
+            reversed.push_back(WeightedEdge{e.target, e.source, e.distance});
+        }
+        for (int source=0; source<num_nodes; source+=7) {
+            check_tree(*graph.DistancesFrom(source), edges, num_nodes);
+            check_tree(*graph.DistancesTo(source), reversed, num_nodes);
+        }
+    }
+}
+
+/**
+ * @brief Checks that trees precomputed by Floyd-Warshall are discarded when an edge they use gets longer.
+ *
+ * Floyd-Warshall sums distances in another order than a search along the
+ * tree, so its distances need not equal the sum of the lengths on their paths.
+ */
+static void test_precomputed_trees_after_lengthening() {
+    const int num_nodes = 16;
+    for (int seed=0; seed<40; seed++) {
+        vector<WeightedEdge> edges = generate_edge_list(num_nodes, 0.05, seed);
+        Graph graph = Graph::FromEdgeList(num_nodes, edges);
+        graph.PrecomputeDistances();
+
+        // Lengthen every edge on the shortest path from 1 to 10
+        const vector<int> path = graph.DistancesFrom(1)->Path(10);
+        for (size_t i=1; i<path.size(); i++) {
+            for (WeightedEdge& edge : edges) {
+                if (edge.source == path[i - 1] && edge.target == path[i]) {
+                    edge.distance *= 2;
+                    graph.UpdateEdge(edge.source, edge.target, edge.distance);
+                }
+            }
+        }
+
+        for (int source=0; source<num_nodes; source++) {
+            const vector<double> expected = reference_distances(num_nodes, edges, source);
+            for (int target=0; target<num_nodes; target++) {
+                CHECK_DISTANCE(graph.ShortestPath(source, target, 0), expected[target]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Checks that a copy of a graph keeps its trees when the original's edges change.
+ */
+static void test_copies_keep_trees() {
+    const int num_nodes = 40;
+    const vector<WeightedEdge> edges = generate_edge_list(num_nodes, 0.1, 5);
+    Graph graph = Graph::FromEdgeList(num_nodes, edges);
+    const Graph copy = graph;
+    shared_ptr<const ShortestPathTree> tree = copy.DistancesFrom(0);
+    for (const WeightedEdge& edge : edges) {
+        graph.UpdateEdge(edge.source, edge.target, edge.distance / 2);
+    }
+    CHECK(copy.DistancesFrom(0) == tree);
+    check_tree(*copy.DistancesFrom(0), edges, num_nodes);
+    CHECK_DISTANCE(graph.DistancesFrom(0)->Distance(num_nodes - 1), tree->Distance(num_nodes - 1) / 2);
+}
+
+/**
+ * @brief Runs the distance cache tests.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+    test_eviction();
+    test_precompute_all();
+    test_update_edges();
+    test_precomputed_trees_after_lengthening();
+    test_copies_keep_trees();
+    return test_result();
+}
@@ -0,0 +1,204 @@
+/**
+ * @file hierarchy_test.cpp
+ * @brief Tests contraction hierarchy queries, repair after edge changes and saving to a file.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "../contraction_hierarchy.h"
+#include "test_support.h"
+
+using namespace std;
+
+/**
+ * @brief Returns the length of the edge from one node to another.
+ *
+ * @param edges The edges.
+ * @param source The node the edge leaves.
+ * @param target The node the edge leads to.
+ * @return The length, or infinity if there is no such edge.
+ */
+static double edge_length(const vector<WeightedEdge>& edges, int source, int target) {
+    double length = numeric_limits<double>::infinity();
+    for (const WeightedEdge& edge : edges) {
+        if (edge.source == source && edge.target == target) {
+            length = min(length, edge.distance);
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief Checks every query of a hierarchy against the reference distances, and that paths follow edges.
+ *
+ * @param hierarchy The hierarchy.
+ * @param edges The edges it answers for.
+ * @param num_nodes The number of nodes.
+ */
+static void check_hierarchy(const ContractionHierarchy& hierarchy, const vector<WeightedEdge>& edges, int num_nodes) {
+    for (int source=0; source<num_nodes; source++) {
+        const vector<double> expected = reference_distances(num_nodes, edges, source);
+        for (int target=0; target<num_nodes; target++) {
+            CHECK_DISTANCE(hierarchy.Distance(source, target), expected[target]);
+
+            double distance = 0.0;
+            const vector<int> path = hierarchy.Path(source, target, &distance);
+            CHECK(path.empty() == isinf(expected[target]));
+            if (path.empty()) {
+                continue;
+            }
+            CHECK_DISTANCE(distance, expected[target]);
+            CHECK(path.front() == source && path.back() == target);
+            double length = 0.0;
+            for (size_t i=1; i<path.size(); i++) {
+                length += edge_length(edges, path[i - 1], path[i]);
+            }
+            CHECK_DISTANCE(length, expected[target]);
+        }
+    }
+}
+
+/**
+ * @brief Checks a hierarchy on a random map, including unreachable nodes.
+ */
+static void test_queries() {
+    const int num_nodes = 60;
+    vector<WeightedEdge> edges = generate_edge_list(num_nodes, 0.05, 8);
+    // A one-way spur and a node with no edges at all
+    edges.push_back(WeightedEdge{0, num_nodes, 0.25});
+    const ContractionHierarchy hierarchy =
+        ContractionHierarchy::Build(CsrAdjacency::FromEdgeList(num_nodes + 2, edges));
+    CHECK(hierarchy.NumNodes() == num_nodes + 2);
+    CHECK(hierarchy.NumGraphEdges() == (int)edges.size());
+    check_hierarchy(hierarchy, edges, num_nodes + 2);
+}
+
+/**
+ * @brief Checks that a customisable hierarchy stays exact as edges get longer and shorter.
+ */
+static void test_repair() {
+    const int num_nodes = 50;
+    CsrAdjacency adjacency = CsrAdjacency::FromEdgeList(num_nodes, generate_edge_list(num_nodes, 0.06, 9));
+    // List the edges in the order of the adjacency, so edge e of the list is edge e of the arrays
+    vector<WeightedEdge> edges;
+    for (int u=0; u<num_nodes; u++) {
+        for (const Edge& edge : adjacency.EdgesOf(u)) {
+            edges.push_back(WeightedEdge{u, edge.target, edge.distance});
+        }
+    }
+    ContractionHierarchy hierarchy = ContractionHierarchy::Build(adjacency, true);
+    CHECK(hierarchy.IsCustomisable());
+
+    for (int round=0; round<10; round++) {
+        vector<WeightChange> changes;
+        double* distances = adjacency.MutableDistances();
+        for (int e = round; e < (int)edges.size(); e += 11) {
+            const double old_distance = edges[e].distance;
+            edges[e].distance = (round % 2 == 0) ? old_distance * 4 : old_distance / 4;
+            distances[e] = edges[e].distance;
+            changes.push_back(WeightChange{edges[e].source, edges[e].target, old_distance, edges[e].distance});
+        }
+        hierarchy.Repair(adjacency, changes);
+        check_hierarchy(hierarchy, edges, num_nodes);
+    }
+}
+
+/**
+ * @brief Checks that a graph answers through an attached hierarchy, and that a loaded hierarchy matches the saved one.
+ */
+static void test_graph_and_file() {
+    const int num_nodes = 40;
+    const vector<WeightedEdge> edges = generate_edge_list(num_nodes, 0.1, 10);
+    Graph graph = Graph::FromEdgeList(num_nodes, edges);
+    auto hierarchy = make_shared<const ContractionHierarchy>(ContractionHierarchy::Build(graph.GetAdjacency()));
+    graph.SetContractionHierarchy(hierarchy);
+    for (int target=0; target<num_nodes; target++) {
+        RouteResult route = graph.Route(3, target);
+        CHECK_DISTANCE(route.distance, reference_distances(num_nodes, edges, 3)[target]);
+    }
+
+    const string path = "hierarchy_test.ch";
+    hierarchy->Save(path);
+    const ContractionHierarchy loaded = ContractionHierarchy::Load(path);
+    remove(path.c_str());
+    CHECK(loaded.NumNodes() == hierarchy->NumNodes());
+    CHECK(loaded.NumShortcuts() == hierarchy->NumShortcuts());
+    for (int node=0; node<num_nodes; node++) {
+        CHECK(loaded.Rank(node) == hierarchy->Rank(node));
+    }
+    check_hierarchy(loaded, edges, num_nodes);
+}
+
+/**
+ * @brief Returns true if loading a file is rejected with a runtime_error.
+ *
+ * @param bytes The contents of the file.
+ * @return True if Load threw a runtime_error.
+ */
+static bool load_rejected(const string& bytes) {
+    const string path = "hierarchy_test_corrupt.ch";
+    ofstream(path, ios::binary) << bytes;
+    bool rejected = false;
+    try {
+        ContractionHierarchy::Load(path);
+    }
+    catch (const runtime_error&) {
+        rejected = true;
+    }
+    remove(path.c_str());
+    return rejected;
+}
+
+/**
+ * @brief Checks that Load rejects truncated files, impossible counts and arrays that would send queries astray.
+ */
+static void test_corrupt_files() {
+    const int num_nodes = 50;
+    const string path = "hierarchy_test.ch";
+    ContractionHierarchy::Build(CsrAdjacency::FromEdgeList(num_nodes, generate_edge_list(num_nodes, 0.1, 12)))
+        .Save(path);
+    string bytes;
+    {
+        ifstream file(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    remove(path.c_str());
+    CHECK(!load_rejected(bytes));
+
+    // The header is 64 bytes, followed by the ranks and the upward offsets, then the upward targets
+    const size_t header_size = 64;
+    const size_t up_targets = header_size + num_nodes * 4 + (num_nodes + 1) * 4;
+    auto patched = [&bytes](size_t position, int32_t value) {
+        string copy = bytes;
+        memcpy(&copy[position], &value, sizeof(value));
+        return copy;
+    };
+    CHECK(load_rejected(bytes.substr(0, bytes.size() - 1)));
+    CHECK(load_rejected(bytes + '\0'));
+    CHECK(load_rejected(patched(up_targets, num_nodes)));
+    CHECK(load_rejected(patched(up_targets, -1)));
+    CHECK(load_rejected(patched(header_size, 1)));
+    CHECK(load_rejected(patched(header_size + num_nodes * 4 + 4, -5)));
+
+    // A header asking for far more arcs than the file could hold
+    string huge = bytes.substr(0, header_size);
+    const uint64_t num_up = numeric_limits<int>::max() - 1;
+    memcpy(&huge[40], &num_up, sizeof(num_up));
+    CHECK(load_rejected(huge));
+}
+
+/**
+ * @brief Runs the contraction hierarchy tests.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+    test_queries();
+    test_repair();
+    test_graph_and_file();
+    test_corrupt_files();
+    return test_result();
+}
@@ -0,0 +1,83 @@
+/**
+ * @file task_queue_test.cpp
+ * @brief Tests inserting orders into a task queue as the map they are costed on changes.
+ */
+
+#include "../task_queue.h"
+#include "test_support.h"
+
+using namespace std;
+
+/**
+ * @brief Lists the trips of a queue.
+ *
+ * @param queue The queue.
+ * @return The orders of each task, in visiting order.
+ */
+static vector<Trip> trips_of(const TaskQueue& queue) {
+    vector<Trip> trips;
+    for (const Task& task : queue.GetTasks()) {
+        trips.push_back(task.GetDeliveryOrders());
+    }
+    return trips;
+}
+
+/**
+ * @brief Checks that insertions after the edges change are costed on the new lengths.
+ *
+ * One queue keeps the leg lengths it measured before the change; the other
+ * holds the same trips but has measured nothing, so both must place every
+ * later order alike.
+ */
+static void test_insert_after_update() {
+    const int num_nodes = 60;
+    const Robot robot(101, 12);
+    vector<WeightedEdge> edges = generate_edge_list(num_nodes, 0.08, 13);
+    Graph graph = Graph::FromEdgeList(num_nodes, edges);
+    for (int round=0; round<10; round++) {
+        TaskQueue measured({}, robot);
+        for (int house = 1 + round; house < num_nodes; house += 4) {
+            measured.InsertOrder(make_pair(house, 1 + house % 3), robot, graph);
+        }
+
+        // Stretch and shrink edges in turn, so the old leg lengths are wrong both ways
+        vector<WeightedEdge> updates;
+        for (size_t e = round; e < edges.size(); e += 3) {
+            updates.push_back(WeightedEdge{edges[e].source, edges[e].target,
+                                           edges[e].distance * ((e / 3) % 2 == 0 ? 8.0 : 0.125)});
+        }
+        graph.UpdateEdges(updates);
+
+        TaskQueue fresh = TaskQueue::FromTrips(trips_of(measured), robot);
+        for (int house = 3 + round; house < num_nodes; house += 4) {
+            const pair<int,int> order(house, 1 + house % 2);
+            CHECK(measured.InsertOrder(order, robot, graph) == fresh.InsertOrder(order, robot, graph));
+        }
+        CHECK(trips_of(measured) == trips_of(fresh));
+    }
+}
+
+/**
+ * @brief Checks that a copy of a graph shares its edges stamp until either changes.
+ */
+static void test_edges_stamp() {
+    Graph graph = Graph::FromEdgeList(3, {{0, 1, 1.0}, {1, 2, 1.0}});
+    const Graph copy = graph;
+    CHECK(copy.EdgesStamp() == graph.EdgesStamp());
+    graph.UpdateEdge(0, 1, 1.0);
+    CHECK(copy.EdgesStamp() == graph.EdgesStamp());
+    graph.UpdateEdge(0, 1, 2.0);
+    CHECK(copy.EdgesStamp() != graph.EdgesStamp());
+    CHECK(Graph::FromEdgeList(3, {}).EdgesStamp() != copy.EdgesStamp());
+}
+
+/**
+ * @brief Runs the task queue tests.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+    test_insert_after_update();
+    test_edges_stamp();
+    return test_result();
+}
@@ -0,0 +1,90 @@
+/**
+ * @file test_support.h
+ * @brief Defines the checks and the reference shortest path search shared by the unit tests.
+ *
+ * Each test is a programme that runs every check, reports the failed ones on
+ * standard error and exits with status 1 if any failed, so that ctest needs
+ * no test framework.
+ */
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+#include "../topological_map.h"
+
+/// The number of checks failed so far.
+static int num_failures = 0;
+
+/// Records a check, reporting it if it failed.
+/// \param passed True if the check passed.
+/// \param expression The expression checked.
+/// \param file The file of the check.
+/// \param line The line of the check.
+inline void record_check(bool passed, const char* expression, const char* file, int line) {
+    if (!passed) {
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+        num_failures++;
+    }
+}
+
+/// Checks that a condition holds.
+#define CHECK(condition) record_check((condition), #condition, __FILE__, __LINE__)
+
+/// Checks that two distances are equal up to rounding, infinities included.
+#define CHECK_DISTANCE(actual, expected) \
+    record_check(same_distance((actual), (expected)), #actual " == " #expected, __FILE__, __LINE__)
+
+/// Returns true if two distances are equal up to rounding.
+/// \param a The first distance.
+/// \param b The second distance.
+inline bool same_distance(double a, double b) {
+    if (std::isinf(a) || std::isinf(b)) {
+        return a == b;
+    }
+    return std::fabs(a - b) <= 1e-9 * (1.0 + std::fabs(b));
+}
+
+/// Returns the exit status of a test programme, reporting the number of failed checks.
+inline int test_result() {
+    if (num_failures > 0) {
+        std::fprintf(stderr, "%d checks failed\n", num_failures);
+        return 1;
+    }
+    return 0;
+}
+
+/// Computes the distances from a source by repeatedly settling the closest unsettled node,
+/// independently of the library's searches.
+/// \param num_nodes The number of nodes.
+/// \param edges The directed edges.
+/// \param source The node to start from.
+/// \return The distance to each node, infinity for the unreachable ones.
+inline std::vector<double> reference_distances(int num_nodes, const std::vector<WeightedEdge>& edges, int source) {
+    const double infinity = std::numeric_limits<double>::infinity();
+    std::vector<double> dist(num_nodes, infinity);
+    std::vector<bool> settled(num_nodes, false);
+    dist[source] = 0.0;
+    for (int round=0; round<num_nodes; round++) {
+        int closest = -1;
+        for (int v=0; v<num_nodes; v++) {
+            if (!settled[v] && !std::isinf(dist[v]) && (closest < 0 || dist[v] < dist[closest])) {
+                closest = v;
+            }
+        }
+        if (closest < 0) {
+            break;
+        }
+        settled[closest] = true;
+        for (const WeightedEdge& edge : edges) {
+            if (edge.source == closest && dist[closest] + edge.distance < dist[edge.target]) {
+                dist[edge.target] = dist[closest] + edge.distance;
+            }
+        }
+    }
+    return dist;
+}
+
+#endif
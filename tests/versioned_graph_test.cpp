@@ -0,0 +1,97 @@
+/**
+ * @file versioned_graph_test.cpp
+ * @brief Tests reading pinned versions of a graph while a writer publishes new ones.
+ *
+ * Readers query each version they pin through DistancesFrom, DistancesTo and
+ * ShortestPath, which fill the version's caches and reversed edges while the
+ * writer copies it. Build with -DDELIVERY_SANITIZER=thread to check for data races.
+ */
+
+#include <atomic>
+#include <thread>
+#include "../route_planner.h"
+#include "../versioned_graph.h"
+#include "test_support.h"
+
+using namespace std;
+
+/**
+ * @brief Checks that readers see every version whole while a writer alternately doubles and halves every edge.
+ *
+ * Scaling by two is exact, so version v has the distances of the first
+ * version, doubled if v is even.
+ */
+static void test_reads_during_updates() {
+    const int num_nodes = 400;
+    const int num_readers = 3;
+    const int num_updates = 40;
+    const vector<WeightedEdge> edges = generate_edge_list(num_nodes, 0.01, 11);
+    Graph first = Graph::FromEdgeList(num_nodes, edges);
+    const vector<double> from_store = reference_distances(num_nodes, edges, store_id);
+    vector<WeightedEdge> reversed;
+    for (const WeightedEdge& edge : edges) {
+        reversed.push_back(WeightedEdge{edge.target, edge.source, edge.distance});
+    }
+    const vector<double> to_store = reference_distances(num_nodes, reversed, store_id);
+
+    VersionedGraph graph(move(first));
+    atomic<bool> done(false);
+    atomic<int> num_reads(0);
+    vector<int> failures(num_readers, 0);
+    vector<thread> readers;
+    for (int r=0; r<num_readers; r++) {
+        readers.emplace_back([&, r]() {
+            int node = r;
+            while (!done) {
+                VersionedGraph::ReadGuard guard = graph.Read();
+                const double scale = (guard.Number() % 2 == 0) ? 2.0 : 1.0;
+                node = (node + 37) % num_nodes;
+                const bool whole =
+                    same_distance(guard->DistancesFrom(store_id)->Distance(node), scale * from_store[node]) &&
+                    same_distance(guard->DistancesTo(store_id)->Distance(node), scale * to_store[node]) &&
+                    same_distance(guard->ShortestPath(node, store_id, 0), scale * to_store[node]) &&
+                    same_distance(guard->DistancesTo(node)->Distance(store_id), scale * from_store[node]);
+                failures[r] += whole ? 0 : 1;
+                num_reads++;
+            }
+        });
+    }
+
+    for (int update=0; update<num_updates; update++) {
+        const double factor = (update % 2 == 0) ? 2.0 : 0.5;
+        graph.Update([&](Graph& next) {
+            vector<WeightedEdge> updates;
+            for (int u=0; u<num_nodes; u++) {
+                for (const Edge& edge : next.GetAdjacency().EdgesOf(u)) {
+                    updates.push_back(WeightedEdge{u, edge.target, edge.distance * factor});
+                }
+            }
+            next.UpdateEdges(updates);
+        });
+        // Let the readers pin the new version before it is replaced
+        while (num_reads < (update + 1) * num_readers) {
+            this_thread::yield();
+        }
+    }
+    done = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+
+    for (int r=0; r<num_readers; r++) {
+        CHECK(failures[r] == 0);
+    }
+    CHECK(graph.CurrentVersion() == num_updates + 1);
+    graph.Reclaim();
+    CHECK(graph.NumRetired() == 0);
+}
+
+/**
+ * @brief Runs the versioned graph tests.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+    test_reads_during_updates();
+    return test_result();
+}
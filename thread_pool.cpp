@@ -0,0 +1,142 @@
+/**
+ * @file thread_pool.cpp
+ * @brief Implements the thread pool.
+ */
+
+#include "thread_pool.h"
+
+using namespace std;
+
+// Implementation of ThreadPool class
+
+thread_local ThreadPool* ThreadPool::current_pool = nullptr;
+thread_local int ThreadPool::current_index = -1;
+
+/**
+ * @brief Starts the worker threads, each with an empty job queue.
+ *
+ * @param num_threads The number of worker threads, or 0 to use one per hardware thread.
+ */
+ThreadPool::ThreadPool(int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = max(1u, thread::hardware_concurrency());
+    }
+    for (int i=0; i<num_threads; i++) {
+        _queues.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    for (int i=0; i<num_threads; i++) {
+        _workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+/**
+ * @brief Lets the workers finish every queued job, then joins them.
+ */
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(_sleep_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+/**
+ * @brief Returns the number of worker threads.
+ *
+ * @return The number of worker threads.
+ */
+int ThreadPool::NumThreads() const { return _workers.size(); }
+
+/**
+ * @brief Queues a job and wakes a sleeping worker.
+ *
+ * A worker of this pool pushes onto its own queue, where it will find the job
+ * first. Other threads spread their jobs over the workers in turn.
+ *
+ * @param job The job to queue.
+ */
+void ThreadPool::Push(function<void()> job) {
+    int index = (current_pool == this) ? current_index : _next_queue++ % _queues.size();
+    {
+        lock_guard<mutex> lock(_queues[index]->lock);
+        _queues[index]->jobs.push_back(move(job));
+    }
+    {
+        // Count the job under the sleep lock so a worker cannot miss it between checking and sleeping
+        lock_guard<mutex> lock(_sleep_mutex);
+        _pending++;
+    }
+    _wake.notify_one();
+}
+
+/**
+ * @brief Takes a job for a worker.
+ *
+ * The worker's own newest job is taken first, as it is the most likely to
+ * have its data in cache. Failing that, the oldest job of each other worker
+ * is tried in turn.
+ *
+ * @param index The index of the worker's own queue.
+ * @param job Set to the job taken.
+ * @return True if a job was taken, false if every queue was empty.
+ */
+bool ThreadPool::TryPop(int index, function<void()>& job) {
+    const int num_queues = _queues.size();
+    for (int i=0; i<num_queues; i++) {
+        WorkQueue& queue = *_queues[(index + i) % num_queues];
+        lock_guard<mutex> lock(queue.lock);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            job = move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        else {
+            job = move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+        _pending--;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Runs one queued job on the calling thread, if there is one.
+ *
+ * @return True if a job was run, false if every queue was empty.
+ */
+bool ThreadPool::RunPendingJob() {
+    function<void()> job;
+    if (!TryPop(current_pool == this ? current_index : 0, job)) {
+        return false;
+    }
+    job();
+    return true;
+}
+
+/**
+ * @brief Runs jobs until the pool stops and no job is left, sleeping while there is nothing to do.
+ *
+ * @param index The index of the worker.
+ */
+void ThreadPool::WorkerLoop(int index) {
+    current_pool = this;
+    current_index = index;
+    while (true) {
+        function<void()> job;
+        if (TryPop(index, job)) {
+            job();
+            continue;
+        }
+        unique_lock<mutex> lock(_sleep_mutex);
+        _wake.wait(lock, [this]() { return _stopping || _pending > 0; });
+        if (_stopping && _pending == 0) {
+            return;
+        }
+    }
+}
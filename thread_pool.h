@@ -0,0 +1,116 @@
+/**
+ * @file thread_pool.h
+ * @brief Defines a pool of worker threads for running planning and routing jobs.
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A fixed set of worker threads with one job queue each.
+/// Workers take their newest job first and steal the oldest job of another worker when
+/// their own queue is empty, so uneven jobs still keep every thread busy.
+class ThreadPool {
+public:
+    /// Constructor.
+    /// \param num_threads The number of worker threads, or 0 to use one per hardware thread.
+    explicit ThreadPool(int num_threads = 0);
+
+    /// Destructor. Waits for every submitted job to finish.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Returns the number of worker threads.
+    int NumThreads() const;
+
+    /// Queues a job to run on a worker thread.
+    /// Jobs submitted from a worker go to that worker's own queue.
+    /// \param job A callable taking no arguments.
+    /// \return A future holding the result of the job, or the exception it threw.
+    template <typename Job>
+    auto Submit(Job job) -> std::future<decltype(job())> {
+        auto task = std::make_shared<std::packaged_task<decltype(job())()>>(std::move(job));
+        std::future<decltype(job())> result = task->get_future();
+        Push([task]() { (*task)(); });
+        return result;
+    }
+
+    /// Waits for the result of a job.
+    /// On a worker of this pool, queued jobs are run while waiting, so jobs may wait on
+    /// jobs they submitted without tying up the pool.
+    /// \param result The future returned by Submit.
+    template <typename T>
+    T Await(std::future<T>& result) {
+        if (current_pool == this) {
+            while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                if (!RunPendingJob()) {
+                    result.wait_for(std::chrono::microseconds(50));
+                }
+            }
+        }
+        return result.get();
+    }
+
+    /// Runs one queued job on the calling thread, if there is one.
+    /// \return True if a job was run, false if every queue was empty.
+    bool RunPendingJob();
+
+private:
+    /// The jobs queued on one worker.
+    struct WorkQueue {
+        /// Guards jobs.
+        std::mutex lock;
+
+        /// The queued jobs, oldest first.
+        std::deque<std::function<void()>> jobs;
+    };
+
+    /// Queues a job on the calling worker, or on the next worker in turn for other threads.
+    void Push(std::function<void()> job);
+
+    /// Takes a job from the given worker's queue, or steals one from another worker.
+    bool TryPop(int index, std::function<void()>& job);
+
+    /// Runs jobs on a worker until the pool is destroyed.
+    void WorkerLoop(int index);
+
+    /// The job queue of each worker.
+    std::vector<std::unique_ptr<WorkQueue>> _queues;
+
+    /// The worker threads.
+    std::vector<std::thread> _workers;
+
+    /// The number of jobs queued and not yet taken.
+    std::atomic<int> _pending{0};
+
+    /// The queue the next job from outside the pool goes to.
+    std::atomic<unsigned> _next_queue{0};
+
+    /// Guards sleeping and waking of the workers.
+    std::mutex _sleep_mutex;
+
+    /// Signalled when a job is queued or the pool is stopping.
+    std::condition_variable _wake;
+
+    /// True once the pool is being destroyed.
+    bool _stopping = false;
+
+    /// The pool the calling thread works for, if any.
+    static thread_local ThreadPool* current_pool;
+
+    /// The index of the calling worker in its pool.
+    static thread_local int current_index;
+};
+
+#endif
@@ -0,0 +1,1734 @@
+/**
+ * @file topological_map.cpp
+ * @brief Implements the map, its edge storage and the map generators.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#if defined(_WIN32)
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "topological_map.h"
+#include "contraction_hierarchy.h"
+#include "thread_pool.h"
+#include "metrics.h"
+#include "counter_rng.h"
+
+using namespace std;
+
+// Global parameters
+const double epsilon = 1e-6;
+
+/// The number of rows or nodes of a random instance generated by one job.
+static const int chunk_size = 1024;
+
+/// The random streams of the instance generators, which are or-ed with a node id.
+static const uint64_t ring_stream = 1ull << 32;
+static const uint64_t pair_stream = 2ull << 32;
+static const uint64_t order_stream = 3ull << 32;
+
+/**
+ * @brief Runs a body over consecutive chunks of a range, as jobs on a pool if one is given.
+ *
+ * Chunks always start at multiples of chunk_size, so a body that draws from
+ * per-item random streams gives the same results however the chunks are run.
+ *
+ * @param count The size of the range [0, count).
+ * @param pool The threads to run the chunks on, or a null pointer to run them on the calling thread.
+ * @param body A callable taking the start and end of a chunk.
+ */
+template <typename Body>
+static void for_each_chunk(int count, ThreadPool* pool, Body body) {
+    if (pool == nullptr || count <= chunk_size) {
+        for (int begin = 0; begin < count; begin += chunk_size) {
+            body(begin, min(count, begin + chunk_size));
+        }
+        return;
+    }
+
+    vector<future<void>> chunks;
+    for (int begin = 0; begin < count; begin += chunk_size) {
+        const int end = min(count, begin + chunk_size);
+        chunks.push_back(pool->Submit([&body, begin, end]() { body(begin, end); }));
+    }
+    for (auto& chunk : chunks) {
+        pool->Await(chunk);
+    }
+}
+
+// Implementation of EdgeRange class
+
+/**
+ * @brief Constructs an iterator over parallel neighbour id and distance arrays.
+ *
+ * @param target The position in the neighbour id array.
+ * @param distance The position in the distance array.
+ */
+EdgeRange::Iterator::Iterator(const int* target, const double* distance):
+    _target(target), _distance(distance) {};
+
+/**
+ * @brief Returns the edge the iterator points to.
+ *
+ * @return The current edge.
+ */
+Edge EdgeRange::Iterator::operator*() const { return Edge{*_target, *_distance}; }
+
+/**
+ * @brief Advances the iterator to the next edge.
+ *
+ * @return A reference to the advanced iterator.
+ */
+EdgeRange::Iterator& EdgeRange::Iterator::operator++() {
+    ++_target;
+    ++_distance;
+    return *this;
+}
+
+/**
+ * @brief Compares two iterators for inequality.
+ *
+ * @param other The iterator to compare against.
+ * @return True if the iterators point to different edges, false otherwise.
+ */
+bool EdgeRange::Iterator::operator!=(const Iterator& other) const {
+    return _target != other._target;
+}
+
+/**
+ * @brief Constructs a view over a contiguous run of edges.
+ *
+ * @param targets The first neighbour id of the range.
+ * @param distances The first edge distance of the range.
+ * @param size The number of edges in the range.
+ */
+EdgeRange::EdgeRange(const int* targets, const double* distances, int size):
+    _targets(targets), _distances(distances), _size(size) {};
+
+/**
+ * @brief Returns an iterator to the first edge of the range.
+ *
+ * @return An iterator to the first edge.
+ */
+EdgeRange::Iterator EdgeRange::begin() const { return Iterator(_targets, _distances); }
+
+/**
+ * @brief Returns an iterator past the last edge of the range.
+ *
+ * @return An iterator past the last edge.
+ */
+EdgeRange::Iterator EdgeRange::end() const { return Iterator(_targets + _size, _distances + _size); }
+
+/**
+ * @brief Returns the number of edges in the range.
+ *
+ * @return The number of edges.
+ */
+int EdgeRange::size() const { return _size; }
+
+/**
+ * @brief Returns the edge at the given position in the range.
+ *
+ * @param i The position of the edge, in [0, size()).
+ * @return The edge at position i.
+ */
+Edge EdgeRange::operator[](int i) const { return Edge{_targets[i], _distances[i]}; }
+
+// Implementation of CsrAdjacency class
+
+/// Heap storage for the structure of a CsrAdjacency built in memory.
+/// The distances are held apart, so that they can be written without copying the structure.
+struct CsrArrays {
+    /// The start position of each node's edges.
+    vector<int> offsets;
+
+    /// The neighbour id of each edge.
+    vector<int> targets;
+};
+
+/// The offsets array of an adjacency with no nodes.
+static const int empty_offsets[1] = {0};
+
+/**
+ * @brief Constructs an adjacency with no nodes and no edges.
+ */
+CsrAdjacency::CsrAdjacency():
+    _num_nodes(0), _offsets(empty_offsets), _targets(nullptr), _distances(nullptr) {};
+
+/**
+ * @brief Constructs an adjacency from its compressed sparse row arrays.
+ *
+ * @param offsets The start position of each node's edges, followed by the total number of edges.
+ * @param targets The neighbour id of each edge.
+ * @param distances The distance of each edge.
+ */
+CsrAdjacency::CsrAdjacency(vector<int> offsets, vector<int> targets, vector<double> distances) {
+    auto arrays = make_shared<CsrArrays>();
+    arrays->offsets = move(offsets);
+    arrays->targets = move(targets);
+    _own_distances = make_shared<vector<double>>(move(distances));
+
+    _num_nodes = arrays->offsets.size() - 1;
+    _offsets = arrays->offsets.data();
+    _targets = arrays->targets.data();
+    _distances = _own_distances->data();
+    _storage = move(arrays);
+}
+
+/**
+ * @brief Constructs a view over compressed sparse row arrays held by another object.
+ *
+ * @param storage The object keeping the arrays alive, shared by all copies of the adjacency.
+ * @param num_nodes The number of nodes.
+ * @param offsets The start position of each node's edges, of size num_nodes + 1.
+ * @param targets The neighbour id of each edge.
+ * @param distances The distance of each edge.
+ */
+CsrAdjacency::CsrAdjacency(shared_ptr<const void> storage, int num_nodes,
+                           const int* offsets, const int* targets, const double* distances):
+    _storage(move(storage)), _num_nodes(num_nodes),
+    _offsets(offsets), _targets(targets), _distances(distances) {};
+
+/**
+ * @brief Builds an adjacency from an unordered edge list.
+ *
+ * The edges are bucketed by source node with a counting sort, so the build
+ * takes O(n + m) time and memory. Edges from the same source keep their
+ * relative order from the list.
+ *
+ * @param num_nodes The number of nodes.
+ * @param edges The edges of the graph, in any order.
+ * @return The adjacency holding the given edges.
+ * @throws invalid_argument If an edge refers to a node outside [0, num_nodes) or has a negative distance.
+ */
+CsrAdjacency CsrAdjacency::FromEdgeList(int num_nodes, const vector<WeightedEdge>& edges) {
+    vector<int> offsets(num_nodes + 1, 0);
+    for (const auto& edge : edges) {
+        if (edge.source < 0 || edge.source >= num_nodes || edge.target < 0 || edge.target >= num_nodes) {
+            throw invalid_argument("Edge refers to a node outside the graph");
+        }
+        if (edge.distance < 0) {
+            throw invalid_argument("Edge distances must be non-negative");
+        }
+        offsets[edge.source + 1]++;
+    }
+    for (int i=0; i<num_nodes; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    vector<int> targets(edges.size());
+    vector<double> distances(edges.size());
+    vector<int> next(offsets.begin(), offsets.end() - 1);
+    for (const auto& edge : edges) {
+        int e = next[edge.source]++;
+        targets[e] = edge.target;
+        distances[e] = edge.distance;
+    }
+
+    return CsrAdjacency(move(offsets), move(targets), move(distances));
+}
+
+/**
+ * @brief Returns the number of nodes in the adjacency.
+ *
+ * @return The number of nodes.
+ */
+int CsrAdjacency::NumNodes() const { return _num_nodes; }
+
+/**
+ * @brief Returns the number of edges in the adjacency.
+ *
+ * @return The number of edges.
+ */
+int CsrAdjacency::NumEdges() const { return _offsets[_num_nodes]; }
+
+/**
+ * @brief Returns the edges leaving a node.
+ *
+ * @param node The ID of the node.
+ * @return A view over the edges leaving the node.
+ */
+EdgeRange CsrAdjacency::EdgesOf(int node) const {
+    const int begin = _offsets[node];
+    return EdgeRange(_targets + begin, _distances + begin, _offsets[node + 1] - begin);
+}
+
+/**
+ * @brief Returns the offsets array.
+ *
+ * @return A pointer to NumNodes() + 1 edge offsets.
+ */
+const int* CsrAdjacency::Offsets() const { return _offsets; }
+
+/**
+ * @brief Returns the neighbour id array.
+ *
+ * @return A pointer to NumEdges() neighbour ids.
+ */
+const int* CsrAdjacency::Targets() const { return _targets; }
+
+/**
+ * @brief Returns the distance array.
+ *
+ * @return A pointer to NumEdges() edge distances.
+ */
+const double* CsrAdjacency::Distances() const { return _distances; }
+
+/**
+ * @brief Returns true if the distance array can be written in place.
+ *
+ * @return True if the distances are on the heap and no copy of the adjacency shares them.
+ */
+bool CsrAdjacency::OwnsDistances() const {
+    return _own_distances && _own_distances.use_count() == 1;
+}
+
+/**
+ * @brief Returns the distance array for writing.
+ *
+ * Distances shared with copies of the adjacency, or read from a mapped
+ * file, are first copied to the heap, so writes never show through other
+ * graphs or the file. The structure arrays stay shared either way.
+ *
+ * @return A pointer to NumEdges() edge distances.
+ */
+double* CsrAdjacency::MutableDistances() {
+    if (!OwnsDistances()) {
+        _own_distances = make_shared<vector<double>>(_distances, _distances + NumEdges());
+        _distances = _own_distances->data();
+    }
+    return _own_distances->data();
+}
+
+/**
+ * @brief Builds the adjacency with every edge reversed.
+ *
+ * @return An adjacency with an edge v -> u of the same length for each edge u -> v.
+ */
+CsrAdjacency CsrAdjacency::Reversed() const {
+    vector<WeightedEdge> edges;
+    edges.reserve(NumEdges());
+    for (int u=0; u<_num_nodes; u++) {
+        for (int e = _offsets[u]; e < _offsets[u + 1]; e++) {
+            edges.push_back(WeightedEdge{_targets[e], u, _distances[e]});
+        }
+    }
+    return FromEdgeList(_num_nodes, edges);
+}
+
+// Implementation of Node class
+
+/**
+ * @brief Constructs a view of a node in a graph.
+ *
+ * @param graph The graph the node belongs to.
+ * @param id The ID of the node.
+ */
+Node::Node(const Graph& graph, int id): _graph(&graph), _id(id) {};
+
+/**
+ * @brief Returns the ID of the current node.
+ *
+ * @return The ID of the current node.
+ */
+int Node::GetId() const { return _id; }
+
+/**
+ * @brief Returns the edges from the current node to other nodes and their distances.
+ *
+ * @return A view over the edges of the current node.
+ */
+EdgeRange Node::GetEdges() const {
+    return _graph->GetAdjacency().EdgesOf(_id);
+}
+
+/**
+ * @brief Returns the number of orders for the current node.
+ *
+ * @return The number of orders for the current node.
+ */
+int Node::GetNumOrders() const { return _graph->GetNumOrders(_id); }
+
+/**
+ * @brief Returns true if the graph has coordinates for its nodes.
+ *
+ * @return True if the node has a position, false otherwise.
+ */
+bool Node::HasCoordinates() const { return _graph->HasCoordinates(); }
+
+/**
+ * @brief Returns the position of the current node.
+ *
+ * @return The position of the node in km.
+ */
+Coordinates Node::GetCoordinates() const { return _graph->GetCoordinates(_id); }
+
+/**
+ * @brief Compares two nodes for equality based on their IDs.
+ *
+ * @param lhs The left-hand side node to compare.
+ * @param rhs The right-hand side node to compare.
+ * @return True if the nodes are equal, false otherwise.
+ */
+bool operator==(const Node &lhs, const Node &rhs) {
+	return lhs.GetId() == rhs.GetId();
+}
+
+
+// Implementation of Graph class
+
+/**
+ * @brief Constructs a graph from a distance matrix.
+ *
+ * The adjacency arrays are filled in a single row-major pass over the matrix,
+ * so each node's edges end up contiguous and ordered by neighbour ID.
+ *
+ * @param dist_matrix The distance matrix to use for constructing the graph.
+ */
+Graph::Graph(const vector<vector<double>>& dist_matrix) {
+    const int num_nodes = dist_matrix.size();
+    vector<int> offsets;
+    vector<int> targets;
+    vector<double> distances;
+
+    offsets.reserve(num_nodes + 1);
+    offsets.push_back(0);
+    for (int i=0; i<num_nodes; i++) {
+        for (int j=0; j<num_nodes; j++) {
+            double dist = dist_matrix[i][j];
+            if (dist > epsilon) {
+                targets.push_back(j);
+                distances.push_back(dist);
+            }
+        }
+        offsets.push_back(targets.size());
+    }
+
+    _adjacency = CsrAdjacency(move(offsets), move(targets), move(distances));
+    _num_orders.assign(num_nodes, 0);
+    _active_position.assign(num_nodes, -1);
+}
+
+/**
+ * @brief Constructs a graph from prebuilt adjacency storage.
+ *
+ * @param adjacency The edges of the map.
+ */
+Graph::Graph(CsrAdjacency adjacency): _adjacency(move(adjacency)) {
+    _num_orders.assign(_adjacency.NumNodes(), 0);
+    _active_position.assign(_adjacency.NumNodes(), -1);
+}
+
+/**
+ * @brief Copies a graph, sharing its edges and caches.
+ *
+ * Every member is copied as the implicit constructor would, except that the
+ * reversed edges are read under the lock DistancesTo fills them in under, so
+ * a graph can be copied while other threads query it.
+ *
+ * @param other The graph to copy.
+ */
+Graph::Graph(const Graph& other):
+    _adjacency(other._adjacency), _num_orders(other._num_orders), _active_orders(other._active_orders),
+    _active_position(other._active_position), _distance_cache(other._distance_cache),
+    _inbound_cache(other._inbound_cache), _hierarchy(other._hierarchy), _search_mode(other._search_mode),
+    _euclidean(other._euclidean), _landmarks(other._landmarks), _reverse_mutex(other._reverse_mutex),
+    _renumbering(other._renumbering), _edges_stamp(other._edges_stamp) {
+    lock_guard<mutex> lock(*_reverse_mutex);
+    _reverse_adjacency = other._reverse_adjacency;
+}
+
+/**
+ * @brief Replaces the graph by a copy of another.
+ *
+ * @param other The graph to copy.
+ * @return This graph.
+ */
+Graph& Graph::operator=(const Graph& other) {
+    if (this != &other) {
+        *this = Graph(other);
+    }
+    return *this;
+}
+
+/**
+ * @brief Builds a graph from an edge list without forming a distance matrix.
+ *
+ * @param num_nodes The number of nodes in the map.
+ * @param edges The directed edges of the map, in any order.
+ * @return The graph holding the given edges.
+ */
+Graph Graph::FromEdgeList(int num_nodes, const vector<WeightedEdge>& edges) {
+    return Graph(CsrAdjacency::FromEdgeList(num_nodes, edges));
+}
+
+/**
+ * @brief Builds a graph from a text edge list file.
+ *
+ * The first value in the file is the number of nodes. Every following line
+ * holds one directed edge as "source target distance". Blank lines and lines
+ * starting with '#' are skipped, and any other text on a line is an error.
+ * Nodes outside the map and negative lengths are reported with their line
+ * as malformed data, not as invalid arguments. The file is read in one pass.
+ *
+ * @param path The path of the file to read.
+ * @return The graph described by the file.
+ * @throws runtime_error If the file cannot be opened or is malformed.
+ */
+Graph Graph::FromFile(const string& path) {
+    ifstream file(path);
+    if (!file) {
+        throw runtime_error("Cannot open map file " + path);
+    }
+
+    int num_nodes = -1;
+    vector<WeightedEdge> edges;
+    string line;
+    int line_number = 0;
+    while (getline(file, line)) {
+        line_number++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#') {
+            continue;
+        }
+
+        istringstream fields(line);
+        bool parsed;
+        if (num_nodes < 0) {
+            parsed = static_cast<bool>(fields >> num_nodes) && num_nodes >= 0;
+        }
+        else {
+            WeightedEdge edge;
+            parsed = static_cast<bool>(fields >> edge.source >> edge.target >> edge.distance);
+            // Checked here rather than left to FromEdgeList, so bad data is reported as a malformed line
+            if (parsed && (edge.source < 0 || edge.source >= num_nodes || edge.target < 0 ||
+                           edge.target >= num_nodes)) {
+                throw runtime_error("Line " + to_string(line_number) + " in map file " + path +
+                                    " refers to a node outside the map");
+            }
+            if (parsed && !(edge.distance >= 0)) {
+                throw runtime_error("Line " + to_string(line_number) + " in map file " + path +
+                                    " has a negative or NaN distance");
+            }
+            edges.push_back(edge);
+        }
+        if (!parsed || !(fields >> ws).eof()) {
+            throw runtime_error("Malformed line " + to_string(line_number) + " in map file " + path);
+        }
+    }
+    if (num_nodes < 0) {
+        throw runtime_error("Map file " + path + " does not give a number of nodes");
+    }
+
+    return FromEdgeList(num_nodes, edges);
+}
+
+// Binary map format
+
+/// Identifies a binary map file.
+static const char map_file_magic[8] = {'B', '1', '6', 'M', 'A', 'P', '\0', '\0'};
+
+/// The version of the binary map format written by Graph::SaveBinary.
+static const uint32_t map_file_version = 1;
+
+/// Written in native byte order to detect files from machines of different endianness.
+static const uint32_t map_file_byte_order = 0x01020304;
+
+/// The alignment of each array section in a binary map file.
+static const uint64_t map_file_alignment = 64;
+
+/**
+ * @brief Fixed-size header at the start of a binary map file.
+ *
+ * The header is followed by four array sections, each starting at a
+ * multiple of map_file_alignment bytes: the CSR offsets (num_nodes + 1
+ * int32), neighbour ids (num_edges int32), edge distances (num_edges
+ * float64) and per-node order counts (num_nodes int32). All values are
+ * stored in the byte order of the machine that wrote the file.
+ */
+struct MapFileHeader {
+    /// Set to map_file_magic.
+    char magic[8];
+
+    /// Set to map_file_version.
+    uint32_t version;
+
+    /// Set to map_file_byte_order.
+    uint32_t byte_order;
+
+    /// The number of nodes in the map.
+    uint64_t num_nodes;
+
+    /// The number of edges in the map.
+    uint64_t num_edges;
+
+    /// The position of the offsets section in bytes from the start of the file.
+    uint64_t offsets_pos;
+
+    /// The position of the neighbour id section.
+    uint64_t targets_pos;
+
+    /// The position of the distance section.
+    uint64_t distances_pos;
+
+    /// The position of the order count section.
+    uint64_t orders_pos;
+
+    /// The total size of the file in bytes.
+    uint64_t file_size;
+};
+
+/**
+ * @brief Rounds a file position up to the next section boundary.
+ *
+ * @param pos The position to round.
+ * @return The smallest multiple of map_file_alignment not below pos.
+ */
+static uint64_t align_section(uint64_t pos) {
+    return (pos + map_file_alignment - 1) / map_file_alignment * map_file_alignment;
+}
+
+/// Read-only view of a whole file, unmapped when the last adjacency using it goes away.
+class MappedFile {
+public:
+    /// Maps the file at the given path.
+    explicit MappedFile(const string& path);
+
+    /// Unmaps the file.
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Returns the first byte of the file.
+    const char* Data() const { return _data; }
+
+    /// Returns the size of the file in bytes.
+    uint64_t Size() const { return _size; }
+
+private:
+    /// The first byte of the file.
+    const char* _data = nullptr;
+
+    /// The size of the file in bytes.
+    uint64_t _size = 0;
+
+#if defined(_WIN32)
+    /// Fallback copy of the file contents where mmap is unavailable, 8-byte aligned.
+    vector<uint64_t> _buffer;
+#endif
+};
+
+/**
+ * @brief Maps a file read-only into memory.
+ *
+ * On POSIX systems the file is mapped shared, so every process opening the
+ * same map is served from the same page cache pages. Elsewhere the file is
+ * read into an aligned buffer in one go.
+ *
+ * @param path The path of the file to map.
+ * @throws runtime_error If the file cannot be opened or mapped.
+ */
+MappedFile::MappedFile(const string& path) {
+#if defined(_WIN32)
+    ifstream file(path, ios::binary);
+    if (!file) {
+        throw runtime_error("Cannot open map file " + path);
+    }
+    file.seekg(0, ios::end);
+    _size = file.tellg();
+    file.seekg(0, ios::beg);
+    _buffer.resize((_size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(_buffer.data()), _size);
+    _data = reinterpret_cast<const char*>(_buffer.data());
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open map file " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw runtime_error("Cannot read size of map file " + path);
+    }
+    _size = info.st_size;
+    if (_size > 0) {
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("Cannot map file " + path);
+        }
+        _data = static_cast<const char*>(data);
+    }
+    close(fd);
+#endif
+}
+
+/**
+ * @brief Releases the mapping.
+ */
+MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+    if (_data != nullptr) {
+        munmap(const_cast<char*>(_data), _size);
+    }
+#endif
+}
+
+/**
+ * @brief Opens a graph saved with SaveBinary.
+ *
+ * The adjacency arrays are used in place from the mapping, with no parsing
+ * and no per-node allocation. They are checked in one pass before use, so a
+ * truncated or corrupt file cannot send a search outside the arrays: the
+ * offsets must rise from 0 to the edge count without decreasing, every
+ * target must be a node of the map, and every length must be non-negative,
+ * as FromEdgeList requires. The order counts are copied out of the
+ * file because they change from day to day.
+ *
+ * @param path The path of the binary map file.
+ * @return The graph stored in the file.
+ * @throws runtime_error If the file cannot be mapped or is not a valid map file of this version.
+ */
+Graph Graph::OpenBinary(const string& path) {
+    auto file = make_shared<MappedFile>(path);
+    const char* data = file->Data();
+
+    MapFileHeader header;
+    if (file->Size() < sizeof(header)) {
+        throw runtime_error("Map file " + path + " is truncated");
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, map_file_magic, sizeof(map_file_magic)) != 0) {
+        throw runtime_error(path + " is not a binary map file");
+    }
+    if (header.byte_order != map_file_byte_order) {
+        throw runtime_error("Map file " + path + " was written with a different byte order");
+    }
+    if (header.version != map_file_version) {
+        throw runtime_error("Map file " + path + " has unsupported version " + to_string(header.version));
+    }
+
+    const uint64_t num_nodes = header.num_nodes;
+    const uint64_t num_edges = header.num_edges;
+    const uint64_t size = file->Size();
+    // Written as pos <= size && length <= size - pos, so a position near 2^64 cannot wrap around
+    auto fits = [size](uint64_t pos, uint64_t length) { return pos <= size && length <= size - pos; };
+    const bool in_bounds =
+        num_nodes < (uint64_t)numeric_limits<int>::max() && num_edges < (uint64_t)numeric_limits<int>::max() &&
+        header.file_size == size &&
+        header.offsets_pos % map_file_alignment == 0 && header.targets_pos % map_file_alignment == 0 &&
+        header.distances_pos % map_file_alignment == 0 && header.orders_pos % map_file_alignment == 0 &&
+        fits(header.offsets_pos, (num_nodes + 1) * sizeof(int32_t)) &&
+        fits(header.targets_pos, num_edges * sizeof(int32_t)) &&
+        fits(header.distances_pos, num_edges * sizeof(double)) &&
+        fits(header.orders_pos, num_nodes * sizeof(int32_t));
+    if (!in_bounds) {
+        throw runtime_error("Map file " + path + " has an inconsistent header");
+    }
+
+    const int* offsets = reinterpret_cast<const int*>(data + header.offsets_pos);
+    if (offsets[0] != 0 || (uint64_t)offsets[num_nodes] != num_edges) {
+        throw runtime_error("Map file " + path + " has an inconsistent header");
+    }
+    for (uint64_t i=0; i<num_nodes; i++) {
+        if (offsets[i + 1] < offsets[i]) {
+            throw runtime_error("Map file " + path + " has decreasing edge offsets");
+        }
+    }
+    const int* targets = reinterpret_cast<const int*>(data + header.targets_pos);
+    const double* distances = reinterpret_cast<const double*>(data + header.distances_pos);
+    for (uint64_t e=0; e<num_edges; e++) {
+        if (targets[e] < 0 || (uint64_t)targets[e] >= num_nodes) {
+            throw runtime_error("Map file " + path + " has an edge to a node outside the map");
+        }
+        if (!(distances[e] >= 0)) {
+            throw runtime_error("Map file " + path + " has an edge with a negative or NaN length");
+        }
+    }
+    const int* orders = reinterpret_cast<const int*>(data + header.orders_pos);
+
+    Graph graph(CsrAdjacency(file, num_nodes, offsets, targets, distances));
+    for (int i=0; i<(int)num_nodes; i++) {
+        if (orders[i] != 0) {
+            graph.SetNumOrders(i, orders[i]);
+        }
+    }
+    return graph;
+}
+
+/**
+ * @brief Saves the graph and its order counts in the binary map format.
+ *
+ * @param path The path of the file to write.
+ * @throws runtime_error If the file cannot be written.
+ */
+void Graph::SaveBinary(const string& path) const {
+    static_assert(sizeof(int) == sizeof(int32_t), "The binary map format stores ids as int32");
+
+    MapFileHeader header;
+    memcpy(header.magic, map_file_magic, sizeof(map_file_magic));
+    header.version = map_file_version;
+    header.byte_order = map_file_byte_order;
+    header.num_nodes = NumNodes();
+    header.num_edges = NumEdges();
+    header.offsets_pos = align_section(sizeof(header));
+    header.targets_pos = align_section(header.offsets_pos + (header.num_nodes + 1) * sizeof(int32_t));
+    header.distances_pos = align_section(header.targets_pos + header.num_edges * sizeof(int32_t));
+    header.orders_pos = align_section(header.distances_pos + header.num_edges * sizeof(double));
+    header.file_size = header.orders_pos + header.num_nodes * sizeof(int32_t);
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file) {
+        throw runtime_error("Cannot create map file " + path);
+    }
+
+    uint64_t pos = 0;
+    auto write_section = [&](uint64_t section_pos, const void* section, uint64_t size) {
+        static const char padding[map_file_alignment] = {};
+        file.write(padding, section_pos - pos);
+        file.write(static_cast<const char*>(section), size);
+        pos = section_pos + size;
+    };
+    write_section(0, &header, sizeof(header));
+    write_section(header.offsets_pos, _adjacency.Offsets(), (header.num_nodes + 1) * sizeof(int32_t));
+    write_section(header.targets_pos, _adjacency.Targets(), header.num_edges * sizeof(int32_t));
+    write_section(header.distances_pos, _adjacency.Distances(), header.num_edges * sizeof(double));
+    write_section(header.orders_pos, _num_orders.data(), header.num_nodes * sizeof(int32_t));
+
+    if (!file) {
+        throw runtime_error("Failed to write map file " + path);
+    }
+}
+
+/**
+ * @brief Returns the number of nodes in the graph.
+ *
+ * @return The number of nodes in the graph.
+ */
+int Graph::NumNodes() const {
+    return _adjacency.NumNodes();
+}
+
+/**
+ * @brief Returns the number of edges in the graph.
+ *
+ * @return The number of edges in the graph.
+ */
+int Graph::NumEdges() const {
+    return _adjacency.NumEdges();
+}
+
+/**
+ * @brief Returns a view of a node in the graph.
+ *
+ * @param id The ID of the node.
+ * @return A view of the node, valid for the lifetime of the graph.
+ */
+Node Graph::GetNode(int id) const {
+    return Node(*this, id);
+}
+
+/**
+ * @brief Returns the adjacency storage of the graph.
+ *
+ * @return The compressed sparse row adjacency of the graph.
+ */
+const CsrAdjacency& Graph::GetAdjacency() const {
+    return _adjacency;
+}
+
+/**
+ * @brief Sets the number of orders for a node.
+ *
+ * The node joins the active order index when its count becomes non-zero and
+ * leaves it when the count drops back to zero, in constant time either way.
+ *
+ * @param id The ID of the node.
+ * @param orders The number of orders to set.
+ */
+void Graph::SetNumOrders(int id, int orders) {
+    const bool was_active = _num_orders[id] != 0;
+    _num_orders[id] = orders;
+    if (orders != 0 && !was_active) {
+        _active_position[id] = _active_orders.size();
+        _active_orders.push_back(id);
+    }
+    else if (orders == 0 && was_active) {
+        // Move the last active node into the freed slot
+        const int last = _active_orders.back();
+        _active_orders[_active_position[id]] = last;
+        _active_position[last] = _active_position[id];
+        _active_orders.pop_back();
+        _active_position[id] = -1;
+    }
+}
+
+/**
+ * @brief Adds orders for a node to those already placed.
+ *
+ * @param id The ID of the node.
+ * @param orders The number of orders to add.
+ * @throws invalid_argument If the number of orders is negative.
+ */
+void Graph::AddOrder(int id, int orders) {
+    if (orders < 0) {
+        throw invalid_argument("Cannot add a negative number of orders");
+    }
+    SetNumOrders(id, _num_orders[id] + orders);
+}
+
+/**
+ * @brief Cancels orders previously placed for a node.
+ *
+ * @param id The ID of the node.
+ * @param orders The number of orders to cancel.
+ * @throws invalid_argument If the number of orders is negative or more than the node has.
+ */
+void Graph::CancelOrder(int id, int orders) {
+    if (orders < 0 || orders > _num_orders[id]) {
+        throw invalid_argument("Cannot cancel more orders than were placed");
+    }
+    SetNumOrders(id, _num_orders[id] - orders);
+}
+
+/**
+ * @brief Cancels every order, touching only the nodes that have orders.
+ */
+void Graph::ClearOrders() {
+    for (int id : _active_orders) {
+        _num_orders[id] = 0;
+        _active_position[id] = -1;
+    }
+    _active_orders.clear();
+}
+
+/**
+ * @brief Returns the number of nodes with orders.
+ *
+ * @return The size of the active order index.
+ */
+int Graph::NumActiveOrders() const { return _active_orders.size(); }
+
+/**
+ * @brief Returns the number of orders for a node.
+ *
+ * @param id The ID of the node.
+ * @return The number of orders for the node.
+ */
+int Graph::GetNumOrders(int id) const { return _num_orders[id]; }
+
+/**
+ * @brief Updates the number of orders for each node in the graph randomly.
+ *
+ * Every house is visited to draw its orders, so this sweep suits simulated
+ * days. Live orders should go through AddOrder and CancelOrder instead.
+ * Each house draws from a stream of its own for the day, so with a pool the
+ * draws run in chunks on several threads and give the same orders as
+ * without one. The order index is then updated on the calling thread.
+ *
+ * @param seed The seed for the random number generator, such as the day.
+ * @param pool The threads to draw on, or a null pointer to draw on the calling thread.
+ */
+void Graph::UpdateOrders(int seed, ThreadPool* pool) {
+    vector<int> orders(NumNodes());
+    for_each_chunk(NumNodes(), pool, [this, &orders, seed](int begin, int end) {
+        for (int i=begin; i<end; i++) {
+            orders[i] = random_orders(seed, ExternalId(i));
+        }
+    });
+    // Exclude the first node that is the store
+    for (int i=1; i<NumNodes(); i++) {
+        SetNumOrders(i, orders[i]);
+    }
+}
+
+/**
+ * @brief Returns the nodes with orders and their order counts.
+ *
+ * The list is built from the active order index, so it costs O(k log k) for
+ * k nodes with orders regardless of the size of the map.
+ *
+ * After Renumber the list stays in the order of the ids the houses were
+ * loaded with, so trips are planned as they would be without renumbering.
+ *
+ * @return A vector of node id and order count pairs, sorted by external node id.
+ */
+vector<pair<int, int>> Graph::GetOrderList() const {
+    vector<int> ids(_active_orders);
+    if (_renumbering.IsIdentity()) {
+        sort(ids.begin(), ids.end());
+    }
+    else {
+        sort(ids.begin(), ids.end(), [this](int a, int b) { return ExternalId(a) < ExternalId(b); });
+    }
+    vector<pair<int, int>> order_list;
+    order_list.reserve(ids.size());
+    for (int id : ids) {
+        order_list.emplace_back(id, _num_orders[id]);
+    }
+    return order_list;
+}
+
+/**
+ * @brief Computes the shortest path between two nodes.
+ *
+ * If the tree of the first node is already cached, the answer is read from
+ * it. Otherwise, if a contraction hierarchy is attached, it answers the
+ * query. Failing both, the search chosen with SetSearchMode runs on an
+ * engine owned by the calling thread, which reuses its buffers across
+ * queries and stops at the second node.
+ *
+ * @param nodeIndex1 Index of the first node.
+ * @param nodeIndex2 Index of the second node.
+ * @param path Filled with the nodes on the path if not null, left empty if
+ *             the second node cannot be reached.
+ * @return The shortest distance between the nodes, or infinity if the
+ *         second node cannot be reached from the first.
+ */
+double Graph::FindRoute(int nodeIndex1, int nodeIndex2, vector<int>* path) const {
+    thread_local ShortestPathEngine engine;
+    thread_local BidirectionalEngine bidirectional;
+    SpanTimer timer(Span::ShortestPath);
+    count_metric(Counter::ShortestPathQueries);
+    shared_ptr<const ShortestPathTree> tree = _distance_cache->Find(nodeIndex1);
+    double dist;
+    if (tree) {
+        count_metric(Counter::TreeCacheHits);
+        dist = tree->Distance(nodeIndex2);
+        if (path) {
+            *path = tree->Path(nodeIndex2);
+        }
+    }
+    else if (_hierarchy) {
+        count_metric(Counter::HierarchyQueries);
+        if (path) {
+            *path = _hierarchy->Path(nodeIndex1, nodeIndex2, &dist);
+        }
+        else {
+            dist = _hierarchy->Distance(nodeIndex1, nodeIndex2);
+        }
+    }
+    else if (_search_mode == SearchMode::Bidirectional) {
+        bidirectional.Run(_adjacency, *ReversedEdges(), nodeIndex1, nodeIndex2);
+        dist = bidirectional.Distance();
+        if (path) {
+            *path = bidirectional.Path();
+        }
+    }
+    else {
+        if (_search_mode == SearchMode::AStar) {
+            engine.Run(_adjacency, nodeIndex1, nodeIndex2, *_euclidean);
+        }
+        else if (_search_mode == SearchMode::Landmarks) {
+            engine.Run(_adjacency, nodeIndex1, nodeIndex2, *_landmarks);
+        }
+        else {
+            engine.Run(_adjacency, nodeIndex1, nodeIndex2);
+        }
+        dist = engine.Distance(nodeIndex2);
+        if (path) {
+            *path = engine.Path(nodeIndex2);
+        }
+    }
+
+    return dist;
+}
+
+/**
+ * @brief Finds the shortest route between two nodes.
+ *
+ * @param source The node to start from.
+ * @param target The node to reach.
+ * @return The route, with an infinite distance and no nodes if the target
+ *         cannot be reached.
+ */
+RouteResult Graph::Route(int source, int target) const {
+    RouteResult route{source, target, 0.0, {}};
+    route.distance = FindRoute(source, target, &route.path);
+    return route;
+}
+
+/**
+ * @brief Finds the shortest routes from one source to several targets.
+ *
+ * Routes to many targets from one source share most of their search, so
+ * one Dijkstra search that stops once the last target is settled replaces
+ * a query per target. A cached tree answers every target by lookup, and a
+ * contraction hierarchy, whose queries settle only a few hundred nodes, is
+ * still queried once per target.
+ *
+ * @param source The node to start from.
+ * @param targets The nodes to reach.
+ * @return One route per target, in the order of the targets.
+ */
+vector<RouteResult> Graph::RoutesFrom(int source, const vector<int>& targets) const {
+    vector<RouteResult> routes;
+    routes.reserve(targets.size());
+    shared_ptr<const ShortestPathTree> tree = _distance_cache->Find(source);
+    if (!tree && (targets.size() < 2 || _hierarchy)) {
+        for (int target : targets) {
+            routes.push_back(Route(source, target));
+        }
+        return routes;
+    }
+
+    SpanTimer timer(Span::ShortestPath);
+    thread_local ShortestPathEngine engine;
+    if (tree) {
+        count_metric(Counter::TreeCacheHits, targets.size());
+    }
+    else {
+        engine.Run(_adjacency, source, targets);
+    }
+    count_metric(Counter::ShortestPathQueries, targets.size());
+    for (int target : targets) {
+        RouteResult route{source, target, 0.0, {}};
+        if (tree) {
+            route.distance = tree->Distance(target);
+            route.path = tree->Path(target);
+        }
+        else {
+            route.distance = engine.Distance(target);
+            route.path = engine.Path(target);
+        }
+        routes.push_back(move(route));
+    }
+    return routes;
+}
+
+/**
+ * @brief Computes the shortest path between two nodes.
+ *
+ * @param nodeIndex1 Index of the first node.
+ * @param nodeIndex2 Index of the second node.
+ * @param verbose If 1, prints just the path to console.
+ *                If >1, prints the path and distance to the console.
+ *                Else, no output to console.
+ * @return A double, representing the shortest distance between the nodes,
+ *         or -1 if the second node cannot be reached from the first.
+ */
+double Graph::ShortestPath(int nodeIndex1, int nodeIndex2, int verbose=0) const {
+    if (verbose <= 0) {
+        double dist = FindRoute(nodeIndex1, nodeIndex2, nullptr);
+        return dist == numeric_limits<double>::infinity() ? -1 : dist;
+    }
+
+    RouteResult route = Route(nodeIndex1, nodeIndex2);
+    if (!route.Reachable()) {
+        // If the destination node is not reachable from the start node, return
+        return -1;
+    }
+
+    TextReportSink console(cout);
+    _renumbering.ToExternal(route);
+    console.Route(route, verbose > 1);
+
+    // Return the shortest distance between the input nodes
+    return route.distance;
+}
+
+/**
+ * @brief Returns the shortest path tree from a source to every node.
+ *
+ * Trees are memoised in a cache shared by copies of the graph while they
+ * share its edges. UpdateEdges discards the trees its changes affect.
+ *
+ * @param source The source of the tree.
+ * @return The shortest path tree from the source.
+ */
+shared_ptr<const ShortestPathTree> Graph::DistancesFrom(int source) const {
+    return _distance_cache->Get(_adjacency, source);
+}
+
+/**
+ * @brief Returns the shortest path tree from every node to a target.
+ *
+ * The search runs from the target over the reversed edges, so the tree's
+ * distances lead to the target and its paths are listed from the target
+ * backwards. The reversed edges are formed on the first call, unless a search
+ * mode already built them, and kept with the graph; the trees are memoised in
+ * a cache of their own, which UpdateEdges repairs like the trees from a source.
+ *
+ * @param target The target of the tree.
+ * @return The shortest path tree to the target.
+ */
+shared_ptr<const ShortestPathTree> Graph::DistancesTo(int target) const {
+    shared_ptr<const ShortestPathTree> tree = _inbound_cache->Find(target);
+    if (tree) {
+        return tree;
+    }
+
+    return _inbound_cache->Get(*ReversedEdges(), target);
+}
+
+/**
+ * @brief Returns a number identifying the graph's current edges and lengths.
+ *
+ * @return The stamp, shared by copies until either changes its edges.
+ */
+uint64_t Graph::EdgesStamp() const { return _edges_stamp; }
+
+/**
+ * @brief Returns a stamp no graph has had before.
+ *
+ * @return The next value of a process-wide counter, starting at 1.
+ */
+uint64_t Graph::NewEdgesStamp() {
+    static atomic<uint64_t> next_stamp(1);
+    return next_stamp++;
+}
+
+/**
+ * @brief Returns the reversed edges, building them on the first call.
+ *
+ * Queries may run concurrently and this is the only const path that writes
+ * the reversed edges, so every const read goes through the same lock.
+ *
+ * @return The reversed edges.
+ */
+shared_ptr<const CsrAdjacency> Graph::ReversedEdges() const {
+    lock_guard<mutex> lock(*_reverse_mutex);
+    if (!_reverse_adjacency) {
+        _reverse_adjacency = make_shared<const CsrAdjacency>(_adjacency.Reversed());
+    }
+    return _reverse_adjacency;
+}
+
+/**
+ * @brief Changes the length of the edges from one node to another.
+ *
+ * @param source The ID of the node the edges leave.
+ * @param target The ID of the node the edges lead to.
+ * @param distance The new length, or infinity to close the road.
+ */
+void Graph::UpdateEdge(int source, int target, double distance) {
+    UpdateEdges(vector<WeightedEdge>(1, WeightedEdge{source, target, distance}));
+}
+
+/**
+ * @brief Changes the lengths of several edges at once and repairs the routing state.
+ *
+ * The distances are written in place in the adjacency arrays, after a one-off
+ * copy if they are shared with copies of the graph or mapped from a file.
+ * Then only what the changes reach is repaired:
+ * - cached trees are discarded only if a change could alter them;
+ * - the reversed edges get the same new lengths;
+ * - a customisable contraction hierarchy has the arcs above the changes
+ *   repaired, while any other hierarchy is detached, since its shortcuts may
+ *   no longer hold;
+ * - the A* and landmark bounds stay valid while edges only get longer, so
+ *   they are rebuilt only when some edge gets shorter.
+ *
+ * Updates must not run while other threads query the graph.
+ *
+ * @param updates The edges to change and their new lengths.
+ * @throws invalid_argument If an update refers to a missing edge or has a negative distance.
+ *         No edge is changed in that case.
+ */
+void Graph::UpdateEdges(const vector<WeightedEdge>& updates) {
+    const int* offsets = _adjacency.Offsets();
+    const int* targets = _adjacency.Targets();
+    for (const WeightedEdge& update : updates) {
+        if (update.source < 0 || update.source >= NumNodes() || update.target < 0 || update.target >= NumNodes()) {
+            throw invalid_argument("Edge refers to a node outside the graph");
+        }
+        if (!(update.distance >= 0)) {
+            throw invalid_argument("Edge distances must be non-negative");
+        }
+        if (find(targets + offsets[update.source], targets + offsets[update.source + 1], update.target) ==
+            targets + offsets[update.source + 1]) {
+            throw invalid_argument("No edge from node " + to_string(update.source) + " to node " +
+                                   to_string(update.target));
+        }
+    }
+
+    const bool shared = !_adjacency.OwnsDistances();
+    vector<WeightChange> changes;
+    double* distances = nullptr;
+    for (const WeightedEdge& update : updates) {
+        for (int e = offsets[update.source]; e < offsets[update.source + 1]; e++) {
+            if (targets[e] != update.target || _adjacency.Distances()[e] == update.distance) {
+                continue;
+            }
+            if (distances == nullptr) {
+                distances = _adjacency.MutableDistances();
+            }
+            changes.push_back(WeightChange{update.source, update.target, distances[e], update.distance});
+            distances[e] = update.distance;
+        }
+    }
+    if (changes.empty()) {
+        return;
+    }
+    _edges_stamp = NewEdgesStamp();
+
+    if (shared) {
+        // Copies of the graph keep the old lengths, so they keep the old cache
+        _distance_cache = make_shared<DistanceCache>(*_distance_cache);
+        _inbound_cache = make_shared<DistanceCache>(*_inbound_cache);
+    }
+    _distance_cache->Invalidate(changes);
+    // A tree to a target runs over the reversed edges, so each change is seen from its target
+    vector<WeightChange> reversed_changes;
+    reversed_changes.reserve(changes.size());
+    for (const WeightChange& change : changes) {
+        reversed_changes.push_back(WeightChange{change.target, change.source, change.old_distance, change.new_distance});
+    }
+    _inbound_cache->Invalidate(reversed_changes);
+
+    if (_reverse_adjacency) {
+        // Drop this graph's hold first, so the lengths are written in place if no copy shares them
+        CsrAdjacency reverse = *_reverse_adjacency;
+        _reverse_adjacency.reset();
+        double* reverse_distances = reverse.MutableDistances();
+        for (const WeightedEdge& update : updates) {
+            for (int e = reverse.Offsets()[update.target]; e < reverse.Offsets()[update.target + 1]; e++) {
+                if (reverse.Targets()[e] == update.source) {
+                    reverse_distances[e] = update.distance;
+                }
+            }
+        }
+        _reverse_adjacency = make_shared<const CsrAdjacency>(move(reverse));
+    }
+
+    const bool shortened = any_of(changes.begin(), changes.end(),
+                                  [](const WeightChange& change) { return change.new_distance < change.old_distance; });
+    if (shortened && _euclidean) {
+        vector<Coordinates> coordinates(NumNodes());
+        for (int i=0; i<NumNodes(); i++) {
+            coordinates[i] = _euclidean->Position(i);
+        }
+        _euclidean = make_shared<const EuclideanHeuristic>(_adjacency, move(coordinates));
+    }
+    if (shortened && _landmarks) {
+        _landmarks = make_shared<const LandmarkHeuristic>(_adjacency, *_reverse_adjacency,
+                                                          _landmarks->Landmarks().size());
+    }
+
+    if (_hierarchy && _hierarchy->IsCustomisable()) {
+        auto hierarchy = make_shared<ContractionHierarchy>(*_hierarchy);
+        hierarchy->Repair(_adjacency, changes);
+        _hierarchy = move(hierarchy);
+    }
+    else {
+        _hierarchy = nullptr;
+    }
+}
+
+/**
+ * @brief Attaches a contraction hierarchy used to answer point-to-point queries.
+ *
+ * @param hierarchy A hierarchy built from this graph's edges, or a null pointer to detach it.
+ * @throws invalid_argument If the hierarchy was built from a graph of a different size.
+ */
+void Graph::SetContractionHierarchy(shared_ptr<const ContractionHierarchy> hierarchy) {
+    if (hierarchy && (hierarchy->NumNodes() != NumNodes() || hierarchy->NumGraphEdges() != NumEdges())) {
+        throw invalid_argument("Contraction hierarchy does not match the graph");
+    }
+    _hierarchy = move(hierarchy);
+}
+
+/**
+ * @brief Returns the attached contraction hierarchy.
+ *
+ * @return The hierarchy, or a null pointer if none is attached.
+ */
+shared_ptr<const ContractionHierarchy> Graph::GetContractionHierarchy() const {
+    return _hierarchy;
+}
+
+/**
+ * @brief Gives every node a position, enabling A* search.
+ *
+ * @param coordinates The position of each node, in km.
+ * @throws invalid_argument If there is not one position per node.
+ */
+void Graph::SetCoordinates(vector<Coordinates> coordinates) {
+    _euclidean = make_shared<const EuclideanHeuristic>(_adjacency, move(coordinates));
+}
+
+/**
+ * @brief Returns true if the nodes have positions.
+ *
+ * @return True once SetCoordinates has been called, false otherwise.
+ */
+bool Graph::HasCoordinates() const { return _euclidean != nullptr; }
+
+/**
+ * @brief Returns the position of a node.
+ *
+ * @param id The ID of the node.
+ * @return The position of the node in km.
+ * @throws logic_error If the nodes have no positions.
+ */
+Coordinates Graph::GetCoordinates(int id) const {
+    if (!_euclidean) {
+        throw logic_error("The graph has no node coordinates");
+    }
+    return _euclidean->Position(id);
+}
+
+/**
+ * @brief Renumbers the nodes so that nodes close on the map have close ids.
+ *
+ * The edges, positions and orders are moved to the new ids. The search
+ * state derived from the edges is rebuilt, except the cached trees, which
+ * are dropped, and the contraction hierarchy, which is detached.
+ *
+ * @param ordering The order to give the nodes.
+ * @throws logic_error If the Hilbert ordering is asked for and the nodes have no positions.
+ */
+void Graph::Renumber(NodeOrdering ordering) {
+    if (ordering == NodeOrdering::Hilbert && !_euclidean) {
+        throw logic_error("The Hilbert ordering needs node coordinates");
+    }
+    vector<Coordinates> coordinates;
+    if (_euclidean) {
+        coordinates.resize(NumNodes());
+        for (int i=0; i<NumNodes(); i++) {
+            coordinates[i] = _euclidean->Position(i);
+        }
+    }
+    const NodeRenumbering renumbering = NodeRenumbering::Compute(_adjacency, ordering, coordinates);
+    if (renumbering.IsIdentity()) {
+        return;
+    }
+
+    _adjacency = renumbering.Apply(_adjacency);
+    _num_orders = renumbering.Apply(_num_orders);
+    for (int& id : _active_orders) {
+        id = renumbering.ToInternal(id);
+    }
+    _active_position.assign(NumNodes(), -1);
+    for (int i=0; i<(int)_active_orders.size(); i++) {
+        _active_position[_active_orders[i]] = i;
+    }
+
+    // Copies of the graph keep the old ids, so they keep the old cache
+    _distance_cache = make_shared<DistanceCache>(*_distance_cache);
+    _distance_cache->Clear();
+    _inbound_cache = make_shared<DistanceCache>(*_inbound_cache);
+    _inbound_cache->Clear();
+    _hierarchy = nullptr;
+    if (_euclidean) {
+        _euclidean = make_shared<const EuclideanHeuristic>(_adjacency, renumbering.Apply(coordinates));
+    }
+    if (_reverse_adjacency) {
+        _reverse_adjacency = make_shared<const CsrAdjacency>(_adjacency.Reversed());
+    }
+    if (_landmarks) {
+        _landmarks = make_shared<const LandmarkHeuristic>(_adjacency, *_reverse_adjacency,
+                                                          _landmarks->Landmarks().size());
+    }
+    _renumbering = _renumbering.Then(renumbering);
+    _edges_stamp = NewEdgesStamp();
+}
+
+/**
+ * @brief Returns the translation between external and internal node ids.
+ *
+ * @return The renumbering, the identity until Renumber is called.
+ */
+const NodeRenumbering& Graph::GetRenumbering() const { return _renumbering; }
+
+/**
+ * @brief Returns the id a node was loaded with.
+ *
+ * @param id The internal ID of the node.
+ * @return The external ID of the node.
+ */
+int Graph::ExternalId(int id) const { return _renumbering.ToExternal(id); }
+
+/**
+ * @brief Returns the id a node is stored under.
+ *
+ * @param external_id The ID the node was loaded with.
+ * @return The internal ID of the node.
+ */
+int Graph::InternalId(int external_id) const { return _renumbering.ToInternal(external_id); }
+
+/**
+ * @brief Picks landmark nodes and computes their distances for the Landmarks search mode.
+ *
+ * @param num_landmarks The number of landmarks, each costing two shortest path trees.
+ */
+void Graph::PrecomputeLandmarks(int num_landmarks) {
+    if (!_reverse_adjacency) {
+        _reverse_adjacency = make_shared<const CsrAdjacency>(_adjacency.Reversed());
+    }
+    _landmarks = make_shared<const LandmarkHeuristic>(_adjacency, *_reverse_adjacency, num_landmarks);
+}
+
+/// The number of landmarks picked when the Landmarks search mode is selected without precomputing them.
+static const int default_num_landmarks = 8;
+
+/**
+ * @brief Selects the search used by ShortestPath, preparing what it needs.
+ *
+ * Bidirectional search builds the reversed edges, and landmark search picks
+ * default_num_landmarks landmarks unless PrecomputeLandmarks was called.
+ *
+ * @param mode The search to use.
+ * @throws logic_error If A* search is selected and the nodes have no positions.
+ */
+void Graph::SetSearchMode(SearchMode mode) {
+    if (mode == SearchMode::AStar && !_euclidean) {
+        throw logic_error("A* search needs node coordinates");
+    }
+    if (mode == SearchMode::Bidirectional && !_reverse_adjacency) {
+        _reverse_adjacency = make_shared<const CsrAdjacency>(_adjacency.Reversed());
+    }
+    if (mode == SearchMode::Landmarks && !_landmarks) {
+        PrecomputeLandmarks(default_num_landmarks);
+    }
+    _search_mode = mode;
+}
+
+/**
+ * @brief Returns the search used by ShortestPath.
+ *
+ * @return The current search mode.
+ */
+SearchMode Graph::GetSearchMode() const { return _search_mode; }
+
+/**
+ * @brief Computes the shortest path distances from every source to every target.
+ *
+ * Each row is one search from its source that stops once every target is
+ * settled, or a lookup if the source's tree is cached. With a pool, rows run
+ * as separate jobs that idle workers steal from each other, all sharing the
+ * read-only graph.
+ *
+ * @param sources The nodes to measure from.
+ * @param targets The nodes to measure to.
+ * @param pool The threads to run the searches on, or a null pointer to run them on the calling thread.
+ * @return A dense table of distances, with infinity for unreachable pairs.
+ */
+DistanceTable Graph::DistancesBetween(const vector<int>& sources, const vector<int>& targets,
+                                      ThreadPool* pool) const {
+    DistanceTable table(sources, targets);
+    auto fill_row = [this, &table](int i) {
+        const int source = table.Sources()[i];
+        const vector<int>& row_targets = table.Targets();
+        double* row = table.Row(i);
+        shared_ptr<const ShortestPathTree> tree = _distance_cache->Find(source);
+        if (tree) {
+            for (int j=0; j<(int)row_targets.size(); j++) {
+                row[j] = tree->Distance(row_targets[j]);
+            }
+            return;
+        }
+        thread_local ShortestPathEngine engine;
+        engine.Run(_adjacency, source, row_targets);
+        for (int j=0; j<(int)row_targets.size(); j++) {
+            row[j] = engine.Distance(row_targets[j]);
+        }
+    };
+
+    if (pool == nullptr || sources.size() < 2) {
+        for (int i=0; i<(int)sources.size(); i++) {
+            fill_row(i);
+        }
+        return table;
+    }
+
+    vector<future<void>> rows;
+    rows.reserve(sources.size());
+    for (int i=0; i<(int)sources.size(); i++) {
+        rows.push_back(pool->Submit([&fill_row, i]() { fill_row(i); }));
+    }
+    for (auto& row : rows) {
+        pool->Await(row);
+    }
+    return table;
+}
+
+/**
+ * @brief Computes the shortest path tree of every node up front.
+ *
+ * This takes O(n^2) memory, so it is meant for small neighbourhoods where
+ * every later query becomes a lookup. Maps up to the all-pairs limit are
+ * solved by a vectorised Floyd-Warshall, larger ones by O(n) searches.
+ */
+void Graph::PrecomputeDistances() const {
+    _distance_cache->PrecomputeAll(_adjacency);
+}
+
+/**
+ * @brief Sets the largest map PrecomputeDistances solves with Floyd-Warshall.
+ *
+ * @param max_nodes The number of nodes, or 0 to always run a search per node.
+ */
+void Graph::SetAllPairsLimit(int max_nodes) {
+    _distance_cache->SetAllPairsLimit(max_nodes);
+}
+
+/**
+ * @brief Sets the largest number of shortest path trees kept in memory at once.
+ *
+ * @param max_sources The number of trees to keep.
+ */
+void Graph::SetDistanceCacheCapacity(int max_sources) {
+    _distance_cache->SetCapacity(max_sources);
+}
+
+/**
+ * @brief Draws the number of orders a house places on a simulated day.
+ *
+ * @param seed The seed of the day.
+ * @param node The ID of the house.
+ * @return The number of orders, from 0 to 2.
+ */
+int random_orders(int seed, int node) {
+    CounterRng rng(seed, order_stream | node);
+    return rng.Below(3); // one can order up to 2 things
+}
+
+/**
+ * @brief Generates a weighted adjacency matrix based on the given parameters.
+ *
+ * This function generates a weighted adjacency matrix based on the given size, 
+ * connectivity and random seed. 
+ * Here, the weights represent distance in km between nodes.
+ * Row i draws the connections to the nodes after it from a stream of its own,
+ * so with a pool the rows are filled in chunks on several threads and the
+ * matrix is the same for a given seed whatever the number of threads.
+ *
+ * @param size The number of nodes to include in the distance matrix.
+ * @param connectivity The probability of a random edge being created between two nodes.
+ * @param seed The seed to use for the random number generator.
+ * @param pool The threads to fill the rows on, or a null pointer to fill them on the calling thread.
+ * @return A 2D vector representing the distance matrix.
+ */
+vector<vector<double>> generate_dist_matrix(int size, double connectivity, int seed, ThreadPool* pool) {
+    vector<vector<double>> matrix(size, vector<double>(size, 0.0));
+
+    // Connect all nodes to the adjacent node to ensure connectivity
+    for (int i = 0; i < size; i++) {
+        int j = (i + 1) % size;
+        CounterRng rng(seed, ring_stream | i);
+        double dist = rng.Uniform();
+        matrix[i][j] = dist;
+        matrix[j][i] = dist;
+    }
+
+    // Make random connections between nodes. Each pair gets two chances to
+    // connect, one from each end, and a random connection replaces the ring edge.
+    // Row i only writes the pairs (i, j > i) and their mirrors, so rows never overlap.
+    for_each_chunk(size, pool, [&matrix, size, connectivity, seed](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            CounterRng rng(seed, pair_stream | i);
+            for (int j = i + 1; j < size; j++) {
+                bool linked = rng.Uniform() <= connectivity;
+                linked = (rng.Uniform() <= connectivity) || linked;
+                double dist = rng.Uniform();
+                if (linked) {
+                    matrix[i][j] = dist;
+                    matrix[j][i] = dist;
+                }
+            }
+        }
+    });
+
+    return matrix;
+}
+
+/**
+ * @brief Generates a random edge list with the same distribution as generate_dist_matrix.
+ *
+ * Nodes are joined in a ring to ensure connectivity, and every other pair of
+ * nodes is joined with the probability that generate_dist_matrix would link
+ * them, 1 - (1 - connectivity)^2. Instead of testing every pair, each row
+ * draws the gap to its next linked pair from a geometric distribution, so the
+ * cost is O(n + m) rather than O(n^2). Rows draw from streams of their own,
+ * so with a pool they are generated in chunks on several threads and joined
+ * in order, giving the same edges for a seed whatever the number of threads.
+ * Each undirected connection is emitted as two directed edges. The exact
+ * edges differ from generate_dist_matrix for the same seed.
+ *
+ * @param size The number of nodes in the map.
+ * @param connectivity The probability of a random edge being created between two nodes.
+ * @param seed The seed to use for the random number generator.
+ * @param pool The threads to generate the rows on, or a null pointer to generate them on the calling thread.
+ * @return A list of directed edges, with distances in km.
+ */
+vector<WeightedEdge> generate_edge_list(int size, double connectivity, int seed, ThreadPool* pool) {
+    vector<WeightedEdge> edges;
+    if (size < 2) {
+        return edges;
+    }
+
+    // ring[i] holds the distance between node i and node (i + 1) % size
+    const int num_ring = (size == 2) ? 1 : size;
+    vector<double> ring(num_ring);
+    for (int i = 0; i < num_ring; i++) {
+        CounterRng rng(seed, ring_stream | i);
+        ring[i] = rng.Uniform();
+    }
+
+    const double p = 1.0 - (1.0 - connectivity) * (1.0 - connectivity);
+    if (p > 0) {
+        const double log_q = log1p(-min(p, 1.0 - 1e-12));
+        const int num_chunks = (size - 1 + chunk_size - 1) / chunk_size;
+        vector<vector<WeightedEdge>> chunk_edges(num_chunks);
+        // Row i replaces ring[i] and row 0 also ring[size - 1], so rows never write the same slot
+        for_each_chunk(size - 1, pool, [&](int begin, int end) {
+            vector<WeightedEdge>& found = chunk_edges[begin / chunk_size];
+            for (int i = begin; i < end; i++) {
+                // Walk the pairs (i, v > i), jumping straight to the next linked one
+                CounterRng rng(seed, pair_stream | i);
+                long long v = i;
+                while (true) {
+                    v += 1 + (long long)floor(log(rng.Uniform()) / log_q);
+                    if (v > size - 1) {
+                        break;
+                    }
+                    double dist = rng.Uniform();
+                    if (v == i + 1) {
+                        ring[i] = dist;
+                    }
+                    else if (i == 0 && v == size - 1 && num_ring == size) {
+                        ring[size - 1] = dist;
+                    }
+                    else {
+                        found.push_back(WeightedEdge{i, (int)v, dist});
+                        found.push_back(WeightedEdge{(int)v, i, dist});
+                    }
+                }
+            }
+        });
+
+        size_t num_edges = 2 * num_ring;
+        for (const vector<WeightedEdge>& found : chunk_edges) {
+            num_edges += found.size();
+        }
+        edges.reserve(num_edges);
+        for (const vector<WeightedEdge>& found : chunk_edges) {
+            edges.insert(edges.end(), found.begin(), found.end());
+        }
+    }
+
+    for (int i = 0; i < num_ring; i++) {
+        int v = (i + 1) % size;
+        edges.push_back(WeightedEdge{i, v, ring[i]});
+        edges.push_back(WeightedEdge{v, i, ring[i]});
+    }
+
+    return edges;
+}
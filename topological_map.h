@@ -2,70 +2,519 @@
  * @file topological_map.h
  * @brief Defines classes and functions for a topological map.
  */
+#ifndef TOPOLOGICAL_MAP_H
+#define TOPOLOGICAL_MAP_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
+#include "shortest_path.h"
+#include "route_report.h"
+#include "node_ordering.h"
+
+class Graph;
+class ThreadPool;
+class ContractionHierarchy;
+
+/// An edge leaving a node, as stored in the graph's adjacency arrays.
+struct Edge {
+    /// The ID of the node the edge leads to.
+    int target;
+
+    /// The distance to the connected node.
+    double distance;
+};
+
+/// A directed, weighted edge between two nodes, used to build a graph from an edge list.
+struct WeightedEdge {
+    /// The ID of the node the edge leaves.
+    int source;
+
+    /// The ID of the node the edge leads to.
+    int target;
+
+    /// The length of the edge.
+    double distance;
+};
+
+/// A read-only view over the edges leaving a single node.
+class EdgeRange {
+public:
+    /// Iterates over the edges of the range, yielding them by value.
+    class Iterator {
+    public:
+        /// Constructor.
+        Iterator(const int* target, const double* distance);
+
+        /// Returns the edge the iterator points to.
+        Edge operator*() const;
+
+        /// Advances to the next edge.
+        Iterator& operator++();
+
+        /// Compares two iterators for inequality.
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        /// The current position in the neighbour id array.
+        const int* _target;
+
+        /// The current position in the distance array.
+        const double* _distance;
+    };
+
+    /// Constructor.
+    /// \param targets The first neighbour id of the range.
+    /// \param distances The first edge distance of the range.
+    /// \param size The number of edges in the range.
+    EdgeRange(const int* targets, const double* distances, int size);
+
+    /// Returns an iterator to the first edge.
+    Iterator begin() const;
+
+    /// Returns an iterator past the last edge.
+    Iterator end() const;
+
+    /// Returns the number of edges in the range.
+    int size() const;
+
+    /// Returns the edge at the given position in the range.
+    Edge operator[](int i) const;
+
+private:
+    /// The neighbour ids of the range.
+    const int* _targets;
+
+    /// The edge distances of the range.
+    const double* _distances;
+
+    /// The number of edges in the range.
+    int _size;
+};
+
+/// Adjacency of a graph in compressed sparse row form.
+/// The edges leaving node u are stored at positions [offsets[u], offsets[u+1]) of the
+/// neighbour id and distance arrays.
+/// The arrays may live in memory owned by the adjacency or in a mapped file, and copies
+/// of an adjacency share them. The structure never changes once built; the distances are
+/// copied on the first write whenever they are shared or mapped.
+class CsrAdjacency {
+public:
+    /// Constructs an empty adjacency.
+    CsrAdjacency();
+
+    /// Constructor.
+    /// \param offsets The start position of each node's edges, followed by the total number of edges.
+    /// \param targets The neighbour id of each edge.
+    /// \param distances The distance of each edge.
+    CsrAdjacency(std::vector<int> offsets, std::vector<int> targets, std::vector<double> distances);
 
-using namespace std;
+    /// Constructs a view over arrays held by another object.
+    /// \param storage The object keeping the arrays alive.
+    /// \param num_nodes The number of nodes.
+    /// \param offsets The start position of each node's edges, of size num_nodes + 1.
+    /// \param targets The neighbour id of each edge.
+    /// \param distances The distance of each edge.
+    CsrAdjacency(std::shared_ptr<const void> storage, int num_nodes,
+                 const int* offsets, const int* targets, const double* distances);
+
+    /// Builds the adjacency from an unordered edge list in linear time.
+    /// \param num_nodes The number of nodes.
+    /// \param edges The edges of the graph, in any order.
+    static CsrAdjacency FromEdgeList(int num_nodes, const std::vector<WeightedEdge>& edges);
+
+    /// Returns the number of nodes.
+    int NumNodes() const;
+
+    /// Returns the number of edges.
+    int NumEdges() const;
+
+    /// Returns the edges leaving a node.
+    EdgeRange EdgesOf(int node) const;
+
+    /// Returns the offsets array, of size NumNodes() + 1.
+    const int* Offsets() const;
+
+    /// Returns the neighbour id array, of size NumEdges().
+    const int* Targets() const;
+
+    /// Returns the distance array, of size NumEdges().
+    const double* Distances() const;
+
+    /// Returns true if the distance array is owned by this adjacency alone and can be written in place.
+    bool OwnsDistances() const;
+
+    /// Returns the distance array for writing, first copying it if it is shared or mapped.
+    double* MutableDistances();
+
+    /// Returns the adjacency with every edge reversed.
+    CsrAdjacency Reversed() const;
+
+private:
+    /// The object keeping the arrays alive.
+    std::shared_ptr<const void> _storage;
+
+    /// The distances when they are held on the heap rather than in _storage.
+    std::shared_ptr<std::vector<double>> _own_distances;
+
+    /// The number of nodes.
+    int _num_nodes;
+
+    /// The start position of each node's edges.
+    const int* _offsets;
+
+    /// The neighbour id of each edge.
+    const int* _targets;
+
+    /// The distance of each edge.
+    const double* _distances;
+};
 
 /// A node represents a point in the map.
+/// Nodes are lightweight views into the graph that owns them, and stay valid as long as the graph does.
 class Node {
 public:
     /// Constructor.
-    Node(int id);
+    /// \param graph The graph the node belongs to.
+    /// \param id The ID of the node.
+    Node(const Graph& graph, int id);
 
     /// Returns the ID of the node.
     int GetId() const;
 
-    /// Adds an edge to the node.
-    /// \param node The node to connect to.
-    /// \param distance The distance to the connected node.
-    void AddEdge(Node node, double distance);
-
     /// Returns a list of edges connected to the node.
-    vector<pair<Node, double>> GetEdges();
-
-    /// Sets the number of orders assigned to the node.
-    /// \param orders The number of orders assigned to the node.
-    void SetNumOrders(int orders);
+    EdgeRange GetEdges() const;
 
     /// Returns the number of orders assigned to the node.
     int GetNumOrders() const;
 
-private:
-    /// A list of edges connected to the node.
-    vector<pair<Node, double>> _edges;
+    /// Returns true if the graph has coordinates for its nodes.
+    bool HasCoordinates() const;
 
-    /// The number of orders assigned to the node.
-    int _num_orders = 0;
+    /// Returns the position of the node, which requires HasCoordinates().
+    Coordinates GetCoordinates() const;
+
+private:
+    /// The graph the node belongs to.
+    const Graph* _graph;
 
     /// The ID of the node.
     int _id;
 };
 
+/// The algorithm used by Graph::ShortestPath for queries no cache or hierarchy can answer.
+enum class SearchMode {
+    /// Unidirectional Dijkstra search.
+    Dijkstra,
+
+    /// A* search guided by straight-line distance, which needs node coordinates.
+    AStar,
+
+    /// Dijkstra search from both ends at once.
+    Bidirectional,
+
+    /// A* search guided by landmark distances (ALT).
+    Landmarks
+};
 
 /// A graph represents the entire map.
 class Graph {
 public:
     /// Constructor.
     /// \param dist_matrix A distance matrix representing the map.
-    Graph(vector<vector<double>> dist_matrix);
+    Graph(const std::vector<std::vector<double>>& dist_matrix);
+
+    /// Constructor.
+    /// \param adjacency The edges of the map.
+    explicit Graph(CsrAdjacency adjacency);
+
+    /// Copies a graph, sharing its edges and caches. Safe while other threads query the original,
+    /// which DistancesTo may give reversed edges meanwhile.
+    Graph(const Graph& other);
+
+    /// Moves a graph. The source must not be queried concurrently.
+    Graph(Graph&& other) = default;
+
+    /// Replaces the graph by a copy of another, as the copy constructor does.
+    Graph& operator=(const Graph& other);
+
+    /// Replaces the graph by another, which must not be queried concurrently.
+    Graph& operator=(Graph&& other) = default;
+
+    /// Builds a graph from an edge list without forming a distance matrix.
+    /// \param num_nodes The number of nodes in the map.
+    /// \param edges The directed edges of the map, in any order.
+    static Graph FromEdgeList(int num_nodes, const std::vector<WeightedEdge>& edges);
+
+    /// Builds a graph from a range of edges, read in a single pass.
+    /// \param num_nodes The number of nodes in the map.
+    /// \param first The first edge of the range.
+    /// \param last The end of the range.
+    template <typename InputIt>
+    static Graph FromEdges(int num_nodes, InputIt first, InputIt last) {
+        return FromEdgeList(num_nodes, std::vector<WeightedEdge>(first, last));
+    }
+
+    /// Builds a graph from a text edge list file.
+    /// The file holds the number of nodes, followed by one "source target distance" line per edge.
+    /// Lines starting with '#' are ignored.
+    /// \param path The path of the file to read.
+    /// \throws std::runtime_error If the file cannot be opened, or a line has extra text, a node outside
+    /// the map or a negative length.
+    static Graph FromFile(const std::string& path);
+
+    /// Opens a graph saved with SaveBinary, mapping the file read-only into memory.
+    /// The adjacency arrays are used in place after one pass checking their offsets and
+    /// targets, with no parsing or copying, and processes opening the same file share its pages.
+    /// \param path The path of the binary map file.
+    /// \throws std::runtime_error If the file cannot be mapped, or its header or arrays are inconsistent.
+    static Graph OpenBinary(const std::string& path);
+
+    /// Saves the graph and its order counts in the binary map format.
+    /// \param path The path of the file to write.
+    void SaveBinary(const std::string& path) const;
 
     /// Computes the shortest path between two nodes using Dijkstra algorithm.
     /// \param nodeIndex1 The index of the first node.
     /// \param nodeIndex2 The index of the second node.
     /// \param verbose Determines the display to console of path information.
-    double ShortestPath(int nodeIndex1, int nodeIndex2, int verbose);
+    double ShortestPath(int nodeIndex1, int nodeIndex2, int verbose) const;
+
+    /// Returns the shortest route between two nodes, for callers that report it themselves.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    RouteResult Route(int source, int target) const;
+
+    /// Returns the shortest routes from one source to several targets, found by a single search
+    /// that stops once every target is settled, or looked up if the source's tree is cached.
+    /// With a contraction hierarchy attached, each route is a hierarchy query instead.
+    /// \param source The node to start from.
+    /// \param targets The nodes to reach, which may repeat.
+    /// \return One route per target, in the order of the targets.
+    std::vector<RouteResult> RoutesFrom(int source, const std::vector<int>& targets) const;
+
+    /// Changes the length of the edges from one node to another, such as for traffic or a closed road.
+    /// \param source The ID of the node the edges leave.
+    /// \param target The ID of the node the edges lead to.
+    /// \param distance The new length, or infinity to close the road.
+    void UpdateEdge(int source, int target, double distance);
+
+    /// Changes the lengths of several edges at once, repairing the routing state a single time.
+    /// Every edge from each update's source to its target takes the update's distance.
+    /// \param updates The edges to change and their new lengths.
+    void UpdateEdges(const std::vector<WeightedEdge>& updates);
+
+    /// Returns the shortest path tree from a source to every node.
+    /// Trees are memoised, so repeated calls for the same source only cost a lookup.
+    /// \param source The source of the tree.
+    std::shared_ptr<const ShortestPathTree> DistancesFrom(int source) const;
+
+    /// Returns the shortest path tree from every node to a target, grown over the reversed edges.
+    /// Distance(v) is the distance from v to the target, and Path(v) lists the way from v
+    /// to the target backwards. Trees to a target and the reversed edges they are grown over
+    /// are memoised like those from a source, so the tree back to the store is built once.
+    /// \param target The target of the tree.
+    std::shared_ptr<const ShortestPathTree> DistancesTo(int target) const;
+
+    /// Attaches a contraction hierarchy, which then answers ShortestPath queries.
+    /// \param hierarchy A hierarchy built from this graph's edges, or a null pointer to detach it.
+    void SetContractionHierarchy(std::shared_ptr<const ContractionHierarchy> hierarchy);
+
+    /// Returns the attached contraction hierarchy, or a null pointer if there is none.
+    std::shared_ptr<const ContractionHierarchy> GetContractionHierarchy() const;
+
+    /// Gives every node a position, enabling A* search.
+    /// \param coordinates The position of each node, in km.
+    void SetCoordinates(std::vector<Coordinates> coordinates);
+
+    /// Returns true if the nodes have positions.
+    bool HasCoordinates() const;
+
+    /// Returns the position of a node, which requires HasCoordinates().
+    Coordinates GetCoordinates(int id) const;
+
+    /// Renumbers the nodes so that nodes close on the map have close ids, for faster searches.
+    /// Meant to be called once the map is loaded. Node ids in every other member function are
+    /// then the new internal ids; ExternalId and InternalId translate to and from the ids the
+    /// map was loaded with. Orders are drawn and listed by external id, and Task reports
+    /// external ids, so the same houses get and show the same orders. The store stays node 0.
+    /// Cached trees are dropped, as is any contraction hierarchy, which must be rebuilt.
+    /// \param ordering The order to give the nodes.
+    /// \throws std::logic_error If the Hilbert ordering is asked for and the nodes have no positions.
+    void Renumber(NodeOrdering ordering);
+
+    /// Returns the translation between external and internal node ids.
+    const NodeRenumbering& GetRenumbering() const;
+
+    /// Returns the id a node was loaded with.
+    /// \param id The internal ID of the node.
+    int ExternalId(int id) const;
+
+    /// Returns the id a node is stored under.
+    /// \param external_id The ID the node was loaded with.
+    int InternalId(int external_id) const;
+
+    /// Picks landmark nodes and computes their distances for the Landmarks search mode.
+    /// \param num_landmarks The number of landmarks, each costing two shortest path trees.
+    void PrecomputeLandmarks(int num_landmarks);
+
+    /// Selects the search used by ShortestPath, preparing what it needs.
+    /// \param mode The search to use.
+    void SetSearchMode(SearchMode mode);
+
+    /// Returns the search used by ShortestPath.
+    SearchMode GetSearchMode() const;
+
+    /// Computes the shortest path distances from every source to every target.
+    /// \param sources The nodes to measure from.
+    /// \param targets The nodes to measure to.
+    /// \param pool The threads to run the searches on, or a null pointer to run them on the calling thread.
+    DistanceTable DistancesBetween(const std::vector<int>& sources, const std::vector<int>& targets,
+                                   ThreadPool* pool = nullptr) const;
+
+    /// Computes the shortest path tree of every node up front, for small neighbourhoods.
+    void PrecomputeDistances() const;
+
+    /// Sets the largest map PrecomputeDistances solves with Floyd-Warshall rather than a search per node.
+    /// \param max_nodes The number of nodes, or 0 to always search.
+    void SetAllPairsLimit(int max_nodes);
+
+    /// Sets the largest number of shortest path trees kept in memory at once.
+    /// \param max_sources The number of trees to keep.
+    void SetDistanceCacheCapacity(int max_sources);
 
     /// Updates the number of orders assigned to each node.
-    /// \param seed A random seed to use for generating the number of orders.
-    void UpdateOrders(int seed);
+    /// The orders depend only on the seed, not on whether or how many threads are used.
+    /// \param seed A random seed to use for generating the number of orders, such as the day.
+    /// \param pool The threads to draw the orders on, or a null pointer to draw them on the calling thread.
+    void UpdateOrders(int seed, ThreadPool* pool = nullptr);
 
     /// Returns the number of nodes in the graph.
-    int NumNodes();
+    int NumNodes() const;
+
+    /// Returns the number of edges in the graph.
+    int NumEdges() const;
 
-    /// Returns a list of pairs of node ids and number of orders for each node in the graph.
-    vector<pair<int, int>> GetOrderList();
+    /// Returns a view of the node with the given ID.
+    Node GetNode(int id) const;
+
+    /// Returns the adjacency storage of the graph.
+    const CsrAdjacency& GetAdjacency() const;
+
+    /// Returns a number identifying the graph's current edges and lengths. Copies share it until
+    /// either is changed, and every UpdateEdges or Renumber that changes the edges draws a new one,
+    /// so anything measured on the graph can tell when it must be measured again.
+    uint64_t EdgesStamp() const;
+
+    /// Sets the number of orders assigned to a node.
+    /// \param id The ID of the node.
+    /// \param orders The number of orders assigned to the node.
+    void SetNumOrders(int id, int orders);
+
+    /// Returns the number of orders assigned to a node.
+    int GetNumOrders(int id) const;
+
+    /// Adds orders for a node to those already placed.
+    /// \param id The ID of the node.
+    /// \param orders The number of orders to add.
+    void AddOrder(int id, int orders = 1);
+
+    /// Cancels orders previously placed for a node.
+    /// \param id The ID of the node.
+    /// \param orders The number of orders to cancel.
+    void CancelOrder(int id, int orders = 1);
+
+    /// Cancels every order, in time proportional to the number of nodes with orders.
+    void ClearOrders();
+
+    /// Returns the number of nodes with at least one order.
+    int NumActiveOrders() const;
+
+    /// Returns the nodes with orders as pairs of node ids and order counts, sorted by external node id.
+    std::vector<std::pair<int, int>> GetOrderList() const;
 
 private:
-    /// A list of nodes in the graph.
-    vector<Node> _nodes;
-};
\ No newline at end of file
+    /// Runs the query behind ShortestPath and Route.
+    /// \param source The node to start from.
+    /// \param target The node to reach.
+    /// \param path Filled with the nodes on the path, if not null.
+    /// \return The shortest distance, or infinity if the target is unreachable.
+    double FindRoute(int source, int target, std::vector<int>* path) const;
+
+    /// Returns the reversed edges, building them on the first call. Safe while other threads query the graph.
+    std::shared_ptr<const CsrAdjacency> ReversedEdges() const;
+
+    /// Returns a stamp no graph has had before.
+    static uint64_t NewEdgesStamp();
+
+    /// The edges of the graph.
+    CsrAdjacency _adjacency;
+
+    /// The number of orders assigned to each node.
+    std::vector<int> _num_orders;
+
+    /// The nodes with orders, in no particular order.
+    std::vector<int> _active_orders;
+
+    /// The position of each node in _active_orders, or -1 if it has no orders.
+    std::vector<int> _active_position;
+
+    /// The memoised shortest path trees, shared by copies of the graph since they share its edges.
+    std::shared_ptr<DistanceCache> _distance_cache = std::make_shared<DistanceCache>();
+
+    /// The memoised shortest path trees to a target, grown over the reversed edges and shared like _distance_cache.
+    std::shared_ptr<DistanceCache> _inbound_cache = std::make_shared<DistanceCache>();
+
+    /// The contraction hierarchy answering point-to-point queries, if one is attached.
+    std::shared_ptr<const ContractionHierarchy> _hierarchy;
+
+    /// The search used by ShortestPath.
+    SearchMode _search_mode = SearchMode::Dijkstra;
+
+    /// The straight-line heuristic over the node positions, if the nodes have positions.
+    std::shared_ptr<const EuclideanHeuristic> _euclidean;
+
+    /// The landmark heuristic, once landmarks are precomputed.
+    std::shared_ptr<const LandmarkHeuristic> _landmarks;
+
+    /// The reversed edges, built when a search mode or DistancesTo first needs them.
+    /// Const methods and the copy constructor only touch them through ReversedEdges or under _reverse_mutex.
+    mutable std::shared_ptr<const CsrAdjacency> _reverse_adjacency;
+
+    /// Guards _reverse_adjacency against DistancesTo filling it in; shared by copies of the graph so they stay movable.
+    std::shared_ptr<std::mutex> _reverse_mutex = std::make_shared<std::mutex>();
+
+    /// The translation between the ids the map was loaded with and the ids of the arrays.
+    NodeRenumbering _renumbering;
+
+    /// Identifies the current edges and lengths, as returned by EdgesStamp.
+    uint64_t _edges_stamp = NewEdgesStamp();
+};
+
+/// Returns the number of orders a house places on a simulated day, as drawn by Graph::UpdateOrders.
+/// \param seed The seed of the day.
+/// \param node The ID of the house.
+int random_orders(int seed, int node);
+
+/// Generates a random distance matrix, with distances in km between connected nodes and 0 elsewhere.
+/// \param size The number of nodes to include in the distance matrix.
+/// \param connectivity The probability of a random edge being created between two nodes.
+/// The matrix depends only on the arguments, not on whether or how many threads are used.
+/// \param seed The seed to use for the random number generator.
+/// \param pool The threads to fill the rows on, or a null pointer to fill them on the calling thread.
+std::vector<std::vector<double>> generate_dist_matrix(int size, double connectivity = 0.0, int seed = 0,
+                                                      ThreadPool* pool = nullptr);
+
+/// Generates a random edge list with the same distribution as generate_dist_matrix, without forming the matrix.
+/// \param size The number of nodes in the map.
+/// \param connectivity The probability of a random edge being created between two nodes.
+/// The edges depend only on the arguments, not on whether or how many threads are used.
+/// \param seed The seed to use for the random number generator.
+/// \param pool The threads to generate the rows on, or a null pointer to generate them on the calling thread.
+std::vector<WeightedEdge> generate_edge_list(int size, double connectivity = 0.0, int seed = 0,
+                                             ThreadPool* pool = nullptr);
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * @file versioned_graph.cpp
+ * @brief Implements version publishing and epoch-based reclamation for VersionedGraph.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include "versioned_graph.h"
+
+using namespace std;
+
+/// The number of reader slots, the most threads that can hold versions at once without waiting.
+static const int max_readers = 128;
+
+/// One version of the graph.
+struct VersionedGraph::Snapshot {
+    /// The graph.
+    Graph graph;
+
+    /// The number of the version.
+    uint64_t number;
+};
+
+/// The epoch a reader entered at, on a cache line of its own so readers do not slow each other down.
+struct alignas(64) VersionedGraph::ReaderSlot {
+    /// The epoch, or 0 while the slot is free.
+    atomic<uint64_t> epoch{0};
+};
+
+// Implementation of VersionedGraph::ReadGuard class
+
+/**
+ * @brief Constructs a hold on a version.
+ *
+ * @param slot The reader slot announcing the hold.
+ * @param version The version held.
+ */
+VersionedGraph::ReadGuard::ReadGuard(ReaderSlot* slot, const Snapshot* version): _slot(slot), _version(version) {}
+
+/**
+ * @brief Takes over another hold, leaving it empty.
+ *
+ * @param other The hold to take over.
+ */
+VersionedGraph::ReadGuard::ReadGuard(ReadGuard&& other) noexcept: _slot(other._slot), _version(other._version) {
+    other._slot = nullptr;
+}
+
+/**
+ * @brief Releases the hold, freeing its reader slot.
+ */
+VersionedGraph::ReadGuard::~ReadGuard() {
+    if (_slot) {
+        _slot->epoch.store(0, memory_order_release);
+    }
+}
+
+/**
+ * @brief Returns the graph of the version.
+ *
+ * @return The graph, unchanged for as long as the hold lasts.
+ */
+const Graph& VersionedGraph::ReadGuard::operator*() const { return _version->graph; }
+
+/**
+ * @brief Returns the graph of the version.
+ *
+ * @return A pointer to the graph, valid for as long as the hold lasts.
+ */
+const Graph* VersionedGraph::ReadGuard::operator->() const { return &_version->graph; }
+
+/**
+ * @brief Returns the number of the version.
+ *
+ * @return The number, counting from 1 for the first version.
+ */
+uint64_t VersionedGraph::ReadGuard::Number() const { return _version->number; }
+
+// Implementation of VersionedGraph class
+
+/**
+ * @brief Constructs a versioned graph.
+ *
+ * @param graph The first version of the graph.
+ */
+VersionedGraph::VersionedGraph(Graph graph):
+    _current(new Snapshot{move(graph), 1}), _slots(new ReaderSlot[max_readers]) {}
+
+/**
+ * @brief Frees every version.
+ */
+VersionedGraph::~VersionedGraph() {
+    delete _current.load();
+    for (const auto& retired : _retired) {
+        delete retired.first;
+    }
+}
+
+/**
+ * @brief Pins the current version for reading.
+ *
+ * The reader announces the epoch it enters at in a free slot, starting from
+ * one picked by its thread id so threads rarely contend for a slot, and
+ * only then loads the current version. A writer that replaces that version
+ * afterwards advances the epoch past the announced one, so it knows to keep
+ * the version until the slot is freed. Neither step takes a lock.
+ *
+ * @return The hold on the current version.
+ */
+VersionedGraph::ReadGuard VersionedGraph::Read() const {
+    const size_t first = hash<thread::id>()(this_thread::get_id());
+    for (size_t attempt = 0; ; attempt++) {
+        ReaderSlot& slot = _slots[(first + attempt) % max_readers];
+        uint64_t free_slot = 0;
+        if (slot.epoch.load(memory_order_relaxed) == 0 &&
+            slot.epoch.compare_exchange_strong(free_slot, _epoch.load())) {
+            return ReadGuard(&slot, _current.load());
+        }
+        if (attempt % max_readers == max_readers - 1) {
+            // Every slot is held, so wait for a reader to finish
+            this_thread::yield();
+        }
+    }
+}
+
+/**
+ * @brief Makes a change to a copy of the current version and publishes the result.
+ *
+ * The copy shares everything with the current version that the change does
+ * not write. If the change throws, nothing is published.
+ *
+ * @param change Called with the copy to change.
+ * @return The number of the published version.
+ */
+uint64_t VersionedGraph::Update(const function<void(Graph&)>& change) {
+    lock_guard<mutex> lock(_write_mutex);
+    Graph next(_current.load()->graph);
+    change(next);
+    return PublishLocked(move(next));
+}
+
+/**
+ * @brief Publishes a graph as the next version.
+ *
+ * @param graph The new version of the graph.
+ * @return The number of the published version.
+ */
+uint64_t VersionedGraph::Publish(Graph graph) {
+    lock_guard<mutex> lock(_write_mutex);
+    return PublishLocked(move(graph));
+}
+
+/**
+ * @brief Returns the number of the current version.
+ *
+ * @return The version number.
+ */
+uint64_t VersionedGraph::CurrentVersion() const { return Read().Number(); }
+
+/**
+ * @brief Returns the number of replaced versions not yet freed.
+ *
+ * @return The number of versions readers may still hold.
+ */
+int VersionedGraph::NumRetired() const {
+    lock_guard<mutex> lock(_write_mutex);
+    return _retired.size();
+}
+
+/**
+ * @brief Frees the replaced versions no reader can still hold.
+ */
+void VersionedGraph::Reclaim() {
+    lock_guard<mutex> lock(_write_mutex);
+    ReclaimLocked();
+}
+
+/**
+ * @brief Swaps in a new version and retires the old one in a new epoch.
+ *
+ * @param graph The new version of the graph.
+ * @return The number of the published version.
+ */
+uint64_t VersionedGraph::PublishLocked(Graph graph) {
+    const Snapshot* next = new Snapshot{move(graph), _current.load()->number + 1};
+    const Snapshot* replaced = _current.exchange(next);
+    _retired.emplace_back(replaced, _epoch.fetch_add(1) + 1);
+    ReclaimLocked();
+    return next->number;
+}
+
+/**
+ * @brief Frees every replaced version whose epoch no reader entered before.
+ *
+ * A reader that entered in the epoch a version was replaced in, or later,
+ * loaded its version after the replacement and so cannot hold it.
+ */
+void VersionedGraph::ReclaimLocked() {
+    uint64_t oldest = numeric_limits<uint64_t>::max();
+    for (int i = 0; i < max_readers; i++) {
+        const uint64_t epoch = _slots[i].epoch.load();
+        if (epoch != 0) {
+            oldest = min(oldest, epoch);
+        }
+    }
+    auto kept = remove_if(_retired.begin(), _retired.end(), [oldest](const pair<const Snapshot*, uint64_t>& retired) {
+        if (retired.second > oldest) {
+            return false;
+        }
+        delete retired.first;
+        return true;
+    });
+    _retired.erase(kept, _retired.end());
+}
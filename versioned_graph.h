@@ -0,0 +1,124 @@
+/**
+ * @file versioned_graph.h
+ * @brief Defines a graph published in immutable versions, so queries never wait for updates.
+ */
+#ifndef VERSIONED_GRAPH_H
+#define VERSIONED_GRAPH_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "topological_map.h"
+
+/// A graph that threads route on while another thread changes its orders and edges.
+/// Each change is made to a copy of the current version and published with an atomic pointer
+/// swap, read-copy-update style. A copy shares the edge arrays, trees and heuristics of the
+/// version it was made from, and only what a change touches is copied: the order counts for
+/// orders, the edge lengths and affected trees for traffic. Readers pin the current version
+/// with Read(), which claims a reader slot and loads the pointer without taking a lock, and
+/// route on it undisturbed for as long as they hold it. A replaced version is freed by the
+/// next writer once no reader slot is pinned to an epoch from before its replacement.
+class VersionedGraph {
+    struct Snapshot;
+    struct ReaderSlot;
+
+public:
+    /// A reader's hold on one version of the graph, which stays unchanged until the hold is released.
+    class ReadGuard {
+    public:
+        /// Releases the hold.
+        ~ReadGuard();
+
+        /// Takes over another hold.
+        ReadGuard(ReadGuard&& other) noexcept;
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ReadGuard& operator=(ReadGuard&&) = delete;
+
+        /// Returns the graph of the version.
+        const Graph& operator*() const;
+
+        /// Returns the graph of the version.
+        const Graph* operator->() const;
+
+        /// Returns the number of the version, counting from 1 for the graph the VersionedGraph was made with.
+        uint64_t Number() const;
+
+    private:
+        friend class VersionedGraph;
+
+        /// Constructor.
+        /// \param slot The reader slot announcing the hold.
+        /// \param version The version held.
+        ReadGuard(ReaderSlot* slot, const Snapshot* version);
+
+        /// The reader slot announcing the hold, or a null pointer once moved from.
+        ReaderSlot* _slot;
+
+        /// The version held.
+        const Snapshot* _version;
+    };
+
+    /// Constructor.
+    /// \param graph The first version of the graph.
+    explicit VersionedGraph(Graph graph);
+
+    /// Destructor, which needs every ReadGuard to have been released.
+    ~VersionedGraph();
+
+    VersionedGraph(const VersionedGraph&) = delete;
+    VersionedGraph& operator=(const VersionedGraph&) = delete;
+
+    /// Pins the current version for reading. Never blocks on writers; waits only if
+    /// more threads than there are reader slots hold versions at once.
+    ReadGuard Read() const;
+
+    /// Makes a change to a copy of the current version and publishes the result.
+    /// Writers are serialised with each other, but never wait for readers.
+    /// \param change Called with the copy to change, such as to update orders or edges.
+    /// \return The number of the published version.
+    uint64_t Update(const std::function<void(Graph&)>& change);
+
+    /// Publishes a graph built elsewhere as the next version.
+    /// \param graph The new version of the graph.
+    /// \return The number of the published version.
+    uint64_t Publish(Graph graph);
+
+    /// Returns the number of the current version.
+    uint64_t CurrentVersion() const;
+
+    /// Returns the number of replaced versions not yet freed because readers may still hold them.
+    int NumRetired() const;
+
+    /// Frees the replaced versions no reader can still hold.
+    void Reclaim();
+
+private:
+    /// Publishes a version, which the caller holds _write_mutex to do.
+    uint64_t PublishLocked(Graph graph);
+
+    /// Frees the replaced versions no reader can still hold, which the caller holds _write_mutex to do.
+    void ReclaimLocked();
+
+    /// The current version, read without locks.
+    std::atomic<const Snapshot*> _current;
+
+    /// The epoch counter, advanced each time a version is replaced.
+    std::atomic<uint64_t> _epoch{1};
+
+    /// The reader slots, each holding the epoch its reader entered at, or 0 if free.
+    std::unique_ptr<ReaderSlot[]> _slots;
+
+    /// Serialises writers and guards _retired.
+    mutable std::mutex _write_mutex;
+
+    /// The replaced versions, each with the epoch its replacement was published in.
+    std::vector<std::pair<const Snapshot*, uint64_t>> _retired;
+};
+
+#endif